@@ -0,0 +1,77 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Read-only cache bundle: a single file with a prebuilt set of entries (see DFCacheBundleBuilder). Bundles are meant to be shipped with the app and mounted by DFCache as the lowest tier (see -[DFCache mountBundle:]) so that the prebuilt entries don't have to be imported into the disk cache.
+ @discussion Bundle file is memory-mapped, opening a bundle only validates its index. Entries are found through a minimal perfect hash function: each lookup reads a single bucket, a single slot and the entry itself. Returned data references the mapped file without copying it. Bundle never writes to disk and is safe to use from multiple threads.
+ */
+@interface DFCacheBundle : NSObject
+
+/*! Opens bundle at the given path.
+ @param error A pointer to an error object. If the file can't be mapped the pointer is set to the file system error. If the file is not a valid bundle the pointer is set to NSFileReadCorruptFileError.
+ */
+- (nullable instancetype)initWithPath:(NSString *)path error:(NSError **)error NS_DESIGNATED_INITIALIZER;
+
+/*! Unavailable initializer, please use designated initializer.
+ */
+- (instancetype)init NS_UNAVAILABLE;
+
+/*! Returns bundle file path.
+ */
+@property (nonatomic, readonly) NSString *path;
+
+/*! Returns the number of the entries in the bundle.
+ */
+@property (nonatomic, readonly) NSUInteger count;
+
+- (nullable NSData *)dataForKey:(NSString *)key;
+
+/*! Returns data for the given key and the value of the extended attribute with the given name that was added together with the data.
+ */
+- (nullable NSData *)dataForKey:(NSString *)key extendedAttributeValue:(id __nullable __autoreleasing *__nullable)value forName:(nullable NSString *)name;
+
+- (BOOL)containsDataForKey:(NSString *)key;
+
+/*! Enumerates keys of the entries in the bundle in no particular order.
+ */
+- (void)enumerateKeysUsingBlock:(void (^)(NSString *key, BOOL *stop))block;
+
+@end
+
+
+/*! Builds cache bundle file (see DFCacheBundle). Entries are written to the file as they are added, only the keys are kept in memory. The index is built and the file is moved to its path by -finish.
+ */
+@interface DFCacheBundleBuilder : NSObject
+
+/*! Initializes builder that writes bundle to the given path. Returns nil if the temporary file can't be created.
+ */
+- (nullable instancetype)initWithPath:(NSString *)path NS_DESIGNATED_INITIALIZER;
+
+/*! Unavailable initializer, please use designated initializer.
+ */
+- (instancetype)init NS_UNAVAILABLE;
+
+@property (nonatomic, readonly) NSString *path;
+
+/*! Returns the number of the added entries.
+ */
+@property (nonatomic, readonly) NSUInteger count;
+
+- (void)addData:(NSData *)data forKey:(NSString *)key;
+
+/*! Adds data together with the extended attributes. When the same key is added more than once the last entry wins.
+ @param attributes Attributes values must conform to NSCoding.
+ */
+- (void)addData:(NSData *)data forKey:(NSString *)key extendedAttributes:(nullable NSDictionary *)attributes;
+
+/*! Builds minimal perfect hash index of the added entries, synchronizes bundle file with the disk and moves it to its path. Returns NO if bundle wasn't written. Entries can't be added after the bundle is finished.
+ */
+- (BOOL)finish;
+
+@end
+
+NS_ASSUME_NONNULL_END
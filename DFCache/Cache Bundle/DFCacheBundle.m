@@ -0,0 +1,461 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFCacheBundle.h"
+#import <fcntl.h>
+#import <unistd.h>
+
+/*! Bundle layout: header, entries, buckets, slots. Entries are packed in the order they were added, each one is aligned to 8 bytes.
+ @discussion Index is a minimal perfect hash function built with "hash, displace and compress" algorithm. Keys are distributed into buckets by the first hash. Each bucket stores either the seed of the second hash that places all of its keys into distinct free slots (positive value) or the slot of its single key (negative value). Slots store offsets of the entries, entries contain their keys so that the missing keys can be detected.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;
+    uint64_t bucketCount;
+    uint64_t bucketsOffset;
+    uint64_t slotsOffset;
+    /*! Checksum of the buckets and slots.
+     */
+    uint32_t indexChecksum;
+    uint32_t reserved;
+} _DFCacheBundleHeader;
+
+/*! Entry layout: header, key, archived attributes, data.
+ */
+typedef struct {
+    uint32_t keyLength;
+    uint32_t attributesLength;
+    uint64_t dataLength;
+} _DFCacheBundleEntryHeader;
+
+static const uint32_t DFCacheBundleMagic = 0x44464342; // "DFCB"
+static const uint32_t DFCacheBundleVersion = 1;
+
+/*! Average number of keys per bucket.
+ */
+static const uint64_t DFCacheBundleBucketSize = 4;
+
+/*! Bundle fails to build if a bucket can't be placed with any of the seeds up to this value.
+ */
+static const int32_t DFCacheBundleMaximumSeed = 1 << 24;
+
+static uint32_t _DFCacheBundleChecksum(const uint8_t *bytes, size_t length) {
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*! Seeded 64-bit FNV-1a followed by the MurmurHash3 finalizer so that the hashes with different seeds are independent.
+ */
+static uint64_t _DFCacheBundleHash(const uint8_t *bytes, size_t length, uint64_t seed) {
+    uint64_t hash = 14695981039346656037ull ^ (seed * 0x9E3779B97F4A7C15ull);
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static inline uint64_t _DFCacheBundleAlign(uint64_t offset) {
+    return (offset + 7) & ~7ull;
+}
+
+
+#pragma mark - DFCacheBundle -
+
+@implementation DFCacheBundle {
+    NSData *_data;
+    _DFCacheBundleHeader _header;
+    const int32_t *_buckets;
+    const uint64_t *_slots;
+}
+
+- (instancetype)initWithPath:(NSString *)path error:(NSError *__autoreleasing *)error {
+    if (self = [super init]) {
+        _path = path;
+        _data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedAlways error:error];
+        if (!_data) {
+            return nil;
+        }
+        if (![self _load]) {
+            if (error) {
+                *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadCorruptFileError userInfo:@{ NSFilePathErrorKey : path }];
+            }
+            return nil;
+        }
+    }
+    return self;
+}
+
+- (instancetype)init {
+    [NSException raise:NSInternalInconsistencyException format:@"Please use designated initialzier"];
+    return nil;
+}
+
+- (BOOL)_load {
+    const uint8_t *bytes = _data.bytes;
+    const uint64_t length = _data.length;
+    if (length < sizeof(_DFCacheBundleHeader)) {
+        return NO;
+    }
+    memcpy(&_header, bytes, sizeof(_header));
+    if (_header.magic != DFCacheBundleMagic || _header.version != DFCacheBundleVersion) {
+        return NO;
+    }
+    // Offsets are validated without overflows, counts are limited by the file length.
+    if (_header.count > length / sizeof(uint64_t) || _header.bucketCount > length / sizeof(int32_t) ||
+        _header.bucketsOffset < sizeof(_DFCacheBundleHeader) || _header.bucketsOffset % 8 != 0 ||
+        _header.bucketsOffset > length || _header.bucketCount * sizeof(int32_t) > length - _header.bucketsOffset ||
+        _header.slotsOffset != _DFCacheBundleAlign(_header.bucketsOffset + _header.bucketCount * sizeof(int32_t)) ||
+        _header.slotsOffset > length || _header.count * sizeof(uint64_t) > length - _header.slotsOffset ||
+        (_header.count > 0) != (_header.bucketCount > 0)) {
+        return NO;
+    }
+    size_t indexLength = (size_t)(_header.slotsOffset + _header.count * sizeof(uint64_t) - _header.bucketsOffset);
+    if (_DFCacheBundleChecksum(bytes + _header.bucketsOffset, indexLength) != _header.indexChecksum) {
+        return NO;
+    }
+    _buckets = (const int32_t *)(bytes + _header.bucketsOffset);
+    _slots = (const uint64_t *)(bytes + _header.slotsOffset);
+    return YES;
+}
+
+- (NSUInteger)count {
+    return (NSUInteger)_header.count;
+}
+
+#pragma mark - Read
+
+- (NSData *)dataForKey:(NSString *)key {
+    return [self dataForKey:key extendedAttributeValue:NULL forName:nil];
+}
+
+- (NSData *)dataForKey:(NSString *)key extendedAttributeValue:(id __autoreleasing *)value forName:(NSString *)name {
+    _DFCacheBundleEntryHeader header;
+    const uint8_t *entry = [self _entryForKey:key header:&header];
+    if (!entry) {
+        return nil;
+    }
+    if (value && name && header.attributesLength > 0) {
+        NSData *archivedAttributes = [NSData dataWithBytesNoCopy:(void *)(entry + header.keyLength) length:header.attributesLength freeWhenDone:NO];
+        id attributes = [NSKeyedUnarchiver unarchiveObjectWithData:archivedAttributes];
+        *value = [attributes isKindOfClass:[NSDictionary class]] ? attributes[name] : nil;
+    }
+    // Data references the mapped file which is kept alive until the data is deallocated.
+    NSData *mappedData = _data;
+    return [[NSData alloc] initWithBytesNoCopy:(void *)(entry + header.keyLength + header.attributesLength) length:(NSUInteger)header.dataLength deallocator:^(void *bytes, NSUInteger length) {
+        (void)mappedData;
+    }];
+}
+
+- (BOOL)containsDataForKey:(NSString *)key {
+    return [self _entryForKey:key header:NULL] != NULL;
+}
+
+/*! Returns pointer to the key of the entry for the given key or NULL if there is no such entry.
+ */
+- (const uint8_t *)_entryForKey:(NSString *)key header:(_DFCacheBundleEntryHeader *)entryHeader {
+    if (!key || _header.count == 0) {
+        return NULL;
+    }
+    const char *keyBytes = [key UTF8String];
+    size_t keyLength = strlen(keyBytes);
+    int32_t seed = _buckets[_DFCacheBundleHash((const uint8_t *)keyBytes, keyLength, 0) % _header.bucketCount];
+    if (seed == 0) {
+        return NULL;
+    }
+    uint64_t slot = (seed < 0) ? (uint64_t)(-(int64_t)seed - 1) : _DFCacheBundleHash((const uint8_t *)keyBytes, keyLength, (uint64_t)seed) % _header.count;
+    if (slot >= _header.count) {
+        return NULL;
+    }
+    _DFCacheBundleEntryHeader header;
+    const uint8_t *entry = [self _entryAtOffset:_slots[slot] header:&header];
+    if (!entry || header.keyLength != keyLength || memcmp(entry, keyBytes, keyLength) != 0) {
+        return NULL;
+    }
+    if (entryHeader) {
+        *entryHeader = header;
+    }
+    return entry;
+}
+
+- (const uint8_t *)_entryAtOffset:(uint64_t)offset header:(_DFCacheBundleEntryHeader *)header {
+    const uint64_t limit = _header.bucketsOffset;
+    if (offset < sizeof(_DFCacheBundleHeader) || offset > limit || limit - offset < sizeof(*header)) {
+        return NULL;
+    }
+    const uint8_t *bytes = _data.bytes;
+    memcpy(header, bytes + offset, sizeof(*header));
+    uint64_t available = limit - offset - sizeof(*header);
+    if ((uint64_t)header->keyLength + header->attributesLength > available ||
+        header->dataLength > available - header->keyLength - header->attributesLength) {
+        return NULL;
+    }
+    return bytes + offset + sizeof(*header);
+}
+
+- (void)enumerateKeysUsingBlock:(void (^)(NSString *, BOOL *))block {
+    BOOL stop = NO;
+    for (uint64_t i = 0; i < _header.count && !stop; i++) {
+        _DFCacheBundleEntryHeader header;
+        const uint8_t *entry = [self _entryAtOffset:_slots[i] header:&header];
+        NSString *key = entry ? [[NSString alloc] initWithBytes:entry length:header.keyLength encoding:NSUTF8StringEncoding] : nil;
+        if (key) {
+            block(key, &stop);
+        }
+    }
+}
+
+#pragma mark - Miscellaneous
+
+- (NSString *)debugDescription {
+    return [NSString stringWithFormat:@"<%@ %p> { path: %@; entries: %lu }", [self class], self, _path, (unsigned long)self.count];
+}
+
+@end
+
+
+#pragma mark - DFCacheBundleBuilder -
+
+@implementation DFCacheBundleBuilder {
+    NSString *_temporaryPath;
+    int _fd;
+    uint64_t _offset;
+    BOOL _failed;
+    /*! UTF-8 representations of the keys and offsets of their entries, in the order the keys were added.
+     */
+    NSMutableArray *_keys;
+    NSMutableData *_offsets;
+    NSMutableDictionary *_indexes;
+}
+
+- (void)dealloc {
+    if (_fd >= 0) {
+        close(_fd);
+        unlink([_temporaryPath fileSystemRepresentation]);
+    }
+}
+
+- (instancetype)initWithPath:(NSString *)path {
+    if (self = [super init]) {
+        _path = path;
+        _temporaryPath = [path stringByAppendingString:@".tmp"];
+        _fd = open([_temporaryPath fileSystemRepresentation], O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (_fd < 0) {
+            return nil;
+        }
+        _keys = [NSMutableArray new];
+        _offsets = [NSMutableData new];
+        _indexes = [NSMutableDictionary new];
+        // Header is written once the index is built.
+        _DFCacheBundleHeader header = {0};
+        [self _writeBytes:&header length:sizeof(header)];
+    }
+    return self;
+}
+
+- (instancetype)init {
+    [NSException raise:NSInternalInconsistencyException format:@"Please use designated initialzier"];
+    return nil;
+}
+
+- (NSUInteger)count {
+    return _keys.count;
+}
+
+- (void)addData:(NSData *)data forKey:(NSString *)key {
+    [self addData:data forKey:key extendedAttributes:nil];
+}
+
+- (void)addData:(NSData *)data forKey:(NSString *)key extendedAttributes:(NSDictionary *)attributes {
+    if (!data || !key || _fd < 0) {
+        return;
+    }
+    NSData *keyData = [key dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *archivedAttributes = attributes.count ? [NSKeyedArchiver archivedDataWithRootObject:attributes] : nil;
+    _DFCacheBundleEntryHeader header = { (uint32_t)keyData.length, (uint32_t)archivedAttributes.length, data.length };
+    uint64_t offset = _offset;
+    [self _writeBytes:&header length:sizeof(header)];
+    [self _writeBytes:keyData.bytes length:keyData.length];
+    [self _writeBytes:archivedAttributes.bytes length:archivedAttributes.length];
+    [self _writeBytes:data.bytes length:data.length];
+    [self _writePadding];
+
+    NSNumber *index = _indexes[key];
+    if (index) {
+        // The previous entry is left in the file unreachable.
+        ((uint64_t *)_offsets.mutableBytes)[index.unsignedIntegerValue] = offset;
+    } else {
+        _indexes[key] = @(_keys.count);
+        [_keys addObject:keyData];
+        [_offsets appendBytes:&offset length:sizeof(offset)];
+    }
+}
+
+- (BOOL)finish {
+    if (_fd < 0) {
+        return NO;
+    }
+    const uint64_t count = _keys.count;
+    const uint64_t bucketCount = count ? (count + DFCacheBundleBucketSize - 1) / DFCacheBundleBucketSize : 0;
+    int32_t *buckets = calloc(MAX(bucketCount, 1), sizeof(int32_t));
+    uint64_t *slots = calloc(MAX(count, 1), sizeof(uint64_t));
+    BOOL success = [self _buildBuckets:buckets bucketCount:bucketCount slots:slots];
+
+    _DFCacheBundleHeader header = {
+        .magic = DFCacheBundleMagic,
+        .version = DFCacheBundleVersion,
+        .count = count,
+        .bucketCount = bucketCount,
+        .bucketsOffset = _offset
+    };
+    // Entries are aligned, so the slots follow the buckets padded to 8 bytes.
+    NSMutableData *index = [NSMutableData dataWithBytes:buckets length:bucketCount * sizeof(int32_t)];
+    index.length = _DFCacheBundleAlign(index.length);
+    header.slotsOffset = _offset + index.length;
+    [index appendBytes:slots length:count * sizeof(uint64_t)];
+    header.indexChecksum = _DFCacheBundleChecksum(index.bytes, index.length);
+    [self _writeBytes:index.bytes length:index.length];
+    free(buckets);
+    free(slots);
+
+    success = success && !_failed && pwrite(_fd, &header, sizeof(header), 0) == sizeof(header);
+    success = success && (fcntl(_fd, F_FULLFSYNC) == 0 || fsync(_fd) == 0);
+    close(_fd);
+    _fd = -1;
+    success = success && rename([_temporaryPath fileSystemRepresentation], [_path fileSystemRepresentation]) == 0;
+    if (!success) {
+        unlink([_temporaryPath fileSystemRepresentation]);
+    }
+    return success;
+}
+
+/*! Builds minimal perfect hash function of the keys. Returns NO if some bucket can't be placed.
+ */
+- (BOOL)_buildBuckets:(int32_t *)buckets bucketCount:(uint64_t)bucketCount slots:(uint64_t *)slots {
+    const uint64_t count = _keys.count;
+    if (count == 0) {
+        return YES;
+    }
+    const uint64_t *offsets = _offsets.bytes;
+
+    // Distribute keys into buckets (counting sort by the bucket).
+    uint64_t *keyBuckets = malloc(count * sizeof(uint64_t));
+    uint64_t *bucketStarts = calloc(bucketCount + 1, sizeof(uint64_t));
+    for (uint64_t i = 0; i < count; i++) {
+        NSData *key = _keys[i];
+        keyBuckets[i] = _DFCacheBundleHash(key.bytes, key.length, 0) % bucketCount;
+        bucketStarts[keyBuckets[i] + 1]++;
+    }
+    for (uint64_t b = 0; b < bucketCount; b++) {
+        bucketStarts[b + 1] += bucketStarts[b];
+    }
+    uint64_t *bucketKeys = malloc(count * sizeof(uint64_t));
+    uint64_t *fill = malloc(bucketCount * sizeof(uint64_t));
+    memcpy(fill, bucketStarts, bucketCount * sizeof(uint64_t));
+    for (uint64_t i = 0; i < count; i++) {
+        bucketKeys[fill[keyBuckets[i]]++] = i;
+    }
+    free(fill);
+    free(keyBuckets);
+
+    // Larger buckets are placed first while most of the slots are free.
+    uint64_t *order = malloc(bucketCount * sizeof(uint64_t));
+    for (uint64_t b = 0; b < bucketCount; b++) {
+        order[b] = b;
+    }
+    qsort_b(order, bucketCount, sizeof(uint64_t), ^int(const void *lhs, const void *rhs) {
+        uint64_t size1 = bucketStarts[*(const uint64_t *)lhs + 1] - bucketStarts[*(const uint64_t *)lhs];
+        uint64_t size2 = bucketStarts[*(const uint64_t *)rhs + 1] - bucketStarts[*(const uint64_t *)rhs];
+        return size1 > size2 ? -1 : (size1 < size2 ? 1 : 0);
+    });
+
+    uint8_t *occupied = calloc(count, 1);
+    uint64_t *candidates = malloc(count * sizeof(uint64_t));
+    BOOL success = YES;
+    uint64_t i = 0;
+    for (; i < bucketCount && success; i++) {
+        const uint64_t b = order[i];
+        const uint64_t start = bucketStarts[b], size = bucketStarts[b + 1] - start;
+        if (size < 2) {
+            break;
+        }
+        success = NO;
+        for (int32_t seed = 1; seed < DFCacheBundleMaximumSeed && !success; seed++) {
+            uint64_t placed = 0;
+            for (; placed < size; placed++) {
+                NSData *key = _keys[bucketKeys[start + placed]];
+                uint64_t slot = _DFCacheBundleHash(key.bytes, key.length, (uint64_t)seed) % count;
+                if (occupied[slot]) {
+                    break;
+                }
+                occupied[slot] = 1; // Also detects collisions within the bucket.
+                candidates[placed] = slot;
+            }
+            if (placed == size) {
+                buckets[b] = seed;
+                for (uint64_t k = 0; k < size; k++) {
+                    slots[candidates[k]] = offsets[bucketKeys[start + k]];
+                }
+                success = YES;
+            } else {
+                for (uint64_t k = 0; k < placed; k++) {
+                    occupied[candidates[k]] = 0;
+                }
+            }
+        }
+    }
+    // Buckets with a single key take the remaining free slots directly.
+    uint64_t freeSlot = 0;
+    for (; i < bucketCount && success; i++) {
+        const uint64_t b = order[i];
+        if (bucketStarts[b + 1] - bucketStarts[b] == 0) {
+            break;
+        }
+        while (occupied[freeSlot]) {
+            freeSlot++;
+        }
+        occupied[freeSlot] = 1;
+        buckets[b] = -(int32_t)freeSlot - 1;
+        slots[freeSlot] = offsets[bucketKeys[bucketStarts[b]]];
+    }
+    free(candidates);
+    free(occupied);
+    free(order);
+    free(bucketKeys);
+    free(bucketStarts);
+    return success;
+}
+
+- (void)_writeBytes:(const void *)bytes length:(uint64_t)length {
+    const uint8_t *buffer = bytes;
+    while (length > 0 && !_failed) {
+        ssize_t written = write(_fd, buffer, (size_t)MIN(length, (uint64_t)INT32_MAX));
+        if (written < 0) {
+            if (errno != EINTR) {
+                _failed = YES;
+            }
+            continue;
+        }
+        buffer += written;
+        length -= written;
+        _offset += written;
+    }
+}
+
+- (void)_writePadding {
+    static const uint8_t padding[8] = {0};
+    [self _writeBytes:padding length:_DFCacheBundleAlign(_offset) - _offset];
+}
+
+@end
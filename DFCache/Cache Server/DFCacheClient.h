@@ -0,0 +1,110 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import <Foundation/Foundation.h>
+#import "DFValueTransformerFactory.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Client of the cache served by DFCacheServer over a Unix domain socket. Mirrors DFCache API.
+ @discussion Requests are pipelined over a single connection: asynchronous methods send the request and return without waiting for the response, the server executes requests in the order they were sent. If you store the object and then immediately retrieve it then you are guaranteed to get the object back.
+
+ Objects are encoded on the calling thread using value transformer factory and stored with the name of their value transformer in front of the encoded data, the server never decodes them. Client keeps decoded objects in its own memory cache. Completion blocks are called on the main thread. If the connection is lost reads return nil and writes are discarded.
+ */
+@interface DFCacheClient : NSObject
+
+/*! Connects to the server listening on the given socket path.
+ @param memoryCache Memory cache of decoded objects, might be nil.
+ @return Client or nil if the connection can't be established.
+ */
+- (nullable instancetype)initWithSocketPath:(NSString *)socketPath memoryCache:(nullable NSCache *)memoryCache error:(NSError **)error NS_DESIGNATED_INITIALIZER;
+
+/*! Connects to the server listening on the given socket path. Client is initialized with a new memory cache.
+ */
+- (nullable instancetype)initWithSocketPath:(NSString *)socketPath error:(NSError **)error;
+
+/*! Unavailable initializer, please use designated initializer.
+ */
+- (instancetype)init NS_UNAVAILABLE;
+
+@property (nonatomic, readonly) NSString *socketPath;
+
+/*! The transformer factory used by client. Client is initialized with a default value transformer factory.
+ */
+@property (nonatomic) id<DFValueTransformerFactory> valueTransfomerFactory;
+
+/*! Returns memory cache used by receiver. Memory cache might be nil.
+ */
+@property (nullable, nonatomic, readonly) NSCache *memoryCache;
+
+/*! Maximum time in seconds to wait for the response to a request. If the server doesn't respond in time the connection is closed and all the pending requests fail. Default value is 10 seconds.
+ */
+@property (nonatomic) NSTimeInterval requestTimeout;
+
+/*! Returns NO if the connection to the server was lost.
+ */
+@property (nonatomic, readonly, getter=isConnected) BOOL connected;
+
+#pragma mark - Read
+
+/*! Reads object from either memory cache or the server. Puts object retrieved from the server into memory cache.
+ */
+- (void)cachedObjectForKey:(NSString *)key completion:(void (^__nullable)(id __nullable object))completion;
+
+/*! Returns object from either memory cache or the server.
+ */
+- (nullable id)cachedObjectForKey:(NSString *)key;
+
+#pragma mark - Write
+
+/*! Stores object into memory cache and sends its encoded data to the server.
+ */
+- (void)storeObject:(id)object forKey:(NSString *)key;
+
+/*! Stores object into memory cache and sends the given data to the server. If the data is nil the object is encoded using value transformer.
+ */
+- (void)storeObject:(id)object forKey:(NSString *)key data:(nullable NSData *)data;
+
+/*! Stores object into memory cache only.
+ */
+- (void)setObject:(id)object forKey:(NSString *)key;
+
+#pragma mark - Remove
+
+- (void)removeObjectsForKeys:(NSArray *)keys;
+- (void)removeObjectForKey:(NSString *)key;
+- (void)removeAllObjects;
+
+#pragma mark - Metadata
+
+- (nullable NSDictionary *)metadataForKey:(NSString *)key;
+- (void)setMetadata:(NSDictionary *)metadata forKey:(NSString *)key;
+- (void)removeMetadataForKey:(NSString *)key;
+
+#pragma mark - Data
+
+/*! Reads data from the server as it was stored, objects are read with the name of their value transformer in front of the data.
+ */
+- (void)cachedDataForKey:(NSString *)key completion:(void (^__nullable)(NSData *__nullable data))completion;
+- (nullable NSData *)cachedDataForKey:(NSString *)key;
+
+/*! Sends data to the server without touching memory cache.
+ */
+- (void)storeData:(NSData *)data forKey:(NSString *)key;
+
+#pragma mark - Batch
+
+/*! Reads data for multiple keys with a single request. Returns dictionary with key:data pairs of the found entries.
+ */
+- (void)batchCachedDataForKeys:(NSArray *)keys completion:(void (^__nullable)(NSDictionary *__nullable batch))completion;
+- (nullable NSDictionary *)batchCachedDataForKeys:(NSArray *)keys;
+
+/*! Reads objects from memory cache and the rest of them from the server with a single request. Returns dictionary with key:object pairs of the found entries.
+ */
+- (void)batchCachedObjectsForKeys:(NSArray *)keys completion:(void (^__nullable)(NSDictionary *__nullable batch))completion;
+- (nullable NSDictionary *)batchCachedObjectsForKeys:(NSArray *)keys;
+
+@end
+
+NS_ASSUME_NONNULL_END
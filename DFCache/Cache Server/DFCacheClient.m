@@ -0,0 +1,604 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFCacheClient.h"
+#import "DFCachePrivate.h"
+#import "DFCacheServerProtocol.h"
+#import "DFValueTransformer.h"
+#import <fcntl.h>
+#import <sys/socket.h>
+#import <unistd.h>
+
+/*! Size of the buffer used to read responses from the socket.
+ */
+static const size_t DFCacheClientReadBufferSize = 1024 * 64;
+
+/*! Called on the response queue with the status and payload of the response, payload is nil if the connection was lost.
+ */
+typedef void (^_DFCacheClientResponseHandler)(uint8_t status, NSData *payload);
+
+static NSData *_DFCacheClientKeyPayload(NSString *key) {
+    NSMutableData *payload = [NSMutableData new];
+    _DFCacheServerAppendString(payload, key);
+    return payload;
+}
+
+static NSData *_DFCacheClientKeysPayload(NSArray *keys) {
+    NSMutableData *payload = [NSMutableData new];
+    _DFCacheServerAppendUInt32(payload, (uint32_t)keys.count);
+    for (NSString *key in keys) {
+        _DFCacheServerAppendString(payload, key);
+    }
+    return payload;
+}
+
+
+@implementation DFCacheClient {
+    int _socket;
+    /*! Serializes writes to the socket so that the handlers are queued in the order of the requests.
+     */
+    NSLock *_writeLock;
+    /*! Guards handlers and connection state. Never held while writing to the socket.
+     */
+    NSLock *_lock;
+    NSMutableArray *_handlers;
+    /*! Number of the sent requests and of the received responses, responses are received in the order of requests.
+     */
+    uint64_t _requestCount;
+    uint64_t _responseCount;
+    BOOL _disconnected;
+    /*! Serial dispatch queue on which responses are read and handlers are called.
+     */
+    dispatch_queue_t _queue;
+    dispatch_source_t _source;
+    /*! Received bytes of the incomplete response. Only accessed on response queue.
+     */
+    NSMutableData *_buffer;
+    /*! Concurrent dispatch queue used for dispatching blocks that decode objects.
+     */
+    dispatch_queue_t _processingQueue;
+}
+
+- (instancetype)initWithSocketPath:(NSString *)socketPath memoryCache:(NSCache *)memoryCache error:(NSError *__autoreleasing *)error {
+    if (self = [super init]) {
+        if (!socketPath.length) {
+            [NSException raise:NSInvalidArgumentException format:@"Attempting to initialize client without socket path"];
+        }
+        _socketPath = [socketPath copy];
+        _memoryCache = memoryCache;
+        _valueTransfomerFactory = [DFValueTransformerFactory defaultFactory];
+        _requestTimeout = 10.0;
+        _writeLock = [NSLock new];
+        _lock = [NSLock new];
+        _handlers = [NSMutableArray new];
+        _queue = dispatch_queue_create("DFCacheClient::ResponseQueue", DISPATCH_QUEUE_SERIAL);
+        _buffer = [NSMutableData new];
+        _processingQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+        if (![self _connectWithError:error]) {
+            return nil;
+        }
+    }
+    return self;
+}
+
+- (instancetype)initWithSocketPath:(NSString *)socketPath error:(NSError *__autoreleasing *)error {
+    return [self initWithSocketPath:socketPath memoryCache:[NSCache new] error:error];
+}
+
+- (instancetype)init {
+    [NSException raise:NSInternalInconsistencyException format:@"Please use designated initialzier"];
+    return nil;
+}
+
+- (void)dealloc {
+    if (_source) {
+        dispatch_source_cancel(_source);
+    }
+}
+
+#pragma mark - Connection
+
+- (BOOL)_connectWithError:(NSError *__autoreleasing *)error {
+    struct sockaddr_un address;
+    if (!_DFCacheServerSocketAddress(_socketPath, &address)) {
+        if (error) {
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENAMETOOLONG userInfo:@{ NSFilePathErrorKey : _socketPath }];
+        }
+        return NO;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        if (error) {
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{ NSFilePathErrorKey : _socketPath }];
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NO;
+    }
+    int enabled = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &enabled, sizeof(enabled));
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    _socket = fd;
+    _source = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, fd, 0, _queue);
+    DFCacheClient *__weak weakSelf = self;
+    dispatch_source_set_event_handler(_source, ^{
+        [weakSelf _readResponses];
+    });
+    dispatch_source_set_cancel_handler(_source, ^{
+        close(fd);
+    });
+    dispatch_resume(_source);
+    return YES;
+}
+
+- (BOOL)isConnected {
+    [_lock lock];
+    BOOL connected = !_disconnected;
+    [_lock unlock];
+    return connected;
+}
+
+/*! Fails all the pending requests. Requests sent after disconnection fail immediately.
+ */
+- (void)_disconnect {
+    [_lock lock];
+    _disconnected = YES;
+    NSArray *handlers = [_handlers copy];
+    [_handlers removeAllObjects];
+    [_lock unlock];
+    dispatch_async(_queue, ^{
+        for (_DFCacheClientResponseHandler handler in handlers) {
+            handler(DFCacheServerStatusError, nil);
+        }
+    });
+}
+
+/*! Fails all the pending requests and closes the socket. Must be called on response queue.
+ */
+- (void)_closeConnection {
+    [self _disconnect];
+    if (_source) {
+        // The socket is closed by the cancel handler once the writer that might be using it is done.
+        [_writeLock lock];
+        dispatch_source_cancel(_source);
+        [_writeLock unlock];
+        _source = nil;
+    }
+}
+
+/*! Closes the connection if the request is not answered within request timeout. Responses are matched to requests by order, so the connection can't be used once a response is late.
+ */
+- (void)_scheduleTimeoutForRequestAtIndex:(uint64_t)index {
+    DFCacheClient *__weak weakSelf = self;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.requestTimeout * NSEC_PER_SEC)), _queue, ^{
+        DFCacheClient *client = weakSelf;
+        if (client) {
+            [client->_lock lock];
+            BOOL pending = !client->_disconnected && client->_responseCount <= index;
+            [client->_lock unlock];
+            if (pending) {
+                [client _closeConnection];
+            }
+        }
+    });
+}
+
+/*! Sends the request without waiting for the response. Handler is called on the response queue.
+ */
+- (void)_sendOperation:(DFCacheServerOperation)operation payload:(NSData *)payload handler:(_DFCacheClientResponseHandler)handler {
+    handler = [handler copy] ?: ^(uint8_t status, NSData *payload) {};
+    NSMutableData *frame = [NSMutableData new];
+    if (!_DFCacheServerAppendFrame(frame, operation, payload)) {
+        // Server would disconnect the client that sends a frame longer than the limit.
+        dispatch_async(_queue, ^{
+            handler(DFCacheServerStatusError, nil);
+        });
+        return;
+    }
+    [_writeLock lock];
+    [_lock lock];
+    BOOL disconnected = _disconnected;
+    uint64_t index = _requestCount;
+    if (!disconnected) {
+        [_handlers addObject:handler];
+        _requestCount++;
+    }
+    [_lock unlock];
+    if (disconnected) {
+        [_writeLock unlock];
+        dispatch_async(_queue, ^{
+            handler(DFCacheServerStatusError, nil);
+        });
+        return;
+    }
+    BOOL written = _DFCacheServerWrite(_socket, frame);
+    [_writeLock unlock];
+    if (!written) {
+        [self _disconnect];
+    } else {
+        [self _scheduleTimeoutForRequestAtIndex:index];
+    }
+}
+
+/*! Sends the request and waits for the response. Returns the status of the response.
+ */
+- (uint8_t)_sendSynchronousOperation:(DFCacheServerOperation)operation payload:(NSData *)payload response:(NSData *__autoreleasing *)response {
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    uint8_t __block status = DFCacheServerStatusError;
+    NSData *__block responsePayload;
+    [self _sendOperation:operation payload:payload handler:^(uint8_t responseStatus, NSData *payload) {
+        status = responseStatus;
+        responsePayload = payload;
+        dispatch_semaphore_signal(semaphore);
+    }];
+    if (dispatch_semaphore_wait(semaphore, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.requestTimeout * NSEC_PER_SEC))) != 0) {
+        // Fails the requests right away in case the response queue is busy.
+        [self _disconnect];
+        dispatch_async(_queue, ^{
+            [self _closeConnection];
+        });
+        if (response) {
+            *response = nil;
+        }
+        return DFCacheServerStatusError;
+    }
+    if (response) {
+        *response = responsePayload;
+    }
+    return status;
+}
+
+/*! Reads available bytes and calls the handlers of the received responses in order. Must be called on response queue.
+ */
+- (void)_readResponses {
+    uint8_t bytes[DFCacheClientReadBufferSize];
+    for (;;) {
+        ssize_t count = read(_socket, bytes, sizeof(bytes));
+        if (count > 0) {
+            [_buffer appendBytes:bytes length:count];
+            // Frames are checked as the bytes arrive so that at most a single frame is buffered.
+            if (![self _handleResponses]) {
+                [self _closeConnection];
+                return;
+            }
+            continue;
+        }
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0 && errno == EAGAIN) {
+            return;
+        }
+        [self _closeConnection]; // Disconnected
+        return;
+    }
+}
+
+/*! Calls the handlers of the received responses. Returns NO if the frame is invalid. Must be called on response queue.
+ */
+- (BOOL)_handleResponses {
+    NSUInteger offset = 0;
+    uint8_t status;
+    NSData *payload;
+    BOOL invalid;
+    while (_DFCacheServerReadFrame(_buffer, &offset, &status, &payload, &invalid)) {
+        [_lock lock];
+        _DFCacheClientResponseHandler handler = _handlers.firstObject;
+        if (handler) {
+            [_handlers removeObjectAtIndex:0];
+            _responseCount++;
+        }
+        [_lock unlock];
+        if (handler) {
+            handler(status, payload);
+        }
+    }
+    [_buffer replaceBytesInRange:NSMakeRange(0, offset) withBytes:NULL length:0];
+    return !invalid;
+}
+
+#pragma mark - Read
+
+- (void)cachedObjectForKey:(NSString *)key completion:(void (^)(id))completion {
+    if (!completion) {
+        return;
+    }
+    if (!key.length) {
+        _dwarf_cache_callback(completion, nil);
+        return;
+    }
+    id object = [self.memoryCache objectForKey:key];
+    if (object) {
+        _dwarf_cache_callback(completion, object);
+        return;
+    }
+    [self _sendOperation:DFCacheServerOperationGet payload:_DFCacheClientKeyPayload(key) handler:^(uint8_t status, NSData *payload) {
+        dispatch_async(_processingQueue, ^{
+            @autoreleasepool {
+                id object = status == DFCacheServerStatusOK ? [self _objectWithFrame:payload forKey:key] : nil;
+                _dwarf_cache_callback(completion, object);
+            }
+        });
+    }];
+}
+
+- (id)cachedObjectForKey:(NSString *)key {
+    if (!key.length) {
+        return nil;
+    }
+    id object = [self.memoryCache objectForKey:key];
+    if (object) {
+        return object;
+    }
+    NSData *payload;
+    if ([self _sendSynchronousOperation:DFCacheServerOperationGet payload:_DFCacheClientKeyPayload(key) response:&payload] != DFCacheServerStatusOK) {
+        return nil;
+    }
+    return [self _objectWithFrame:payload forKey:key];
+}
+
+/*! Decodes object and puts it into memory cache.
+ */
+- (id)_objectWithFrame:(NSData *)frame forKey:(NSString *)key {
+    NSString *valueTransformerName;
+    NSData *data = _dwarf_cache_unframe(frame, &valueTransformerName);
+    if (!data) {
+        return nil;
+    }
+    id<DFValueTransforming> valueTransformer = [self.valueTransfomerFactory valueTransformerForName:valueTransformerName];
+    id object = [valueTransformer reverseTransfomedValue:data];
+    [self _setObject:object forKey:key valueTransformer:valueTransformer];
+    return object;
+}
+
+#pragma mark - Write
+
+- (void)storeObject:(id)object forKey:(NSString *)key {
+    [self storeObject:object forKey:key data:nil];
+}
+
+- (void)storeObject:(id)object forKey:(NSString *)key data:(NSData *)data {
+    if (!key.length) {
+        return;
+    }
+    NSString *valueTransformerName = [self.valueTransfomerFactory valueTransformerNameForValue:object];
+    id<DFValueTransforming> valueTransformer = [self.valueTransfomerFactory valueTransformerForName:valueTransformerName];
+
+    [self _setObject:object forKey:key valueTransformer:valueTransformer];
+
+    @autoreleasepool {
+        NSData *encodedData = data ?: [valueTransformer transformedValue:object];
+        NSData *frame = encodedData ? _dwarf_cache_frame(encodedData, valueTransformerName) : nil;
+        if (frame) {
+            [self _sendPutWithData:frame forKey:key];
+        }
+    }
+}
+
+- (void)setObject:(id)object forKey:(NSString *)key {
+    [self _setObject:object forKey:key valueTransformer:nil];
+}
+
+- (void)_setObject:(id)object forKey:(NSString *)key valueTransformer:(id<DFValueTransforming>)valueTransformer {
+    if (!object || !key.length) {
+        return;
+    }
+    if (!valueTransformer) {
+        NSString *valueTransformerName = [self.valueTransfomerFactory valueTransformerNameForValue:object];
+        valueTransformer = [self.valueTransfomerFactory valueTransformerForName:valueTransformerName];
+    }
+    NSUInteger cost = 0;
+    if ([valueTransformer respondsToSelector:@selector(costForValue:)]) {
+        cost = [valueTransformer costForValue:object];
+    }
+    [self.memoryCache setObject:object forKey:key cost:cost];
+}
+
+- (void)_sendPutWithData:(NSData *)data forKey:(NSString *)key {
+    NSMutableData *payload = [NSMutableData new];
+    _DFCacheServerAppendString(payload, key);
+    _DFCacheServerAppendField(payload, data);
+    [self _sendOperation:DFCacheServerOperationPut payload:payload handler:nil];
+}
+
+#pragma mark - Remove
+
+- (void)removeObjectsForKeys:(NSArray *)keys {
+    if (!keys.count) {
+        return;
+    }
+    for (NSString *key in keys) {
+        [self.memoryCache removeObjectForKey:key];
+    }
+    [self _sendOperation:DFCacheServerOperationRemove payload:_DFCacheClientKeysPayload(keys) handler:nil];
+}
+
+- (void)removeObjectForKey:(NSString *)key {
+    if (key) {
+        [self removeObjectsForKeys:@[key]];
+    }
+}
+
+- (void)removeAllObjects {
+    [self.memoryCache removeAllObjects];
+    [self _sendOperation:DFCacheServerOperationRemoveAll payload:nil handler:nil];
+}
+
+#pragma mark - Metadata
+
+- (NSDictionary *)metadataForKey:(NSString *)key {
+    if (!key.length) {
+        return nil;
+    }
+    NSData *payload;
+    if ([self _sendSynchronousOperation:DFCacheServerOperationGetMetadata payload:_DFCacheClientKeyPayload(key) response:&payload] != DFCacheServerStatusOK) {
+        return nil;
+    }
+    return _DFCacheServerUnarchiveMetadata(payload);
+}
+
+- (void)setMetadata:(NSDictionary *)metadata forKey:(NSString *)key {
+    if (!metadata || !key.length) {
+        return;
+    }
+    NSMutableData *payload = [NSMutableData new];
+    _DFCacheServerAppendString(payload, key);
+    _DFCacheServerAppendField(payload, [NSKeyedArchiver archivedDataWithRootObject:metadata]);
+    [self _sendOperation:DFCacheServerOperationSetMetadata payload:payload handler:nil];
+}
+
+- (void)removeMetadataForKey:(NSString *)key {
+    if (!key.length) {
+        return;
+    }
+    [self _sendOperation:DFCacheServerOperationRemoveMetadata payload:_DFCacheClientKeyPayload(key) handler:nil];
+}
+
+#pragma mark - Data
+
+- (void)cachedDataForKey:(NSString *)key completion:(void (^)(NSData *))completion {
+    if (!completion) {
+        return;
+    }
+    if (!key.length) {
+        _dwarf_cache_callback(completion, nil);
+        return;
+    }
+    [self _sendOperation:DFCacheServerOperationGet payload:_DFCacheClientKeyPayload(key) handler:^(uint8_t status, NSData *payload) {
+        _dwarf_cache_callback(completion, status == DFCacheServerStatusOK ? payload : nil);
+    }];
+}
+
+- (NSData *)cachedDataForKey:(NSString *)key {
+    if (!key.length) {
+        return nil;
+    }
+    NSData *payload;
+    if ([self _sendSynchronousOperation:DFCacheServerOperationGet payload:_DFCacheClientKeyPayload(key) response:&payload] != DFCacheServerStatusOK) {
+        return nil;
+    }
+    return payload;
+}
+
+- (void)storeData:(NSData *)data forKey:(NSString *)key {
+    if (!data || !key.length) {
+        return;
+    }
+    [self _sendPutWithData:data forKey:key];
+}
+
+#pragma mark - Batch
+
+- (void)batchCachedDataForKeys:(NSArray *)keys completion:(void (^)(NSDictionary *))completion {
+    if (!keys.count) {
+        _dwarf_cache_callback(completion, nil);
+        return;
+    }
+    keys = [keys copy];
+    [self _sendOperation:DFCacheServerOperationMultiGet payload:_DFCacheClientKeysPayload(keys) handler:^(uint8_t status, NSData *payload) {
+        _dwarf_cache_callback(completion, status == DFCacheServerStatusOK ? [self _batchWithPayload:payload keys:keys] : nil);
+    }];
+}
+
+- (NSDictionary *)batchCachedDataForKeys:(NSArray *)keys {
+    if (!keys.count) {
+        return nil;
+    }
+    NSData *payload;
+    if ([self _sendSynchronousOperation:DFCacheServerOperationMultiGet payload:_DFCacheClientKeysPayload(keys) response:&payload] != DFCacheServerStatusOK) {
+        return nil;
+    }
+    return [self _batchWithPayload:payload keys:keys];
+}
+
+- (void)batchCachedObjectsForKeys:(NSArray *)keys completion:(void (^)(NSDictionary *))completion {
+    if (!keys.count) {
+        _dwarf_cache_callback(completion, nil);
+        return;
+    }
+    NSMutableDictionary *batch = [NSMutableDictionary new];
+    NSArray *remainingKeys = [self _addMemoryObjectsForKeys:keys toBatch:batch];
+    if (!remainingKeys.count) {
+        _dwarf_cache_callback(completion, batch);
+        return;
+    }
+    [self _sendOperation:DFCacheServerOperationMultiGet payload:_DFCacheClientKeysPayload(remainingKeys) handler:^(uint8_t status, NSData *payload) {
+        NSDictionary *frames = status == DFCacheServerStatusOK ? [self _batchWithPayload:payload keys:remainingKeys] : nil;
+        dispatch_async(_processingQueue, ^{
+            @autoreleasepool {
+                [self _addObjectsWithFrames:frames toBatch:batch];
+            }
+            _dwarf_cache_callback(completion, batch);
+        });
+    }];
+}
+
+- (NSDictionary *)batchCachedObjectsForKeys:(NSArray *)keys {
+    if (!keys.count) {
+        return nil;
+    }
+    NSMutableDictionary *batch = [NSMutableDictionary new];
+    NSArray *remainingKeys = [self _addMemoryObjectsForKeys:keys toBatch:batch];
+    if (remainingKeys.count) {
+        NSData *payload;
+        if ([self _sendSynchronousOperation:DFCacheServerOperationMultiGet payload:_DFCacheClientKeysPayload(remainingKeys) response:&payload] == DFCacheServerStatusOK) {
+            [self _addObjectsWithFrames:[self _batchWithPayload:payload keys:remainingKeys] toBatch:batch];
+        }
+    }
+    return batch;
+}
+
+/*! Adds objects found in memory cache to the batch. Returns the keys of the objects that were not found.
+ */
+- (NSArray *)_addMemoryObjectsForKeys:(NSArray *)keys toBatch:(NSMutableDictionary *)batch {
+    NSMutableArray *remainingKeys = [NSMutableArray new];
+    for (NSString *key in keys) {
+        id object = [self.memoryCache objectForKey:key];
+        if (object) {
+            batch[key] = object;
+        } else {
+            [remainingKeys addObject:key];
+        }
+    }
+    return remainingKeys;
+}
+
+- (void)_addObjectsWithFrames:(NSDictionary *)frames toBatch:(NSMutableDictionary *)batch {
+    [frames enumerateKeysAndObjectsUsingBlock:^(NSString *key, NSData *frame, BOOL *stop) {
+        id object = [self _objectWithFrame:frame forKey:key];
+        if (object) {
+            batch[key] = object;
+        }
+    }];
+}
+
+/*! Parses the response to the MultiGet request. Returns dictionary with key:data pairs of the found entries. Response might be cut short, the keys that are missing from it are not found.
+ */
+- (NSDictionary *)_batchWithPayload:(NSData *)payload keys:(NSArray *)keys {
+    NSMutableDictionary *batch = [NSMutableDictionary new];
+    _DFCacheServerCursor cursor = _DFCacheServerCursorMake(payload);
+    for (NSString *key in keys) {
+        if (cursor.offset >= cursor.length) {
+            break;
+        }
+        BOOL found = cursor.bytes[cursor.offset++] != 0;
+        if (found) {
+            NSData *data = _DFCacheServerReadField(&cursor);
+            if (cursor.failed) {
+                break;
+            }
+            batch[key] = data;
+        }
+    }
+    return [batch copy];
+}
+
+#pragma mark - Miscellaneous
+
+- (NSString *)debugDescription {
+    return [NSString stringWithFormat:@"<%@ %p> { socket: %@; memoryCache: %@ }", [self class], self, _socketPath, self.memoryCache];
+}
+
+@end
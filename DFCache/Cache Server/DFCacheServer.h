@@ -0,0 +1,46 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import <Foundation/Foundation.h>
+
+@class DFCache;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Serves the cache to the other processes on the host over a Unix domain socket (see DFCacheClient). A single server process (see dfcached tool) owns the memory and disk tiers instead of each process keeping its own copy.
+ @discussion Each connection is handled on its own serial queue, requests of the connection are executed and answered in order. Server works with encoded data only: it keeps data of the recently read and written entries in the memory cache of the served cache (cost is the length of data) and never decodes objects. Use a cache dedicated to the server.
+ */
+@interface DFCacheServer : NSObject
+
+/*! Initializes server with the given cache and the path of the socket.
+ @param socketPath Path of the socket. Must be shorter than 104 bytes.
+ */
+- (instancetype)initWithCache:(DFCache *)cache socketPath:(NSString *)socketPath NS_DESIGNATED_INITIALIZER;
+
+/*! Unavailable initializer, please use designated initializer.
+ */
+- (instancetype)init NS_UNAVAILABLE;
+
+@property (nonatomic, readonly) DFCache *cache;
+@property (nonatomic, readonly) NSString *socketPath;
+
+/*! Returns YES if the server accepts connections.
+ */
+@property (nonatomic, readonly, getter=isRunning) BOOL running;
+
+/*! Returns the number of the connected clients.
+ */
+@property (nonatomic, readonly) NSUInteger connectionCount;
+
+/*! Binds the socket and starts accepting connections. Socket file left by the previous server is replaced.
+ */
+- (BOOL)startWithError:(NSError **)error;
+
+/*! Closes the socket and all the connections.
+ */
+- (void)stop;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,402 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFCache.h"
+#import "DFCacheServer.h"
+#import "DFCacheServerProtocol.h"
+#import <fcntl.h>
+#import <sys/socket.h>
+#import <unistd.h>
+
+/*! Size of the buffer used to read requests from the socket.
+ */
+static const size_t DFCacheServerReadBufferSize = 1024 * 64;
+
+
+@interface _DFCacheServerConnection : NSObject {
+    @public
+    int _socket;
+    /*! Serial queue on which requests of the connection are read and executed.
+     */
+    dispatch_queue_t _queue;
+    dispatch_source_t _source;
+    /*! Received bytes of the requests that are not executed yet. Only accessed on connection queue.
+     */
+    NSMutableData *_buffer;
+}
+@end
+
+@implementation _DFCacheServerConnection
+@end
+
+/*! Stops reading the connection, the socket is closed by the cancel handler. Must be called on connection queue.
+ */
+static void _DFCacheServerConnectionClose(_DFCacheServerConnection *connection) {
+    if (connection->_source) {
+        dispatch_source_cancel(connection->_source);
+        connection->_source = nil;
+    }
+}
+
+
+@implementation DFCacheServer {
+    NSLock *_lock;
+    /*! Serial queue on which connections are accepted.
+     */
+    dispatch_queue_t _acceptQueue;
+    dispatch_source_t _acceptSource;
+    NSMutableSet *_connections;
+}
+
+- (instancetype)initWithCache:(DFCache *)cache socketPath:(NSString *)socketPath {
+    if (self = [super init]) {
+        if (!cache || !socketPath.length) {
+            [NSException raise:NSInvalidArgumentException format:@"Attempting to initialize server without cache or socket path"];
+        }
+        _cache = cache;
+        _socketPath = [socketPath copy];
+        _lock = [NSLock new];
+        _acceptQueue = dispatch_queue_create("DFCacheServer::AcceptQueue", DISPATCH_QUEUE_SERIAL);
+        _connections = [NSMutableSet new];
+    }
+    return self;
+}
+
+- (instancetype)init {
+    [NSException raise:NSInternalInconsistencyException format:@"Please use designated initialzier"];
+    return nil;
+}
+
+- (void)dealloc {
+    [self stop];
+}
+
+#pragma mark - Lifecycle
+
+- (BOOL)startWithError:(NSError *__autoreleasing *)error {
+    [_lock lock];
+    BOOL success = _acceptSource != nil || [self _startWithError:error];
+    [_lock unlock];
+    return success;
+}
+
+- (BOOL)_startWithError:(NSError *__autoreleasing *)error {
+    struct sockaddr_un address;
+    if (!_DFCacheServerSocketAddress(_socketPath, &address)) {
+        if (error) {
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENAMETOOLONG userInfo:@{ NSFilePathErrorKey : _socketPath }];
+        }
+        return NO;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0) {
+        unlink(address.sun_path);
+    }
+    if (fd < 0 || bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0 || fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+        if (error) {
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{ NSFilePathErrorKey : _socketPath }];
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NO;
+    }
+    dispatch_source_t source = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, fd, 0, _acceptQueue);
+    DFCacheServer *__weak weakSelf = self;
+    dispatch_source_set_event_handler(source, ^{
+        [weakSelf _acceptConnectionsFromSocket:fd];
+    });
+    dispatch_source_set_cancel_handler(source, ^{
+        close(fd);
+    });
+    _acceptSource = source;
+    dispatch_resume(source);
+    return YES;
+}
+
+- (void)stop {
+    [_lock lock];
+    dispatch_source_t source = _acceptSource;
+    _acceptSource = nil;
+    NSArray *connections = [_connections allObjects];
+    [_connections removeAllObjects];
+    [_lock unlock];
+    if (source) {
+        dispatch_source_cancel(source);
+        unlink(_socketPath.fileSystemRepresentation);
+    }
+    for (_DFCacheServerConnection *connection in connections) {
+        dispatch_async(connection->_queue, ^{
+            _DFCacheServerConnectionClose(connection);
+        });
+    }
+}
+
+- (BOOL)isRunning {
+    [_lock lock];
+    BOOL running = _acceptSource != nil;
+    [_lock unlock];
+    return running;
+}
+
+- (NSUInteger)connectionCount {
+    [_lock lock];
+    NSUInteger count = _connections.count;
+    [_lock unlock];
+    return count;
+}
+
+#pragma mark - Connections
+
+- (void)_acceptConnectionsFromSocket:(int)listeningSocket {
+    for (;;) {
+        int fd = accept(listeningSocket, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return; // EAGAIN, no more pending connections
+        }
+        int enabled = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &enabled, sizeof(enabled));
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+
+        _DFCacheServerConnection *connection = [_DFCacheServerConnection new];
+        connection->_socket = fd;
+        connection->_queue = dispatch_queue_create("DFCacheServer::ConnectionQueue", DISPATCH_QUEUE_SERIAL);
+        connection->_buffer = [NSMutableData new];
+        connection->_source = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, fd, 0, connection->_queue);
+        DFCacheServer *__weak weakSelf = self;
+        dispatch_source_set_event_handler(connection->_source, ^{
+            DFCacheServer *server = weakSelf;
+            if (server) {
+                [server _readConnection:connection];
+            } else {
+                _DFCacheServerConnectionClose(connection);
+            }
+        });
+        dispatch_source_set_cancel_handler(connection->_source, ^{
+            close(fd);
+        });
+        [_lock lock];
+        [_connections addObject:connection];
+        [_lock unlock];
+        dispatch_resume(connection->_source);
+    }
+}
+
+- (void)_closeConnection:(_DFCacheServerConnection *)connection {
+    _DFCacheServerConnectionClose(connection);
+    [_lock lock];
+    [_connections removeObject:connection];
+    [_lock unlock];
+}
+
+/*! Reads available bytes and executes the requests as they arrive, responses to the requests received with a single read are sent at once. Must be called on connection queue.
+ */
+- (void)_readConnection:(_DFCacheServerConnection *)connection {
+    uint8_t bytes[DFCacheServerReadBufferSize];
+    for (;;) {
+        ssize_t count = read(connection->_socket, bytes, sizeof(bytes));
+        if (count > 0) {
+            [connection->_buffer appendBytes:bytes length:count];
+            // Frames are checked as the bytes arrive so that the peer can't make the server buffer more than a single frame.
+            if (![self _executeRequestsOfConnection:connection]) {
+                [self _closeConnection:connection];
+                return;
+            }
+            continue;
+        }
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0 && errno == EAGAIN) {
+            return;
+        }
+        [self _closeConnection:connection]; // Disconnected
+        return;
+    }
+}
+
+/*! Executes the received requests and sends their responses. Returns NO if the frame is invalid or the responses can't be written. Must be called on connection queue.
+ */
+- (BOOL)_executeRequestsOfConnection:(_DFCacheServerConnection *)connection {
+    NSMutableData *responses = [NSMutableData new];
+    NSUInteger offset = 0;
+    uint8_t operation;
+    NSData *payload;
+    BOOL invalid;
+    while (_DFCacheServerReadFrame(connection->_buffer, &offset, &operation, &payload, &invalid)) {
+        @autoreleasepool {
+            [self _executeOperation:operation payload:payload response:responses];
+        }
+    }
+    [connection->_buffer replaceBytesInRange:NSMakeRange(0, offset) withBytes:NULL length:0];
+    BOOL written = !responses.length || _DFCacheServerWrite(connection->_socket, responses);
+    return written && !invalid;
+}
+
+#pragma mark - Operations
+
+- (void)_executeOperation:(uint8_t)operation payload:(NSData *)payload response:(NSMutableData *)response {
+    _DFCacheServerCursor cursor = _DFCacheServerCursorMake(payload);
+    switch (operation) {
+        case DFCacheServerOperationGet: {
+            NSString *key = _DFCacheServerReadString(&cursor);
+            if (cursor.failed) {
+                break;
+            }
+            NSData *data = [self _dataForKey:key];
+            if (!_DFCacheServerAppendFrame(response, data ? DFCacheServerStatusOK : DFCacheServerStatusNotFound, data)) {
+                break; // Data doesn't fit in a frame
+            }
+            return;
+        }
+        case DFCacheServerOperationPut: {
+            NSString *key = _DFCacheServerReadString(&cursor);
+            NSData *data = _DFCacheServerReadField(&cursor);
+            if (cursor.failed || !key.length) {
+                break;
+            }
+            [self _setMemoryData:data forKey:key];
+            [self.cache storeData:data forKey:key];
+            _DFCacheServerAppendFrame(response, DFCacheServerStatusOK, nil);
+            return;
+        }
+        case DFCacheServerOperationRemove: {
+            NSArray *keys = [self _readKeys:&cursor];
+            if (cursor.failed) {
+                break;
+            }
+            [self.cache removeObjectsForKeys:keys];
+            _DFCacheServerAppendFrame(response, DFCacheServerStatusOK, nil);
+            return;
+        }
+        case DFCacheServerOperationRemoveAll: {
+            [self.cache removeAllObjects];
+            _DFCacheServerAppendFrame(response, DFCacheServerStatusOK, nil);
+            return;
+        }
+        case DFCacheServerOperationGetMetadata: {
+            NSString *key = _DFCacheServerReadString(&cursor);
+            if (cursor.failed) {
+                break;
+            }
+            NSDictionary *metadata = [self.cache metadataForKey:key];
+            NSData *archivedMetadata = metadata ? [NSKeyedArchiver archivedDataWithRootObject:metadata] : nil;
+            if (!_DFCacheServerAppendFrame(response, archivedMetadata ? DFCacheServerStatusOK : DFCacheServerStatusNotFound, archivedMetadata)) {
+                break;
+            }
+            return;
+        }
+        case DFCacheServerOperationSetMetadata: {
+            NSString *key = _DFCacheServerReadString(&cursor);
+            NSData *archivedMetadata = _DFCacheServerReadField(&cursor);
+            NSDictionary *metadata = cursor.failed ? nil : _DFCacheServerUnarchiveMetadata(archivedMetadata);
+            if (!metadata) {
+                break;
+            }
+            [self.cache setMetadata:metadata forKey:key];
+            _DFCacheServerAppendFrame(response, DFCacheServerStatusOK, nil);
+            return;
+        }
+        case DFCacheServerOperationRemoveMetadata: {
+            NSString *key = _DFCacheServerReadString(&cursor);
+            if (cursor.failed) {
+                break;
+            }
+            [self.cache removeMetadataForKey:key];
+            _DFCacheServerAppendFrame(response, DFCacheServerStatusOK, nil);
+            return;
+        }
+        case DFCacheServerOperationMultiGet: {
+            NSArray *keys = [self _readKeys:&cursor];
+            if (cursor.failed) {
+                break;
+            }
+            NSDictionary *batch = [self _dataForKeys:keys];
+            NSMutableData *batchPayload = [NSMutableData new];
+            for (NSString *key in keys) {
+                NSData *data = batch[key];
+                // Response is cut before the entry that doesn't fit in a frame, the remaining keys are reported as not found.
+                if (batchPayload.length + 1 + (data ? sizeof(uint32_t) + data.length : 0) >= DFCacheServerMaximumFrameLength) {
+                    break;
+                }
+                uint8_t found = data != nil;
+                [batchPayload appendBytes:&found length:1];
+                if (data) {
+                    _DFCacheServerAppendField(batchPayload, data);
+                }
+            }
+            _DFCacheServerAppendFrame(response, DFCacheServerStatusOK, batchPayload);
+            return;
+        }
+        default:
+            break;
+    }
+    _DFCacheServerAppendFrame(response, DFCacheServerStatusError, nil);
+}
+
+- (NSArray *)_readKeys:(_DFCacheServerCursor *)cursor {
+    uint32_t count = _DFCacheServerReadUInt32(cursor);
+    NSMutableArray *keys = [NSMutableArray new];
+    for (uint32_t i = 0; i < count && !cursor->failed; i++) {
+        NSString *key = _DFCacheServerReadString(cursor);
+        if (key) {
+            [keys addObject:key];
+        }
+    }
+    return keys;
+}
+
+#pragma mark - Data
+
+/*! Reads data from memory cache, then from the cache (which reads from disk cache and bundles).
+ */
+- (NSData *)_dataForKey:(NSString *)key {
+    NSData *data = [self _memoryDataForKey:key];
+    if (!data) {
+        data = [self.cache cachedDataForKey:key];
+        [self _setMemoryData:data forKey:key];
+    }
+    return data;
+}
+
+- (NSDictionary *)_dataForKeys:(NSArray *)keys {
+    NSMutableDictionary *batch = [NSMutableDictionary new];
+    NSMutableArray *remainingKeys = [NSMutableArray new];
+    for (NSString *key in keys) {
+        NSData *data = [self _memoryDataForKey:key];
+        if (data) {
+            batch[key] = data;
+        } else {
+            [remainingKeys addObject:key];
+        }
+    }
+    NSDictionary *diskBatch = remainingKeys.count ? [self.cache batchCachedDataForKeys:remainingKeys] : nil;
+    for (NSString *key in diskBatch) {
+        [self _setMemoryData:diskBatch[key] forKey:key];
+    }
+    [batch addEntriesFromDictionary:diskBatch];
+    return batch;
+}
+
+- (NSData *)_memoryDataForKey:(NSString *)key {
+    id object = [self.cache.memoryCache objectForKey:key];
+    return [object isKindOfClass:[NSData class]] ? object : nil;
+}
+
+- (void)_setMemoryData:(NSData *)data forKey:(NSString *)key {
+    if (data) {
+        [self.cache.memoryCache setObject:data forKey:key cost:data.length];
+    }
+}
+
+#pragma mark - Miscellaneous
+
+- (NSString *)debugDescription {
+    return [NSString stringWithFormat:@"<%@ %p> { socket: %@; connections: %lu }", [self class], self, _socketPath, (unsigned long)self.connectionCount];
+}
+
+@end
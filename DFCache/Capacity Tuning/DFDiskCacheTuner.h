@@ -0,0 +1,52 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class DFDiskCache;
+
+/*! Controller that adjusts disk cache capacity and cleanup rate based on the statistics collected by the disk cache, including ghost hits (misses on recently evicted entries that more capacity would have avoided).
+ @discussion Disk cache calls tuner each time before it cleans up its contents. Tuner adjusts capacity within the [minimumCapacity, maximumCapacity] bounds to reach the target hit ratio. It also raises cleanup rate (evicts less) while ghost hits are observed and gradually lowers it back when they are not.
+ */
+@interface DFDiskCacheTuner : NSObject
+
+/*! Initializes tuner with the given capacity bounds.
+ @param minimumCapacity Minimum disk cache capacity, in bytes.
+ @param maximumCapacity Maximum disk cache capacity, in bytes. Raises NSInvalidArgumentException if it is less than minimum capacity.
+ */
+- (instancetype)initWithMinimumCapacity:(unsigned long long)minimumCapacity maximumCapacity:(unsigned long long)maximumCapacity NS_DESIGNATED_INITIALIZER;
+
+/*! Unavailable initializer, please use designated initializer.
+ */
+- (instancetype)init NS_UNAVAILABLE;
+
+@property (nonatomic, readonly) unsigned long long minimumCapacity;
+@property (nonatomic, readonly) unsigned long long maximumCapacity;
+
+/*! Hit ratio that tuner tries to reach, in the range of 0.0 to 1.0. Default value is 0.9. Set to 0.0 to only tune cleanup rate.
+ */
+@property (nonatomic) float targetHitRatio;
+
+/*! Maximum number of bytes the disk cache is allowed to use. When set to non-zero value, capacity never grows past the budget even if target hit ratio is not reached. Default value is 0 (no budget).
+ */
+@property (nonatomic) unsigned long long byteBudget;
+
+/*! Cleanup rate bounds, in the range of 0.0 to 1.0. Default values are 0.5 and 0.9.
+ */
+@property (nonatomic) float minimumCleanupRate;
+@property (nonatomic) float maximumCleanupRate;
+
+/*! Minimum number of reads that should happen between two tuning passes for tuner to make any adjustments. Default value is 100.
+ */
+@property (nonatomic) NSUInteger minimumSampleCount;
+
+/*! Adjusts capacity and cleanup rate of the given disk cache based on the statistics collected since the previous call.
+ */
+- (void)tuneDiskCache:(DFDiskCache *)diskCache;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,81 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFDiskCacheTuner.h"
+#import "DFDiskCache.h"
+
+/*! Maximum relative capacity change in a single tuning pass.
+ */
+static const double DFDiskCacheTunerMaxCapacityStep = 0.25;
+
+/*! Cleanup rate change in a single tuning pass.
+ */
+static const float DFDiskCacheTunerCleanupRateStep = 0.05f;
+
+@implementation DFDiskCacheTuner {
+    DFDiskCacheStatistics _previousStatistics;
+}
+
+- (instancetype)initWithMinimumCapacity:(unsigned long long)minimumCapacity maximumCapacity:(unsigned long long)maximumCapacity {
+    if (self = [super init]) {
+        if (maximumCapacity < minimumCapacity) {
+            [NSException raise:NSInvalidArgumentException format:@"Attempting to initialize tuner with maximum capacity less than minimum capacity"];
+        }
+        _minimumCapacity = minimumCapacity;
+        _maximumCapacity = maximumCapacity;
+        _targetHitRatio = 0.9f;
+        _minimumCleanupRate = 0.5f;
+        _maximumCleanupRate = 0.9f;
+        _minimumSampleCount = 100;
+    }
+    return self;
+}
+
+- (instancetype)init {
+    [NSException raise:NSInternalInconsistencyException format:@"Please use designated initialzier"];
+    return nil;
+}
+
+- (void)tuneDiskCache:(DFDiskCache *)diskCache {
+    DFDiskCacheStatistics statistics = diskCache.statistics;
+    if (statistics.hitCount < _previousStatistics.hitCount || statistics.missCount < _previousStatistics.missCount) {
+        _previousStatistics = (DFDiskCacheStatistics){0}; // Statistics were reset
+    }
+    unsigned long long hits = statistics.hitCount - _previousStatistics.hitCount;
+    unsigned long long misses = statistics.missCount - _previousStatistics.missCount;
+    unsigned long long ghostHits = statistics.ghostHitCount - MIN(statistics.ghostHitCount, _previousStatistics.ghostHitCount);
+    unsigned long long reads = hits + misses;
+    if (reads < _minimumSampleCount) {
+        return; // Not enough samples, keep accumulating
+    }
+    _previousStatistics = statistics;
+
+    double hitRatio = (double)hits / reads;
+    double ghostHitRatio = (double)ghostHits / reads;
+
+    unsigned long long capacity = diskCache.capacity;
+    if (_targetHitRatio > 0.f) {
+        if (hitRatio < _targetHitRatio && ghostHits > 0) {
+            // Misses that more capacity would have avoided, grow proportionally to them.
+            double step = MIN(DFDiskCacheTunerMaxCapacityStep, ghostHitRatio * 2.0);
+            capacity = capacity + (unsigned long long)(capacity * MAX(step, 0.05));
+        } else if (hitRatio > _targetHitRatio && ghostHits == 0) {
+            // Target reached without help from recently evicted entries, give disk space back.
+            capacity = capacity - (unsigned long long)(capacity * 0.05);
+        }
+    }
+    unsigned long long maximumCapacity = _byteBudget ? MIN(_maximumCapacity, _byteBudget) : _maximumCapacity;
+    capacity = MAX(_minimumCapacity, MIN(maximumCapacity, capacity));
+    diskCache.capacity = capacity;
+
+    float cleanupRate = diskCache.cleanupRate;
+    if (ghostHits > 0) {
+        cleanupRate += DFDiskCacheTunerCleanupRateStep;
+    } else {
+        cleanupRate -= DFDiskCacheTunerCleanupRateStep;
+    }
+    diskCache.cleanupRate = MAX(_minimumCleanupRate, MIN(_maximumCleanupRate, cleanupRate));
+}
+
+@end
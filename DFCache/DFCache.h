@@ -3,7 +3,18 @@
 // Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
 
 #import <Foundation/Foundation.h>
+#import "DFCacheBundle.h"
+#import "DFCacheClient.h"
+#import "DFCacheServer.h"
 #import "DFDiskCache.h"
+#import "DFDiskCacheTuner.h"
+#import "DFLSMStorage.h"
+#import "DFMemoryStorage.h"
+#import "DFPackStorage.h"
+#import "DFSharedMemoryStorage.h"
+#import "DFSlabStorage.h"
+#import "DFStorageEngine.h"
+#import "DFStripedStorage.h"
 #import "DFValueTransformer.h"
 #import "DFValueTransformerFactory.h"
 #import "DFCacheImageDecoder.h"
@@ -48,6 +59,18 @@ extern NSString *const DFCacheAttributeMetadataKey;
  */
 - (instancetype)initWithName:(NSString *)name memoryCache:(nullable NSCache *)memoryCache;
 
+/*! Initializes cache by creating DFDiskCache instance with a given storage engine and calling designated initializer.
+ @param engine Storage engine that disk cache keeps its entries in (see DFDiskCache initWithEngine:). Raises NSInvalidArgumentException if engine is nil.
+ @param memoryCache Memory cache. Pass nil to disable in-memory cache.
+ */
+- (instancetype)initWithEngine:(id<DFStorageEngine>)engine memoryCache:(nullable NSCache *)memoryCache;
+
+/*! Initializes cache with a hierarchy of disk caches, from the fastest to the slowest. Each disk cache becomes the lower tier of the previous one (see DFDiskCache lowerTier), the first one is used as the disk cache of DFCache.
+ @param diskCaches Disk caches, raises NSInvalidArgumentException if the array is empty.
+ @param memoryCache Memory cache. Pass nil to disable in-memory cache.
+ */
+- (instancetype)initWithDiskCaches:(NSArray *)diskCaches memoryCache:(nullable NSCache *)memoryCache;
+
 /*! Initializes cache by creating DFDiskCache instance with a given name and NSCache instance and calling designated initializer.
  @param name Name used to initialize disk cache. Raises NSInvalidArgumentException if name length is 0.
  */
@@ -69,6 +92,11 @@ extern NSString *const DFCacheAttributeMetadataKey;
  */
 @property (nullable, nonatomic, readonly) NSCache *memoryCache;
 
+/*! Shared memory tier that keeps encoded data shared by the processes on the host between memory cache and disk cache. Processes that open the same segment share a single set of hot entries, each of them keeps only decoded objects in its own memory cache. Default value is nil.
+ @note Set the tier before using the cache.
+ */
+@property (nullable, nonatomic) DFSharedMemoryStorage *sharedMemoryTier;
+
 #pragma mark - Read
 
 /*! Reads object from either in-memory or on-disk cache. Refreshes object in memory cache it it was retrieved from disk. Uses value transformer provided by value transformer factory.
@@ -97,6 +125,11 @@ extern NSString *const DFCacheAttributeMetadataKey;
  */
 - (void)storeObject:(id)object forKey:(NSString *)key data:(nullable NSData *)data;
 
+/*! Stores objects (key:object pairs) into memory cache. Encodes objects and stores their data into disk cache at once as a single locality group so that the objects that are read together can be fetched with a single read (see DFPackStorage and -batchCachedDataForKeys:).
+ @param group Locality group of the objects.
+ */
+- (void)storeObjects:(NSDictionary *)objects localityGroup:(nullable NSString *)group;
+
 /*! Stores object into memory cache. Retrieves value transformer from factory and uses it to calculate object cost.
  @param object The object to store into memory cache.
  */
@@ -118,6 +151,15 @@ extern NSString *const DFCacheAttributeMetadataKey;
  */
 - (void)removeAllObjects;
 
+/*! Removes objects which keys start with the given prefix from disk cache, memory cache and shared memory tier. Metadata is also removed. Does nothing with disk cache which storage engine doesn't support key prefixes (see -[DFDiskCache supportsKeyPrefixes]).
+ @discussion Memory cache can't enumerate its keys, objects are removed from memory cache by the keys found in disk cache and the keys tracked for memory snapshot. Keys are read from disk cache synchronously.
+ */
+- (void)removeObjectsForKeysWithPrefix:(NSString *)prefix;
+
+/*! Enumerates keys of the objects stored in disk cache that start with the given prefix. Does nothing if the storage engine of disk cache doesn't support key prefixes.
+ */
+- (void)enumerateKeysWithPrefix:(NSString *)prefix usingBlock:(void (^)(NSString *key, BOOL *stop))block;
+
 #pragma mark - Metadata
 
 /*! Returns copy of metadata for provided key.
@@ -160,6 +202,39 @@ extern NSString *const DFCacheAttributeMetadataKey;
  */
 - (void)cleanupDiskCache;
 
+/*! Sets the time interval of the timer that reconciles the index of the disk cache contents with the storage directory. Each reconciliation scans the entire directory. Default value is 0 which means that the timer is disabled, enable it if the directory is modified by other means.
+ */
+- (void)setReconciliationTimerInterval:(NSTimeInterval)timeInterval;
+
+/*! Reconciles running totals of the disk cache contents asynchronously on the background queue. For more info see DFDiskCache - (long long)reconcileContents.
+ */
+- (void)reconcileDiskCacheContents;
+
+#pragma mark - Memory Snapshot
+
+/*! Enables or disables memory snapshots. Memory snapshots are disabled by default.
+ @discussion When enabled, cache keeps track of the keys of the objects in memory cache ranked by recency and frequency of access. The list of the hottest keys is periodically saved into the disk cache directory. The first time memory snapshots are enabled (usually right after initialization) cache starts restoring the snapshot saved by the previous launch in the background, see -restoreMemorySnapshotWithCompletion:. Requires both disk and memory cache.
+ */
+- (void)setMemorySnapshotEnabled:(BOOL)enabled;
+
+/*! Sets memory snapshot time interval and schedules snapshot timer with the given time interval. Default value is 60 seconds.
+ */
+- (void)setMemorySnapshotTimerInterval:(NSTimeInterval)timeInterval;
+
+/*! Maximum number of keys saved in memory snapshot. Default value is 1000.
+ */
+@property (nonatomic) NSUInteger memorySnapshotCapacity;
+
+/*! Saves memory snapshot asynchronously. Call this method before the application shuts down. On iOS and tvOS memory snapshot is also saved automatically when the application enters background.
+ */
+- (void)saveMemorySnapshot;
+
+/*! Loads objects for the keys from the last saved memory snapshot into memory cache in the background, the most valuable objects first. Called automatically when memory snapshots are enabled, call it to get notified when the objects are loaded or to restore the snapshot without tracking the keys.
+ @discussion Objects are read from disk in small batches interleaved with other disk IO operations. Loading stops when memory cache count limit or total cost limit is reached. Objects that are already in memory cache are not replaced.
+ @param completion Completion block with the number of objects loaded into memory cache.
+ */
+- (void)restoreMemorySnapshotWithCompletion:(void (^__nullable)(NSUInteger count))completion;
+
 #pragma mark - Data
 
 /*! Retrieves data from disk cache.
@@ -179,6 +254,40 @@ extern NSString *const DFCacheAttributeMetadataKey;
  */
 - (void)storeData:(NSData *)data forKey:(NSString *)key;
 
+#pragma mark - Export & Import
+
+/*! Asynchronously writes all disk cache entries to the stream as a single sequential archive (see -[DFDiskCache exportContentsToStream:]). Entries keep the names of their value transformers, metadata and access times. Mounted bundles are not exported.
+ @param completion Completion block that is called on the main thread, success is NO if the stream failed.
+ */
+- (void)exportContentsToStream:(NSOutputStream *)stream completion:(void (^__nullable)(BOOL success))completion;
+
+/*! Asynchronously reads archive written by -exportContentsToStream:completion: into disk cache (see -[DFDiskCache importContentsFromStream:]). Memory cache is cleared once the import finishes.
+ @param completion Completion block that is called on the main thread, success is NO if the archive is damaged or any of the entries wasn't written.
+ */
+- (void)importContentsFromStream:(NSInputStream *)stream completion:(void (^__nullable)(BOOL success))completion;
+
+#pragma mark - Bundles
+
+/*! Mounts read-only bundle (see DFCacheBundle) as the lowest tier of the cache. Reads that miss both memory and disk caches are answered by the mounted bundles in the order they were mounted. Bundle data is never copied into the disk cache, decoded objects are put into the memory cache.
+ @discussion Removing objects from the cache doesn't affect the bundles, objects with the same keys are going to be read from the bundles again.
+ */
+- (void)mountBundle:(DFCacheBundle *)bundle;
+
+- (void)unmountBundle:(DFCacheBundle *)bundle;
+
+/*! Returns mounted bundles.
+ */
+@property (nonatomic, readonly) NSArray *bundles;
+
+@end
+
+
+@interface DFCacheBundleBuilder (DFCache)
+
+/*! Encodes object using the value transformer provided by the given factory and adds it to the bundle so that DFCache decodes it the same way as the objects stored into the cache.
+ */
+- (void)addObject:(id)object forKey:(NSString *)key valueTransformerFactory:(id<DFValueTransformerFactory>)factory;
+
 @end
 
 
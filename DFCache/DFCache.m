@@ -3,18 +3,18 @@
 // Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
 
 #import "DFCache.h"
+#import "DFCacheKeyTracker.h"
 #import "DFCachePrivate.h"
 #import "DFCacheTimer.h"
 #import "DFValueTransformer.h"
 #import "DFValueTransformerFactory.h"
-#import "NSURL+DFExtendedFileAttributes.h"
 
 
 NSString *const DFCacheAttributeMetadataKey = @"_df_cache_metadata_key";
 
-/*! Extended attribute name used to store value transformer associated with data.
+/*! Maximum number of entries read from disk in a single disk IO operation when restoring memory snapshot.
  */
-static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_value_transformer_name_key";
+static const NSUInteger DFCacheMemorySnapshotRestoreBatchSize = 16;
 
 
 @implementation DFCache {
@@ -22,6 +22,18 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
     NSTimeInterval _cleanupTimeInterval;
     NSTimer *__weak _cleanupTimer;
     
+    NSTimeInterval _reconciliationTimeInterval;
+    NSTimer *__weak _reconciliationTimer;
+    
+    BOOL _memorySnapshotEnabled;
+    BOOL _memorySnapshotRestoreStarted;
+    NSTimeInterval _memorySnapshotTimeInterval;
+    NSTimer *__weak _memorySnapshotTimer;
+    
+    /*! Ranks keys of the objects in memory cache. Created once and used from any thread, only tracks keys when memory snapshots are enabled.
+     */
+    DFCacheKeyTracker *_keyTracker;
+    
     /*! Serial dispatch queue used for all disk IO operations. If you store the object using DFCache asynchronous API and then immediately try to retrieve it then you are guaranteed to get the object back.
      */
     dispatch_queue_t _ioQueue;
@@ -29,11 +41,17 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
     /*! Concurrent dispatch queue used for dispatching blocks that decode cached data.
      */
     dispatch_queue_t _processingQueue;
+    
+    /*! Mounted bundles. Only accessed on IO queue.
+     */
+    NSArray *_bundles;
 }
 
 - (void)dealloc {
     [[NSNotificationCenter defaultCenter] removeObserver:self];
     [_cleanupTimer invalidate];
+    [_reconciliationTimer invalidate];
+    [_memorySnapshotTimer invalidate];
 }
 
 - (instancetype)initWithDiskCache:(DFDiskCache *)diskCache memoryCache:(NSCache *)memoryCache {
@@ -50,8 +68,14 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
         _cleanupTimerEnabled = YES;
         [self _scheduleCleanupTimer];
         
+        _memorySnapshotTimeInterval = 60.f;
+        _memorySnapshotCapacity = 1000;
+        _keyTracker = [[DFCacheKeyTracker alloc] initWithCapacity:_memorySnapshotCapacity];
+        _keyTracker.enabled = NO;
+        
 #if TARGET_OS_IOS || TARGET_OS_TV
         [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(_didReceiveMemoryWarning:) name:UIApplicationDidReceiveMemoryWarningNotification object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(_didEnterBackground:) name:UIApplicationDidEnterBackgroundNotification object:nil];
 #endif
     }
     return self;
@@ -67,6 +91,23 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
     return [self initWithDiskCache:diskCache memoryCache:memoryCache];
 }
 
+- (instancetype)initWithEngine:(id<DFStorageEngine>)engine memoryCache:(NSCache *)memoryCache {
+    DFDiskCache *diskCache = [[DFDiskCache alloc] initWithEngine:engine];
+    diskCache.capacity = 1024 * 1024 * 100; // 100 Mb
+    diskCache.cleanupRate = 0.5f;
+    return [self initWithDiskCache:diskCache memoryCache:memoryCache];
+}
+
+- (instancetype)initWithDiskCaches:(NSArray *)diskCaches memoryCache:(NSCache *)memoryCache {
+    if (!diskCaches.count) {
+        [NSException raise:NSInvalidArgumentException format:@"Attemting to initialize DFCache without disk caches"];
+    }
+    for (NSUInteger i = 0; i + 1 < diskCaches.count; i++) {
+        ((DFDiskCache *)diskCaches[i]).lowerTier = diskCaches[i + 1];
+    }
+    return [self initWithDiskCache:diskCaches.firstObject memoryCache:memoryCache];
+}
+
 - (instancetype)initWithName:(NSString *)name {
     NSCache *memoryCache = [NSCache new];
     memoryCache.name = name;
@@ -87,14 +128,19 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
     }
     id object = [self.memoryCache objectForKey:key];
     if (object) {
+        [_keyTracker recordAccessForKey:key];
         _dwarf_cache_callback(completion, object);
         return;
     }
-    dispatch_async(_processingQueue, ^{
-        @autoreleasepool {
-            id object = [self _cachedObjectForKey:key];
-            _dwarf_cache_callback(completion, object);
-        }
+    dispatch_async(_ioQueue, ^{
+        [self _readDiskDataForKey:key completion:^(NSData *data, NSString *valueTransformerName) {
+            dispatch_async(_processingQueue, ^{
+                @autoreleasepool {
+                    id object = [self _objectWithData:data valueTransformerName:valueTransformerName forKey:key];
+                    _dwarf_cache_callback(completion, object);
+                }
+            });
+        }];
     });
 }
 
@@ -104,6 +150,7 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
     }
     id object = [self.memoryCache objectForKey:key];
     if (object) {
+        [_keyTracker recordAccessForKey:key];
         return object;
     }
     @autoreleasepool {
@@ -115,18 +162,116 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
     NSData *__block data;
     NSString *__block valueTransformerName;
     dispatch_sync(_ioQueue, ^{
-        NSURL *fileURL = [self.diskCache URLForKey:key];
-        data = [NSData dataWithContentsOfURL:fileURL];
-        if (data) {
-            valueTransformerName = [fileURL df_extendedAttributeValueForKey:DFCacheAttributeValueTransformerNameKey error:nil];
-        }
+        NSString *name;
+        data = [self _diskDataForKey:key valueTransformerName:&name];
+        valueTransformerName = name;
     });
+    return [self _objectWithData:data valueTransformerName:valueTransformerName forKey:key];
+}
+
+/*! Decodes object and puts it into memory cache.
+ */
+- (id)_objectWithData:(NSData *)data valueTransformerName:(NSString *)valueTransformerName forKey:(NSString *)key {
     id<DFValueTransforming> valueTransformer = [self.valueTransfomerFactory valueTransformerForName:valueTransformerName];
     id object = [valueTransformer reverseTransfomedValue:data];
     [self _setObject:object forKey:key valueTransformer:valueTransformer];
     return object;
 }
 
+/*! Reads data and the name of the associated value transformer from disk cache. Must be called on IO queue.
+ */
+- (NSData *)_diskDataForKey:(NSString *)key valueTransformerName:(NSString *__autoreleasing *)valueTransformerName {
+    NSData *data = [self _sharedMemoryDataForKey:key valueTransformerName:valueTransformerName];
+    if (data) {
+        return data;
+    }
+    id value;
+    data = [self.diskCache dataForKey:key extendedAttributeValue:&value forName:DFCacheAttributeValueTransformerNameKey];
+    if (data) {
+        *valueTransformerName = value;
+    } else {
+        data = [self _bundleDataForKey:key valueTransformerName:valueTransformerName];
+    }
+    [self _setSharedMemoryData:data valueTransformerName:*valueTransformerName forKey:key];
+    return data;
+}
+
+/*! Reads data and the name of the associated value transformer from disk cache asynchronously. Data is read using dispatch I/O without blocking IO queue. Must be called on IO queue, completion is called on IO queue.
+ */
+- (void)_readDiskDataForKey:(NSString *)key completion:(void (^)(NSData *data, NSString *valueTransformerName))completion {
+    NSString *valueTransformerName;
+    NSData *data = [self _sharedMemoryDataForKey:key valueTransformerName:&valueTransformerName];
+    if (data || !self.diskCache) {
+        if (!data) {
+            data = [self _bundleDataForKey:key valueTransformerName:&valueTransformerName];
+            [self _setSharedMemoryData:data valueTransformerName:valueTransformerName forKey:key];
+        }
+        completion(data, valueTransformerName);
+        return;
+    }
+    [self.diskCache readDataForKey:key extendedAttributeName:DFCacheAttributeValueTransformerNameKey queue:_ioQueue completion:^(NSData *data, id value) {
+        if (!data) {
+            NSString *valueTransformerName;
+            data = [self _bundleDataForKey:key valueTransformerName:&valueTransformerName];
+            value = valueTransformerName;
+        }
+        [self _setSharedMemoryData:data valueTransformerName:value forKey:key];
+        completion(data, value);
+    }];
+}
+
+/*! Reads data and the names of the associated value transformers for multiple keys from shared memory tier, disk cache and bundles, in that order. Data read from disk cache and bundles is put into shared memory tier. Must be called on IO queue, completion is called on IO queue.
+ */
+- (void)_readDiskDataForKeys:(NSArray *)keys completion:(void (^)(NSMutableDictionary *batch, NSMutableDictionary *valueTransformerNames))completion {
+    NSMutableDictionary *batch = [NSMutableDictionary new];
+    NSMutableDictionary *valueTransformerNames = [NSMutableDictionary new];
+    NSMutableArray *remainingKeys = [NSMutableArray new];
+    for (NSString *key in keys) {
+        NSString *valueTransformerName;
+        NSData *data = [self _sharedMemoryDataForKey:key valueTransformerName:&valueTransformerName];
+        if (data) {
+            batch[key] = data;
+            if (valueTransformerName) {
+                valueTransformerNames[key] = valueTransformerName;
+            }
+        } else {
+            [remainingKeys addObject:key];
+        }
+    }
+    void (^readBundles)(void) = ^{
+        [self _addBundleDataForKeys:remainingKeys toBatch:batch valueTransformerNames:valueTransformerNames];
+        for (NSString *key in remainingKeys) {
+            [self _setSharedMemoryData:batch[key] valueTransformerName:valueTransformerNames[key] forKey:key];
+        }
+        completion(batch, valueTransformerNames);
+    };
+    if (!remainingKeys.count || !self.diskCache) {
+        readBundles();
+        return;
+    }
+    [self.diskCache readDataForKeys:remainingKeys extendedAttributeName:DFCacheAttributeValueTransformerNameKey queue:_ioQueue completion:^(NSDictionary *diskBatch, NSDictionary *values) {
+        [batch addEntriesFromDictionary:diskBatch];
+        [valueTransformerNames addEntriesFromDictionary:values];
+        readBundles();
+    }];
+}
+
+/*! Reads data and the name of the associated value transformer from shared memory tier.
+ */
+- (NSData *)_sharedMemoryDataForKey:(NSString *)key valueTransformerName:(NSString *__autoreleasing *)valueTransformerName {
+    NSData *frame = [self.sharedMemoryTier dataForKey:key];
+    return frame ? _dwarf_cache_unframe(frame, valueTransformerName) : nil;
+}
+
+- (void)_setSharedMemoryData:(NSData *)data valueTransformerName:(NSString *)valueTransformerName forKey:(NSString *)key {
+    if (data && self.sharedMemoryTier) {
+        NSData *frame = _dwarf_cache_frame(data, valueTransformerName);
+        if (frame) {
+            [self.sharedMemoryTier setData:frame forKey:key];
+        }
+    }
+}
+
 #pragma mark - Write
 
 - (void)storeObject:(id)object forKey:(NSString *)key {
@@ -152,12 +297,45 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
                 encodedData = [valueTransformer transformedValue:object];
             }
             if (encodedData) {
-                NSURL *fileURL = [self.diskCache URLForKey:key];
-                [encodedData writeToURL:fileURL atomically:YES];
-                if (valueTransformerName) {
-                    [fileURL df_setExtendedAttributeValue:valueTransformerName forKey:DFCacheAttributeValueTransformerNameKey];
+                NSDictionary *attributes = valueTransformerName ? @{ DFCacheAttributeValueTransformerNameKey : valueTransformerName } : nil;
+                [self _setSharedMemoryData:encodedData valueTransformerName:valueTransformerName forKey:key];
+                [self.diskCache setData:encodedData forKey:key extendedAttributes:attributes];
+            }
+        }
+    });
+}
+
+- (void)storeObjects:(NSDictionary *)objects localityGroup:(NSString *)group {
+    objects = [objects copy];
+    NSMutableDictionary *valueTransformerNames = [NSMutableDictionary new];
+    for (NSString *key in objects) {
+        if (!key.length) {
+            continue;
+        }
+        id object = objects[key];
+        NSString *valueTransformerName = [self.valueTransfomerFactory valueTransformerNameForValue:object];
+        id<DFValueTransforming> valueTransformer = [self.valueTransfomerFactory valueTransformerForName:valueTransformerName];
+        [self _setObject:object forKey:key valueTransformer:valueTransformer];
+        if (valueTransformer && valueTransformerName) {
+            valueTransformerNames[key] = valueTransformerName;
+        }
+    }
+    if (!valueTransformerNames.count) {
+        return;
+    }
+    dispatch_async(_ioQueue, ^{
+        @autoreleasepool {
+            NSMutableDictionary *batch = [NSMutableDictionary new];
+            NSMutableDictionary *attributes = [NSMutableDictionary new];
+            for (NSString *key in valueTransformerNames) {
+                NSData *encodedData = [[self.valueTransfomerFactory valueTransformerForName:valueTransformerNames[key]] transformedValue:objects[key]];
+                if (encodedData) {
+                    batch[key] = encodedData;
+                    attributes[key] = @{ DFCacheAttributeValueTransformerNameKey : valueTransformerNames[key] };
+                    [self _setSharedMemoryData:encodedData valueTransformerName:valueTransformerNames[key] forKey:key];
                 }
             }
+            [self.diskCache setDataBatch:batch extendedAttributes:attributes localityGroup:group];
         }
     });
 }
@@ -179,6 +357,7 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
         cost = [valueTransformer costForValue:object];
     }
     [self.memoryCache setObject:object forKey:key cost:cost];
+    [_keyTracker recordAccessForKey:key];
 }
 
 #pragma mark - Remove
@@ -189,8 +368,10 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
     }
     for (NSString *key in keys) {
         [self.memoryCache removeObjectForKey:key];
+        [_keyTracker removeKey:key];
     }
     dispatch_async(_ioQueue, ^{
+        [self.sharedMemoryTier removeDataForKeys:keys];
         for (NSString *key in keys) {
             [self.diskCache removeDataForKey:key];
         }
@@ -205,11 +386,59 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
 
 - (void)removeAllObjects {
     [self.memoryCache removeAllObjects];
+    [_keyTracker removeAllKeys];
     dispatch_async(_ioQueue, ^{
+        [self.sharedMemoryTier removeAllData];
         [self.diskCache removeAllData];
     });
 }
 
+- (void)removeObjectsForKeysWithPrefix:(NSString *)prefix {
+    if (!prefix.length) {
+        return;
+    }
+    // Keys are read synchronously so that the objects are removed from memory cache by the time the method returns.
+    NSMutableArray *keys = [NSMutableArray new];
+    for (NSString *key in [_keyTracker keysOrderedByPriority]) {
+        if ([key hasPrefix:prefix]) {
+            [keys addObject:key];
+        }
+    }
+    dispatch_sync(_ioQueue, ^{
+        [self.diskCache enumerateKeysWithPrefix:prefix usingBlock:^(NSString *key, BOOL *stop) {
+            [keys addObject:key];
+        }];
+    });
+    for (NSString *key in keys) {
+        [self.memoryCache removeObjectForKey:key];
+        [_keyTracker removeKey:key];
+    }
+    dispatch_async(_ioQueue, ^{
+        [self.sharedMemoryTier removeDataForKeys:keys];
+        [self.diskCache removeDataForKeysWithPrefix:prefix];
+    });
+}
+
+- (void)enumerateKeysWithPrefix:(NSString *)prefix usingBlock:(void (^)(NSString *, BOOL *))block {
+    if (!prefix || !block) {
+        return;
+    }
+    NSMutableArray *keys = [NSMutableArray new];
+    dispatch_sync(_ioQueue, ^{
+        [self.diskCache enumerateKeysWithPrefix:prefix usingBlock:^(NSString *key, BOOL *stop) {
+            [keys addObject:key];
+        }];
+    });
+    // The block is called outside of IO queue so that it can use the cache.
+    BOOL stop = NO;
+    for (NSString *key in keys) {
+        block(key, &stop);
+        if (stop) {
+            break;
+        }
+    }
+}
+
 #pragma mark - Metadata
 
 - (NSDictionary *)metadataForKey:(NSString *)key {
@@ -218,8 +447,7 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
     }
     NSDictionary *__block metadata;
     dispatch_sync(_ioQueue, ^{
-        NSURL *fileURL = [self.diskCache URLForKey:key];
-        metadata = [fileURL df_extendedAttributeValueForKey:DFCacheAttributeMetadataKey error:nil];
+        metadata = [self.diskCache extendedAttributeValueForName:DFCacheAttributeMetadataKey key:key];
     });
     return metadata;
 }
@@ -229,8 +457,7 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
         return;
     }
     dispatch_async(_ioQueue, ^{
-        NSURL *fileURL = [self.diskCache URLForKey:key];
-        [fileURL df_setExtendedAttributeValue:metadata forKey:DFCacheAttributeMetadataKey];
+        [self.diskCache setExtendedAttributeValue:metadata forName:DFCacheAttributeMetadataKey key:key];
     });
 }
 
@@ -239,11 +466,10 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
         return;
     }
     dispatch_async(_ioQueue, ^{
-        NSURL *fileURL = [self.diskCache URLForKey:key];
-        NSDictionary *metadata = [fileURL df_extendedAttributeValueForKey:DFCacheAttributeMetadataKey error:nil];
+        NSDictionary *metadata = [self.diskCache extendedAttributeValueForName:DFCacheAttributeMetadataKey key:key];
         NSMutableDictionary *mutableMetadata = [[NSMutableDictionary alloc] initWithDictionary:metadata];
         [mutableMetadata addEntriesFromDictionary:keyedValues];
-        [fileURL df_setExtendedAttributeValue:mutableMetadata forKey:DFCacheAttributeMetadataKey];
+        [self.diskCache setExtendedAttributeValue:mutableMetadata forName:DFCacheAttributeMetadataKey key:key];
     });
 }
 
@@ -252,8 +478,7 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
         return;
     }
     dispatch_async(_ioQueue, ^{
-        NSURL *fileURL = [self.diskCache URLForKey:key];
-        [fileURL df_removeExtendedAttributeForKey:DFCacheAttributeMetadataKey];
+        [self.diskCache setExtendedAttributeValue:nil forName:DFCacheAttributeMetadataKey key:key];
     });
 }
 
@@ -289,12 +514,171 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
     });
 }
 
+- (void)setReconciliationTimerInterval:(NSTimeInterval)timeInterval {
+    if (_reconciliationTimeInterval != timeInterval) {
+        _reconciliationTimeInterval = timeInterval;
+        [self _scheduleReconciliationTimer];
+    }
+}
+
+- (void)_scheduleReconciliationTimer {
+    [_reconciliationTimer invalidate];
+    if (_diskCache && _reconciliationTimeInterval > 0) {
+        DFCache *__weak weakSelf = self;
+        _reconciliationTimer = [DFCacheTimer scheduledTimerWithTimeInterval:_reconciliationTimeInterval block:^{
+            [weakSelf reconcileDiskCacheContents];
+        } userInfo:nil repeats:YES];
+    }
+}
+
+- (void)reconcileDiskCacheContents {
+    DFDiskCache *diskCache = self.diskCache;
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), ^{
+        [diskCache reconcileContents];
+    });
+}
+
 #if TARGET_OS_IOS || TARGET_OS_TV
 - (void)_didReceiveMemoryWarning:(NSNotification *__unused)notification {
     [self.memoryCache removeAllObjects];
 }
 #endif
 
+#pragma mark - Memory Snapshot
+
+- (void)setMemorySnapshotEnabled:(BOOL)enabled {
+    if (_memorySnapshotEnabled != enabled) {
+        _memorySnapshotEnabled = enabled;
+        _keyTracker.enabled = enabled;
+        [self _scheduleMemorySnapshotTimer];
+        if (enabled && !_memorySnapshotRestoreStarted) {
+            // Warms up memory cache with the snapshot saved by the previous launch.
+            _memorySnapshotRestoreStarted = YES;
+            [self restoreMemorySnapshotWithCompletion:nil];
+        }
+    }
+}
+
+- (void)setMemorySnapshotTimerInterval:(NSTimeInterval)timeInterval {
+    if (_memorySnapshotTimeInterval != timeInterval) {
+        _memorySnapshotTimeInterval = timeInterval;
+        [self _scheduleMemorySnapshotTimer];
+    }
+}
+
+- (void)setMemorySnapshotCapacity:(NSUInteger)memorySnapshotCapacity {
+    _memorySnapshotCapacity = memorySnapshotCapacity;
+    _keyTracker.capacity = memorySnapshotCapacity;
+}
+
+- (void)_scheduleMemorySnapshotTimer {
+    [_memorySnapshotTimer invalidate];
+    if (_memorySnapshotEnabled) {
+        DFCache *__weak weakSelf = self;
+        _memorySnapshotTimer = [DFCacheTimer scheduledTimerWithTimeInterval:_memorySnapshotTimeInterval block:^{
+            [weakSelf saveMemorySnapshot];
+        } userInfo:nil repeats:YES];
+    }
+}
+
+- (NSString *)_memorySnapshotPath {
+    return [self.diskCache.internalDirectoryPath stringByAppendingPathComponent:@"memory_snapshot"];
+}
+
+- (void)saveMemorySnapshot {
+    if (!_keyTracker.enabled || !self.diskCache) {
+        return;
+    }
+    dispatch_async(_ioQueue, ^{
+        NSArray *keys = [_keyTracker keysOrderedByPriority];
+        NSData *data = [NSPropertyListSerialization dataWithPropertyList:keys format:NSPropertyListBinaryFormat_v1_0 options:0 error:nil];
+        NSString *path = [self _memorySnapshotPath];
+        if (path) {
+            [data writeToFile:path atomically:YES];
+        }
+    });
+}
+
+- (void)restoreMemorySnapshotWithCompletion:(void (^)(NSUInteger))completion {
+    if (!self.diskCache || !self.memoryCache) {
+        [self _memorySnapshotRestoreDidFinishWithCount:0 completion:completion];
+        return;
+    }
+    dispatch_async(_ioQueue, ^{
+        NSString *path = [self _memorySnapshotPath];
+        NSData *data = path ? [NSData dataWithContentsOfFile:path] : nil;
+        NSArray *keys = data ? [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:nil error:nil] : nil;
+        if (![keys isKindOfClass:[NSArray class]]) {
+            keys = nil;
+        }
+        [_keyTracker addKeys:keys];
+        [self _restoreObjectsForKeys:keys fromIndex:0 count:0 cost:0 completion:completion];
+    });
+}
+
+/*! Reads the next batch of entries on IO queue, decodes them on processing queue and schedules reading of the next batch. Interleaving batches with other IO operations keeps disk available for the regular requests.
+ */
+- (void)_restoreObjectsForKeys:(NSArray *)keys fromIndex:(NSUInteger)index count:(NSUInteger)count cost:(NSUInteger)cost completion:(void (^)(NSUInteger))completion {
+    NSCache *memoryCache = self.memoryCache;
+    if (index >= keys.count ||
+        (memoryCache.countLimit && count >= memoryCache.countLimit) ||
+        (memoryCache.totalCostLimit && cost >= memoryCache.totalCostLimit)) {
+        [self _memorySnapshotRestoreDidFinishWithCount:count completion:completion];
+        return;
+    }
+    NSRange range = NSMakeRange(index, MIN(DFCacheMemorySnapshotRestoreBatchSize, keys.count - index));
+    NSMutableArray *entries = [NSMutableArray new];
+    @autoreleasepool {
+        for (NSString *key in [keys subarrayWithRange:range]) {
+            if (![key isKindOfClass:[NSString class]] || [memoryCache objectForKey:key]) {
+                continue;
+            }
+            NSString *valueTransformerName;
+            NSData *data = [self _diskDataForKey:key valueTransformerName:&valueTransformerName];
+            if (data && valueTransformerName) {
+                [entries addObject:@[key, data, valueTransformerName]];
+            }
+        }
+    }
+    dispatch_async(_processingQueue, ^{
+        NSUInteger batchCount = 0;
+        NSUInteger batchCost = 0;
+        @autoreleasepool {
+            for (NSArray *entry in entries) {
+                id<DFValueTransforming> valueTransformer = [self.valueTransfomerFactory valueTransformerForName:entry[2]];
+                id object = [valueTransformer reverseTransfomedValue:entry[1]];
+                if (!object || [memoryCache objectForKey:entry[0]]) {
+                    continue;
+                }
+                NSUInteger objectCost = 0;
+                if ([valueTransformer respondsToSelector:@selector(costForValue:)]) {
+                    objectCost = [valueTransformer costForValue:object];
+                }
+                [memoryCache setObject:object forKey:entry[0] cost:objectCost];
+                batchCount++;
+                batchCost += objectCost;
+            }
+        }
+        dispatch_async(_ioQueue, ^{
+            [self _restoreObjectsForKeys:keys fromIndex:NSMaxRange(range) count:(count + batchCount) cost:(cost + batchCost) completion:completion];
+        });
+    });
+}
+
+- (void)_memorySnapshotRestoreDidFinishWithCount:(NSUInteger)count completion:(void (^)(NSUInteger))completion {
+    if (completion) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(count);
+        });
+    }
+}
+
+#if TARGET_OS_IOS || TARGET_OS_TV
+- (void)_didEnterBackground:(NSNotification *__unused)notification {
+    [self saveMemorySnapshot];
+}
+#endif
+
 #pragma mark - Data
 
 - (void)cachedDataForKey:(NSString *)key completion:(void (^)(NSData *))completion {
@@ -306,8 +690,9 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
         return;
     }
     dispatch_async(_ioQueue, ^{
-        NSData *data = [self.diskCache dataForKey:key];
-        _dwarf_cache_callback(completion, data);
+        [self _readDiskDataForKey:key completion:^(NSData *data, NSString *valueTransformerName) {
+            _dwarf_cache_callback(completion, data);
+        }];
     });
 }
 
@@ -317,7 +702,8 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
     }
     NSData *__block data;
     dispatch_sync(_ioQueue, ^{
-        data = [self.diskCache dataForKey:key];
+        NSString *valueTransformerName;
+        data = [self _diskDataForKey:key valueTransformerName:&valueTransformerName];
     });
     return data;
 }
@@ -327,10 +713,106 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
         return;
     }
     dispatch_async(_ioQueue, ^{
+        [self _setSharedMemoryData:data valueTransformerName:nil forKey:key];
         [self.diskCache setData:data forKey:key];
     });
 }
 
+#pragma mark - Export & Import
+
+- (void)exportContentsToStream:(NSOutputStream *)stream completion:(void (^)(BOOL))completion {
+    dispatch_async(_ioQueue, ^{
+        BOOL success = [self.diskCache exportContentsToStream:stream];
+        [self _archiveOperationDidFinishWithSuccess:success completion:completion];
+    });
+}
+
+- (void)importContentsFromStream:(NSInputStream *)stream completion:(void (^)(BOOL))completion {
+    dispatch_async(_ioQueue, ^{
+        BOOL success = [self.diskCache importContentsFromStream:stream];
+        // Imported entries might replace the data of the objects that are already in memory cache.
+        [self.memoryCache removeAllObjects];
+        [self _archiveOperationDidFinishWithSuccess:success completion:completion];
+    });
+}
+
+- (void)_archiveOperationDidFinishWithSuccess:(BOOL)success completion:(void (^)(BOOL))completion {
+    if (completion) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(success);
+        });
+    }
+}
+
+#pragma mark - Bundles
+
+- (void)mountBundle:(DFCacheBundle *)bundle {
+    if (!bundle) {
+        return;
+    }
+    dispatch_sync(_ioQueue, ^{
+        if (![_bundles containsObject:bundle]) {
+            _bundles = [(_bundles ?: @[]) arrayByAddingObject:bundle];
+        }
+    });
+}
+
+- (void)unmountBundle:(DFCacheBundle *)bundle {
+    if (!bundle) {
+        return;
+    }
+    dispatch_sync(_ioQueue, ^{
+        NSMutableArray *bundles = [_bundles mutableCopy];
+        [bundles removeObject:bundle];
+        _bundles = [bundles copy];
+    });
+}
+
+- (NSArray *)bundles {
+    NSArray *__block bundles;
+    dispatch_sync(_ioQueue, ^{
+        bundles = _bundles ?: @[];
+    });
+    return bundles;
+}
+
+/*! Reads data and the name of the associated value transformer from the mounted bundles. Must be called on IO queue.
+ */
+- (NSData *)_bundleDataForKey:(NSString *)key valueTransformerName:(NSString *__autoreleasing *)valueTransformerName {
+    for (DFCacheBundle *bundle in _bundles) {
+        id value;
+        NSData *data = [bundle dataForKey:key extendedAttributeValue:&value forName:DFCacheAttributeValueTransformerNameKey];
+        if (data) {
+            if (valueTransformerName) {
+                *valueTransformerName = value;
+            }
+            return data;
+        }
+    }
+    return nil;
+}
+
+/*! Adds data of the keys missing from the batch from the mounted bundles. Must be called on IO queue.
+ */
+- (void)_addBundleDataForKeys:(NSArray *)keys toBatch:(NSMutableDictionary *)batch valueTransformerNames:(NSMutableDictionary *)valueTransformerNames {
+    if (!_bundles.count) {
+        return;
+    }
+    for (NSString *key in keys) {
+        if (batch[key]) {
+            continue;
+        }
+        NSString *valueTransformerName;
+        NSData *data = [self _bundleDataForKey:key valueTransformerName:&valueTransformerName];
+        if (data) {
+            batch[key] = data;
+            if (valueTransformerName) {
+                valueTransformerNames[key] = valueTransformerName;
+            }
+        }
+    }
+}
+
 #pragma mark - Miscellaneous
 
 - (NSString *)debugDescription {
@@ -356,6 +838,21 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
 #endif
 
 
+@implementation DFCacheBundleBuilder (DFCache)
+
+- (void)addObject:(id)object forKey:(NSString *)key valueTransformerFactory:(id<DFValueTransformerFactory>)factory {
+    NSString *valueTransformerName = [factory valueTransformerNameForValue:object];
+    id<DFValueTransforming> valueTransformer = [factory valueTransformerForName:valueTransformerName];
+    NSData *data = [valueTransformer transformedValue:object];
+    if (data) {
+        NSDictionary *attributes = valueTransformerName ? @{ DFCacheAttributeValueTransformerNameKey : valueTransformerName } : nil;
+        [self addData:data forKey:key extendedAttributes:attributes];
+    }
+}
+
+@end
+
+
 @implementation DFCache (DFCacheExtended)
 
 - (void)batchCachedDataForKeys:(NSArray *)keys completion:(void (^)(NSDictionary *batch))completion {
@@ -363,9 +860,10 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
         _dwarf_cache_callback(completion, nil);
         return;
     }
-    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-        NSDictionary *batch = [self batchCachedDataForKeys:keys];
-        _dwarf_cache_callback(completion, batch);
+    dispatch_async(_ioQueue, ^{
+        [self _readDiskDataForKeys:keys completion:^(NSMutableDictionary *batch, NSMutableDictionary *valueTransformerNames) {
+            _dwarf_cache_callback(completion, [batch copy]);
+        }];
     });
 }
 
@@ -374,7 +872,9 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
         return nil;
     }
     NSMutableDictionary *batch = [NSMutableDictionary new];
-    for (NSString *key in keys) {
+    // Files are read in the order of their location on disk, the batch is keyed so the order of the keys doesn't matter.
+    NSArray *sortedKeys = self.diskCache.readsInPhysicalOrder ? [self.diskCache keysSortedByPhysicalLocation:keys] : keys;
+    for (NSString *key in sortedKeys) {
         NSData *data = [self cachedDataForKey:key];
         if (data) {
             batch[key] = data;
@@ -388,9 +888,35 @@ static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_val
         _dwarf_cache_callback(completion, nil);
         return;
     }
-    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-        NSDictionary *batch = [self batchCachedObjectsForKeys:keys];
+    NSMutableDictionary *batch = [NSMutableDictionary new];
+    NSMutableArray *remainingKeys = [NSMutableArray new];
+    for (NSString *key in keys) {
+        id object = [self.memoryCache objectForKey:key];
+        if (object) {
+            [_keyTracker recordAccessForKey:key];
+            batch[key] = object;
+        } else {
+            [remainingKeys addObject:key];
+        }
+    }
+    if (!remainingKeys.count) {
         _dwarf_cache_callback(completion, batch);
+        return;
+    }
+    dispatch_async(_ioQueue, ^{
+        [self _readDiskDataForKeys:remainingKeys completion:^(NSMutableDictionary *dataBatch, NSMutableDictionary *valueTransformerNames) {
+            dispatch_async(_processingQueue, ^{
+                @autoreleasepool {
+                    [dataBatch enumerateKeysAndObjectsUsingBlock:^(NSString *key, NSData *data, BOOL *stop) {
+                        id object = [self _objectWithData:data valueTransformerName:valueTransformerNames[key] forKey:key];
+                        if (object) {
+                            batch[key] = object;
+                        }
+                    }];
+                }
+                _dwarf_cache_callback(completion, batch);
+            });
+        }];
     });
 }
 
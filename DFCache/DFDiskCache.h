@@ -7,14 +7,94 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+@class DFDiskCacheTuner;
+
 static const unsigned long long DFDiskCacheCapacityUnlimited = 0;
 
+/*! Counters collected by disk cache since initialization or the last reset.
+ */
+typedef struct {
+    /*! Number of reads that found data on disk.
+     */
+    unsigned long long hitCount;
+    /*! Number of reads that found no data on disk.
+     */
+    unsigned long long missCount;
+    /*! Number of misses on recently evicted entries. These are the misses that more disk capacity would have avoided.
+     */
+    unsigned long long ghostHitCount;
+    /*! Number of entries discarded by cleanup.
+     */
+    unsigned long long evictionCount;
+    /*! Number of times the index of the contents was reconciled with the storage directory (see -reconcileContents).
+     */
+    unsigned long long reconciliationCount;
+    /*! Sum of the absolute corrections of the size of the contents made by reconciliations, in bytes. Drift means that storage directory was modified by other means, for example by another process.
+     */
+    unsigned long long contentsSizeDrift;
+    /*! Number of entries moved from the lower tier to this disk cache after they were read enough times (see promotionThreshold).
+     */
+    unsigned long long promotionCount;
+    /*! Number of entries moved to the lower tier instead of being discarded by cleanup.
+     */
+    unsigned long long demotionCount;
+} DFDiskCacheStatistics;
+
+/*! Durability of the writes in case of power loss or operating system crash. Writes are always atomic, durability only defines whether they survive the crash.
+ */
+typedef NS_ENUM(NSUInteger, DFDiskCacheDurability) {
+    /*! Writes are not synchronized with the disk. Recent writes might be lost.
+     */
+    DFDiskCacheDurabilityNone = 0,
+    /*! Writes are collected into groups which are synchronized with the disk together. Pending writes are served from memory.
+     */
+    DFDiskCacheDurabilityGroupCommit,
+    /*! Each write is synchronized with the disk before it returns.
+     */
+    DFDiskCacheDurabilityPerWrite
+};
+
+/*! Options of the disk cache that keeps entries in the files of its directory.
+ */
+typedef NS_OPTIONS(NSUInteger, DFDiskCacheOptions) {
+    DFDiskCacheOptionNone = 0,
+    /*! Disk cache directory is shared with the other processes. Processes share the index of the contents (sizes and access times) through a memory-mapped file instead of keeping their own index and journal. Only a single elected process (see cleanupLeader) performs cleanup. All processes should open the directory with this option. The shared index holds up to 786,432 entries, disk cache with more entries falls back to scanning its directory.
+     */
+    DFDiskCacheOptionShared = 1 << 0
+};
+
 /*! Disk cache extends file storage functionality by providing LRU (least recently used) cleanup. Cleanup doesn't get called automatically.
+ @discussion By default disk cache keeps each entry in a separate file of its directory. Disk cache can also be initialized with any other storage engine (see DFStorageEngine). Disk cache is a storage engine itself.
  */
 @interface DFDiskCache : DFFileStorage
 
 - (instancetype)initWithName:(NSString *)name;
 
+/*! Initializes disk cache with the given directory path and options.
+ */
+- (instancetype)initWithPath:(NSString *)path options:(DFDiskCacheOptions)options error:(NSError **)error;
+
+/*! Initializes disk cache with the given directory name in the caches directory and options.
+ */
+- (instancetype)initWithName:(NSString *)name options:(DFDiskCacheOptions)options;
+
+/*! Returns YES if disk cache was initialized with DFDiskCacheOptionShared and shares its index with the other processes. Disk cache falls back to the private index if the shared index can't be opened.
+ */
+@property (nonatomic, readonly, getter=isShared) BOOL shared;
+
+/*! Returns YES if the receiver performs cleanup of the shared disk cache. Cleanup does nothing in the other processes. Leadership is acquired by the first process that attempts cleanup and is passed on when the leader terminates.
+ */
+@property (nonatomic, readonly, getter=isCleanupLeader) BOOL cleanupLeader;
+
+/*! Initializes disk cache that keeps its entries in the given storage engine instead of the files of its own directory.
+ @discussion Cleanup, statistics and extended attributes work with any engine. Extended attributes are stored together with the data of the entry. Index, journal and group commit are specific to the files of disk cache directory, writes go straight to the engine. File-specific methods (path, pathForKey:, URLForKey:, contentsWithResourceKeys:, reconcileContents, asynchronous reads through dispatch I/O) are not available.
+ */
+- (instancetype)initWithEngine:(id<DFStorageEngine>)engine;
+
+/*! Returns storage engine that disk cache keeps its entries in. Returns the receiver unless disk cache was initialized with another engine.
+ */
+@property (nonatomic, readonly) id<DFStorageEngine> engine;
+
 /*! Maximum disk cache capacity. Default value is 100 Mb.
  @discussion Not a strict limit. Disk storage is actually cleaned up only when cleanup method gets called.
  */
@@ -24,8 +104,98 @@ static const unsigned long long DFDiskCacheCapacityUnlimited = 0;
  */
 @property (nonatomic) float cleanupRate;
 
+/*! Maximum number of recently evicted entries that disk cache remembers (without their data) in order to detect ghost hits. Default value is 4096. Set to 0 to disable ghost hits detection.
+ */
+@property (nonatomic) NSUInteger ghostListCapacity;
+
+/*! Durability of the writes. Default value is DFDiskCacheDurabilityNone.
+ */
+@property (nonatomic) DFDiskCacheDurability durability;
+
+/*! Maximum time that writes wait for the group commit when durability is set to DFDiskCacheDurabilityGroupCommit. Default value is 0.05 seconds.
+ */
+@property (nonatomic) NSTimeInterval groupCommitInterval;
+
+/*! Size of the pending writes (in bytes) that triggers group commit before the group commit interval elapses. Default value is 4 Mb.
+ */
+@property (nonatomic) unsigned long long groupCommitByteThreshold;
+
+/*! Optional controller that adjusts capacity and cleanup rate before each cleanup. Default value is nil.
+ */
+@property (nullable, nonatomic) DFDiskCacheTuner *tuner;
+
+/*! Slower disk cache below this one, for example a disk cache on a large hard drive below the disk cache on a small SSD. Default value is nil.
+ @discussion Tiers are exclusive, each entry is stored in a single tier. Reads that miss this disk cache fall through to the lower tier, entries that are read from the lower tier enough times are promoted to this disk cache (see promotionThreshold). Cleanup demotes the least recently used entries to the lower tier instead of discarding them and then cleans up the lower tier. Removals are applied to all tiers. Each tier has its own capacity and statistics.
+
+ Files are moved between tiers by their names so both tiers must either keep entries in files of their directories or use storage engines. Entries of the storage engines are moved by their keys (see -[DFStorageEngine keyForIdentifier:]), entries which keys the engine of this disk cache can't tell are evicted without demotion. Entries evicted by the storage engine on its own are not demoted.
+ */
+@property (nullable, nonatomic) DFDiskCache *lowerTier;
+
+/*! Number of reads from the lower tier after which the entry is promoted to this disk cache. Default value is 2. Set to 0 to disable promotion.
+ */
+@property (nonatomic) NSUInteger promotionThreshold;
+
+/*! Values larger than the threshold (in bytes) bypass this disk cache and are written directly to the lower tier and are never promoted. Default value is 0 which means that no values bypass this disk cache.
+ */
+@property (nonatomic) unsigned long long largeValueThreshold;
+
+/*! Returns counters collected by disk cache.
+ */
+@property (nonatomic, readonly) DFDiskCacheStatistics statistics;
+
+/*! Resets counters collected by disk cache.
+ */
+- (void)resetStatistics;
+
+/*! Writes data together with the extended attributes of the file as a single transaction. Either both data and attributes are stored or none of them, even if the process is terminated during the write.
+ @param attributes Dictionary of the extended attribute names and values (see NSURL+DFExtendedFileAttributes).
+ */
+- (void)setData:(NSData *)data forKey:(NSString *)key extendedAttributes:(nullable NSDictionary *)attributes;
+
+/*! Writes entries of the batch (key:data pairs) at once. If the engine supports locality groups (see DFPackStorage) the entries are stored next to each other so that the batch reads can fetch them with a single read. Otherwise the entries are written one by one.
+ @param attributes Dictionary of key:attributes pairs, attributes of each entry are written as in -setData:forKey:extendedAttributes:.
+ */
+- (void)setDataBatch:(NSDictionary *)batch extendedAttributes:(nullable NSDictionary *)attributes localityGroup:(nullable NSString *)group;
+
+/*! Returns YES if the storage engine can enumerate and remove entries by the prefix of their keys (see DFLSMStorage). Disk cache that keeps entries in files stores hashes of the keys and doesn't support prefixes.
+ */
+@property (nonatomic, readonly) BOOL supportsKeyPrefixes;
+
+/*! Enumerates keys that start with the given prefix, the keys of this disk cache first and then the keys of the lower tier if it supports prefixes. Does nothing if the storage engine doesn't support prefixes.
+ */
+- (void)enumerateKeysWithPrefix:(NSString *)prefix usingBlock:(void (^)(NSString *key, BOOL *stop))block;
+
+/*! Removes all entries which keys start with the given prefix from this disk cache and from the lower tier if it supports prefixes. Does nothing if the storage engine doesn't support prefixes.
+ */
+- (void)removeDataForKeysWithPrefix:(NSString *)prefix;
+
+/*! Returns the value of the extended attribute with the given name of the entry for the given key.
+ */
+- (nullable id)extendedAttributeValueForName:(NSString *)name key:(NSString *)key;
+
+/*! Sets the value of the extended attribute with the given name of the entry for the given key. Nil value removes the attribute. Does nothing if there is no entry for the key.
+ */
+- (void)setExtendedAttributeValue:(nullable id)value forName:(NSString *)name key:(NSString *)key;
+
+/*! Synchronously commits pending writes (if any) and synchronizes them with the disk together with the recorded access times of the entries.
+ */
+- (void)synchronize;
+
+/*! Writes all entries (data, extended attributes and access times) to the stream as a single sequential archive, least recently used first. Pending writes are committed first. Returns NO if the stream failed.
+ @discussion Files are identified in the archive by their names so the archive of the files should be imported into the disk cache that also keeps entries in files. Entries of the storage engine are identified by their keys (see -[DFStorageEngine keyForIdentifier:]), returns NO without writing anything if the engine can't tell the keys of its entries.
+ */
+- (BOOL)exportContentsToStream:(NSOutputStream *)stream;
+
+/*! Reads archive written by -exportContentsToStream: and stores its entries. Entries are written in parallel batches while the next batch is read from the stream. Access times of the entries are preserved in the index of disk cache (but not by the other storage engines). Returns NO if the archive is damaged or any of the entries wasn't written, entries read before the failure are kept.
+ */
+- (BOOL)importContentsFromStream:(NSInputStream *)stream;
+
+/*! Scans storage directory and corrects the index of the contents: indexes the files that are missing from it, removes the entries of the files that no longer exist and updates the sizes that changed. Reconciles running totals of the file storage instead until the index is ready. Returns the correction of the size of the contents, in bytes, which is also recorded in statistics.
+ */
+- (long long)reconcileContents;
+
 /*! Cleans up disk cache by discarding the least recently used items.
- @discussion Cleanup algorithm runs only if max disk cache capacity is set to non-zero value. Target size is calculated by multiplying disk capacity and cleanup rate.
+ @discussion Cleanup algorithm runs only if max disk cache capacity is set to non-zero value. Target size is calculated by multiplying disk capacity and cleanup rate. If the tuner is set it gets a chance to adjust capacity and cleanup rate first.
  */
 - (void)cleanup;
 
@@ -2,55 +2,1093 @@
 //
 // Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
 
+#import "DFCacheArchive.h"
 #import "DFCachePrivate.h"
+#import "DFDirectoryScan.h"
 #import "DFDiskCache.h"
+#import "DFDiskCacheIndex.h"
+#import "DFDiskCacheJournal.h"
+#import "DFDiskCacheSharedIndex.h"
+#import "DFDiskCacheTuner.h"
+#import "DFFileStoragePrivate.h"
+#import "NSURL+DFExtendedFileAttributes.h"
+#import <fcntl.h>
+#import <signal.h>
+#import <sys/stat.h>
+#import <unistd.h>
 
-@implementation DFDiskCache
+/*! Flushes the drive cache. Unlike fsync(2) on Darwin, F_FULLFSYNC guarantees that the data that was already sent to the drive is written to the permanent storage. A single F_FULLFSYNC works as a barrier for all the files that were synchronized with fsync(2) before it.
+ */
+static BOOL _DFDiskCacheFullSynchronizeFile(int fd) {
+    return fcntl(fd, F_FULLFSYNC) == 0 || fsync(fd) == 0;
+}
+
+static const uint32_t DFDiskCacheFrameMagic = 0x44464346; // "DFCF"
+
+/*! Frames data together with its extended attributes for the storage engines that don't support extended attributes. Frame: u32 magic, u32 attributes length, archived attributes, data.
+ */
+static NSData *_DFDiskCacheFrame(NSData *data, NSDictionary *attributes) {
+    NSData *archivedAttributes = attributes.count ? [NSKeyedArchiver archivedDataWithRootObject:attributes] : nil;
+    uint32_t header[2] = { DFDiskCacheFrameMagic, (uint32_t)archivedAttributes.length };
+    NSMutableData *frame = [NSMutableData dataWithCapacity:sizeof(header) + archivedAttributes.length + data.length];
+    [frame appendBytes:header length:sizeof(header)];
+    if (archivedAttributes) {
+        [frame appendData:archivedAttributes];
+    }
+    [frame appendData:data];
+    return frame;
+}
+
+/*! Returns data of the frame. Returns nil if the frame is damaged.
+ */
+static NSData *_DFDiskCacheUnframe(NSData *frame, NSDictionary *__autoreleasing *attributes) {
+    uint32_t header[2];
+    if (frame.length < sizeof(header)) {
+        return nil;
+    }
+    [frame getBytes:header length:sizeof(header)];
+    if (header[0] != DFDiskCacheFrameMagic || header[1] > frame.length - sizeof(header)) {
+        return nil;
+    }
+    if (attributes && header[1] > 0) {
+        id value = [NSKeyedUnarchiver unarchiveObjectWithData:[frame subdataWithRange:NSMakeRange(sizeof(header), header[1])]];
+        *attributes = [value isKindOfClass:[NSDictionary class]] ? value : nil;
+    }
+    NSUInteger offset = sizeof(header) + header[1];
+    return [frame subdataWithRange:NSMakeRange(offset, frame.length - offset)];
+}
+
+/*! Import writes entries in batches of at most this many entries or bytes. The next batch is read from the archive while the previous one is being written.
+ */
+static const NSUInteger DFDiskCacheImportBatchCount = 256;
+static const unsigned long long DFDiskCacheImportBatchSize = 1024 * 1024 * 8; // 8 Mb
+
+@interface _DFDiskCachePendingWrite : NSObject {
+    @public
+    NSString *_filename;
+    NSData *_data;
+    NSDictionary *_attributes;
+}
+@end
+
+@implementation _DFDiskCachePendingWrite
+@end
+
+@implementation DFDiskCache {
+    /*! Storage engine, nil if disk cache keeps entries in the files of its own directory.
+     */
+    id<DFStorageEngine> _engine;
+    
+    /*! Only accessed on statistics queue.
+     */
+    DFDiskCacheStatistics _statistics;
+    dispatch_queue_t _statisticsQueue;
+
+    /*! Hashes of the file names of the recently evicted entries, oldest first. Only accessed on statistics queue.
+     */
+    NSMutableOrderedSet *_ghostList;
+    
+    /*! Number of hits in the lower tier per key of the entries that are not yet promoted.
+     */
+    NSCache *_promotionCandidates;
+    
+    /*! Index of the disk cache contents. Built in the background when disk cache is initialized. Until index is ready disk cache falls back to scanning storage directory.
+     */
+    DFDiskCacheIndex *_index;
+    dispatch_queue_t _indexQueue;
+    
+    /*! Index shared with the other processes, the same object as _index. Nil unless disk cache is shared.
+     */
+    DFDiskCacheSharedIndex *_sharedIndex;
+    
+    /*! Write-ahead journal of the index mutations since the last index snapshot.
+     */
+    DFDiskCacheJournal *_journal;
+    
+    /*! Writes waiting for the group commit, keyed by file name. Protected by _pendingWritesLock.
+     */
+    NSMutableDictionary *_pendingWrites;
+    unsigned long long _pendingWritesSize;
+    BOOL _groupCommitScheduled;
+    NSLock *_pendingWritesLock;
+    dispatch_queue_t _commitQueue;
+}
 
 - (instancetype)initWithPath:(NSString *)path error:(NSError **)error {
+    return [self initWithPath:path options:DFDiskCacheOptionNone error:error];
+}
+
+- (instancetype)initWithPath:(NSString *)path options:(DFDiskCacheOptions)options error:(NSError **)error {
     if (self = [super initWithPath:path error:error]) {
-        _capacity = 1024 * 1024 * 100; // 100 Mb
-        _cleanupRate = 0.5f;
+        [self _commonInit];
+        _indexQueue = dispatch_queue_create("DFDiskCache::IndexQueue", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(_indexQueue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0));
+        if (options & DFDiskCacheOptionShared) {
+            _sharedIndex = [[DFDiskCacheSharedIndex alloc] initWithPath:[self.internalDirectoryPath stringByAppendingPathComponent:@"shared_index"]];
+        }
+        if (_sharedIndex) {
+            // Shared index is built by the leader, the other processes use it once it is ready.
+            _index = _sharedIndex;
+            if ([_sharedIndex acquireLeadership] && !_index.isReady) {
+                [self _buildIndex];
+            }
+        } else {
+            _index = [DFDiskCacheIndex new];
+            _journal = [[DFDiskCacheJournal alloc] initWithPath:[self.internalDirectoryPath stringByAppendingPathComponent:@"journal"]];
+            [self _buildIndex];
+        }
     }
     return self;
 }
 
 - (instancetype)initWithName:(NSString *)name {
+    return [self initWithName:name options:DFDiskCacheOptionNone];
+}
+
+- (instancetype)initWithName:(NSString *)name options:(DFDiskCacheOptions)options {
     NSString *directoryPath = [[DFDiskCache cachesDirectoryPath] stringByAppendingPathComponent:name];
-    return [self initWithPath:directoryPath error:nil];
+    return [self initWithPath:directoryPath options:options error:nil];
+}
+
+- (instancetype)initWithEngine:(id<DFStorageEngine>)engine {
+    if (!engine) {
+        [NSException raise:NSInvalidArgumentException format:@"Attempting to initialize disk cache without storage engine"];
+    }
+    if (self = [super _initWithoutDirectory]) {
+        [self _commonInit];
+        _engine = engine;
+        if ([engine respondsToSelector:@selector(setEvictionHandler:)]) {
+            DFDiskCache *__weak weakSelf = self;
+            engine.evictionHandler = ^(NSArray *identifiers) {
+                [weakSelf _didEvictIdentifiers:identifiers];
+            };
+        }
+    }
+    return self;
+}
+
+- (void)_commonInit {
+    _capacity = 1024 * 1024 * 100; // 100 Mb
+    _cleanupRate = 0.5f;
+    _ghostListCapacity = 4096;
+    _promotionThreshold = 2;
+    _promotionCandidates = [NSCache new];
+    _promotionCandidates.countLimit = 4096;
+    _ghostList = [NSMutableOrderedSet new];
+    _groupCommitInterval = 0.05;
+    _groupCommitByteThreshold = 1024 * 1024 * 4; // 4 Mb
+    _pendingWrites = [NSMutableDictionary new];
+    _pendingWritesLock = [NSLock new];
+    _commitQueue = dispatch_queue_create("DFDiskCache::CommitQueue", DISPATCH_QUEUE_SERIAL);
+    _statisticsQueue = dispatch_queue_create("DFDiskCache::StatisticsQueue", DISPATCH_QUEUE_SERIAL);
+}
+
+- (id<DFStorageEngine>)engine {
+    return _engine ?: self;
+}
+
+- (BOOL)isShared {
+    return _sharedIndex != nil;
+}
+
+- (BOOL)isCleanupLeader {
+    return _sharedIndex.isLeader;
+}
+
+#pragma mark - Read & Write
+
+- (NSData *)dataForKey:(NSString *)key options:(DFFileStorageReadOptions)options extendedAttributeValue:(id __autoreleasing *)value forName:(NSString *)name {
+    NSData *data = [self _localDataForKey:key options:options extendedAttributeValue:value forName:name];
+    if (!data && key && _lowerTier) {
+        data = [_lowerTier dataForKey:key options:options extendedAttributeValue:value forName:name];
+        if (data) {
+            [self _didReadLowerTierDataForKey:key];
+        }
+    }
+    return data;
+}
+
+- (NSData *)_localDataForKey:(NSString *)key options:(DFFileStorageReadOptions)options extendedAttributeValue:(id __autoreleasing *)value forName:(NSString *)name {
+    if (_engine) {
+        NSDictionary *attributes;
+        NSData *data = key ? _DFDiskCacheUnframe([_engine dataForKey:key], &attributes) : nil;
+        if (data && value && name) {
+            *value = attributes[name];
+        }
+        [self _didReadData:data forKey:key];
+        return data;
+    }
+    _DFDiskCachePendingWrite *write = [self _pendingWriteForKey:key];
+    if (write) {
+        [self _updateStatistics:^(DFDiskCacheStatistics *statistics) {
+            statistics->hitCount++;
+        }];
+        if (value && name) {
+            *value = write->_attributes[name];
+        }
+        return write->_data;
+    }
+    NSData *data = [super dataForKey:key options:options extendedAttributeValue:value forName:name];
+    [self _didReadData:data forKey:key];
+    return data;
+}
+
+- (void)readDataForKey:(NSString *)key extendedAttributeName:(NSString *)name queue:(dispatch_queue_t)queue completion:(void (^)(NSData *, id))completion {
+    DFDiskCache *lowerTier = _lowerTier;
+    if (!lowerTier || !key) {
+        [self _readLocalDataForKey:key extendedAttributeName:name queue:queue completion:completion];
+        return;
+    }
+    [self _readLocalDataForKey:key extendedAttributeName:name queue:queue completion:^(NSData *data, id value) {
+        if (data) {
+            completion(data, value);
+            return;
+        }
+        [lowerTier readDataForKey:key extendedAttributeName:name queue:queue completion:^(NSData *lowerTierData, id lowerTierValue) {
+            if (lowerTierData) {
+                [self _didReadLowerTierDataForKey:key];
+            }
+            completion(lowerTierData, lowerTierValue);
+        }];
+    }];
+}
+
+- (void)_readLocalDataForKey:(NSString *)key extendedAttributeName:(NSString *)name queue:(dispatch_queue_t)queue completion:(void (^)(NSData *, id))completion {
+    if (_engine) {
+        dispatch_async(queue, ^{
+            id value;
+            NSData *data = [self _localDataForKey:key options:DFFileStorageReadOptionsNone extendedAttributeValue:&value forName:name];
+            completion(data, value);
+        });
+        return;
+    }
+    _DFDiskCachePendingWrite *write = [self _pendingWriteForKey:key];
+    if (write) {
+        [self _updateStatistics:^(DFDiskCacheStatistics *statistics) {
+            statistics->hitCount++;
+        }];
+        dispatch_async(queue, ^{
+            completion(write->_data, name ? write->_attributes[name] : nil);
+        });
+        return;
+    }
+    [super readDataForKey:key extendedAttributeName:name queue:queue completion:^(NSData *data, id value) {
+        [self _didReadData:data forKey:key];
+        completion(data, value);
+    }];
+}
+
+- (void)readDataForKeys:(NSArray *)keys extendedAttributeName:(NSString *)name queue:(dispatch_queue_t)queue completion:(void (^)(NSDictionary *, NSDictionary *))completion {
+    if (!_engine || ![_engine respondsToSelector:@selector(dataForKeys:)]) {
+        [super readDataForKeys:keys extendedAttributeName:name queue:queue completion:completion];
+        return;
+    }
+    dispatch_async(queue, ^{
+        NSDictionary *frames = [_engine dataForKeys:keys];
+        NSMutableDictionary *batch = [[NSMutableDictionary alloc] initWithCapacity:frames.count];
+        NSMutableDictionary *values = [NSMutableDictionary new];
+        NSMutableArray *missingKeys = [NSMutableArray new];
+        for (NSString *key in keys) {
+            NSDictionary *attributes;
+            NSData *data = _DFDiskCacheUnframe(frames[key], name ? &attributes : NULL);
+            if (data) {
+                batch[key] = data;
+                if (name && attributes[name]) {
+                    values[key] = attributes[name];
+                }
+            } else {
+                [missingKeys addObject:key];
+            }
+            [self _didReadData:data forKey:key];
+        }
+        DFDiskCache *lowerTier = _lowerTier;
+        if (!lowerTier || !missingKeys.count) {
+            completion(batch, values);
+            return;
+        }
+        [lowerTier readDataForKeys:missingKeys extendedAttributeName:name queue:queue completion:^(NSDictionary *lowerTierBatch, NSDictionary *lowerTierValues) {
+            for (NSString *key in lowerTierBatch) {
+                [self _didReadLowerTierDataForKey:key];
+            }
+            [batch addEntriesFromDictionary:lowerTierBatch];
+            [values addEntriesFromDictionary:lowerTierValues];
+            completion(batch, values);
+        }];
+    });
+}
+
+- (NSArray *)keysSortedByPhysicalLocation:(NSArray *)keys {
+    // Engines order their batch reads by themselves (see -[DFPackStorage dataForKeys:]).
+    return _engine ? keys : [super keysSortedByPhysicalLocation:keys];
+}
+
+/*! Updates statistics and index after reading the data from disk.
+ */
+- (void)_didReadData:(NSData *)data forKey:(NSString *)key {
+    if (!key) {
+        return;
+    }
+    if (_engine) {
+        if (data) {
+            [self _updateStatistics:^(DFDiskCacheStatistics *statistics) {
+                statistics->hitCount++;
+            }];
+        } else {
+            [self _updateStatistics:^(DFDiskCacheStatistics *statistics) {
+                statistics->missCount++;
+            }];
+            [self _checkGhostListForFilename:[_engine identifierForKey:key]];
+        }
+        return;
+    }
+    NSString *filename = [self filenameForKey:key];
+    if (data) {
+        [self _updateStatistics:^(DFDiskCacheStatistics *statistics) {
+            statistics->hitCount++;
+        }];
+        if ([_index entryForFilename:filename]) {
+            CFAbsoluteTime accessTime = CFAbsoluteTimeGetCurrent();
+            [_index updateAccessTime:accessTime forFilename:filename];
+            [_journal logAccessForFilename:filename accessTime:accessTime];
+        } else {
+            [self _indexFilename:filename accessTime:CFAbsoluteTimeGetCurrent()];
+        }
+    } else {
+        [self _updateStatistics:^(DFDiskCacheStatistics *statistics) {
+            statistics->missCount++;
+        }];
+        if ([_index entryForFilename:filename]) {
+            [_index removeEntryForFilename:filename];
+            [_journal logRemoveForFilename:filename];
+        }
+        [self _checkGhostListForFilename:filename];
+    }
+}
+
+- (void)setData:(NSData *)data forKey:(NSString *)key {
+    [self setData:data forKey:key extendedAttributes:nil];
+}
+
+- (void)setData:(NSData *)data forKey:(NSString *)key extendedAttributes:(NSDictionary *)attributes {
+    if (!data || !key) {
+        return;
+    }
+    if (_lowerTier) {
+        // Tiers are exclusive, the entry is only stored in the tier it is written to.
+        if ([self _bypassesData:data]) {
+            [self _removeLocalDataForKey:key];
+            [_lowerTier setData:data forKey:key extendedAttributes:attributes];
+            return;
+        }
+        [_lowerTier removeDataForKey:key];
+    }
+    if (_engine) {
+        [_engine setData:_DFDiskCacheFrame(data, attributes) forKey:key];
+        return;
+    }
+    NSString *filename = [self filenameForKey:key];
+    switch (_durability) {
+        case DFDiskCacheDurabilityNone:
+            [self _writeData:data extendedAttributes:attributes filename:filename synchronize:NO];
+            break;
+        case DFDiskCacheDurabilityGroupCommit:
+            [self _addPendingWriteWithData:data extendedAttributes:attributes filename:filename];
+            break;
+        case DFDiskCacheDurabilityPerWrite:
+            if ([self _writeData:data extendedAttributes:attributes filename:filename synchronize:YES]) {
+                [self _synchronizeDirectory];
+            }
+            break;
+    }
+}
+
+- (void)setDataBatch:(NSDictionary *)batch extendedAttributes:(NSDictionary *)attributes localityGroup:(NSString *)group {
+    if (!batch.count) {
+        return;
+    }
+    if (!_engine || ![_engine respondsToSelector:@selector(setDataBatch:localityGroup:)]) {
+        for (NSString *key in batch) {
+            [self setData:batch[key] forKey:key extendedAttributes:attributes[key]];
+        }
+        return;
+    }
+    NSMutableDictionary *frames = [[NSMutableDictionary alloc] initWithCapacity:batch.count];
+    for (NSString *key in batch) {
+        NSData *data = batch[key];
+        if (_lowerTier && [self _bypassesData:data]) {
+            [self setData:data forKey:key extendedAttributes:attributes[key]];
+            continue;
+        }
+        [_lowerTier removeDataForKey:key];
+        frames[key] = _DFDiskCacheFrame(data, attributes[key]);
+    }
+    if (frames.count) {
+        [_engine setDataBatch:frames localityGroup:group];
+    }
+}
+
+- (void)removeDataForKey:(NSString *)key {
+    [self _removeLocalDataForKey:key];
+    [_lowerTier removeDataForKey:key];
+}
+
+- (void)_removeLocalDataForKey:(NSString *)key {
+    if (!key) {
+        return;
+    }
+    if (_engine) {
+        [_engine removeDataForKey:key];
+        return;
+    }
+    NSString *filename = [self filenameForKey:key];
+    [self _performAfterPendingCommits:^{
+        [_pendingWritesLock lock];
+        _DFDiskCachePendingWrite *write = _pendingWrites[filename];
+        if (write) {
+            _pendingWritesSize -= write->_data.length;
+            [_pendingWrites removeObjectForKey:filename];
+        }
+        [_pendingWritesLock unlock];
+        [super removeDataForKey:key];
+        [_index removeEntryForFilename:filename];
+        [_journal logRemoveForFilename:filename];
+    }];
+}
+
+- (void)removeDataForKeys:(NSArray *)keys {
+    [self _removeLocalDataForKeys:keys];
+    [_lowerTier removeDataForKeys:keys];
+}
+
+- (void)_removeLocalDataForKeys:(NSArray *)keys {
+    if (_engine) {
+        if ([_engine respondsToSelector:@selector(removeDataForKeys:)]) {
+            [_engine removeDataForKeys:keys];
+        } else {
+            for (NSString *key in keys) {
+                [_engine removeDataForKey:key];
+            }
+        }
+        return;
+    }
+    NSMutableArray *filenames = [[NSMutableArray alloc] initWithCapacity:keys.count];
+    for (NSString *key in keys) {
+        [filenames addObject:[self filenameForKey:key]];
+    }
+    [self _performAfterPendingCommits:^{
+        [_pendingWritesLock lock];
+        for (NSString *filename in filenames) {
+            _DFDiskCachePendingWrite *write = _pendingWrites[filename];
+            if (write) {
+                _pendingWritesSize -= write->_data.length;
+                [_pendingWrites removeObjectForKey:filename];
+            }
+        }
+        [_pendingWritesLock unlock];
+        NSArray *removedFilenames = [self _unlinkFilenames:filenames];
+        [_index removeEntriesForFilenames:removedFilenames];
+        [_journal logRemoveForFilenames:removedFilenames];
+    }];
+}
+
+- (void)removeAllData {
+    [self _removeAllLocalData];
+    [_lowerTier removeAllData];
+}
+
+- (void)_removeAllLocalData {
+    if (_engine) {
+        [_engine removeAllData];
+        return;
+    }
+    [self _performAfterPendingCommits:^{
+        [_pendingWritesLock lock];
+        [_pendingWrites removeAllObjects];
+        _pendingWritesSize = 0;
+        [_pendingWritesLock unlock];
+        if (_sharedIndex) {
+            // The other processes keep the index file and the leader lock mapped, only the entries are removed.
+            [_sharedIndex removeAllEntriesUsingBlock:^{
+                DFDirectoryScan *scan = [self _scanContents];
+                NSMutableArray *filenames = [[NSMutableArray alloc] initWithCapacity:scan.count];
+                for (NSUInteger i = 0; i < scan.count; i++) {
+                    [filenames addObject:[scan filenameStringAtIndex:i]];
+                }
+                [self _unlinkFilenames:filenames];
+            }];
+            return;
+        }
+        [super removeAllData];
+        [_index removeAllEntries];
+        [self _checkpoint];
+    }];
+}
+
+#pragma mark - Key Prefixes
+
+- (BOOL)supportsKeyPrefixes {
+    return [_engine respondsToSelector:@selector(enumerateKeysWithPrefix:usingBlock:)] && [_engine respondsToSelector:@selector(removeDataForKeysWithPrefix:)];
+}
+
+- (void)enumerateKeysWithPrefix:(NSString *)prefix usingBlock:(void (^)(NSString *, BOOL *))block {
+    if (!prefix || !block) {
+        return;
+    }
+    BOOL __block stopped = NO;
+    if (self.supportsKeyPrefixes) {
+        [_engine enumerateKeysWithPrefix:prefix usingBlock:^(NSString *key, BOOL *stop) {
+            block(key, stop);
+            stopped = *stop;
+        }];
+    }
+    DFDiskCache *lowerTier = _lowerTier;
+    if (!stopped && lowerTier.supportsKeyPrefixes) {
+        [lowerTier enumerateKeysWithPrefix:prefix usingBlock:block];
+    }
+}
+
+- (void)removeDataForKeysWithPrefix:(NSString *)prefix {
+    if (!prefix) {
+        return;
+    }
+    if (self.supportsKeyPrefixes) {
+        [_engine removeDataForKeysWithPrefix:prefix];
+    }
+    DFDiskCache *lowerTier = _lowerTier;
+    if (lowerTier.supportsKeyPrefixes) {
+        [lowerTier removeDataForKeysWithPrefix:prefix];
+    }
+}
+
+- (BOOL)containsDataForKey:(NSString *)key {
+    return [self _containsLocalDataForKey:key] || [_lowerTier containsDataForKey:key];
+}
+
+- (BOOL)_containsLocalDataForKey:(NSString *)key {
+    if (_engine) {
+        return key ? [_engine containsDataForKey:key] : NO;
+    }
+    return [self _pendingWriteForKey:key] != nil || [super containsDataForKey:key];
+}
+
+- (void)prefetchDataForKeys:(NSArray *)keys {
+    if (!_engine) {
+        [super prefetchDataForKeys:keys];
+    }
+}
+
+- (NSURL *)URLForKey:(NSString *)key {
+    if (_engine) {
+        [NSException raise:NSInternalInconsistencyException format:@"Disk cache with a storage engine doesn't store entries in files"];
+    }
+    if ([self _pendingWriteForKey:key]) {
+        // Extended attributes of the entry can only be accessed once the entry is moved in place.
+        [self synchronize];
+    }
+    return [super URLForKey:key];
 }
 
+- (id)extendedAttributeValueForName:(NSString *)name key:(NSString *)key {
+    if (!name || !key) {
+        return nil;
+    }
+    if (_lowerTier && ![self _containsLocalDataForKey:key]) {
+        return [_lowerTier extendedAttributeValueForName:name key:key];
+    }
+    if (_engine) {
+        NSDictionary *attributes;
+        _DFDiskCacheUnframe([_engine dataForKey:key], &attributes);
+        return attributes[name];
+    }
+    return [[self URLForKey:key] df_extendedAttributeValueForKey:name error:nil];
+}
+
+- (void)setExtendedAttributeValue:(id)value forName:(NSString *)name key:(NSString *)key {
+    if (!name || !key) {
+        return;
+    }
+    if (_lowerTier && ![self _containsLocalDataForKey:key]) {
+        [_lowerTier setExtendedAttributeValue:value forName:name key:key];
+        return;
+    }
+    if (_engine) {
+        NSDictionary *attributes;
+        NSData *data = _DFDiskCacheUnframe([_engine dataForKey:key], &attributes);
+        if (data) {
+            NSMutableDictionary *mutableAttributes = [[NSMutableDictionary alloc] initWithDictionary:attributes];
+            mutableAttributes[name] = value;
+            [_engine setData:_DFDiskCacheFrame(data, mutableAttributes) forKey:key];
+        }
+        return;
+    }
+    NSURL *fileURL = [self URLForKey:key];
+    if (value) {
+        [fileURL df_setExtendedAttributeValue:value forKey:name];
+    } else {
+        [fileURL df_removeExtendedAttributeForKey:name];
+    }
+}
+
+/*! Writes data and extended attributes to the temporary file and moves it in place. Returns YES if the entry was written.
+ */
+- (BOOL)_writeData:(NSData *)data extendedAttributes:(NSDictionary *)attributes filename:(NSString *)filename synchronize:(BOOL)synchronize {
+    NSString *temporaryFilename = [self _temporaryFilenameForFilename:filename processIdentifier:getpid()];
+    [_journal logBeginForFilename:filename];
+    BOOL success = [self _writeData:data extendedAttributes:attributes toFilename:temporaryFilename synchronize:synchronize];
+    return [self _moveTemporaryFilename:temporaryFilename toFilename:filename success:success accessTime:CFAbsoluteTimeGetCurrent()];
+}
+
+/*! Moves written temporary file in place and indexes it with the given access time. Removes temporary file if the write failed.
+ */
+- (BOOL)_moveTemporaryFilename:(NSString *)temporaryFilename toFilename:(NSString *)filename success:(BOOL)success accessTime:(CFAbsoluteTime)accessTime {
+    success = success && [self _renameFilename:temporaryFilename toFilename:filename] == 0;
+    if (success) {
+        [self _indexFilename:filename accessTime:accessTime];
+    } else {
+        [self _unlinkFilename:temporaryFilename];
+        [_journal logAbortForFilename:filename];
+    }
+    return success;
+}
+
+- (void)_synchronizeDirectory {
+    int directoryDescriptor = [self _directoryDescriptor];
+    if (directoryDescriptor >= 0) {
+        _DFDiskCacheFullSynchronizeFile(directoryDescriptor);
+        return;
+    }
+    int fd = open([self.path fileSystemRepresentation], O_RDONLY);
+    if (fd >= 0) {
+        _DFDiskCacheFullSynchronizeFile(fd);
+        close(fd);
+    }
+}
+
+#pragma mark - Group Commit
+
+- (void)setDurability:(DFDiskCacheDurability)durability {
+    if (_durability == DFDiskCacheDurabilityGroupCommit && durability != _durability) {
+        [self synchronize];
+    }
+    _durability = durability;
+}
+
+- (void)synchronize {
+    if (_engine) {
+        if ([_engine respondsToSelector:@selector(synchronize)]) {
+            [_engine synchronize];
+        }
+        return;
+    }
+    dispatch_sync(_commitQueue, ^{
+        [self _commitPendingWrites];
+    });
+    [_journal synchronize];
+}
+
+- (_DFDiskCachePendingWrite *)_pendingWriteForKey:(NSString *)key {
+    if (!key || _durability != DFDiskCacheDurabilityGroupCommit) {
+        return nil;
+    }
+    NSString *filename = [self filenameForKey:key];
+    [_pendingWritesLock lock];
+    _DFDiskCachePendingWrite *write = _pendingWrites[filename];
+    [_pendingWritesLock unlock];
+    return write;
+}
+
+- (void)_addPendingWriteWithData:(NSData *)data extendedAttributes:(NSDictionary *)attributes filename:(NSString *)filename {
+    _DFDiskCachePendingWrite *write = [_DFDiskCachePendingWrite new];
+    write->_filename = filename;
+    write->_data = data;
+    write->_attributes = attributes;
+    
+    [_pendingWritesLock lock];
+    _DFDiskCachePendingWrite *previousWrite = _pendingWrites[filename];
+    if (previousWrite) {
+        _pendingWritesSize -= previousWrite->_data.length;
+    }
+    _pendingWrites[filename] = write;
+    _pendingWritesSize += data.length;
+    BOOL commitNow = _pendingWritesSize >= _groupCommitByteThreshold;
+    BOOL scheduleCommit = !commitNow && !_groupCommitScheduled;
+    _groupCommitScheduled = _groupCommitScheduled || scheduleCommit;
+    [_pendingWritesLock unlock];
+    
+    if (commitNow) {
+        dispatch_async(_commitQueue, ^{
+            [self _commitPendingWrites];
+        });
+    } else if (scheduleCommit) {
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(_groupCommitInterval * NSEC_PER_SEC)), _commitQueue, ^{
+            [self _commitPendingWrites];
+        });
+    }
+}
+
+/*! Writes pending entries to temporary files, synchronizes each file, moves them in place and then flushes the drive cache once for the entire group. Must be called on commit queue.
+ */
+- (void)_commitPendingWrites {
+    [_pendingWritesLock lock];
+    NSArray *writes = [_pendingWrites allValues];
+    _groupCommitScheduled = NO;
+    [_pendingWritesLock unlock];
+    if (!writes.count) {
+        return;
+    }
+    for (_DFDiskCachePendingWrite *write in writes) {
+        [self _writeData:write->_data extendedAttributes:write->_attributes filename:write->_filename synchronize:YES];
+    }
+    [_journal synchronize];
+    [self _synchronizeDirectory];
+    
+    [_pendingWritesLock lock];
+    for (_DFDiskCachePendingWrite *write in writes) {
+        // Failed writes are dropped. The entry might have been overwritten by a newer write that is still pending.
+        if (_pendingWrites[write->_filename] == write) {
+            _pendingWritesSize -= write->_data.length;
+            [_pendingWrites removeObjectForKey:write->_filename];
+        }
+    }
+    [_pendingWritesLock unlock];
+}
+
+/*! Performs the block once the writes that are already being committed are moved in place so that they don't resurrect removed entries.
+ */
+- (void)_performAfterPendingCommits:(dispatch_block_t)block {
+    if (_durability == DFDiskCacheDurabilityGroupCommit) {
+        dispatch_sync(_commitQueue, block);
+    } else {
+        block();
+    }
+}
+
+#pragma mark - Contents
+
+- (_dwarf_cache_bytes)contentsSize {
+    if (_engine) {
+        return [_engine contentsSize];
+    }
+    return _index.isReady ? _index.totalSize : [super contentsSize];
+}
+
+- (_dwarf_cache_bytes)contentsLogicalSize {
+    if (_engine) {
+        return [_engine respondsToSelector:@selector(contentsLogicalSize)] ? [_engine contentsLogicalSize] : [_engine contentsSize];
+    }
+    return _index.isReady ? _index.totalLogicalSize : [super contentsLogicalSize];
+}
+
+- (NSUInteger)contentsCount {
+    if (_engine) {
+        NSUInteger __block count = 0;
+        [_engine enumerateEntriesUsingBlock:^(NSString *identifier, DFStorageEntryStat stat, BOOL *stop) {
+            count++;
+        }];
+        return count;
+    }
+    return _index.isReady ? _index.count : [super contentsCount];
+}
+
+/*! Corrects the index with the scan of the storage directory once the index is ready, otherwise reconciles the running totals of the file storage. Entries of the files that differ from the index are indexed again with their current state.
+ */
+- (long long)reconcileContents {
+    if (_engine) {
+        return 0;
+    }
+    long long drift = _index.isReady ? [self _reconcileIndex] : [super reconcileContents];
+    [self _updateStatistics:^(DFDiskCacheStatistics *statistics) {
+        statistics->reconciliationCount++;
+        statistics->contentsSizeDrift += (unsigned long long)llabs(drift);
+    }];
+    return drift;
+}
+
+- (long long)_reconcileIndex {
+    _dwarf_cache_bytes indexSize = _index.totalSize;
+    DFDirectoryScan *scan = [self _scanContents];
+    NSMutableSet *filenames = [[NSMutableSet alloc] initWithCapacity:scan.count];
+    NSMutableArray *mismatchedFilenames = [NSMutableArray new];
+    for (NSUInteger i = 0; i < scan.count; i++) {
+        NSString *filename = [scan filenameStringAtIndex:i];
+        [filenames addObject:filename];
+        DFDiskCacheIndexEntry *entry = [_index entryForFilename:filename];
+        if (!entry || entry.size != scan.entries[i].size || entry.logicalSize != scan.entries[i].logicalSize) {
+            [mismatchedFilenames addObject:filename];
+        }
+    }
+    for (DFDiskCacheIndexEntry *entry in [_index entriesSortedByAccessTime]) {
+        if (![filenames containsObject:entry.filename]) {
+            [mismatchedFilenames addObject:entry.filename];
+        }
+    }
+    // Files might be written or removed during the scan, each file is checked again before the index is corrected.
+    for (NSString *filename in mismatchedFilenames) {
+        DFDiskCacheIndexEntry *entry = [_index entryForFilename:filename];
+        [self _indexFilename:filename accessTime:(entry ? entry.accessTime : CFAbsoluteTimeGetCurrent())];
+    }
+    return (long long)_index.totalSize - (long long)indexSize;
+}
+
+#pragma mark - Index
+
+- (void)_buildIndex {
+    NSUInteger generation = [_index beginBuild];
+    DFDiskCache *__weak weakSelf = self;
+    dispatch_async(_indexQueue, ^{
+        DFDiskCache *strongSelf = weakSelf;
+        [strongSelf _buildIndexWithGeneration:generation];
+    });
+}
+
+/*! Loads index from the snapshot and replays the journal on top of it. Scans storage directory if either of them is missing or they don't match.
+ */
+- (void)_buildIndexWithGeneration:(NSUInteger)generation {
+    uint64_t epoch = 0;
+    NSArray *snapshotEntries = [DFDiskCacheIndex entriesFromSnapshotAtPath:[self _indexSnapshotPath] epoch:&epoch];
+    NSArray *records = (snapshotEntries && epoch == _journal.epoch) ? [_journal recordsWrittenBeforeOpen] : nil;
+    NSArray *entries = records ? [self _entriesByReplayingJournalRecords:records snapshotEntries:snapshotEntries] : [self _entriesByScanningContents];
+    [_index finishBuildWithEntries:entries generation:generation];
+    [self _checkpoint];
+}
+
+- (NSArray *)_entriesByReplayingJournalRecords:(NSArray *)records snapshotEntries:(NSArray *)snapshotEntries {
+    NSMutableDictionary *entries = [[NSMutableDictionary alloc] initWithCapacity:snapshotEntries.count];
+    for (DFDiskCacheIndexEntry *entry in snapshotEntries) {
+        entries[entry.filename] = entry;
+    }
+    NSMutableDictionary *pendingWrites = [NSMutableDictionary new]; // File name -> process identifier
+    for (DFDiskCacheJournalRecord *record in records) {
+        switch (record.type) {
+            case DFDiskCacheJournalRecordTypeBegin:
+                pendingWrites[record.filename] = @(record.value);
+                break;
+            case DFDiskCacheJournalRecordTypeCommit:
+                [pendingWrites removeObjectForKey:record.filename];
+                entries[record.filename] = [[DFDiskCacheIndexEntry alloc] initWithFilename:record.filename size:record.value logicalSize:record.logicalSize accessTime:record.time];
+                break;
+            case DFDiskCacheJournalRecordTypeAbort:
+                [pendingWrites removeObjectForKey:record.filename];
+                break;
+            case DFDiskCacheJournalRecordTypeRemove:
+                [entries removeObjectForKey:record.filename];
+                break;
+            case DFDiskCacheJournalRecordTypeAccess:
+                ((DFDiskCacheIndexEntry *)entries[record.filename]).accessTime = record.time;
+                break;
+        }
+    }
+    // Writes that were interrupted. Data and attributes are moved in place with a single rename(2) so the entry is either complete or wasn't written at all.
+    [pendingWrites enumerateKeysAndObjectsUsingBlock:^(NSString *filename, NSNumber *processIdentifier, BOOL *stop) {
+        [self _unlinkFilename:[self _temporaryFilenameForFilename:filename processIdentifier:processIdentifier.intValue]];
+        struct stat fileStat;
+        if ([self _statFilename:filename stat:&fileStat] == 0) {
+            entries[filename] = [[DFDiskCacheIndexEntry alloc] initWithFilename:filename size:(fileStat.st_blocks * 512) logicalSize:fileStat.st_size accessTime:fileStat.st_atimespec.tv_sec - kCFAbsoluteTimeIntervalSince1970];
+        } else {
+            [entries removeObjectForKey:filename];
+        }
+    }];
+    return [entries allValues];
+}
+
+- (NSArray *)_entriesByScanningContents {
+    // Hidden files are included in the scan to find temporary files.
+    DFDirectoryScan *scan = [[DFDirectoryScan alloc] initWithPath:self.path options:DFDirectoryScanOptionNone];
+    NSMutableArray *entries = [[NSMutableArray alloc] initWithCapacity:scan.count];
+    const char *temporaryPrefix = [DFFileStorageTemporaryFilePrefix fileSystemRepresentation];
+    const size_t temporaryPrefixLength = strlen(temporaryPrefix);
+    for (NSUInteger i = 0; i < scan.count; i++) {
+        const char *filename = [scan filenameAtIndex:i];
+        if (filename[0] == '.') {
+            // Remove temporary files left by the interrupted writes of the other processes. Processes that share disk cache might still be writing them, only the files of the processes that are no longer running are removed.
+            if (strncmp(filename, temporaryPrefix, temporaryPrefixLength) == 0) {
+                pid_t processIdentifier = (pid_t)strtol(filename + temporaryPrefixLength, NULL, 10);
+                BOOL terminated = processIdentifier > 0 && kill(processIdentifier, 0) != 0 && errno == ESRCH;
+                if (processIdentifier != getpid() && (!_sharedIndex || terminated)) {
+                    [self _unlinkFilename:[scan filenameStringAtIndex:i]];
+                }
+            }
+            continue;
+        }
+        const DFDirectoryScanEntry *entry = &scan.entries[i];
+        [entries addObject:[[DFDiskCacheIndexEntry alloc] initWithFilename:[scan filenameStringAtIndex:i] size:entry->size logicalSize:entry->logicalSize accessTime:entry->accessTime]];
+    }
+    return entries;
+}
+
+- (void)_indexFilename:(NSString *)filename accessTime:(CFAbsoluteTime)accessTime {
+    struct stat fileStat;
+    if ([self _statFilename:filename stat:&fileStat] == 0) {
+        unsigned long long size = fileStat.st_blocks * 512;
+        unsigned long long logicalSize = fileStat.st_size;
+        [_index setSize:size logicalSize:logicalSize accessTime:accessTime forFilename:filename];
+        [_journal logCommitForFilename:filename size:size logicalSize:logicalSize accessTime:accessTime];
+    } else {
+        [_index removeEntryForFilename:filename];
+        [_journal logAbortForFilename:filename];
+    }
+}
+
+- (NSString *)_indexSnapshotPath {
+    return [self.internalDirectoryPath stringByAppendingPathComponent:@"index"];
+}
+
+/*! Writes index snapshot and starts a new journal so that the next time disk cache is initialized it only has to replay the mutations made after the checkpoint.
+ */
+- (void)_checkpoint {
+    if (!_index.isReady) {
+        return;
+    }
+    NSString *snapshotPath = [self _indexSnapshotPath]; // Creates internal directory if needed
+    DFDiskCacheIndex *index = _index;
+    [_journal checkpointWithSnapshotBlock:^BOOL(uint64_t epoch) {
+        return [index writeSnapshotToFile:snapshotPath epoch:epoch];
+    }];
+}
+
+#pragma mark - Cleanup
+
 - (void)cleanup {
+    [self _cleanupContents];
+    // Entries evicted from this tier are demoted to the lower tier which might need cleanup as well.
+    [_lowerTier cleanup];
+}
+
+- (void)_cleanupContents {
+    [self.tuner tuneDiskCache:self];
     if (_capacity == DFDiskCacheCapacityUnlimited) {
         return;
     }
-    NSArray *resourceKeys = @[NSURLContentAccessDateKey, NSURLFileAllocatedSizeKey];
-    NSArray *contents = [self contentsWithResourceKeys:resourceKeys];
-    NSMutableDictionary *fileAttributes = [NSMutableDictionary dictionary];
-    _dwarf_cache_bytes contentsSize = 0;
-    for (NSURL *fileURL in contents) {
-        NSDictionary *resourceValues = [fileURL resourceValuesForKeys:resourceKeys error:NULL];
-        if (resourceValues) {
-            fileAttributes[fileURL] = resourceValues;
-            NSNumber *fileSize = resourceValues[NSURLFileAllocatedSizeKey];
-            contentsSize += [fileSize unsignedLongLongValue];
+    if (_engine) {
+        [self _cleanupWithEngineEntries];
+        return;
+    }
+    if (_sharedIndex) {
+        if (![_sharedIndex acquireLeadership]) {
+            return;
         }
+        if (!_index.isReady) {
+            // The previous leader terminated before the build finished or the index overflowed.
+            [self _buildIndexWithGeneration:[_index beginBuild]];
+        }
+    }
+    if (!_index.isReady) {
+        [self _cleanupWithContentsScan];
+        return;
+    }
+    _dwarf_cache_bytes contentsSize = _index.totalSize;
+    if (contentsSize >= _capacity) {
+        const _dwarf_cache_bytes desiredSize = _capacity * _cleanupRate;
+        NSMutableArray *filenames = [NSMutableArray new];
+        for (DFDiskCacheIndexEntry *entry in [_index entriesSortedByAccessTime]) {
+            if (contentsSize < desiredSize) {
+                break;
+            }
+            contentsSize -= MIN(contentsSize, entry.size);
+            [filenames addObject:entry.filename];
+        }
+        [self _evictFilenames:filenames];
+    }
+    [_sharedIndex compact];
+    if (_index.isDirty) {
+        [self _checkpoint];
     }
+}
+
+/*! Fallback cleanup that is used until index is ready.
+ */
+- (void)_cleanupWithContentsScan {
+    DFDirectoryScan *scan = [self _scanContents];
+    _dwarf_cache_bytes contentsSize = scan.totalSize;
     if (contentsSize < _capacity) {
         return;
     }
     const _dwarf_cache_bytes desiredSize = _capacity * _cleanupRate;
-    NSArray *sortedFiles = [fileAttributes keysSortedByValueWithOptions:NSSortConcurrent usingComparator:^NSComparisonResult(id obj1, id obj2) {
-        return [obj1[NSURLContentAccessDateKey] compare:obj2[NSURLContentAccessDateKey]];
+    const DFDirectoryScanEntry *entries = scan.entries;
+    NSUInteger *order = malloc(scan.count * sizeof(NSUInteger));
+    for (NSUInteger i = 0; i < scan.count; i++) {
+        order[i] = i;
+    }
+    qsort_b(order, scan.count, sizeof(NSUInteger), ^int(const void *lhs, const void *rhs) {
+        CFAbsoluteTime time1 = entries[*(const NSUInteger *)lhs].accessTime;
+        CFAbsoluteTime time2 = entries[*(const NSUInteger *)rhs].accessTime;
+        return time1 < time2 ? -1 : (time1 > time2 ? 1 : 0);
+    });
+    NSMutableArray *filenames = [NSMutableArray new];
+    for (NSUInteger i = 0; i < scan.count && contentsSize >= desiredSize; i++) {
+        contentsSize -= MIN(contentsSize, entries[order[i]].size);
+        [filenames addObject:[scan filenameStringAtIndex:order[i]]];
+    }
+    free(order);
+    [self _evictFilenames:filenames];
+}
+
+/*! Cleanup that is used by the disk cache with a storage engine. Engine entries are enumerated and evicted in the order of their access times.
+ */
+- (void)_cleanupWithEngineEntries {
+    if ([_engine contentsSize] < _capacity) {
+        return;
+    }
+    NSMutableArray *identifiers = [NSMutableArray new];
+    NSMutableData *stats = [NSMutableData new];
+    [_engine enumerateEntriesUsingBlock:^(NSString *identifier, DFStorageEntryStat stat, BOOL *stop) {
+        [identifiers addObject:identifier];
+        [stats appendBytes:&stat length:sizeof(stat)];
     }];
-    for (NSURL *fileURL in sortedFiles) {
-        if (contentsSize < desiredSize) {
-            break;
-        }
-        if ([[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil]) {
-            NSNumber *fileSize = fileAttributes[fileURL][NSURLFileAllocatedSizeKey];
-            contentsSize -= [fileSize unsignedLongLongValue];
-        }
+    const DFStorageEntryStat *entries = stats.bytes;
+    NSUInteger count = identifiers.count;
+    _dwarf_cache_bytes contentsSize = 0;
+    for (NSUInteger i = 0; i < count; i++) {
+        contentsSize += entries[i].size;
+    }
+    const _dwarf_cache_bytes desiredSize = _capacity * _cleanupRate;
+    NSUInteger *order = malloc(MAX(count, 1) * sizeof(NSUInteger));
+    for (NSUInteger i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    qsort_b(order, count, sizeof(NSUInteger), ^int(const void *lhs, const void *rhs) {
+        CFAbsoluteTime time1 = entries[*(const NSUInteger *)lhs].accessTime;
+        CFAbsoluteTime time2 = entries[*(const NSUInteger *)rhs].accessTime;
+        return time1 < time2 ? -1 : (time1 > time2 ? 1 : 0);
+    });
+    NSMutableArray *evictedIdentifiers = [NSMutableArray new];
+    for (NSUInteger i = 0; i < count && contentsSize >= desiredSize; i++) {
+        contentsSize -= MIN(contentsSize, entries[order[i]].size);
+        [evictedIdentifiers addObject:identifiers[order[i]]];
+    }
+    free(order);
+    [self _evictFilenames:evictedIdentifiers];
+}
+
+/*! Removes files in parallel, then applies the removals to the index and the journal in a single batch. Disk cache with a storage engine removes the entries with the given identifiers instead.
+ */
+- (void)_evictFilenames:(NSArray *)filenames {
+    if (!filenames.count) {
+        return;
+    }
+    if (_lowerTier) {
+        [self _demoteIdentifiers:filenames];
+    }
+    NSArray *removedFilenames = filenames;
+    if (_engine) {
+        [_engine removeEntriesWithIdentifiers:filenames];
+    } else {
+        removedFilenames = [self _unlinkFilenames:filenames];
+        [_index removeEntriesForFilenames:removedFilenames];
+        [_journal logRemoveForFilenames:removedFilenames];
+    }
+    [self _didEvictIdentifiers:removedFilenames];
+}
+
+/*! Counts the evicted entries and remembers them in the ghost list. Also called by the storage engines that evict entries on their own.
+ */
+- (void)_didEvictIdentifiers:(NSArray *)identifiers {
+    NSUInteger count = identifiers.count;
+    [self _updateStatistics:^(DFDiskCacheStatistics *statistics) {
+        statistics->evictionCount += count;
+    }];
+    for (NSString *identifier in identifiers) {
+        [self _addFilenameToGhostList:identifier];
     }
 }
 
@@ -58,10 +1096,380 @@
     return [NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES) firstObject];
 }
 
+#pragma mark - Tiers
+
+- (void)setLowerTier:(DFDiskCache *)lowerTier {
+    for (DFDiskCache *tier = lowerTier; tier; tier = tier.lowerTier) {
+        if (tier == self) {
+            [NSException raise:NSInvalidArgumentException format:@"Attempting to create a cycle of disk cache tiers"];
+        }
+    }
+    if (lowerTier && (lowerTier->_engine == nil) != (_engine == nil)) {
+        [NSException raise:NSInvalidArgumentException format:@"Disk cache tiers must either both keep entries in files or both use storage engines"];
+    }
+    _lowerTier = lowerTier;
+}
+
+- (BOOL)_bypassesData:(NSData *)data {
+    return _lowerTier && _largeValueThreshold > 0 && data.length > _largeValueThreshold;
+}
+
+/*! Counts the hits of the entry in the lower tier and moves the entry to this tier once it reaches promotion threshold.
+ */
+- (void)_didReadLowerTierDataForKey:(NSString *)key {
+    if (!_promotionThreshold) {
+        return;
+    }
+    NSUInteger hitCount = [[_promotionCandidates objectForKey:key] unsignedIntegerValue] + 1;
+    if (hitCount < _promotionThreshold) {
+        [_promotionCandidates setObject:@(hitCount) forKey:key];
+        return;
+    }
+    [_promotionCandidates removeObjectForKey:key];
+    DFDiskCache *lowerTier = _lowerTier;
+    NSString *identifier = [lowerTier identifierForKey:key];
+    DFCacheArchiveEntry *entry = [lowerTier _archiveEntryWithIdentifier:(lowerTier->_engine ? key : identifier) accessTime:CFAbsoluteTimeGetCurrent()];
+    if (entry && ![self _bypassesData:entry.data] && [self _importArchiveEntries:@[ entry ]]) {
+        [lowerTier removeEntriesWithIdentifiers:@[ identifier ]];
+        [self _updateStatistics:^(DFDiskCacheStatistics *statistics) {
+            statistics->promotionCount++;
+        }];
+    }
+}
+
+/*! Moves the entries that are about to be evicted to the lower tier. Entries keep their access times. Entries which keys the engine can't tell (see -[DFStorageEngine keyForIdentifier:]) are evicted without demotion.
+ */
+- (void)_demoteIdentifiers:(NSArray *)identifiers {
+    NSMutableArray *entries = [NSMutableArray new];
+    unsigned long long entriesSize = 0;
+    for (NSString *identifier in identifiers) {
+        NSString *archiveIdentifier = [self _archiveIdentifierForIdentifier:identifier];
+        if (!archiveIdentifier) {
+            continue;
+        }
+        DFDiskCacheIndexEntry *indexEntry = [_index entryForFilename:identifier];
+        DFCacheArchiveEntry *entry = [self _archiveEntryWithIdentifier:archiveIdentifier accessTime:(indexEntry ? indexEntry.accessTime : CFAbsoluteTimeGetCurrent())];
+        if (!entry) {
+            continue;
+        }
+        [entries addObject:entry];
+        entriesSize += entry.data.length;
+        if (entries.count >= DFDiskCacheImportBatchCount || entriesSize >= DFDiskCacheImportBatchSize) {
+            [self _demoteArchiveEntries:entries];
+            [entries removeAllObjects];
+            entriesSize = 0;
+        }
+    }
+    if (entries.count) {
+        [self _demoteArchiveEntries:entries];
+    }
+}
+
+- (void)_demoteArchiveEntries:(NSArray *)entries {
+    [_lowerTier _importArchiveEntries:entries];
+    NSUInteger count = entries.count;
+    [self _updateStatistics:^(DFDiskCacheStatistics *statistics) {
+        statistics->demotionCount += count;
+    }];
+}
+
+#pragma mark - Ghost List
+
+@synthesize ghostListCapacity = _ghostListCapacity;
+
+- (void)setGhostListCapacity:(NSUInteger)ghostListCapacity {
+    dispatch_async(_statisticsQueue, ^{
+        _ghostListCapacity = ghostListCapacity;
+        [self _trimGhostList];
+    });
+}
+
+- (NSUInteger)ghostListCapacity {
+    NSUInteger __block capacity;
+    dispatch_sync(_statisticsQueue, ^{
+        capacity = _ghostListCapacity;
+    });
+    return capacity;
+}
+
+/*! Entries are evicted by cleanup and by the storage engine on any thread, ghost list is only accessed on statistics queue.
+ */
+- (void)_addFilenameToGhostList:(NSString *)filename {
+    if (!filename) {
+        return;
+    }
+    NSNumber *hash = @([filename hash]);
+    dispatch_async(_statisticsQueue, ^{
+        if (!_ghostListCapacity) {
+            return;
+        }
+        [_ghostList removeObject:hash];
+        [_ghostList addObject:hash];
+        [self _trimGhostList];
+    });
+}
+
+/*! Must be called on statistics queue.
+ */
+- (void)_trimGhostList {
+    if (_ghostList.count > _ghostListCapacity) {
+        [_ghostList removeObjectsInRange:NSMakeRange(0, _ghostList.count - _ghostListCapacity)];
+    }
+}
+
+- (void)_checkGhostListForFilename:(NSString *)filename {
+    if (!filename) {
+        return;
+    }
+    NSNumber *hash = @([filename hash]);
+    dispatch_async(_statisticsQueue, ^{
+        if ([_ghostList containsObject:hash]) {
+            // Each evicted entry counts as a ghost hit at most once.
+            [_ghostList removeObject:hash];
+            _statistics.ghostHitCount++;
+        }
+    });
+}
+
+#pragma mark - Storage Engine
+
+- (BOOL)getStat:(DFStorageEntryStat *)stat forKey:(NSString *)key {
+    return _engine ? [_engine getStat:stat forKey:key] : [super getStat:stat forKey:key];
+}
+
+- (NSString *)identifierForKey:(NSString *)key {
+    return _engine ? [_engine identifierForKey:key] : [super identifierForKey:key];
+}
+
+- (void)enumerateEntriesUsingBlock:(void (^)(NSString *, DFStorageEntryStat, BOOL *))block {
+    if (_engine) {
+        [_engine enumerateEntriesUsingBlock:block];
+    } else {
+        [super enumerateEntriesUsingBlock:block];
+    }
+}
+
+/*! Unlike eviction doesn't affect statistics and ghost list.
+ */
+- (void)removeEntriesWithIdentifiers:(NSArray *)identifiers {
+    if (_engine) {
+        [_engine removeEntriesWithIdentifiers:identifiers];
+        return;
+    }
+    [self _performAfterPendingCommits:^{
+        NSArray *removedFilenames = [self _unlinkFilenames:identifiers];
+        [_index removeEntriesForFilenames:removedFilenames];
+        [_journal logRemoveForFilenames:removedFilenames];
+    }];
+}
+
+#pragma mark - Export & Import
+
+- (BOOL)exportContentsToStream:(NSOutputStream *)stream {
+    [self synchronize];
+    NSMutableArray *identifiers = [NSMutableArray new];
+    NSMutableData *accessTimes = [NSMutableData new];
+    if (!_engine && _index.isReady) {
+        for (DFDiskCacheIndexEntry *entry in [_index entriesSortedByAccessTime]) {
+            CFAbsoluteTime accessTime = entry.accessTime;
+            [identifiers addObject:entry.filename];
+            [accessTimes appendBytes:&accessTime length:sizeof(accessTime)];
+        }
+    } else {
+        BOOL __block unknownKeys = NO;
+        [self enumerateEntriesUsingBlock:^(NSString *identifier, DFStorageEntryStat stat, BOOL *stop) {
+            NSString *archiveIdentifier = [self _archiveIdentifierForIdentifier:identifier];
+            if (!archiveIdentifier) {
+                unknownKeys = YES;
+                *stop = YES;
+                return;
+            }
+            [identifiers addObject:archiveIdentifier];
+            [accessTimes appendBytes:&stat.accessTime length:sizeof(stat.accessTime)];
+        }];
+        if (unknownKeys) {
+            return NO;
+        }
+    }
+    DFCacheArchiveWriter *writer = [[DFCacheArchiveWriter alloc] initWithStream:stream];
+    const CFAbsoluteTime *times = accessTimes.bytes;
+    BOOL success = YES;
+    for (NSUInteger start = 0; start < identifiers.count && success; start += DFDiskCacheImportBatchCount) {
+        // Entries of the batch are read in parallel and written to the archive in order.
+        NSUInteger count = MIN(DFDiskCacheImportBatchCount, identifiers.count - start);
+        NSMutableArray *entries = [[NSMutableArray alloc] initWithCapacity:count];
+        for (NSUInteger i = 0; i < count; i++) {
+            [entries addObject:[NSNull null]];
+        }
+        NSLock *lock = [NSLock new];
+        dispatch_apply(count, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+            DFCacheArchiveEntry *entry = [self _archiveEntryWithIdentifier:identifiers[start + i] accessTime:times[start + i]];
+            if (entry) {
+                [lock lock];
+                entries[i] = entry;
+                [lock unlock];
+            }
+        });
+        for (DFCacheArchiveEntry *entry in entries) {
+            // Entries removed since the enumeration are skipped.
+            if (entry != (id)[NSNull null] && ![writer writeEntry:entry]) {
+                success = NO;
+                break;
+            }
+        }
+    }
+    return [writer finish] && success;
+}
+
+/*! Entries of the storage engine are archived with their keys, files with their names. Returns nil if the engine doesn't know the key of the entry.
+ */
+- (NSString *)_archiveIdentifierForIdentifier:(NSString *)identifier {
+    if (!_engine) {
+        return identifier;
+    }
+    return [_engine respondsToSelector:@selector(keyForIdentifier:)] ? [_engine keyForIdentifier:identifier] : nil;
+}
+
+/*! Reads the entry with the given archive identifier (see -_archiveIdentifierForIdentifier:).
+ */
+- (DFCacheArchiveEntry *)_archiveEntryWithIdentifier:(NSString *)identifier accessTime:(CFAbsoluteTime)accessTime {
+    NSData *data;
+    NSDictionary *attributes;
+    if (_engine) {
+        NSDictionary *values;
+        data = _DFDiskCacheUnframe([_engine dataForKey:identifier], &values);
+        NSMutableDictionary *archivedValues = [[NSMutableDictionary alloc] initWithCapacity:values.count];
+        for (NSString *name in values) {
+            archivedValues[name] = [NSKeyedArchiver archivedDataWithRootObject:values[name]];
+        }
+        attributes = archivedValues;
+    } else {
+        data = [self _readFilename:identifier archivedExtendedAttributes:&attributes];
+    }
+    return data ? [[DFCacheArchiveEntry alloc] initWithIdentifier:identifier data:data attributes:attributes accessTime:accessTime] : nil;
+}
+
+- (BOOL)importContentsFromStream:(NSInputStream *)stream {
+    DFCacheArchiveReader *reader = [[DFCacheArchiveReader alloc] initWithStream:stream];
+    dispatch_group_t group = dispatch_group_create();
+    dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+    BOOL __block success = YES;
+    NSMutableArray *batch = [NSMutableArray new];
+    unsigned long long batchSize = 0;
+    DFCacheArchiveEntry *entry;
+    do {
+        entry = [reader nextEntry];
+        if (entry) {
+            [batch addObject:entry];
+            batchSize += entry.data.length;
+        }
+        if (batch.count && (!entry || batch.count >= DFDiskCacheImportBatchCount || batchSize >= DFDiskCacheImportBatchSize)) {
+            // Only one batch is written at a time.
+            dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+            NSArray *entries = [batch copy];
+            dispatch_group_async(group, queue, ^{
+                if (![self _importArchiveEntries:entries]) {
+                    success = NO;
+                }
+            });
+            [batch removeAllObjects];
+            batchSize = 0;
+        }
+    } while (entry);
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    if (_engine) {
+        [self synchronize];
+    } else if (_durability != DFDiskCacheDurabilityNone) {
+        [_journal synchronize];
+        [self _synchronizeDirectory];
+    }
+    return success && reader.isFinished;
+}
+
+/*! Writes entries in parallel. Returns NO if any of the entries wasn't written.
+ */
+- (BOOL)_importArchiveEntries:(NSArray *)entries {
+    // Concurrent writes of the same identifier would race for its temporary file, the last entry with the identifier wins.
+    entries = [self _archiveEntriesByRemovingDuplicateIdentifiers:entries];
+    BOOL *failures = calloc(MAX(entries.count, 1), sizeof(BOOL));
+    const BOOL synchronize = _durability != DFDiskCacheDurabilityNone;
+    dispatch_apply(entries.count, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        DFCacheArchiveEntry *entry = entries[i];
+        if (_engine) {
+            NSMutableDictionary *values = [[NSMutableDictionary alloc] initWithCapacity:entry.attributes.count];
+            for (NSString *name in entry.attributes) {
+                id value = [NSKeyedUnarchiver unarchiveObjectWithData:entry.attributes[name]];
+                if (value) {
+                    values[name] = value;
+                }
+            }
+            [_engine setData:_DFDiskCacheFrame(entry.data, values) forKey:entry.identifier];
+            return;
+        }
+        NSString *filename = entry.identifier;
+        // Identifiers come from the archive, only plain file names are accepted.
+        if ([filename hasPrefix:@"."] || [filename rangeOfString:@"/"].location != NSNotFound) {
+            failures[i] = YES;
+            return;
+        }
+        NSString *temporaryFilename = [self _temporaryFilenameForFilename:filename processIdentifier:getpid()];
+        [_journal logBeginForFilename:filename];
+        BOOL written = [self _writeData:entry.data archivedExtendedAttributes:entry.attributes toFilename:temporaryFilename synchronize:synchronize];
+        failures[i] = ![self _moveTemporaryFilename:temporaryFilename toFilename:filename success:written accessTime:entry.accessTime];
+    });
+    BOOL success = YES;
+    for (NSUInteger i = 0; i < entries.count; i++) {
+        success = success && !failures[i];
+    }
+    free(failures);
+    return success;
+}
+
+- (NSArray *)_archiveEntriesByRemovingDuplicateIdentifiers:(NSArray *)entries {
+    NSMutableDictionary *indexes = [[NSMutableDictionary alloc] initWithCapacity:entries.count];
+    [entries enumerateObjectsUsingBlock:^(DFCacheArchiveEntry *entry, NSUInteger index, BOOL *stop) {
+        indexes[entry.identifier] = @(index);
+    }];
+    if (indexes.count == entries.count) {
+        return entries;
+    }
+    NSMutableArray *uniqueEntries = [[NSMutableArray alloc] initWithCapacity:indexes.count];
+    [entries enumerateObjectsUsingBlock:^(DFCacheArchiveEntry *entry, NSUInteger index, BOOL *stop) {
+        if ([indexes[entry.identifier] unsignedIntegerValue] == index) {
+            [uniqueEntries addObject:entry];
+        }
+    }];
+    return uniqueEntries;
+}
+
+#pragma mark - Statistics
+
+- (DFDiskCacheStatistics)statistics {
+    DFDiskCacheStatistics __block statistics;
+    dispatch_sync(_statisticsQueue, ^{
+        statistics = _statistics;
+    });
+    return statistics;
+}
+
+- (void)resetStatistics {
+    dispatch_async(_statisticsQueue, ^{
+        _statistics = (DFDiskCacheStatistics){0};
+    });
+}
+
+/*! Counters are updated from the threads of all reads and writes, updates are serialized on statistics queue.
+ */
+- (void)_updateStatistics:(void (^)(DFDiskCacheStatistics *statistics))block {
+    dispatch_async(_statisticsQueue, ^{
+        block(&_statistics);
+    });
+}
+
 #pragma mark - Miscellaneous
 
 - (NSString *)debugDescription {
-    return [NSString stringWithFormat:@"<%@ %p> { capacity: %@; usage: %@; files: %lu }", [self class], self, _dwarf_bytes_to_str(self.capacity), _dwarf_bytes_to_str(self.contentsSize), (unsigned long)[self contentsWithResourceKeys:nil].count];
+    return [NSString stringWithFormat:@"<%@ %p> { capacity: %@; usage: %@; logical: %@; files: %lu }", [self class], self, _dwarf_bytes_to_str(self.capacity), _dwarf_bytes_to_str(self.contentsSize), _dwarf_bytes_to_str(self.contentsLogicalSize), (unsigned long)self.contentsCount];
 }
 
 @end
@@ -3,13 +3,26 @@
 // Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
 
 #import <Foundation/Foundation.h>
+#import "DFStorageEngine.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
+/*! Hints that tell the kernel how the data is going to be used so that large one-shot reads don't evict frequently used entries from the unified buffer cache.
+ */
+typedef NS_OPTIONS(NSUInteger, DFFileStorageReadOptions) {
+    DFFileStorageReadOptionsNone = 0,
+    /*! The file is going to be read soon, the kernel starts reading it ahead (F_RDADVISE).
+     */
+    DFFileStorageReadOptionWillNeed = 1 << 0,
+    /*! The file is read once, its data is not kept in the buffer cache (F_NOCACHE). Data is read into page-aligned buffer which allows the kernel to bypass the buffer cache.
+     */
+    DFFileStorageReadOptionNoCache = 1 << 1
+};
+
 /*! Key-value file storage.
- @discussion File storage doesn't limit your access to the underlying storage directory.
+ @discussion File storage doesn't limit your access to the underlying storage directory. File storage is the storage engine that keeps each entry in a separate file, entry identifiers are file names.
  */
-@interface DFFileStorage : NSObject
+@interface DFFileStorage : NSObject <DFStorageEngine>
 
 /*! Initializes and returns storage with the given directory path.
  @param path Storage directory path.
@@ -25,10 +38,68 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property (nonatomic, readonly) NSString *path;
 
+/*! Returns path to the hidden directory inside the storage directory that is used for the files that are not storage contents (snapshots, journals, etc). The directory is created on demand. Returns nil if storage has no directory (see DFDiskCache initWithEngine:).
+ */
+@property (nullable, nonatomic, readonly) NSString *internalDirectoryPath;
+
 /*! Returns the contents of the file for the given key.
  */
 - (nullable NSData *)dataForKey:(NSString *)key;
 
+/*! Returns the contents of the file for the given key using the given read options. Options are combined with the ones implied by the noCacheReadThreshold.
+ */
+- (nullable NSData *)dataForKey:(NSString *)key options:(DFFileStorageReadOptions)options;
+
+/*! Returns the contents of the file for the given key and the value of the file extended attribute with the given name. Both are read through a single file descriptor.
+ @param value Pointer to the extended attribute value (see NSURL+DFExtendedFileAttributes). The value is only read if the file exists.
+ */
+- (nullable NSData *)dataForKey:(NSString *)key extendedAttributeValue:(id __nullable __autoreleasing *__nullable)value forName:(nullable NSString *)name;
+
+/*! Returns the contents of the file for the given key and the value of the file extended attribute with the given name using the given read options. All the other read methods call this method.
+ */
+- (nullable NSData *)dataForKey:(NSString *)key options:(DFFileStorageReadOptions)options extendedAttributeValue:(id __nullable __autoreleasing *__nullable)value forName:(nullable NSString *)name;
+
+/*! Advises the kernel to start reading the files for the given keys into the buffer cache and returns immediately.
+ */
+- (void)prefetchDataForKeys:(NSArray *)keys;
+
+/*! Files that are larger than the threshold (in bytes) are read with DFFileStorageReadOptionNoCache option by all the read methods. Default value is 0 which means that the option is never implied.
+ */
+@property (nonatomic) unsigned long long noCacheReadThreshold;
+
+/*! Reads the contents of the file for the given key asynchronously using dispatch I/O. Falls back to the synchronous read if dispatch I/O channel can't be created.
+ @param queue Queue on which the completion is called.
+ */
+- (void)readDataForKey:(NSString *)key queue:(dispatch_queue_t)queue completion:(void (^)(NSData *__nullable data))completion;
+
+/*! Reads the contents of the file for the given key and the value of the file extended attribute with the given name asynchronously. Both are read through a single file descriptor.
+ @param queue Queue on which the completion is called.
+ */
+- (void)readDataForKey:(NSString *)key extendedAttributeName:(nullable NSString *)name queue:(dispatch_queue_t)queue completion:(void (^)(NSData *__nullable data, id __nullable value))completion;
+
+/*! Reads the contents of the files for the given keys asynchronously keeping at most maximumConcurrentReadCount reads in flight. The kernel is advised to read ahead the files that are next in line.
+ @param queue Serial queue on which the completion is called.
+ @param completion Completion block. Batch dictionary contains key:data pairs.
+ */
+- (void)readDataForKeys:(NSArray *)keys queue:(dispatch_queue_t)queue completion:(void (^)(NSDictionary *batch))completion;
+
+/*! Reads the contents of the files for the given keys and the values of the file extended attribute with the given name the same way as -readDataForKeys:queue:completion:. Data and value of each file are read through a single file descriptor.
+ @param completion Completion block. Batch dictionary contains key:data pairs, values dictionary contains key:value pairs of the files that have the attribute.
+ */
+- (void)readDataForKeys:(NSArray *)keys extendedAttributeName:(nullable NSString *)name queue:(dispatch_queue_t)queue completion:(void (^)(NSDictionary *batch, NSDictionary *values))completion;
+
+/*! Maximum number of asynchronous reads that batch read keeps in flight. Default value is 8.
+ */
+@property (nonatomic) NSUInteger maximumConcurrentReadCount;
+
+/*! If YES batch reads read the files in the order of their physical location (see -keysSortedByPhysicalLocation:) instead of the order of the keys, which saves seeks on rotational disks. Default value is YES.
+ */
+@property (nonatomic) BOOL readsInPhysicalOrder;
+
+/*! Returns the keys sorted by the physical location of their files. Files are ordered by their inode numbers which file systems allocate close to the data of the files created at the same time. Keys without files go last.
+ */
+- (NSArray *)keysSortedByPhysicalLocation:(NSArray *)keys;
+
 /*! Creates a file with the specified content for the given key.
  */
 - (void)setData:(NSData *)data forKey:(NSString *)key;
@@ -37,6 +108,19 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (void)removeDataForKey:(NSString *)key;
 
+/*! Removes the files for the given keys. Files are removed in parallel by at most maximumConcurrentRemovalCount workers.
+ */
+- (void)removeDataForKeys:(NSArray *)keys;
+
+/*! Maximum number of files that are removed concurrently by bulk removals. Default value is 4.
+ */
+@property (nonatomic) NSUInteger maximumConcurrentRemovalCount;
+
+/*! Data of this length or shorter is stored inline in the extended attribute of an empty file instead of the file contents. Default value is 0 (disabled).
+ @discussion Many file systems (including HFS+ and APFS) keep small extended attributes together with the file metadata, so inline entries don't use data blocks and are read with a single system call. Keep the threshold under a few kilobytes, larger attributes are stored out of line. Inline entries are accounted by the length of their data in contentsLogicalSize and as a single 4 Kb allocation unit in contentsSize, so disk cache capacity applies to them as to any other entries. Their files are empty, read them using storage methods rather than by the file URL.
+ */
+@property (nonatomic) NSUInteger inlineDataThreshold;
+
 /*! Removes all storage contents.
  */
 - (void)removeAllData;
@@ -58,9 +142,22 @@ NS_ASSUME_NONNULL_BEGIN
 - (NSURL *)URLForKey:(NSString *)key;
 
 /*! Returns the current size of the receiver contents, in bytes.
+ @discussion Storage keeps running totals of its contents that are updated on each write and removal. Storage directory is only scanned the first time the totals are requested. Changes made to the storage directory by other means (for example, by another process) are picked up by -reconcileContents.
  */
 - (unsigned long long)contentsSize;
 
+/*! Returns the total length of the contents of the stored files, in bytes. Unlike contentsSize which counts the allocated disk space, doesn't include the space wasted on partially filled blocks.
+ */
+- (unsigned long long)contentsLogicalSize;
+
+/*! Returns the number of the stored files.
+ */
+- (NSUInteger)contentsCount;
+
+/*! Scans storage directory and replaces running totals of the contents with the actual values. Returns the difference between the actual size of the contents and the running total before the reconciliation, in bytes.
+ */
+- (long long)reconcileContents;
+
 /*! Returns URLs of items contained into storage.
  @param keys An array of keys that identify the file properties that you want pre-fetched for each item in the storage. For each returned URL, the specified properties are fetched and cached in the NSURL object. For a list of keys you can specify, see Common File System Resource Keys.
  */
@@ -3,10 +3,213 @@
 // Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
 
 #import "DFCachePrivate.h"
+#import "DFDirectoryScan.h"
 #import "DFFileStorage.h"
+#import "DFFileStoragePrivate.h"
+#import <fcntl.h>
+#import <sys/xattr.h>
+#import <unistd.h>
+
+/*! Returns YES if *at(2) system calls are available (OS X 10.10, iOS 8 and later).
+ */
+static BOOL _DFFileStorageAtSystemCallsAvailable(void) {
+#if DF_FILE_STORAGE_CHECKS_SYSTEM_CALLS
+    static BOOL available;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        available = (&openat != NULL && &fstatat != NULL && &unlinkat != NULL && &renameat != NULL);
+    });
+    return available;
+#else
+    return YES;
+#endif
+}
+
+/*! Applies read options to the file descriptor.
+ */
+static void _DFFileStorageAdviseFile(int fd, off_t size, DFFileStorageReadOptions options) {
+    if (options & DFFileStorageReadOptionWillNeed) {
+        struct radvisory advisory = { .ra_offset = 0, .ra_count = (int)MIN(size, INT_MAX) };
+        fcntl(fd, F_RDADVISE, &advisory);
+    }
+    if (options & DFFileStorageReadOptionNoCache) {
+        fcntl(fd, F_NOCACHE, 1);
+    }
+}
+
+/*! Files smaller than this are likely to fit into a single extent anyway and are not preallocated.
+ */
+static const off_t DFFileStoragePreallocationThreshold = 64 * 1024;
+
+/*! Preallocates disk space for the file contents of the given size so that the file is written into as few extents as possible. Tries to allocate contiguous space first. Failures are ignored, the file is then simply allocated as it grows.
+ */
+static void _DFFileStoragePreallocateFile(int fd, off_t size) {
+    if (size < DFFileStoragePreallocationThreshold) {
+        return;
+    }
+    fstore_t store = { .fst_flags = F_ALLOCATECONTIG | F_ALLOCATEALL, .fst_posmode = F_PEOFPOSMODE, .fst_offset = 0, .fst_length = size };
+    if (fcntl(fd, F_PREALLOCATE, &store) == -1) {
+        store.fst_flags = F_ALLOCATEALL;
+        fcntl(fd, F_PREALLOCATE, &store);
+    }
+}
+
+/*! Reads the data stored inline in the extended attribute of the empty file. Returns nil if the data is not stored inline.
+ */
+static NSData *_DFFileStorageReadInlineData(int fd) {
+    // Inline data is small, read it with a single system call in the common case.
+    uint8_t buffer[1024];
+    ssize_t size = fgetxattr(fd, DFFileStorageInlineDataAttributeName, buffer, sizeof(buffer), 0, 0);
+    if (size >= 0) {
+        return [NSData dataWithBytes:buffer length:size];
+    }
+    if (errno != ERANGE) {
+        return nil;
+    }
+    size = fgetxattr(fd, DFFileStorageInlineDataAttributeName, NULL, 0, 0, 0);
+    if (size < 0) {
+        return nil;
+    }
+    NSMutableData *data = [NSMutableData dataWithLength:size];
+    size = fgetxattr(fd, DFFileStorageInlineDataAttributeName, data.mutableBytes, data.length, 0, 0);
+    if (size < 0) {
+        return nil;
+    }
+    data.length = size;
+    return data;
+}
+
+/*! Reads the entire contents of the file. Files read with DFFileStorageReadOptionNoCache are read into page-aligned buffer.
+ */
+static NSData *_DFFileStorageReadFile(int fd, DFFileStorageReadOptions options, unsigned long long noCacheThreshold) {
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        return nil;
+    }
+    if (fileStat.st_size == 0) {
+        NSData *data = _DFFileStorageReadInlineData(fd);
+        if (data) {
+            return data;
+        }
+    }
+    size_t size = (size_t)fileStat.st_size;
+    if (noCacheThreshold > 0 && fileStat.st_size > noCacheThreshold) {
+        options |= DFFileStorageReadOptionNoCache;
+    }
+    _DFFileStorageAdviseFile(fd, fileStat.st_size, options);
+    void *buffer = NULL;
+    if (options & DFFileStorageReadOptionNoCache) {
+        size_t pageSize = (size_t)getpagesize();
+        if (posix_memalign(&buffer, pageSize, MAX(size, 1)) != 0) {
+            buffer = NULL;
+        }
+    } else {
+        buffer = malloc(MAX(size, 1));
+    }
+    if (!buffer) {
+        return nil;
+    }
+    size_t offset = 0;
+    while (offset < size) {
+        ssize_t length = pread(fd, (uint8_t *)buffer + offset, size - offset, offset);
+        if (length < 0 && errno == EINTR) {
+            continue;
+        }
+        if (length <= 0) {
+            break;
+        }
+        offset += length;
+    }
+    return [NSData dataWithBytesNoCopy:buffer length:offset freeWhenDone:YES];
+}
+
+/*! Reads the value of the extended attribute archived with NSKeyedArchiver (see NSURL+DFExtendedFileAttributes).
+ */
+static id _DFFileStorageReadExtendedAttributeValue(int fd, NSString *name) {
+    const char *attributeName = [name UTF8String];
+    ssize_t size = fgetxattr(fd, attributeName, NULL, 0, 0, 0);
+    if (size <= 0) {
+        return nil;
+    }
+    NSMutableData *data = [NSMutableData dataWithLength:size];
+    size = fgetxattr(fd, attributeName, data.mutableBytes, data.length, 0, 0);
+    if (size <= 0) {
+        return nil;
+    }
+    data.length = size;
+    return [NSKeyedUnarchiver unarchiveObjectWithData:data];
+}
+
+/*! Reads all extended attributes of the file without unarchiving their values. Skips the inline data and the attributes maintained by the system.
+ */
+static NSDictionary *_DFFileStorageReadExtendedAttributes(int fd) {
+    ssize_t size = flistxattr(fd, NULL, 0, 0);
+    if (size <= 0) {
+        return @{};
+    }
+    NSMutableData *names = [NSMutableData dataWithLength:size];
+    size = flistxattr(fd, names.mutableBytes, names.length, 0);
+    NSMutableDictionary *attributes = [NSMutableDictionary new];
+    for (const char *name = names.bytes; size > 0 && name < (const char *)names.bytes + size; name += strlen(name) + 1) {
+        if (strcmp(name, DFFileStorageInlineDataAttributeName) == 0 || strncmp(name, "com.apple.", 10) == 0) {
+            continue;
+        }
+        ssize_t length = fgetxattr(fd, name, NULL, 0, 0, 0);
+        if (length < 0) {
+            continue;
+        }
+        NSMutableData *value = [NSMutableData dataWithLength:length];
+        length = fgetxattr(fd, name, value.mutableBytes, value.length, 0, 0);
+        NSString *nameString = [NSString stringWithUTF8String:name];
+        if (length >= 0 && nameString) {
+            value.length = length;
+            attributes[nameString] = value;
+        }
+    }
+    return attributes;
+}
+
+/*! State of the batch read. Only accessed on the batch read queue.
+ */
+@interface _DFFileStorageBatchRead : NSObject {
+    @public
+    NSArray *_keys;
+    NSString *_name;
+    dispatch_queue_t _queue;
+    NSMutableDictionary *_batch;
+    NSMutableDictionary *_values;
+    NSUInteger _nextIndex;
+    NSUInteger _remainingCount;
+    void (^_completion)(NSDictionary *, NSDictionary *);
+}
+@end
+
+@implementation _DFFileStorageBatchRead
+@end
+
 
 @implementation DFFileStorage {
     NSFileManager *_fileManager;
+    int _directoryDescriptor;
+    
+    /*! Running totals of the contents, valid once the contents are reconciled for the first time. Protected by _contentsLock.
+     */
+    NSLock *_contentsLock;
+    BOOL _contentsTotalsReady;
+    _dwarf_cache_bytes _contentsSize;
+    _dwarf_cache_bytes _contentsLogicalSize;
+    NSUInteger _contentsCount;
+    
+    /*! File names of the files mutated while the contents are being reconciled, nil if reconciliation is not in progress.
+     */
+    NSMutableSet *_contentsMutatedFilenames;
+    NSLock *_reconciliationLock;
+}
+
+- (void)dealloc {
+    if (_directoryDescriptor >= 0) {
+        close(_directoryDescriptor);
+    }
 }
 
 - (instancetype)initWithPath:(NSString *)path error:(NSError *__autoreleasing *)error {
@@ -16,9 +219,31 @@
         }
         _fileManager = [NSFileManager defaultManager];
         _path = path;
+        _maximumConcurrentReadCount = 8;
+        _readsInPhysicalOrder = YES;
+        _maximumConcurrentRemovalCount = 4;
+        _inlineDataThreshold = 0;
+        _noCacheReadThreshold = 0;
+        _contentsLock = [NSLock new];
+        _reconciliationLock = [NSLock new];
         if (![_fileManager fileExistsAtPath:_path]) {
             [_fileManager createDirectoryAtPath:_path withIntermediateDirectories:YES attributes:nil error:error];
         }
+        _directoryDescriptor = -1;
+        [self _openDirectory];
+    }
+    return self;
+}
+
+- (instancetype)_initWithoutDirectory {
+    if (self = [super init]) {
+        _fileManager = [NSFileManager defaultManager];
+        _maximumConcurrentReadCount = 8;
+        _readsInPhysicalOrder = YES;
+        _maximumConcurrentRemovalCount = 4;
+        _contentsLock = [NSLock new];
+        _reconciliationLock = [NSLock new];
+        _directoryDescriptor = -1;
     }
     return self;
 }
@@ -28,25 +253,228 @@
     return nil;
 }
 
+- (NSString *)internalDirectoryPath {
+    if (!_path) {
+        return nil;
+    }
+    NSString *path = [_path stringByAppendingPathComponent:@".dfcache"];
+    if (![_fileManager fileExistsAtPath:path]) {
+        [_fileManager createDirectoryAtPath:path withIntermediateDirectories:YES attributes:nil error:nil];
+    }
+    return path;
+}
+
 - (NSData *)dataForKey:(NSString *)key {
-    return key ? [_fileManager contentsAtPath:[self pathForKey:key]] : nil;
+    return [self dataForKey:key options:DFFileStorageReadOptionsNone extendedAttributeValue:NULL forName:nil];
+}
+
+- (NSData *)dataForKey:(NSString *)key options:(DFFileStorageReadOptions)options {
+    return [self dataForKey:key options:options extendedAttributeValue:NULL forName:nil];
+}
+
+- (NSData *)dataForKey:(NSString *)key extendedAttributeValue:(id __autoreleasing *)value forName:(NSString *)name {
+    return [self dataForKey:key options:DFFileStorageReadOptionsNone extendedAttributeValue:value forName:name];
+}
+
+- (NSData *)dataForKey:(NSString *)key options:(DFFileStorageReadOptions)options extendedAttributeValue:(id __autoreleasing *)value forName:(NSString *)name {
+    if (!key) {
+        return nil;
+    }
+    int fd = [self _openFilename:[self filenameForKey:key] flags:O_RDONLY];
+    if (fd < 0) {
+        return nil;
+    }
+    NSData *data = _DFFileStorageReadFile(fd, options, _noCacheReadThreshold);
+    if (data && value && name) {
+        *value = _DFFileStorageReadExtendedAttributeValue(fd, name);
+    }
+    close(fd);
+    return data;
+}
+
+- (void)readDataForKey:(NSString *)key queue:(dispatch_queue_t)queue completion:(void (^)(NSData *))completion {
+    [self readDataForKey:key extendedAttributeName:nil queue:queue completion:^(NSData *data, id value) {
+        completion(data);
+    }];
+}
+
+- (void)readDataForKey:(NSString *)key extendedAttributeName:(NSString *)name queue:(dispatch_queue_t)queue completion:(void (^)(NSData *, id))completion {
+    int fd = key ? [self _openFilename:[self filenameForKey:key] flags:O_RDONLY] : -1;
+    if (fd < 0) {
+        dispatch_async(queue, ^{
+            completion(nil, nil);
+        });
+        return;
+    }
+    struct stat fileStat;
+    BOOL inlined = NO;
+    if (fstat(fd, &fileStat) == 0) {
+        if (_noCacheReadThreshold > 0 && fileStat.st_size > _noCacheReadThreshold) {
+            _DFFileStorageAdviseFile(fd, fileStat.st_size, DFFileStorageReadOptionNoCache);
+        }
+        inlined = fileStat.st_size == 0;
+    }
+    // Data stored inline is read with a single fgetxattr(2), there is nothing to stream.
+    dispatch_io_t channel = inlined ? NULL : dispatch_io_create(DISPATCH_IO_STREAM, fd, queue, ^(int error) {
+        close(fd);
+    });
+    if (!channel) {
+        dispatch_async(queue, ^{
+            NSData *data = _DFFileStorageReadFile(fd, DFFileStorageReadOptionsNone, _noCacheReadThreshold);
+            id value = (data && name) ? _DFFileStorageReadExtendedAttributeValue(fd, name) : nil;
+            close(fd);
+            completion(data, value);
+        });
+        return;
+    }
+    NSMutableData *data = [NSMutableData new];
+    dispatch_io_read(channel, 0, SIZE_MAX, queue, ^(bool done, dispatch_data_t chunk, int error) {
+        if (chunk) {
+            dispatch_data_apply(chunk, ^bool(dispatch_data_t region, size_t offset, const void *buffer, size_t size) {
+                [data appendBytes:buffer length:size];
+                return true;
+            });
+        }
+        if (done) {
+            // The descriptor stays open until the channel is closed, read the attribute through the same descriptor.
+            id value = (!error && name) ? _DFFileStorageReadExtendedAttributeValue(fd, name) : nil;
+            dispatch_io_close(channel, 0);
+            completion(error ? nil : data, value);
+        }
+    });
+}
+
+- (void)prefetchDataForKeys:(NSArray *)keys {
+    for (NSString *key in keys) {
+        int fd = [self _openFilename:[self filenameForKey:key] flags:O_RDONLY];
+        if (fd >= 0) {
+            struct stat fileStat;
+            if (fstat(fd, &fileStat) == 0) {
+                _DFFileStorageAdviseFile(fd, fileStat.st_size, DFFileStorageReadOptionWillNeed);
+            }
+            close(fd);
+        }
+    }
+}
+
+- (void)readDataForKeys:(NSArray *)keys queue:(dispatch_queue_t)queue completion:(void (^)(NSDictionary *))completion {
+    [self readDataForKeys:keys extendedAttributeName:nil queue:queue completion:^(NSDictionary *batch, NSDictionary *values) {
+        completion(batch);
+    }];
+}
+
+- (void)readDataForKeys:(NSArray *)keys extendedAttributeName:(NSString *)name queue:(dispatch_queue_t)queue completion:(void (^)(NSDictionary *, NSDictionary *))completion {
+    _DFFileStorageBatchRead *read = [_DFFileStorageBatchRead new];
+    read->_keys = [keys copy];
+    read->_name = [name copy];
+    read->_queue = queue;
+    read->_batch = [NSMutableDictionary new];
+    read->_values = [NSMutableDictionary new];
+    read->_remainingCount = keys.count;
+    read->_completion = [completion copy];
+    dispatch_async(queue, ^{
+        if (!read->_keys.count) {
+            completion(read->_batch, read->_values);
+            return;
+        }
+        if (_readsInPhysicalOrder) {
+            read->_keys = [self keysSortedByPhysicalLocation:read->_keys];
+        }
+        NSUInteger count = MIN(MAX(_maximumConcurrentReadCount, 1), read->_keys.count);
+        // Read ahead the next window of keys while the first one is being read.
+        [self prefetchDataForKeys:[read->_keys subarrayWithRange:NSMakeRange(count, MIN(count, read->_keys.count - count))]];
+        for (NSUInteger i = 0; i < count; i++) {
+            [self _readNextKeyForBatchRead:read];
+        }
+    });
+}
+
+- (NSArray *)keysSortedByPhysicalLocation:(NSArray *)keys {
+    NSUInteger count = keys.count;
+    if (count < 2) {
+        return keys;
+    }
+    typedef struct { ino_t inode; NSUInteger index; } _DFFileStorageKeyLocation;
+    _DFFileStorageKeyLocation *locations = malloc(count * sizeof(_DFFileStorageKeyLocation));
+    for (NSUInteger i = 0; i < count; i++) {
+        struct stat fileStat;
+        // Stat only reads the inode which is much cheaper than the seek to the file data it saves.
+        locations[i].inode = [self _statFilename:[self filenameForKey:keys[i]] stat:&fileStat] == 0 ? fileStat.st_ino : (ino_t)UINT64_MAX;
+        locations[i].index = i;
+    }
+    qsort_b(locations, count, sizeof(_DFFileStorageKeyLocation), ^int(const void *lhs, const void *rhs) {
+        const _DFFileStorageKeyLocation *location1 = lhs, *location2 = rhs;
+        if (location1->inode != location2->inode) {
+            return location1->inode < location2->inode ? -1 : 1;
+        }
+        return location1->index < location2->index ? -1 : (location1->index > location2->index ? 1 : 0);
+    });
+    NSMutableArray *sortedKeys = [[NSMutableArray alloc] initWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        [sortedKeys addObject:keys[locations[i].index]];
+    }
+    free(locations);
+    return sortedKeys;
+}
+
+/*! Must be called on the batch read queue.
+ */
+- (void)_readNextKeyForBatchRead:(_DFFileStorageBatchRead *)read {
+    NSString *key = read->_keys[read->_nextIndex++];
+    NSUInteger prefetchIndex = read->_nextIndex + MAX(_maximumConcurrentReadCount, 1) * 2 - 1;
+    if (prefetchIndex < read->_keys.count) {
+        [self prefetchDataForKeys:@[read->_keys[prefetchIndex]]];
+    }
+    [self readDataForKey:key extendedAttributeName:read->_name queue:read->_queue completion:^(NSData *data, id value) {
+        if (data) {
+            read->_batch[key] = data;
+            if (value) {
+                read->_values[key] = value;
+            }
+        }
+        if (--read->_remainingCount == 0) {
+            read->_completion(read->_batch, read->_values);
+        } else if (read->_nextIndex < read->_keys.count) {
+            [self _readNextKeyForBatchRead:read];
+        }
+    }];
 }
 
 - (void)setData:(NSData *)data forKey:(NSString *)key {
     if (data && key) {
-        [_fileManager createFileAtPath:[self pathForKey:key] contents:data attributes:nil];
+        NSString *filename = [self filenameForKey:key];
+        NSString *temporaryFilename = [self _temporaryFilenameForFilename:filename processIdentifier:getpid()];
+        if (![self _writeData:data extendedAttributes:nil toFilename:temporaryFilename synchronize:NO] ||
+            [self _renameFilename:temporaryFilename toFilename:filename] != 0) {
+            [self _unlinkFilename:temporaryFilename];
+        }
     }
 }
 
 - (void)removeDataForKey:(NSString *)key {
     if (key) {
-        [_fileManager removeItemAtPath:[self pathForKey:key] error:nil];
+        [self _unlinkFilename:[self filenameForKey:key]];
+    }
+}
+
+- (void)removeDataForKeys:(NSArray *)keys {
+    NSMutableArray *filenames = [[NSMutableArray alloc] initWithCapacity:keys.count];
+    for (NSString *key in keys) {
+        [filenames addObject:[self filenameForKey:key]];
     }
+    [self _unlinkFilenames:filenames];
 }
 
 - (void)removeAllData {
     [_fileManager removeItemAtPath:_path error:nil];
     [_fileManager createDirectoryAtPath:_path withIntermediateDirectories:YES attributes:nil error:nil];
+    [self _openDirectory];
+    [_contentsLock lock];
+    _contentsSize = 0;
+    _contentsLogicalSize = 0;
+    _contentsCount = 0;
+    _contentsTotalsReady = YES;
+    [_contentsLock unlock];
 }
 
 - (NSString *)filenameForKey:(NSString *)key {
@@ -63,27 +491,325 @@
 }
 
 - (BOOL)containsDataForKey:(NSString *)key {
-    return key ? [_fileManager fileExistsAtPath:[self pathForKey:key]] : NO;
+    struct stat fileStat;
+    return key ? [self _statFilename:[self filenameForKey:key] stat:&fileStat] == 0 : NO;
 }
 
+#pragma mark - Contents
+
 - (_dwarf_cache_bytes)contentsSize {
-    _dwarf_cache_bytes size = 0;
-    NSArray *contents = [self contentsWithResourceKeys:@[NSURLFileAllocatedSizeKey]];
-    for (NSURL *fileURL in contents) {
-        NSNumber *fileSize;
-        [fileURL getResourceValue:&fileSize forKey:NSURLFileAllocatedSizeKey error:nil];
-        size += [fileSize unsignedLongLongValue];
-    }
+    [self _prepareContentsTotals];
+    [_contentsLock lock];
+    _dwarf_cache_bytes size = _contentsSize;
+    [_contentsLock unlock];
     return size;
 }
 
+- (_dwarf_cache_bytes)contentsLogicalSize {
+    [self _prepareContentsTotals];
+    [_contentsLock lock];
+    _dwarf_cache_bytes logicalSize = _contentsLogicalSize;
+    [_contentsLock unlock];
+    return logicalSize;
+}
+
+- (NSUInteger)contentsCount {
+    [self _prepareContentsTotals];
+    [_contentsLock lock];
+    NSUInteger count = _contentsCount;
+    [_contentsLock unlock];
+    return count;
+}
+
+- (void)_prepareContentsTotals {
+    [_contentsLock lock];
+    BOOL ready = _contentsTotalsReady;
+    [_contentsLock unlock];
+    if (!ready) {
+        [self reconcileContents];
+    }
+}
+
+- (long long)reconcileContents {
+    [_reconciliationLock lock];
+    [_contentsLock lock];
+    _contentsMutatedFilenames = [NSMutableSet new];
+    [_contentsLock unlock];
+    
+    DFDirectoryScan *scan = [self _scanContents];
+    
+    [_contentsLock lock];
+    _dwarf_cache_bytes size = scan.totalSize;
+    _dwarf_cache_bytes logicalSize = scan.totalLogicalSize;
+    NSUInteger count = scan.count;
+    if (_contentsMutatedFilenames.count > 0) {
+        // Files mutated during the scan might or might not be reflected by it, they are accounted with their current state instead.
+        for (NSUInteger i = 0; i < scan.count; i++) {
+            if ([_contentsMutatedFilenames containsObject:[scan filenameStringAtIndex:i]]) {
+                size -= scan.entries[i].size;
+                logicalSize -= scan.entries[i].logicalSize;
+                count--;
+            }
+        }
+        for (NSString *filename in _contentsMutatedFilenames) {
+            struct stat fileStat;
+            if ([self _statFilename:filename stat:&fileStat] == 0) {
+                size += fileStat.st_blocks * 512;
+                logicalSize += fileStat.st_size;
+                count++;
+            }
+        }
+    }
+    long long drift = _contentsTotalsReady ? (long long)size - (long long)_contentsSize : 0;
+    _contentsSize = size;
+    _contentsLogicalSize = logicalSize;
+    _contentsCount = count;
+    _contentsTotalsReady = YES;
+    _contentsMutatedFilenames = nil;
+    [_contentsLock unlock];
+    [_reconciliationLock unlock];
+    return drift;
+}
+
+/*! Applies the change of a single file to the running totals of the contents.
+ @param addedStat Status of the file that was added, NULL if none.
+ @param removedStat Status of the file that was removed or replaced, NULL if none.
+ */
+- (void)_updateContentsTotalsForFilename:(NSString *)filename addedStat:(const struct stat *)addedStat removedStat:(const struct stat *)removedStat {
+    [_contentsLock lock];
+    if (_contentsTotalsReady) {
+        if (removedStat) {
+            _contentsSize -= MIN(_contentsSize, (_dwarf_cache_bytes)removedStat->st_blocks * 512);
+            _contentsLogicalSize -= MIN(_contentsLogicalSize, (_dwarf_cache_bytes)removedStat->st_size);
+            _contentsCount -= MIN(_contentsCount, 1);
+        }
+        if (addedStat) {
+            _contentsSize += addedStat->st_blocks * 512;
+            _contentsLogicalSize += addedStat->st_size;
+            _contentsCount++;
+        }
+    }
+    [_contentsMutatedFilenames addObject:filename];
+    [_contentsLock unlock];
+}
+
+#pragma mark - Storage Engine
+
+- (BOOL)getStat:(DFStorageEntryStat *)entryStat forKey:(NSString *)key {
+    struct stat fileStat;
+    if (!key || [self _statFilename:[self filenameForKey:key] stat:&fileStat] != 0) {
+        return NO;
+    }
+    if (entryStat) {
+        *entryStat = (DFStorageEntryStat){
+            .size = fileStat.st_blocks * 512,
+            .accessTime = (fileStat.st_atimespec.tv_sec - kCFAbsoluteTimeIntervalSince1970) + fileStat.st_atimespec.tv_nsec / 1.0e9
+        };
+    }
+    return YES;
+}
+
+- (NSString *)identifierForKey:(NSString *)key {
+    return [self filenameForKey:key];
+}
+
+- (void)enumerateEntriesUsingBlock:(void (^)(NSString *, DFStorageEntryStat, BOOL *))block {
+    DFDirectoryScan *scan = [self _scanContents];
+    BOOL stop = NO;
+    for (NSUInteger i = 0; i < scan.count && !stop; i++) {
+        block([scan filenameStringAtIndex:i], (DFStorageEntryStat){ .size = scan.entries[i].size, .accessTime = scan.entries[i].accessTime }, &stop);
+    }
+}
+
+- (void)removeEntriesWithIdentifiers:(NSArray *)identifiers {
+    [self _unlinkFilenames:identifiers];
+}
+
 - (NSArray *)contentsWithResourceKeys:(NSArray *)keys {
     NSURL *rootURL = [NSURL fileURLWithPath:_path isDirectory:YES];
     return [_fileManager contentsOfDirectoryAtURL:rootURL includingPropertiesForKeys:keys options:NSDirectoryEnumerationSkipsHiddenFiles error:nil];
 }
 
+#pragma mark - Directory Descriptor
+
+/*! Opens storage directory. Storage directory is reopened when it is recreated.
+ @discussion The descriptor is used by the operations on the other threads without synchronization. The recreated directory atomically replaces the previous one under the same descriptor (see dup2(2)) so that the descriptor is never closed while it is in use and is never reused for another file. Operations that are still running on the previous directory fail as if the directory was removed.
+ */
+- (void)_openDirectory {
+    if (!_DFFileStorageAtSystemCallsAvailable()) {
+        return;
+    }
+    int fd = open([_path fileSystemRepresentation], O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return; // Previous descriptor (if any) is kept, operations on it fail as on the removed directory
+    }
+    if (_directoryDescriptor < 0) {
+        _directoryDescriptor = fd;
+        return;
+    }
+    if (dup2(fd, _directoryDescriptor) >= 0) {
+        fcntl(_directoryDescriptor, F_SETFD, FD_CLOEXEC); // dup2(2) clears close-on-exec flag
+    }
+    close(fd);
+}
+
+- (int)_directoryDescriptor {
+    return _directoryDescriptor;
+}
+
+- (int)_openFilename:(NSString *)filename flags:(int)flags {
+    if (_directoryDescriptor >= 0) {
+        return openat(_directoryDescriptor, [filename fileSystemRepresentation], flags | O_CLOEXEC, 0644);
+    }
+    return open([[_path stringByAppendingPathComponent:filename] fileSystemRepresentation], flags | O_CLOEXEC, 0644);
+}
+
+- (int)_statFilename:(NSString *)filename stat:(struct stat *)fileStat {
+    int result;
+    if (_directoryDescriptor >= 0) {
+        result = fstatat(_directoryDescriptor, [filename fileSystemRepresentation], fileStat, 0);
+    } else {
+        result = stat([[_path stringByAppendingPathComponent:filename] fileSystemRepresentation], fileStat);
+    }
+    if (result == 0 && fileStat->st_size == 0 && S_ISREG(fileStat->st_mode)) {
+        int fd = [self _openFilename:filename flags:O_RDONLY | O_NOFOLLOW];
+        ssize_t length = fd >= 0 ? fgetxattr(fd, DFFileStorageInlineDataAttributeName, NULL, 0, 0, 0) : -1;
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (length > 0) {
+            fileStat->st_size = length;
+            fileStat->st_blocks = MAX(fileStat->st_blocks, (blkcnt_t)(DFFileStorageInlineDataAllocationUnit / 512));
+        }
+    }
+    return result;
+}
+
+- (int)_unlinkFilename:(NSString *)filename {
+    // Hidden files (temporary files, internal directory) are not storage contents.
+    struct stat fileStat;
+    BOOL accounted = ![filename hasPrefix:@"."] && [self _statFilename:filename stat:&fileStat] == 0;
+    int result;
+    if (_directoryDescriptor >= 0) {
+        result = unlinkat(_directoryDescriptor, [filename fileSystemRepresentation], 0);
+    } else {
+        result = unlink([[_path stringByAppendingPathComponent:filename] fileSystemRepresentation]);
+    }
+    if (result == 0 && accounted) {
+        [self _updateContentsTotalsForFilename:filename addedStat:NULL removedStat:&fileStat];
+    }
+    return result;
+}
+
+- (NSArray *)_unlinkFilenames:(NSArray *)filenames {
+    const NSUInteger count = filenames.count;
+    if (!count) {
+        return @[];
+    }
+    BOOL *removed = calloc(count, sizeof(BOOL));
+    const size_t workerCount = MAX(1, MIN(_maximumConcurrentRemovalCount, count));
+    // Each worker removes every workerCount-th file. Removals from the same directory contend for the directory lock, so the number of workers is kept small.
+    dispatch_apply(workerCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t worker) {
+        for (NSUInteger i = worker; i < count; i += workerCount) {
+            @autoreleasepool {
+                removed[i] = [self _unlinkFilename:filenames[i]] == 0 || errno == ENOENT;
+            }
+        }
+    });
+    NSMutableArray *removedFilenames = [[NSMutableArray alloc] initWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        if (removed[i]) {
+            [removedFilenames addObject:filenames[i]];
+        }
+    }
+    free(removed);
+    return removedFilenames;
+}
+
+- (int)_renameFilename:(NSString *)filename toFilename:(NSString *)toFilename {
+    struct stat fileStat, replacedFileStat;
+    BOOL accounted = ![toFilename hasPrefix:@"."] && [self _statFilename:filename stat:&fileStat] == 0;
+    BOOL replaces = accounted && [self _statFilename:toFilename stat:&replacedFileStat] == 0;
+    int result;
+    if (_directoryDescriptor >= 0) {
+        result = renameat(_directoryDescriptor, [filename fileSystemRepresentation], _directoryDescriptor, [toFilename fileSystemRepresentation]);
+    } else {
+        result = rename([[_path stringByAppendingPathComponent:filename] fileSystemRepresentation], [[_path stringByAppendingPathComponent:toFilename] fileSystemRepresentation]);
+    }
+    if (result == 0 && accounted) {
+        [self _updateContentsTotalsForFilename:toFilename addedStat:&fileStat removedStat:(replaces ? &replacedFileStat : NULL)];
+    }
+    return result;
+}
+
+- (DFDirectoryScan *)_scanContents {
+    return [[DFDirectoryScan alloc] initWithPath:_path options:DFDirectoryScanOptionSkipsHiddenFiles];
+}
+
+- (NSString *)_temporaryFilenameForFilename:(NSString *)filename processIdentifier:(pid_t)processIdentifier {
+    return [NSString stringWithFormat:@"%@%i.%@", DFFileStorageTemporaryFilePrefix, processIdentifier, filename];
+}
+
+- (BOOL)_writeData:(NSData *)data extendedAttributes:(NSDictionary *)attributes toFilename:(NSString *)filename synchronize:(BOOL)synchronize {
+    NSMutableDictionary *archivedAttributes = attributes.count ? [[NSMutableDictionary alloc] initWithCapacity:attributes.count] : nil;
+    for (NSString *name in attributes) {
+        archivedAttributes[name] = [NSKeyedArchiver archivedDataWithRootObject:attributes[name]];
+    }
+    return [self _writeData:data archivedExtendedAttributes:archivedAttributes toFilename:filename synchronize:synchronize];
+}
+
+- (BOOL)_writeData:(NSData *)data archivedExtendedAttributes:(NSDictionary *)attributes toFilename:(NSString *)filename synchronize:(BOOL)synchronize {
+    int fd = [self _openFilename:filename flags:(O_WRONLY | O_CREAT | O_TRUNC)];
+    if (fd < 0) {
+        return NO;
+    }
+    BOOL success = YES;
+    const uint8_t *bytes = data.bytes;
+    // Falls back to writing the file contents if the file system doesn't support extended attributes.
+    BOOL inlined = data.length > 0 && data.length <= _inlineDataThreshold && fsetxattr(fd, DFFileStorageInlineDataAttributeName, bytes, data.length, 0, 0) == 0;
+    if (!inlined) {
+        _DFFileStoragePreallocateFile(fd, (off_t)data.length);
+        NSUInteger offset = 0;
+        while (success && offset < data.length) {
+            ssize_t length = write(fd, bytes + offset, data.length - offset);
+            if (length < 0 && errno != EINTR) {
+                success = NO;
+            } else if (length > 0) {
+                offset += length;
+            }
+        }
+    }
+    for (NSString *name in attributes) {
+        if (!success) {
+            break;
+        }
+        NSData *value = attributes[name];
+        success = fsetxattr(fd, [name UTF8String], value.bytes, value.length, 0, 0) == 0;
+    }
+    if (success && synchronize) {
+        success = fsync(fd) == 0;
+    }
+    close(fd);
+    return success;
+}
+
+- (NSData *)_readFilename:(NSString *)filename archivedExtendedAttributes:(NSDictionary *__autoreleasing *)attributes {
+    int fd = [self _openFilename:filename flags:O_RDONLY];
+    if (fd < 0) {
+        return nil;
+    }
+    NSData *data = _DFFileStorageReadFile(fd, DFFileStorageReadOptionNoCache, 0);
+    if (data && attributes) {
+        *attributes = _DFFileStorageReadExtendedAttributes(fd);
+    }
+    close(fd);
+    return data;
+}
+
+#pragma mark - Miscellaneous
+
 - (NSString *)debugDescription {
-    return [NSString stringWithFormat:@"<%@ %p> { usage: %@; files: %lu }", [self class], self, _dwarf_bytes_to_str(self.contentsSize), (unsigned long)[self contentsWithResourceKeys:nil].count];
+    return [NSString stringWithFormat:@"<%@ %p> { usage: %@; files: %lu }", [self class], self, _dwarf_bytes_to_str(self.contentsSize), (unsigned long)self.contentsCount];
 }
 
 @end
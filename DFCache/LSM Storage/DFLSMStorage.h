@@ -0,0 +1,83 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import <Foundation/Foundation.h>
+#import "DFStorageEngine.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Key-value storage based on a log-structured merge tree. Keeps keys ordered which allows efficient prefix and range enumeration.
+ @discussion Writes go to the write-ahead log and the in-memory table (memtable). Once the memtable reaches its capacity it is written to disk as an immutable sorted table (SSTable) on a background queue. Each table has a block index and a Bloom filter so that a lookup reads at most a single data block of the table, and most lookups of the missing keys don't read any.
+
+ Tables are organized in levels. Level 0 tables are written from the memtable and may have overlapping key ranges. Once there are 4 tables at level 0 they are merged into level 1. Tables at levels 1 and deeper have disjoint key ranges, each level is 10 times larger than the previous one (10 Mb at level 1). When the level exceeds its size one of its tables is merged with the overlapping tables of the next level (leveled compaction). Removed keys are kept as tombstones until they reach the deepest level.
+
+ Storage exposes the same methods as DFFileStorage and is safe to use from multiple threads. Storage is a storage engine, entry identifiers are the keys. Access times are not tracked, disk cache evicts entries in key order.
+ */
+@interface DFLSMStorage : NSObject <DFStorageEngine>
+
+/*! Initializes and returns storage with the given directory path. Replays write-ahead log of the previous session.
+ @param path Storage directory path.
+ @param error A pointer to an error object. If an error occurs while creating storage directory, the pointer is set to the file system error (see NSFileManager).
+ */
+- (instancetype)initWithPath:(NSString *)path error:(NSError **)error NS_DESIGNATED_INITIALIZER;
+
+/*! Unavailable initializer, please use designated initializer.
+ */
+- (instancetype)init NS_UNAVAILABLE;
+
+/*! Returns storage directory path.
+ */
+@property (nonatomic, readonly) NSString *path;
+
+/*! Size of the memtable, in bytes, after which it gets written to disk. Default value is 4 Mb.
+ */
+@property (nonatomic) unsigned long long memtableCapacity;
+
+- (nullable NSData *)dataForKey:(NSString *)key;
+
+- (void)setData:(NSData *)data forKey:(NSString *)key;
+
+- (void)removeDataForKey:(NSString *)key;
+
+- (void)removeDataForKeys:(NSArray *)keys;
+
+/*! Removes all entries which keys start with the given prefix.
+ */
+- (void)removeDataForKeysWithPrefix:(NSString *)prefix;
+
+/*! Removes all storage contents.
+ */
+- (void)removeAllData;
+
+- (BOOL)containsDataForKey:(NSString *)key;
+
+/*! Enumerates keys that start with the given prefix in ascending order. Only reads the tables and blocks that may contain such keys.
+ */
+- (void)enumerateKeysWithPrefix:(NSString *)prefix usingBlock:(void (^)(NSString *key, BOOL *stop))block;
+
+/*! Enumerates entries with the keys in the given range in ascending order.
+ @param fromKey The first key of the range, inclusive. Nil to start from the smallest key.
+ @param toKey The end of the range, exclusive. Nil to enumerate till the largest key.
+ */
+- (void)enumerateKeysAndDataFromKey:(nullable NSString *)fromKey toKey:(nullable NSString *)toKey usingBlock:(void (^)(NSString *key, NSData *data, BOOL *stop))block;
+
+/*! Returns the size of the tables and memtables, in bytes. Includes removed and overwritten entries that are not yet compacted.
+ */
+- (unsigned long long)contentsSize;
+
+/*! Returns number of tables at the given level.
+ */
+- (NSUInteger)tableCountAtLevel:(NSUInteger)level;
+
+/*! Writes memtable to disk and waits until scheduled compactions finish.
+ */
+- (void)flush;
+
+/*! Synchronizes write-ahead log with the disk.
+ */
+- (void)synchronize;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,742 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFLSMStorage.h"
+#import "DFLSMTable.h"
+#import <fcntl.h>
+#import <unistd.h>
+
+static NSString *const DFLSMStorageManifestFilename = @"MANIFEST";
+static NSString *const DFLSMStorageTableExtension = @"sst";
+static NSString *const DFLSMStorageLogExtension = @"log";
+
+static const NSUInteger DFLSMStorageLevelCount = 7;
+
+/*! Number of level 0 tables that triggers their compaction into level 1.
+ */
+static const NSUInteger DFLSMStorageLevel0CompactionTrigger = 4;
+static const unsigned long long DFLSMStorageLevel1MaximumSize = 10 * 1024 * 1024;
+static const unsigned long long DFLSMStorageLevelSizeMultiplier = 10;
+
+/*! Compaction output is split into tables of this size.
+ */
+static const unsigned long long DFLSMStorageTableMaximumSize = 2 * 1024 * 1024;
+
+/*! Log record: u32 checksum of the rest of the record, u8 type, u32 key length, u32 value length, key, value.
+ */
+static const size_t DFLSMStorageLogRecordHeaderLength = 13;
+
+typedef NS_ENUM(uint8_t, _DFLSMLogRecordType) {
+    _DFLSMLogRecordTypeSet = 1,
+    _DFLSMLogRecordTypeRemove = 2
+};
+
+static uint32_t _DFLSMStorageChecksum(const uint8_t *bytes, size_t length) {
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static NSData *_DFLSMStorageLogRecord(NSString *key, NSData *value) {
+    NSData *keyData = [key dataUsingEncoding:NSUTF8StringEncoding];
+    NSMutableData *record = [NSMutableData dataWithCapacity:DFLSMStorageLogRecordHeaderLength + keyData.length + value.length];
+    uint8_t header[DFLSMStorageLogRecordHeaderLength];
+    header[4] = value ? _DFLSMLogRecordTypeSet : _DFLSMLogRecordTypeRemove;
+    uint32_t keyLength = (uint32_t)keyData.length;
+    uint32_t valueLength = (uint32_t)value.length;
+    memcpy(header + 5, &keyLength, sizeof(keyLength));
+    memcpy(header + 9, &valueLength, sizeof(valueLength));
+    [record appendBytes:header length:sizeof(header)];
+    [record appendData:keyData];
+    if (value) {
+        [record appendData:value];
+    }
+    uint32_t checksum = _DFLSMStorageChecksum((const uint8_t *)record.bytes + sizeof(uint32_t), record.length - sizeof(uint32_t));
+    [record replaceBytesInRange:NSMakeRange(0, sizeof(checksum)) withBytes:&checksum];
+    return record;
+}
+
+static unsigned long long _DFLSMStorageEntrySize(NSString *key, id value) {
+    return key.length + ((value == [NSNull null]) ? 0 : [(NSData *)value length]);
+}
+
+
+@implementation DFLSMStorage {
+    NSLock *_lock;
+    dispatch_queue_t _compactionQueue;
+
+    NSMutableDictionary *_memtable;
+    unsigned long long _memtableSize;
+    /*! Memtable that is being written to disk.
+     */
+    NSDictionary *_immutableMemtable;
+    unsigned long long _immutableMemtableSize;
+    uint64_t _immutableMemtableLogNumber;
+
+    /*! Array of immutable arrays of tables. Level 0 tables are ordered from the newest to the oldest, tables of the other levels are ordered by their keys. Arrays are replaced rather than mutated so that readers can use them outside of the lock.
+     */
+    NSArray *_levels;
+    /*! Largest key of the last compacted table of each level. Compactions of the level go round-robin over its key range.
+     */
+    NSMutableDictionary *_compactionPointers;
+
+    uint64_t _nextFileNumber;
+    uint64_t _logNumber;
+    int _logFileDescriptor;
+}
+
+- (void)dealloc {
+    if (_logFileDescriptor >= 0) {
+        close(_logFileDescriptor);
+    }
+}
+
+- (instancetype)initWithPath:(NSString *)path error:(NSError *__autoreleasing *)error {
+    if (self = [super init]) {
+        if (!path.length) {
+            [NSException raise:NSInvalidArgumentException format:@"Attempting to initialize storage without directory path"];
+        }
+        _path = path;
+        _memtableCapacity = 1024 * 1024 * 4; // 4 Mb
+        _lock = [NSLock new];
+        _compactionQueue = dispatch_queue_create("DFLSMStorage::CompactionQueue", DISPATCH_QUEUE_SERIAL);
+        _compactionPointers = [NSMutableDictionary new];
+        _logFileDescriptor = -1;
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        if (![fileManager fileExistsAtPath:_path]) {
+            [fileManager createDirectoryAtPath:_path withIntermediateDirectories:YES attributes:nil error:error];
+        }
+        [self _open];
+        dispatch_async(_compactionQueue, ^{
+            [self _compactIfNeeded];
+        });
+    }
+    return self;
+}
+
+- (instancetype)init {
+    [NSException raise:NSInternalInconsistencyException format:@"Please use designated initialzier"];
+    return nil;
+}
+
+#pragma mark - Read
+
+- (NSData *)dataForKey:(NSString *)key {
+    if (!key) {
+        return nil;
+    }
+    [_lock lock];
+    id value = _memtable[key] ?: _immutableMemtable[key];
+    NSArray *levels = _levels;
+    [_lock unlock];
+    if (value) {
+        return (value == [NSNull null]) ? nil : value;
+    }
+    NSData *data;
+    for (DFLSMTable *table in levels[0]) {
+        switch ([table lookupKey:key data:&data]) {
+            case DFLSMLookupResultFound: return data;
+            case DFLSMLookupResultRemoved: return nil;
+            case DFLSMLookupResultNotFound: break;
+        }
+    }
+    for (NSUInteger level = 1; level < levels.count; level++) {
+        DFLSMTable *table = [self _tableForKey:key inTables:levels[level]];
+        if (table) {
+            switch ([table lookupKey:key data:&data]) {
+                case DFLSMLookupResultFound: return data;
+                case DFLSMLookupResultRemoved: return nil;
+                case DFLSMLookupResultNotFound: break;
+            }
+        }
+    }
+    return nil;
+}
+
+- (BOOL)containsDataForKey:(NSString *)key {
+    return [self dataForKey:key] != nil;
+}
+
+/*! Returns the only table of the level (with disjoint tables) which key range contains the given key.
+ */
+- (DFLSMTable *)_tableForKey:(NSString *)key inTables:(NSArray *)tables {
+    NSUInteger lower = 0;
+    NSUInteger upper = tables.count;
+    while (lower < upper) {
+        NSUInteger middle = lower + (upper - lower) / 2;
+        if (DFLSMCompareKeys(((DFLSMTable *)tables[middle]).largestKey, key) == NSOrderedAscending) {
+            lower = middle + 1;
+        } else {
+            upper = middle;
+        }
+    }
+    if (lower == tables.count) {
+        return nil;
+    }
+    DFLSMTable *table = tables[lower];
+    return (DFLSMCompareKeys(table.smallestKey, key) != NSOrderedDescending) ? table : nil;
+}
+
+#pragma mark - Enumeration
+
+- (void)enumerateKeysWithPrefix:(NSString *)prefix usingBlock:(void (^)(NSString *, BOOL *))block {
+    if (!prefix || !block) {
+        return;
+    }
+    id<DFLSMIterator> iterator = [self _iteratorWithPrefix:prefix fromKey:prefix toKey:nil];
+    BOOL stop = NO;
+    for ([iterator seekToKey:prefix]; iterator.valid && !stop; [iterator next]) {
+        NSString *key = iterator.key;
+        if (![key hasPrefix:prefix]) {
+            break;
+        }
+        if (!iterator.removed) {
+            block(key, &stop);
+        }
+    }
+}
+
+- (void)enumerateKeysAndDataFromKey:(NSString *)fromKey toKey:(NSString *)toKey usingBlock:(void (^)(NSString *, NSData *, BOOL *))block {
+    if (!block) {
+        return;
+    }
+    id<DFLSMIterator> iterator = [self _iteratorWithPrefix:nil fromKey:fromKey toKey:toKey];
+    BOOL stop = NO;
+    for ([iterator seekToKey:fromKey]; iterator.valid && !stop; [iterator next]) {
+        NSString *key = iterator.key;
+        if (toKey && DFLSMCompareKeys(key, toKey) != NSOrderedAscending) {
+            break;
+        }
+        if (!iterator.removed) {
+            block(key, iterator.value, &stop);
+        }
+    }
+}
+
+/*! Returns iterator over the snapshot of the storage contents. Only the memtable entries and the tables that overlap the given range are included.
+ */
+- (id<DFLSMIterator>)_iteratorWithPrefix:(NSString *)prefix fromKey:(NSString *)fromKey toKey:(NSString *)toKey {
+    BOOL (^isInRange)(NSString *) = ^BOOL(NSString *key) {
+        if (prefix) {
+            return [key hasPrefix:prefix];
+        }
+        return (!fromKey || DFLSMCompareKeys(key, fromKey) != NSOrderedAscending) && (!toKey || DFLSMCompareKeys(key, toKey) == NSOrderedAscending);
+    };
+    NSMutableArray *iterators = [NSMutableArray new];
+    [_lock lock];
+    for (NSDictionary *memtable in @[ _memtable, _immutableMemtable ?: @{} ]) {
+        NSMutableDictionary *entries = [NSMutableDictionary new];
+        [memtable enumerateKeysAndObjectsUsingBlock:^(NSString *key, id value, BOOL *stop) {
+            if (isInRange(key)) {
+                entries[key] = value;
+            }
+        }];
+        [iterators addObject:[[DFLSMArrayIterator alloc] initWithDictionary:entries]];
+    }
+    NSArray *levels = _levels;
+    [_lock unlock];
+
+    // Tables are checked against the closed range that contains the requested one.
+    NSString *largestKey = prefix ? nil : toKey;
+    for (NSUInteger level = 0; level < levels.count; level++) {
+        NSMutableArray *tables = [NSMutableArray new];
+        for (DFLSMTable *table in levels[level]) {
+            if ([table overlapsRangeFromKey:fromKey toKey:largestKey] && (!prefix || [self _table:table mayContainPrefix:prefix])) {
+                [tables addObject:table];
+            }
+        }
+        if (level == 0) {
+            for (DFLSMTable *table in tables) {
+                [iterators addObject:[table iterator]];
+            }
+        } else if (tables.count) {
+            [iterators addObject:[[DFLSMConcatenatingIterator alloc] initWithTables:tables]];
+        }
+    }
+    return [[DFLSMMergingIterator alloc] initWithIterators:iterators];
+}
+
+- (BOOL)_table:(DFLSMTable *)table mayContainPrefix:(NSString *)prefix {
+    // Table contains no keys with the prefix if its smallest key is greater than all such keys.
+    return [table.smallestKey hasPrefix:prefix] || DFLSMCompareKeys(table.smallestKey, prefix) == NSOrderedAscending;
+}
+
+#pragma mark - Write
+
+- (void)setData:(NSData *)data forKey:(NSString *)key {
+    if (!data || !key) {
+        return;
+    }
+    [self _writeValue:data forKey:key];
+}
+
+- (void)removeDataForKey:(NSString *)key {
+    if (!key) {
+        return;
+    }
+    [self _writeValue:nil forKey:key];
+}
+
+- (void)removeDataForKeys:(NSArray *)keys {
+    for (NSString *key in keys) {
+        [self removeDataForKey:key];
+    }
+}
+
+- (void)removeDataForKeysWithPrefix:(NSString *)prefix {
+    NSMutableArray *keys = [NSMutableArray new];
+    [self enumerateKeysWithPrefix:prefix usingBlock:^(NSString *key, BOOL *stop) {
+        [keys addObject:key];
+    }];
+    [self removeDataForKeys:keys];
+}
+
+- (void)_writeValue:(NSData *)value forKey:(NSString *)key {
+    NSData *record = _DFLSMStorageLogRecord(key, value);
+    id entry = value ?: [NSNull null];
+    [_lock lock];
+    if (_logFileDescriptor >= 0) {
+        // Appending writes of a single record are not interleaved. Records torn by a crash are discarded during replay.
+        ssize_t written;
+        do {
+            written = write(_logFileDescriptor, record.bytes, record.length);
+        } while (written < 0 && errno == EINTR);
+    }
+    id previousEntry = _memtable[key];
+    if (previousEntry) {
+        _memtableSize -= _DFLSMStorageEntrySize(key, previousEntry);
+    }
+    _memtable[key] = entry;
+    _memtableSize += _DFLSMStorageEntrySize(key, entry);
+    if (_memtableSize >= _memtableCapacity && !_immutableMemtable) {
+        [self _scheduleMemtableFlush];
+    }
+    [_lock unlock];
+}
+
+#pragma mark - Management
+
+- (void)removeAllData {
+    dispatch_sync(_compactionQueue, ^{
+        [_lock lock];
+        if (_logFileDescriptor >= 0) {
+            close(_logFileDescriptor);
+            _logFileDescriptor = -1;
+        }
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        [fileManager removeItemAtPath:_path error:nil];
+        [fileManager createDirectoryAtPath:_path withIntermediateDirectories:YES attributes:nil error:nil];
+        [self _open];
+        [_lock unlock];
+    });
+}
+
+- (unsigned long long)contentsSize {
+    [_lock lock];
+    unsigned long long contentsSize = _memtableSize + _immutableMemtableSize;
+    for (NSArray *tables in _levels) {
+        for (DFLSMTable *table in tables) {
+            contentsSize += table.fileSize;
+        }
+    }
+    [_lock unlock];
+    return contentsSize;
+}
+
+- (NSUInteger)tableCountAtLevel:(NSUInteger)level {
+    [_lock lock];
+    NSUInteger count = (level < _levels.count) ? [_levels[level] count] : 0;
+    [_lock unlock];
+    return count;
+}
+
+- (void)flush {
+    for (;;) {
+        dispatch_sync(_compactionQueue, ^{});
+        [_lock lock];
+        BOOL isFlushed = (_memtable.count == 0 && !_immutableMemtable);
+        if (!isFlushed && !_immutableMemtable) {
+            [self _scheduleMemtableFlush];
+        }
+        [_lock unlock];
+        if (isFlushed) {
+            break;
+        }
+    }
+}
+
+- (void)synchronize {
+    [_lock lock];
+    if (_logFileDescriptor >= 0) {
+        fsync(_logFileDescriptor);
+    }
+    [_lock unlock];
+}
+
+#pragma mark - Storage Engine
+
+- (BOOL)getStat:(DFStorageEntryStat *)stat forKey:(NSString *)key {
+    NSData *data = [self dataForKey:key];
+    if (data && stat) {
+        *stat = (DFStorageEntryStat){ .size = strlen([key UTF8String]) + data.length, .accessTime = 0 };
+    }
+    return data != nil;
+}
+
+- (NSString *)identifierForKey:(NSString *)key {
+    return key;
+}
+
+- (NSString *)keyForIdentifier:(NSString *)identifier {
+    return identifier;
+}
+
+- (void)enumerateEntriesUsingBlock:(void (^)(NSString *, DFStorageEntryStat, BOOL *))block {
+    [self enumerateKeysAndDataFromKey:nil toKey:nil usingBlock:^(NSString *key, NSData *data, BOOL *stop) {
+        block(key, (DFStorageEntryStat){ .size = strlen([key UTF8String]) + data.length, .accessTime = 0 }, stop);
+    }];
+}
+
+- (void)removeEntriesWithIdentifiers:(NSArray *)identifiers {
+    [self removeDataForKeys:identifiers];
+}
+
+#pragma mark - Open
+
+/*! Loads manifest, removes obsolete files and replays logs of the previous session. Called on initialization and after the directory is cleared.
+ */
+- (void)_open {
+    _memtable = [NSMutableDictionary new];
+    _memtableSize = 0;
+    _immutableMemtable = nil;
+    _immutableMemtableSize = 0;
+    [_compactionPointers removeAllObjects];
+
+    NSDictionary *manifest;
+    NSData *manifestData = [NSData dataWithContentsOfFile:[_path stringByAppendingPathComponent:DFLSMStorageManifestFilename]];
+    if (manifestData) {
+        manifest = [NSPropertyListSerialization propertyListWithData:manifestData options:NSPropertyListImmutable format:nil error:nil];
+        if (![manifest isKindOfClass:[NSDictionary class]]) {
+            manifest = nil;
+        }
+    }
+    _nextFileNumber = MAX([manifest[@"nextFileNumber"] unsignedLongLongValue], 1);
+    uint64_t logNumber = [manifest[@"logNumber"] unsignedLongLongValue];
+    NSMutableArray *levels = [NSMutableArray new];
+    NSMutableSet *liveTableNumbers = [NSMutableSet new];
+    NSArray *manifestLevels = manifest[@"levels"];
+    for (NSUInteger level = 0; level < DFLSMStorageLevelCount; level++) {
+        NSMutableArray *tables = [NSMutableArray new];
+        if (level < manifestLevels.count) {
+            for (NSNumber *number in manifestLevels[level]) {
+                // Damaged tables are dropped, storage is a cache.
+                DFLSMTable *table = [[DFLSMTable alloc] initWithPath:[self _pathForFileNumber:number.unsignedLongLongValue extension:DFLSMStorageTableExtension] number:number.unsignedLongLongValue];
+                if (table) {
+                    [tables addObject:table];
+                    [liveTableNumbers addObject:number];
+                }
+            }
+        }
+        [levels addObject:[tables copy]];
+    }
+    _levels = [levels copy];
+
+    NSMutableArray *logNumbers = [NSMutableArray new];
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    for (NSString *filename in [fileManager contentsOfDirectoryAtPath:_path error:nil]) {
+        if ([filename isEqualToString:DFLSMStorageManifestFilename]) {
+            continue;
+        }
+        NSString *path = [_path stringByAppendingPathComponent:filename];
+        uint64_t number = strtoull([filename UTF8String], NULL, 10);
+        _nextFileNumber = MAX(_nextFileNumber, number + 1);
+        if ([filename.pathExtension isEqualToString:DFLSMStorageLogExtension] && number >= logNumber) {
+            [logNumbers addObject:@(number)];
+        } else if (![filename.pathExtension isEqualToString:DFLSMStorageTableExtension] || ![liveTableNumbers containsObject:@(number)]) {
+            [fileManager removeItemAtPath:path error:nil];
+        }
+    }
+
+    NSMutableArray *logPaths = [NSMutableArray new];
+    for (NSNumber *number in [logNumbers sortedArrayUsingSelector:@selector(compare:)]) {
+        [logPaths addObject:[self _pathForFileNumber:number.unsignedLongLongValue extension:DFLSMStorageLogExtension]];
+    }
+    NSMutableDictionary *memtable = [NSMutableDictionary new];
+    for (NSString *logPath in logPaths) {
+        [self _replayLogAtPath:logPath intoMemtable:memtable];
+    }
+    if (memtable.count) {
+        uint64_t tableNumber = _nextFileNumber++;
+        NSArray *tables = [self _writeTablesWithIterator:[[DFLSMArrayIterator alloc] initWithDictionary:memtable] numbers:@[ @(tableNumber) ] dropsTombstones:NO];
+        if (tables.count) {
+            _levels = [self _levels:_levels byInsertingTables:tables atLevel:0 removingTables:nil];
+        }
+    }
+    [self _openLogWithNumber:_nextFileNumber++];
+    DFLSMWriteFile([self _manifestData], [_path stringByAppendingPathComponent:DFLSMStorageManifestFilename]);
+    for (NSString *logPath in logPaths) {
+        [fileManager removeItemAtPath:logPath error:nil];
+    }
+}
+
+- (void)_replayLogAtPath:(NSString *)path intoMemtable:(NSMutableDictionary *)memtable {
+    NSData *data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:nil];
+    const uint8_t *bytes = data.bytes;
+    size_t remaining = data.length;
+    while (remaining >= DFLSMStorageLogRecordHeaderLength) {
+        uint32_t checksum, keyLength, valueLength;
+        memcpy(&checksum, bytes, sizeof(checksum));
+        memcpy(&keyLength, bytes + 5, sizeof(keyLength));
+        memcpy(&valueLength, bytes + 9, sizeof(valueLength));
+        size_t recordLength = DFLSMStorageLogRecordHeaderLength + (size_t)keyLength + valueLength;
+        // The tail of the log may be torn by a crash.
+        if (recordLength > remaining || _DFLSMStorageChecksum(bytes + sizeof(checksum), recordLength - sizeof(checksum)) != checksum) {
+            break;
+        }
+        NSString *key = [[NSString alloc] initWithBytes:bytes + DFLSMStorageLogRecordHeaderLength length:keyLength encoding:NSUTF8StringEncoding];
+        if (key) {
+            if (bytes[4] == _DFLSMLogRecordTypeSet) {
+                memtable[key] = [NSData dataWithBytes:bytes + DFLSMStorageLogRecordHeaderLength + keyLength length:valueLength];
+            } else {
+                memtable[key] = [NSNull null];
+            }
+        }
+        bytes += recordLength;
+        remaining -= recordLength;
+    }
+}
+
+- (void)_openLogWithNumber:(uint64_t)number {
+    if (_logFileDescriptor >= 0) {
+        close(_logFileDescriptor);
+    }
+    _logNumber = number;
+    _logFileDescriptor = open([[self _pathForFileNumber:number extension:DFLSMStorageLogExtension] fileSystemRepresentation], O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+}
+
+#pragma mark - Flush (Compaction Queue)
+
+/*! Replaces memtable with the new one and schedules its flush. Must be called with the lock acquired.
+ */
+- (void)_scheduleMemtableFlush {
+    if (_memtable.count == 0) {
+        return;
+    }
+    _immutableMemtable = _memtable;
+    _immutableMemtableSize = _memtableSize;
+    _immutableMemtableLogNumber = _logNumber;
+    _memtable = [NSMutableDictionary new];
+    _memtableSize = 0;
+    uint64_t obsoleteLogNumber = _logNumber;
+    [self _openLogWithNumber:_nextFileNumber++];
+    uint64_t tableNumber = _nextFileNumber++;
+    NSDictionary *memtable = _immutableMemtable;
+    dispatch_async(_compactionQueue, ^{
+        [self _flushMemtable:memtable tableNumber:tableNumber obsoleteLogNumber:obsoleteLogNumber];
+        [self _compactIfNeeded];
+    });
+}
+
+- (void)_flushMemtable:(NSDictionary *)memtable tableNumber:(uint64_t)tableNumber obsoleteLogNumber:(uint64_t)obsoleteLogNumber {
+    // Level 0 tables keep tombstones, they have to shadow the older values at the deeper levels.
+    NSArray *tables = [self _writeTablesWithIterator:[[DFLSMArrayIterator alloc] initWithDictionary:memtable] numbers:@[ @(tableNumber) ] dropsTombstones:NO];
+    [_lock lock];
+    // If the table can't be written the entries are dropped, storage is a cache.
+    if (tables.count) {
+        _levels = [self _levels:_levels byInsertingTables:tables atLevel:0 removingTables:nil];
+    }
+    _immutableMemtable = nil;
+    _immutableMemtableSize = 0;
+    NSData *manifestData = [self _manifestData];
+    if (_memtableSize >= _memtableCapacity) {
+        [self _scheduleMemtableFlush];
+    }
+    [_lock unlock];
+    DFLSMWriteFile(manifestData, [_path stringByAppendingPathComponent:DFLSMStorageManifestFilename]);
+    unlink([[self _pathForFileNumber:obsoleteLogNumber extension:DFLSMStorageLogExtension] fileSystemRepresentation]);
+}
+
+#pragma mark - Compaction (Compaction Queue)
+
+- (void)_compactIfNeeded {
+    for (;;) {
+        [_lock lock];
+        NSArray *levels = _levels;
+        NSUInteger level = [self _levelToCompactInLevels:levels];
+        if (level == NSNotFound) {
+            [_lock unlock];
+            break;
+        }
+        NSArray *inputs = (level == 0) ? levels[0] : @[ [self _tableToCompactAtLevel:level inTables:levels[level]] ];
+        NSString *smallestKey;
+        NSString *largestKey;
+        for (DFLSMTable *table in inputs) {
+            if (!smallestKey || DFLSMCompareKeys(table.smallestKey, smallestKey) == NSOrderedAscending) {
+                smallestKey = table.smallestKey;
+            }
+            if (!largestKey || DFLSMCompareKeys(table.largestKey, largestKey) == NSOrderedDescending) {
+                largestKey = table.largestKey;
+            }
+        }
+        NSMutableArray *overlappingTables = [NSMutableArray new];
+        for (DFLSMTable *table in levels[level + 1]) {
+            if ([table overlapsRangeFromKey:smallestKey toKey:largestKey]) {
+                [overlappingTables addObject:table];
+            }
+        }
+        // Tombstones are only needed while there are older values at the deeper levels.
+        BOOL dropsTombstones = YES;
+        for (NSUInteger deeperLevel = level + 2; deeperLevel < levels.count; deeperLevel++) {
+            if ([levels[deeperLevel] count]) {
+                dropsTombstones = NO;
+                break;
+            }
+        }
+        unsigned long long inputSize = 0;
+        for (DFLSMTable *table in [inputs arrayByAddingObjectsFromArray:overlappingTables]) {
+            inputSize += table.fileSize;
+        }
+        NSMutableArray *numbers = [NSMutableArray new];
+        for (unsigned long long i = 0; i <= inputSize / DFLSMStorageTableMaximumSize + 1; i++) {
+            [numbers addObject:@(_nextFileNumber++)];
+        }
+        [_lock unlock];
+
+        // Inputs are ordered from the newest to the oldest as the merging iterator requires.
+        NSMutableArray *iterators = [NSMutableArray new];
+        for (DFLSMTable *table in inputs) {
+            [iterators addObject:[table iterator]];
+        }
+        [iterators addObject:[[DFLSMConcatenatingIterator alloc] initWithTables:overlappingTables]];
+        NSArray *outputs = [self _writeTablesWithIterator:[[DFLSMMergingIterator alloc] initWithIterators:iterators] numbers:numbers dropsTombstones:dropsTombstones];
+        if (!outputs) {
+            break;
+        }
+
+        [_lock lock];
+        NSArray *updatedLevels = [self _levels:_levels byInsertingTables:@[] atLevel:level removingTables:inputs];
+        _levels = [self _levels:updatedLevels byInsertingTables:outputs atLevel:level + 1 removingTables:overlappingTables];
+        _compactionPointers[@(level)] = largestKey;
+        NSData *manifestData = [self _manifestData];
+        [_lock unlock];
+
+        // Input tables are removed only after the manifest no longer references them. Readers that still use them keep their mappings.
+        DFLSMWriteFile(manifestData, [_path stringByAppendingPathComponent:DFLSMStorageManifestFilename]);
+        for (DFLSMTable *table in [inputs arrayByAddingObjectsFromArray:overlappingTables]) {
+            unlink([table.path fileSystemRepresentation]);
+        }
+    }
+}
+
+- (NSUInteger)_levelToCompactInLevels:(NSArray *)levels {
+    if ([levels[0] count] >= DFLSMStorageLevel0CompactionTrigger) {
+        return 0;
+    }
+    unsigned long long maximumSize = DFLSMStorageLevel1MaximumSize;
+    for (NSUInteger level = 1; level < levels.count - 1; level++) {
+        unsigned long long size = 0;
+        for (DFLSMTable *table in levels[level]) {
+            size += table.fileSize;
+        }
+        if (size > maximumSize) {
+            return level;
+        }
+        maximumSize *= DFLSMStorageLevelSizeMultiplier;
+    }
+    return NSNotFound;
+}
+
+- (DFLSMTable *)_tableToCompactAtLevel:(NSUInteger)level inTables:(NSArray *)tables {
+    NSString *pointer = _compactionPointers[@(level)];
+    for (DFLSMTable *table in tables) {
+        if (!pointer || DFLSMCompareKeys(table.smallestKey, pointer) == NSOrderedDescending) {
+            return table;
+        }
+    }
+    return tables.firstObject;
+}
+
+/*! Writes entries of the iterator into the new tables, a new table is started once the current one reaches maximum size. Returns nil if any of the tables can't be written.
+ */
+- (NSArray *)_writeTablesWithIterator:(id<DFLSMIterator>)iterator numbers:(NSArray *)numbers dropsTombstones:(BOOL)dropsTombstones {
+    NSMutableArray *tables = [NSMutableArray new];
+    DFLSMTableBuilder *builder;
+    NSUInteger numberIndex = 0;
+    BOOL success = YES;
+    for ([iterator seekToKey:nil]; iterator.valid && success; [iterator next]) {
+        if (dropsTombstones && iterator.removed) {
+            continue;
+        }
+        if (!builder) {
+            if (numberIndex == numbers.count) {
+                success = NO;
+                break;
+            }
+            builder = [[DFLSMTableBuilder alloc] initWithPath:[self _pathForFileNumber:[numbers[numberIndex] unsignedLongLongValue] extension:DFLSMStorageTableExtension]];
+        }
+        [builder addKey:iterator.key value:iterator.value];
+        if (builder.estimatedSize >= DFLSMStorageTableMaximumSize && numberIndex + 1 < numbers.count) {
+            success = [self _finishBuilder:builder number:numbers[numberIndex] tables:tables];
+            builder = nil;
+            numberIndex++;
+        }
+    }
+    if (success && builder) {
+        success = [self _finishBuilder:builder number:numbers[numberIndex] tables:tables];
+    }
+    if (!success) {
+        for (DFLSMTable *table in tables) {
+            unlink([table.path fileSystemRepresentation]);
+        }
+        return nil;
+    }
+    return tables;
+}
+
+- (BOOL)_finishBuilder:(DFLSMTableBuilder *)builder number:(NSNumber *)number tables:(NSMutableArray *)tables {
+    NSString *path = [self _pathForFileNumber:number.unsignedLongLongValue extension:DFLSMStorageTableExtension];
+    DFLSMTable *table = [builder finish] ? [[DFLSMTable alloc] initWithPath:path number:number.unsignedLongLongValue] : nil;
+    if (table) {
+        [tables addObject:table];
+    }
+    return table != nil;
+}
+
+#pragma mark - Private
+
+- (NSArray *)_levels:(NSArray *)levels byInsertingTables:(NSArray *)insertedTables atLevel:(NSUInteger)level removingTables:(NSArray *)removedTables {
+    NSMutableArray *tables = [levels[level] mutableCopy];
+    [tables removeObjectsInArray:removedTables ?: @[]];
+    if (level == 0) {
+        [tables insertObjects:insertedTables atIndexes:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, insertedTables.count)]];
+    } else {
+        [tables addObjectsFromArray:insertedTables];
+        [tables sortUsingComparator:^NSComparisonResult(DFLSMTable *table1, DFLSMTable *table2) {
+            return DFLSMCompareKeys(table1.smallestKey, table2.smallestKey);
+        }];
+    }
+    NSMutableArray *updatedLevels = [levels mutableCopy];
+    updatedLevels[level] = [tables copy];
+    return [updatedLevels copy];
+}
+
+- (NSData *)_manifestData {
+    NSMutableArray *levels = [NSMutableArray new];
+    for (NSArray *tables in _levels) {
+        [levels addObject:[tables valueForKey:@"number"]];
+    }
+    NSDictionary *manifest = @{ @"nextFileNumber" : @(_nextFileNumber),
+                                @"logNumber" : @(_immutableMemtable ? _immutableMemtableLogNumber : _logNumber),
+                                @"levels" : levels };
+    return [NSPropertyListSerialization dataWithPropertyList:manifest format:NSPropertyListBinaryFormat_v1_0 options:0 error:nil];
+}
+
+- (NSString *)_pathForFileNumber:(uint64_t)number extension:(NSString *)extension {
+    return [_path stringByAppendingPathComponent:[NSString stringWithFormat:@"%06llu.%@", number, extension]];
+}
+
+@end
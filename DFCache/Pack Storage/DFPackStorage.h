@@ -0,0 +1,93 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import <Foundation/Foundation.h>
+#import "DFStorageEngine.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Key-value storage that appends entries to large pack segment files instead of keeping a file per entry. Entries can be written in locality groups so that the entries that are read together are stored next to each other.
+ @discussion Entries of the batch written with -setDataBatch:localityGroup: are written contiguously with a single write. Batch reads (-dataForKeys:) sort the entries by their position in the segments and read the entries that are close to each other with a single read. DFDiskCache uses both when it is initialized with pack storage (see -[DFCache storeObjects:localityGroup:] and -[DFCache batchCachedDataForKeys:]).
+
+ Removed and overwritten entries leave garbage in their segments. Once the share of garbage in the segment exceeds compaction threshold the segment is compacted in the background: its live entries are rewritten to the active segment sorted by their locality groups, which also brings together the entries of the groups that were scattered by the later writes. Entries keep their locality group when they are overwritten individually.
+
+ Storage keeps an in-memory index of its contents which is rebuilt from the segments when storage is initialized. Each record is protected by a checksum, damaged records at the end of the last segment (left by the interrupted writes) are discarded. Segments are synchronized with the disk when they are sealed. Pack storage is a storage engine, entry identifiers are the keys.
+ */
+@interface DFPackStorage : NSObject <DFStorageEngine>
+
+/*! Initializes and returns storage with the given directory path. Reads segments to build the index of the contents.
+ @param path Storage directory path.
+ @param error A pointer to an error object. If an error occurs while creating storage directory, the pointer is set to the file system error (see NSFileManager).
+ */
+- (instancetype)initWithPath:(NSString *)path error:(NSError **)error NS_DESIGNATED_INITIALIZER;
+
+/*! Unavailable initializer, please use designated initializer.
+ */
+- (instancetype)init NS_UNAVAILABLE;
+
+/*! Returns storage directory path.
+ */
+@property (nonatomic, readonly) NSString *path;
+
+/*! Size of the segment after which a new segment is started, in bytes. Default value is 64 Mb.
+ */
+@property (nonatomic) unsigned long long segmentSize;
+
+/*! Entries which are separated by at most this many bytes are read by batch reads with a single read. Default value is 16 Kb.
+ */
+@property (nonatomic) unsigned long long maximumReadGap;
+
+/*! Share of garbage in the segment (0.0 to 1.0) after which the segment is compacted. Default value is 0.5.
+ */
+@property (nonatomic) float compactionThreshold;
+
+/*! Number of read system calls issued by the reads since storage was initialized.
+ */
+@property (nonatomic, readonly) unsigned long long readCount;
+
+- (nullable NSData *)dataForKey:(NSString *)key;
+
+/*! Reads data for the given keys. Entries that are close to each other in the same segment are read with a single read. Returns dictionary with key:data pairs of the found entries.
+ */
+- (NSDictionary *)dataForKeys:(NSArray *)keys;
+
+- (void)setData:(NSData *)data forKey:(NSString *)key;
+
+/*! Writes entries of the batch (key:data pairs) contiguously with a single write.
+ @param group Locality group of the entries. Compaction keeps the entries of the same group together.
+ */
+- (void)setDataBatch:(NSDictionary *)batch localityGroup:(nullable NSString *)group;
+
+/*! Returns locality group of the entry for the given key.
+ */
+- (nullable NSString *)localityGroupForKey:(NSString *)key;
+
+- (void)removeDataForKey:(NSString *)key;
+- (void)removeDataForKeys:(NSArray *)keys;
+
+/*! Removes all storage contents and segments.
+ */
+- (void)removeAllData;
+
+- (BOOL)containsDataForKey:(NSString *)key;
+
+/*! Returns the total size of the segments, including garbage.
+ */
+- (unsigned long long)contentsSize;
+
+/*! Returns the number of the stored entries.
+ */
+- (NSUInteger)contentsCount;
+
+/*! Synchronously compacts all segments (except the active one) that contain any garbage.
+ */
+- (void)compact;
+
+/*! Synchronizes the active segment with the disk.
+ */
+- (void)synchronize;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,780 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFPackStorage.h"
+#import <fcntl.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
+static NSString *const DFPackStorageSegmentExtension = @"pack";
+
+/*! Segments grow by preallocated steps of this size so that each segment is written into as few extents as possible.
+ */
+static const off_t DFPackStoragePreallocationStep = 4 * 1024 * 1024;
+
+/*! Batch reads never read more than this many bytes with a single read.
+ */
+static const unsigned long long DFPackStorageMaximumReadLength = 4 * 1024 * 1024;
+
+/*! Records with longer keys or locality group names are considered damaged.
+ */
+static const uint32_t DFPackStorageMaximumKeyLength = 4096;
+
+typedef NS_OPTIONS(uint32_t, _DFPackRecordFlags) {
+    /*! Tombstone record of the removed entry, has no data.
+     */
+    _DFPackRecordFlagRemoved = 1 << 0
+};
+
+/*! Record layout: header, key, locality group, data, padding to 8 bytes.
+ */
+typedef struct {
+    /*! Checksum of the record following the checksum, including key, group and data.
+     */
+    uint32_t checksum;
+    uint32_t flags;
+    uint32_t keyLength;
+    uint32_t groupLength;
+    uint64_t dataLength;
+} _DFPackRecordHeader;
+
+static uint32_t _DFPackStorageChecksum(const uint8_t *bytes, size_t length) {
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static inline unsigned long long _DFPackStorageAlign(unsigned long long offset) {
+    return (offset + 7) & ~7ull;
+}
+
+/*! Appends record to the buffer. Returns offset of the record data in the buffer.
+ */
+static NSUInteger _DFPackStorageAppendRecord(NSMutableData *buffer, _DFPackRecordFlags flags, NSData *key, NSData *group, NSData *data) {
+    NSUInteger recordOffset = buffer.length;
+    _DFPackRecordHeader header = {
+        .flags = flags,
+        .keyLength = (uint32_t)key.length,
+        .groupLength = (uint32_t)group.length,
+        .dataLength = data.length
+    };
+    [buffer appendBytes:&header length:sizeof(header)];
+    [buffer appendData:key];
+    if (group) {
+        [buffer appendData:group];
+    }
+    NSUInteger dataOffset = buffer.length;
+    if (data) {
+        [buffer appendData:data];
+    }
+    uint8_t *record = (uint8_t *)buffer.mutableBytes + recordOffset;
+    header.checksum = _DFPackStorageChecksum(record + sizeof(uint32_t), buffer.length - recordOffset - sizeof(uint32_t));
+    memcpy(record, &header.checksum, sizeof(uint32_t));
+    buffer.length = (NSUInteger)_DFPackStorageAlign(buffer.length);
+    return dataOffset;
+}
+
+static BOOL _DFPackStorageRead(int fd, void *buffer, size_t length, off_t offset) {
+    size_t position = 0;
+    while (position < length) {
+        ssize_t count = pread(fd, (uint8_t *)buffer + position, length - position, offset + position);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return NO;
+        }
+        position += count;
+    }
+    return YES;
+}
+
+
+@interface _DFPackSegment : NSObject {
+    @public
+    uint32_t _identifier;
+    int _fd;
+    unsigned long long _length;
+    unsigned long long _allocatedLength;
+    /*! Length of the records of the live entries.
+     */
+    unsigned long long _liveLength;
+}
+@end
+
+@implementation _DFPackSegment
+
+- (void)dealloc {
+    // Readers retain the segment so the descriptor stays open while they read it, even if the segment was removed.
+    if (_fd >= 0) {
+        close(_fd);
+    }
+}
+
+@end
+
+
+@interface _DFPackEntry : NSObject {
+    @public
+    _DFPackSegment *_segment;
+    unsigned long long _dataOffset;
+    unsigned long long _dataLength;
+    unsigned long long _recordLength;
+    NSString *_group;
+    CFAbsoluteTime _accessTime;
+}
+@end
+
+@implementation _DFPackEntry
+@end
+
+
+@implementation DFPackStorage {
+    /*! Index and segments. Protected by _lock, all writes are performed under the lock.
+     */
+    NSLock *_lock;
+    NSMutableDictionary *_entries;
+    NSMutableArray *_segments;
+    _DFPackSegment *_activeSegment;
+    unsigned long long _contentsSize;
+    BOOL _compactionScheduled;
+    dispatch_queue_t _compactionQueue;
+}
+
+- (instancetype)initWithPath:(NSString *)path error:(NSError *__autoreleasing *)error {
+    if (self = [super init]) {
+        if (!path.length) {
+            [NSException raise:NSInvalidArgumentException format:@"Attempting to initialize storage without directory path"];
+        }
+        _path = path;
+        _segmentSize = 64 * 1024 * 1024; // 64 Mb
+        _maximumReadGap = 16 * 1024; // 16 Kb
+        _compactionThreshold = 0.5f;
+        _lock = [NSLock new];
+        _entries = [NSMutableDictionary new];
+        _segments = [NSMutableArray new];
+        _compactionQueue = dispatch_queue_create("DFPackStorage::CompactionQueue", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(_compactionQueue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0));
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        if (![fileManager fileExistsAtPath:_path]) {
+            [fileManager createDirectoryAtPath:_path withIntermediateDirectories:YES attributes:nil error:error];
+        }
+        [self _openSegments];
+    }
+    return self;
+}
+
+- (instancetype)init {
+    [NSException raise:NSInternalInconsistencyException format:@"Please use designated initialzier"];
+    return nil;
+}
+
+#pragma mark - Segments
+
+/*! Opens existing segments in the order they were created and replays their records. Only the records of the last segment are verified, the other segments were synchronized with the disk when they were sealed.
+ */
+- (void)_openSegments {
+    NSMutableArray *identifiers = [NSMutableArray new];
+    for (NSString *filename in [[NSFileManager defaultManager] contentsOfDirectoryAtPath:_path error:nil]) {
+        if ([filename.pathExtension isEqualToString:DFPackStorageSegmentExtension]) {
+            unsigned int identifier;
+            if ([[NSScanner scannerWithString:filename.stringByDeletingPathExtension] scanHexInt:&identifier]) {
+                [identifiers addObject:@(identifier)];
+            }
+        }
+    }
+    [identifiers sortUsingSelector:@selector(compare:)];
+    for (NSNumber *identifier in identifiers) {
+        _DFPackSegment *segment = [self _openSegmentWithIdentifier:identifier.unsignedIntValue create:NO];
+        if (segment) {
+            BOOL last = identifier == identifiers.lastObject;
+            [self _replaySegment:segment verify:last];
+            [_segments addObject:segment];
+            _contentsSize += segment->_length;
+        }
+    }
+    _activeSegment = _segments.lastObject;
+    if (!_activeSegment) {
+        [self _startSegmentWithIdentifier:1];
+    }
+}
+
+- (NSString *)_pathForSegmentWithIdentifier:(uint32_t)identifier {
+    return [_path stringByAppendingPathComponent:[NSString stringWithFormat:@"%08x.%@", identifier, DFPackStorageSegmentExtension]];
+}
+
+- (_DFPackSegment *)_openSegmentWithIdentifier:(uint32_t)identifier create:(BOOL)create {
+    int fd = open([[self _pathForSegmentWithIdentifier:identifier] fileSystemRepresentation], O_RDWR | (create ? (O_CREAT | O_TRUNC) : 0), 0644);
+    if (fd < 0) {
+        return nil;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        close(fd);
+        return nil;
+    }
+    _DFPackSegment *segment = [_DFPackSegment new];
+    segment->_identifier = identifier;
+    segment->_fd = fd;
+    segment->_length = (unsigned long long)fileStat.st_size;
+    segment->_allocatedLength = (unsigned long long)fileStat.st_blocks * 512;
+    return segment;
+}
+
+/*! Starts a new active segment. Must be called under the lock.
+ */
+- (void)_startSegmentWithIdentifier:(uint32_t)identifier {
+    _DFPackSegment *segment = [self _openSegmentWithIdentifier:identifier create:YES];
+    if (segment) {
+        [_segments addObject:segment];
+    }
+    _activeSegment = segment;
+}
+
+/*! Seals active segment by synchronizing it with the disk and starts a new one. Must be called under the lock.
+ */
+- (void)_sealActiveSegment {
+    fsync(_activeSegment->_fd);
+    [self _startSegmentWithIdentifier:_activeSegment->_identifier + 1];
+}
+
+/*! Enumerates records of the segment. Stops at the first record that is damaged. Returns the length of the valid records.
+ */
+- (unsigned long long)_enumerateRecordsInSegment:(_DFPackSegment *)segment verify:(BOOL)verify usingBlock:(void (^)(const _DFPackRecordHeader *header, NSString *key, NSString *group, unsigned long long dataOffset, unsigned long long recordLength))block {
+    unsigned long long offset = 0;
+    NSMutableData *buffer = [NSMutableData new];
+    while (offset + sizeof(_DFPackRecordHeader) <= segment->_length) {
+        _DFPackRecordHeader header;
+        if (!_DFPackStorageRead(segment->_fd, &header, sizeof(header), (off_t)offset)) {
+            break;
+        }
+        unsigned long long available = segment->_length - offset - sizeof(header);
+        if (header.keyLength == 0 || header.keyLength > DFPackStorageMaximumKeyLength || header.groupLength > DFPackStorageMaximumKeyLength ||
+            header.keyLength + header.groupLength > available || header.dataLength > available - header.keyLength - header.groupLength) {
+            break;
+        }
+        unsigned long long payloadLength = header.keyLength + header.groupLength + (verify ? header.dataLength : 0);
+        buffer.length = sizeof(header) + (NSUInteger)payloadLength;
+        memcpy(buffer.mutableBytes, &header, sizeof(header));
+        if (!_DFPackStorageRead(segment->_fd, (uint8_t *)buffer.mutableBytes + sizeof(header), (size_t)payloadLength, (off_t)(offset + sizeof(header)))) {
+            break;
+        }
+        const uint8_t *bytes = buffer.bytes;
+        if (verify && header.checksum != _DFPackStorageChecksum(bytes + sizeof(uint32_t), buffer.length - sizeof(uint32_t))) {
+            break;
+        }
+        NSString *key = [[NSString alloc] initWithBytes:bytes + sizeof(header) length:header.keyLength encoding:NSUTF8StringEncoding];
+        NSString *group = header.groupLength ? [[NSString alloc] initWithBytes:bytes + sizeof(header) + header.keyLength length:header.groupLength encoding:NSUTF8StringEncoding] : nil;
+        if (!key) {
+            break;
+        }
+        unsigned long long dataOffset = offset + sizeof(header) + header.keyLength + header.groupLength;
+        unsigned long long recordLength = _DFPackStorageAlign(sizeof(header) + header.keyLength + header.groupLength + header.dataLength);
+        block(&header, key, group, dataOffset, recordLength);
+        offset += recordLength;
+    }
+    return MIN(offset, segment->_length);
+}
+
+- (void)_replaySegment:(_DFPackSegment *)segment verify:(BOOL)verify {
+    struct stat fileStat;
+    CFAbsoluteTime accessTime = fstat(segment->_fd, &fileStat) == 0 ? fileStat.st_mtimespec.tv_sec - kCFAbsoluteTimeIntervalSince1970 : CFAbsoluteTimeGetCurrent();
+    unsigned long long length = [self _enumerateRecordsInSegment:segment verify:verify usingBlock:^(const _DFPackRecordHeader *header, NSString *key, NSString *group, unsigned long long dataOffset, unsigned long long recordLength) {
+        [self _removeEntryForKey:key];
+        if (!(header->flags & _DFPackRecordFlagRemoved)) {
+            _DFPackEntry *entry = [_DFPackEntry new];
+            entry->_segment = segment;
+            entry->_dataOffset = dataOffset;
+            entry->_dataLength = header->dataLength;
+            entry->_recordLength = recordLength;
+            entry->_group = group;
+            entry->_accessTime = accessTime;
+            [self _setEntry:entry forKey:key];
+        }
+    }];
+    if (length < segment->_length) {
+        // Discards the damaged tail left by the interrupted write.
+        ftruncate(segment->_fd, (off_t)length);
+        segment->_length = length;
+    }
+}
+
+- (void)_setEntry:(_DFPackEntry *)entry forKey:(NSString *)key {
+    _entries[key] = entry;
+    entry->_segment->_liveLength += entry->_recordLength;
+}
+
+- (_DFPackEntry *)_removeEntryForKey:(NSString *)key {
+    _DFPackEntry *entry = _entries[key];
+    if (entry) {
+        entry->_segment->_liveLength -= entry->_recordLength;
+        [_entries removeObjectForKey:key];
+    }
+    return entry;
+}
+
+#pragma mark - Write
+
+/*! Appends records to the active segment with a single write. Seals active segment first if the records don't fit into it. Must be called under the lock.
+ @return Active segment and the offset at which the records were written or nil if the write failed.
+ */
+- (_DFPackSegment *)_appendRecords:(NSData *)records offset:(unsigned long long *)offset {
+    if (!_activeSegment) {
+        return nil;
+    }
+    if (_activeSegment->_length > 0 && _activeSegment->_length + records.length > _segmentSize) {
+        [self _sealActiveSegment];
+        if (!_activeSegment) {
+            return nil;
+        }
+    }
+    _DFPackSegment *segment = _activeSegment;
+    unsigned long long length = segment->_length + records.length;
+    if (length > segment->_allocatedLength) {
+        off_t size = (off_t)MAX(length - segment->_allocatedLength, (unsigned long long)DFPackStoragePreallocationStep);
+        fstore_t store = { .fst_flags = F_ALLOCATECONTIG | F_ALLOCATEALL, .fst_posmode = F_PEOFPOSMODE, .fst_offset = 0, .fst_length = size };
+        if (fcntl(segment->_fd, F_PREALLOCATE, &store) == -1) {
+            store.fst_flags = F_ALLOCATEALL;
+            fcntl(segment->_fd, F_PREALLOCATE, &store);
+        }
+        // Failures are ignored, the segment is then simply allocated as it grows.
+        segment->_allocatedLength += (unsigned long long)MAX(store.fst_bytesalloc, 0);
+    }
+    const uint8_t *bytes = records.bytes;
+    size_t position = 0;
+    while (position < records.length) {
+        ssize_t count = pwrite(segment->_fd, bytes + position, records.length - position, (off_t)(segment->_length + position));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            // The partially written records are overwritten by the next write.
+            return nil;
+        }
+        position += count;
+    }
+    *offset = segment->_length;
+    segment->_length = length;
+    _contentsSize += records.length;
+    return segment;
+}
+
+- (void)setData:(NSData *)data forKey:(NSString *)key {
+    if (data && key) {
+        [self _setDataBatch:@{ key : data } localityGroup:nil];
+    }
+}
+
+- (void)setDataBatch:(NSDictionary *)batch localityGroup:(NSString *)group {
+    [self _setDataBatch:batch localityGroup:group];
+}
+
+/*! Returns YES if the records were written.
+ */
+- (BOOL)_setDataBatch:(NSDictionary *)batch localityGroup:(NSString *)group {
+    if (!batch.count) {
+        return YES;
+    }
+    NSArray *keys = [batch.allKeys sortedArrayUsingSelector:@selector(compare:)];
+    NSMutableArray *groups = [[NSMutableArray alloc] initWithCapacity:keys.count];
+    NSMutableData *records = [NSMutableData new];
+    NSMutableData *dataOffsets = [NSMutableData new];
+    NSData *groupData = [group dataUsingEncoding:NSUTF8StringEncoding];
+    [_lock lock];
+    for (NSString *key in keys) {
+        // Entries that are overwritten individually stay in their locality group.
+        _DFPackEntry *previousEntry = _entries[key];
+        NSString *entryGroup = group ?: (previousEntry ? previousEntry->_group : nil);
+        NSData *entryGroupData = group ? groupData : [entryGroup dataUsingEncoding:NSUTF8StringEncoding];
+        [groups addObject:entryGroup ?: [NSNull null]];
+        unsigned long long dataOffset = _DFPackStorageAppendRecord(records, 0, [key dataUsingEncoding:NSUTF8StringEncoding], entryGroupData, batch[key]);
+        [dataOffsets appendBytes:&dataOffset length:sizeof(dataOffset)];
+    }
+    unsigned long long offset;
+    _DFPackSegment *segment = [self _appendRecords:records offset:&offset];
+    if (segment) {
+        const unsigned long long *offsets = dataOffsets.bytes;
+        CFAbsoluteTime accessTime = CFAbsoluteTimeGetCurrent();
+        for (NSUInteger i = 0; i < keys.count; i++) {
+            NSString *key = keys[i];
+            _DFPackEntry *entry = [_DFPackEntry new];
+            entry->_segment = segment;
+            entry->_dataOffset = offset + offsets[i];
+            entry->_dataLength = ((NSData *)batch[key]).length;
+            entry->_recordLength = _DFPackStorageAlign(offsets[i] + entry->_dataLength) - (i > 0 ? _DFPackStorageAlign(offsets[i - 1] + ((NSData *)batch[keys[i - 1]]).length) : 0);
+            entry->_group = groups[i] == [NSNull null] ? nil : groups[i];
+            entry->_accessTime = accessTime;
+            [self _removeEntryForKey:key];
+            [self _setEntry:entry forKey:key];
+        }
+    }
+    BOOL scheduleCompaction = [self _shouldCompact];
+    [_lock unlock];
+    if (scheduleCompaction) {
+        [self _scheduleCompaction];
+    }
+    return segment != nil;
+}
+
+- (void)removeDataForKey:(NSString *)key {
+    if (key) {
+        [self removeDataForKeys:@[ key ]];
+    }
+}
+
+- (void)removeDataForKeys:(NSArray *)keys {
+    NSMutableData *records = [NSMutableData new];
+    [_lock lock];
+    for (NSString *key in keys) {
+        if ([self _removeEntryForKey:key]) {
+            _DFPackStorageAppendRecord(records, _DFPackRecordFlagRemoved, [key dataUsingEncoding:NSUTF8StringEncoding], nil, nil);
+        }
+    }
+    unsigned long long offset;
+    if (records.length) {
+        [self _appendRecords:records offset:&offset];
+    }
+    BOOL scheduleCompaction = [self _shouldCompact];
+    [_lock unlock];
+    if (scheduleCompaction) {
+        [self _scheduleCompaction];
+    }
+}
+
+- (void)removeAllData {
+    [_lock lock];
+    uint32_t identifier = _activeSegment ? _activeSegment->_identifier + 1 : 1;
+    for (_DFPackSegment *segment in _segments) {
+        unlink([[self _pathForSegmentWithIdentifier:segment->_identifier] fileSystemRepresentation]);
+    }
+    [_segments removeAllObjects];
+    [_entries removeAllObjects];
+    _contentsSize = 0;
+    [self _startSegmentWithIdentifier:identifier];
+    [_lock unlock];
+}
+
+- (void)synchronize {
+    [_lock lock];
+    if (_activeSegment) {
+        fsync(_activeSegment->_fd);
+    }
+    [_lock unlock];
+}
+
+#pragma mark - Read
+
+- (NSData *)dataForKey:(NSString *)key {
+    if (!key) {
+        return nil;
+    }
+    [_lock lock];
+    _DFPackEntry *entry = _entries[key];
+    if (entry) {
+        entry->_accessTime = CFAbsoluteTimeGetCurrent();
+        _readCount++;
+    }
+    [_lock unlock];
+    if (!entry) {
+        return nil;
+    }
+    // Entries are immutable, the segment is retained by the entry while it is read.
+    NSMutableData *data = [NSMutableData dataWithLength:(NSUInteger)entry->_dataLength];
+    return _DFPackStorageRead(entry->_segment->_fd, data.mutableBytes, data.length, (off_t)entry->_dataOffset) ? data : nil;
+}
+
+- (NSDictionary *)dataForKeys:(NSArray *)keys {
+    NSMutableArray *entries = [[NSMutableArray alloc] initWithCapacity:keys.count];
+    NSMutableArray *entryKeys = [[NSMutableArray alloc] initWithCapacity:keys.count];
+    [_lock lock];
+    CFAbsoluteTime accessTime = CFAbsoluteTimeGetCurrent();
+    for (NSString *key in keys) {
+        _DFPackEntry *entry = _entries[key];
+        if (entry) {
+            entry->_accessTime = accessTime;
+            [entries addObject:entry];
+            [entryKeys addObject:key];
+        }
+    }
+    [_lock unlock];
+
+    // Sorts entries by their position so that the neighbouring entries can be read together.
+    NSUInteger count = entries.count;
+    NSUInteger *order = malloc(MAX(count, 1) * sizeof(NSUInteger));
+    for (NSUInteger i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    qsort_b(order, count, sizeof(NSUInteger), ^int(const void *lhs, const void *rhs) {
+        _DFPackEntry *entry1 = entries[*(const NSUInteger *)lhs], *entry2 = entries[*(const NSUInteger *)rhs];
+        if (entry1->_segment->_identifier != entry2->_segment->_identifier) {
+            return entry1->_segment->_identifier < entry2->_segment->_identifier ? -1 : 1;
+        }
+        return entry1->_dataOffset < entry2->_dataOffset ? -1 : (entry1->_dataOffset > entry2->_dataOffset ? 1 : 0);
+    });
+    NSMutableDictionary *batch = [[NSMutableDictionary alloc] initWithCapacity:count];
+    unsigned long long readCount = 0;
+    for (NSUInteger start = 0; start < count;) {
+        _DFPackEntry *first = entries[order[start]];
+        unsigned long long runStart = first->_dataOffset;
+        unsigned long long runEnd = first->_dataOffset + first->_dataLength;
+        NSUInteger end = start + 1;
+        for (; end < count; end++) {
+            _DFPackEntry *next = entries[order[end]];
+            unsigned long long nextEnd = MAX(runEnd, next->_dataOffset + next->_dataLength);
+            if (next->_segment != first->_segment || next->_dataOffset > runEnd + _maximumReadGap || nextEnd - runStart > DFPackStorageMaximumReadLength) {
+                break;
+            }
+            runEnd = nextEnd;
+        }
+        NSMutableData *run = [NSMutableData dataWithLength:(NSUInteger)(runEnd - runStart)];
+        readCount++;
+        if (_DFPackStorageRead(first->_segment->_fd, run.mutableBytes, run.length, (off_t)runStart)) {
+            for (NSUInteger i = start; i < end; i++) {
+                _DFPackEntry *entry = entries[order[i]];
+                // Data references the run buffer without copying it.
+                uint8_t *bytes = (uint8_t *)run.mutableBytes + (entry->_dataOffset - runStart);
+                batch[entryKeys[order[i]]] = [[NSData alloc] initWithBytesNoCopy:bytes length:(NSUInteger)entry->_dataLength deallocator:^(void *runBytes, NSUInteger runLength) {
+                    (void)run;
+                }];
+            }
+        }
+        start = end;
+    }
+    free(order);
+    [_lock lock];
+    _readCount += readCount;
+    [_lock unlock];
+    return batch;
+}
+
+- (NSString *)localityGroupForKey:(NSString *)key {
+    if (!key) {
+        return nil;
+    }
+    [_lock lock];
+    _DFPackEntry *entry = _entries[key];
+    NSString *group = entry ? entry->_group : nil;
+    [_lock unlock];
+    return group;
+}
+
+- (BOOL)containsDataForKey:(NSString *)key {
+    if (!key) {
+        return NO;
+    }
+    [_lock lock];
+    BOOL contains = _entries[key] != nil;
+    [_lock unlock];
+    return contains;
+}
+
+- (unsigned long long)contentsSize {
+    [_lock lock];
+    unsigned long long contentsSize = _contentsSize;
+    [_lock unlock];
+    return contentsSize;
+}
+
+- (NSUInteger)contentsCount {
+    [_lock lock];
+    NSUInteger count = _entries.count;
+    [_lock unlock];
+    return count;
+}
+
+#pragma mark - Compaction
+
+/*! Returns YES if any of the sealed segments should be compacted and marks compaction as scheduled. Must be called under the lock.
+ */
+- (BOOL)_shouldCompact {
+    if (_compactionScheduled) {
+        return NO;
+    }
+    for (_DFPackSegment *segment in _segments) {
+        if (segment != _activeSegment && segment->_length > 0 && (segment->_length - segment->_liveLength) > segment->_length * _compactionThreshold) {
+            _compactionScheduled = YES;
+            return YES;
+        }
+    }
+    return NO;
+}
+
+- (void)_scheduleCompaction {
+    DFPackStorage *__weak weakSelf = self;
+    dispatch_async(_compactionQueue, ^{
+        [weakSelf _compactSegmentsWithThreshold:weakSelf.compactionThreshold];
+    });
+}
+
+- (void)compact {
+    dispatch_sync(_compactionQueue, ^{
+        [self _compactSegmentsWithThreshold:0.f];
+    });
+}
+
+/*! Compacts sealed segments which share of garbage exceeds the given threshold. Must be called on the compaction queue.
+ */
+- (void)_compactSegmentsWithThreshold:(float)threshold {
+    [_lock lock];
+    _compactionScheduled = NO;
+    NSMutableArray *segments = [NSMutableArray new];
+    for (_DFPackSegment *segment in _segments) {
+        if (segment != _activeSegment && (segment->_length - segment->_liveLength) > segment->_length * threshold) {
+            [segments addObject:segment];
+        }
+    }
+    [_lock unlock];
+    for (_DFPackSegment *segment in segments) {
+        [self _compactSegment:segment];
+    }
+}
+
+/*! Rewrites live entries of the sealed segment to the active segment sorted by their locality groups and removes the segment. Sealed segment is immutable so its records are read without the lock.
+ */
+- (void)_compactSegment:(_DFPackSegment *)segment {
+    NSMutableArray *keys = [NSMutableArray new];
+    NSMutableArray *removedKeys = [NSMutableArray new];
+    [self _enumerateRecordsInSegment:segment verify:NO usingBlock:^(const _DFPackRecordHeader *header, NSString *key, NSString *group, unsigned long long dataOffset, unsigned long long recordLength) {
+        [((header->flags & _DFPackRecordFlagRemoved) ? removedKeys : keys) addObject:key];
+    }];
+    [_lock lock];
+    NSMutableArray *entries = [NSMutableArray new];
+    NSMutableArray *entryKeys = [NSMutableArray new];
+    for (NSString *key in [NSOrderedSet orderedSetWithArray:keys]) {
+        _DFPackEntry *entry = _entries[key];
+        if (entry && entry->_segment == segment) {
+            [entries addObject:entry];
+            [entryKeys addObject:key];
+        }
+    }
+    [_lock unlock];
+
+    // Keys are grouped by their locality groups, entries without a group go last.
+    NSMutableArray *order = [NSMutableArray new];
+    for (NSUInteger i = 0; i < entries.count; i++) {
+        [order addObject:@(i)];
+    }
+    [order sortUsingComparator:^NSComparisonResult(NSNumber *index1, NSNumber *index2) {
+        NSString *group1 = ((_DFPackEntry *)entries[index1.unsignedIntegerValue])->_group;
+        NSString *group2 = ((_DFPackEntry *)entries[index2.unsignedIntegerValue])->_group;
+        if (group1 != group2 && ![group1 isEqualToString:group2]) {
+            return !group1 ? NSOrderedDescending : (!group2 ? NSOrderedAscending : [group1 compare:group2]);
+        }
+        return [entryKeys[index1.unsignedIntegerValue] compare:entryKeys[index2.unsignedIntegerValue]];
+    }];
+    NSMutableArray *datas = [[NSMutableArray alloc] initWithCapacity:order.count];
+    for (NSNumber *index in order) {
+        _DFPackEntry *entry = entries[index.unsignedIntegerValue];
+        NSMutableData *data = [NSMutableData dataWithLength:(NSUInteger)entry->_dataLength];
+        if (!_DFPackStorageRead(segment->_fd, data.mutableBytes, data.length, (off_t)entry->_dataOffset)) {
+            return; // Segment is kept
+        }
+        [datas addObject:data];
+    }
+
+    [_lock lock];
+    if ([_segments indexOfObjectIdenticalTo:segment] == NSNotFound) {
+        [_lock unlock];
+        return; // All data was removed during compaction
+    }
+    // Records are only built for the entries that are still current, otherwise the copy would shadow the newer record when segments are replayed.
+    NSMutableData *records = [NSMutableData new];
+    NSMutableArray *compactedEntries = [NSMutableArray new];
+    NSMutableArray *compactedKeys = [NSMutableArray new];
+    NSMutableData *dataOffsets = [NSMutableData new];
+    for (NSUInteger i = 0; i < order.count; i++) {
+        NSUInteger index = [order[i] unsignedIntegerValue];
+        _DFPackEntry *entry = entries[index];
+        NSString *key = entryKeys[index];
+        if (_entries[key] == entry) {
+            unsigned long long dataOffset = _DFPackStorageAppendRecord(records, 0, [key dataUsingEncoding:NSUTF8StringEncoding], [entry->_group dataUsingEncoding:NSUTF8StringEncoding], datas[i]);
+            [dataOffsets appendBytes:&dataOffset length:sizeof(dataOffset)];
+            [compactedEntries addObject:entry];
+            [compactedKeys addObject:key];
+        }
+    }
+    BOOL oldest = _segments.firstObject == segment;
+    for (NSString *key in removedKeys) {
+        // Tombstones are only needed while the older segments might contain the removed entries.
+        if (!oldest && !_entries[key]) {
+            _DFPackStorageAppendRecord(records, _DFPackRecordFlagRemoved, [key dataUsingEncoding:NSUTF8StringEncoding], nil, nil);
+        }
+    }
+    unsigned long long offset = 0;
+    _DFPackSegment *activeSegment = records.length ? [self _appendRecords:records offset:&offset] : _activeSegment;
+    if (activeSegment) {
+        const unsigned long long *offsets = dataOffsets.bytes;
+        for (NSUInteger i = 0; i < compactedKeys.count; i++) {
+            _DFPackEntry *entry = compactedEntries[i];
+            _DFPackEntry *compactedEntry = [_DFPackEntry new];
+            compactedEntry->_segment = activeSegment;
+            compactedEntry->_dataOffset = offset + offsets[i];
+            compactedEntry->_dataLength = entry->_dataLength;
+            compactedEntry->_recordLength = entry->_recordLength;
+            compactedEntry->_group = entry->_group;
+            compactedEntry->_accessTime = entry->_accessTime;
+            [self _removeEntryForKey:compactedKeys[i]];
+            [self _setEntry:compactedEntry forKey:compactedKeys[i]];
+        }
+        [_segments removeObjectIdenticalTo:segment];
+        _contentsSize -= segment->_length;
+        unlink([[self _pathForSegmentWithIdentifier:segment->_identifier] fileSystemRepresentation]);
+    }
+    [_lock unlock];
+}
+
+#pragma mark - Storage Engine
+
+- (BOOL)getStat:(DFStorageEntryStat *)stat forKey:(NSString *)key {
+    if (!key) {
+        return NO;
+    }
+    [_lock lock];
+    _DFPackEntry *entry = _entries[key];
+    if (entry && stat) {
+        *stat = (DFStorageEntryStat){ .size = entry->_recordLength, .accessTime = entry->_accessTime };
+    }
+    [_lock unlock];
+    return entry != nil;
+}
+
+- (NSString *)identifierForKey:(NSString *)key {
+    return key;
+}
+
+- (NSString *)keyForIdentifier:(NSString *)identifier {
+    return identifier;
+}
+
+- (void)enumerateEntriesUsingBlock:(void (^)(NSString *, DFStorageEntryStat, BOOL *))block {
+    [_lock lock];
+    NSArray *keys = [_entries allKeys];
+    NSMutableData *stats = [[NSMutableData alloc] initWithCapacity:keys.count * sizeof(DFStorageEntryStat)];
+    for (NSString *key in keys) {
+        _DFPackEntry *entry = _entries[key];
+        DFStorageEntryStat stat = { .size = entry->_recordLength, .accessTime = entry->_accessTime };
+        [stats appendBytes:&stat length:sizeof(stat)];
+    }
+    [_lock unlock];
+    const DFStorageEntryStat *entryStats = stats.bytes;
+    BOOL stop = NO;
+    for (NSUInteger i = 0; i < keys.count && !stop; i++) {
+        block(keys[i], entryStats[i], &stop);
+    }
+}
+
+- (void)removeEntriesWithIdentifiers:(NSArray *)identifiers {
+    [self removeDataForKeys:identifiers];
+}
+
+#pragma mark - Miscellaneous
+
+- (NSString *)debugDescription {
+    return [NSString stringWithFormat:@"<%@ %p> { path: %@; entries: %lu; segments: %lu }", [self class], self, _path, (unsigned long)self.contentsCount, (unsigned long)_segments.count];
+}
+
+@end
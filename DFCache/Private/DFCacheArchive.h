@@ -0,0 +1,68 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Entry of the cache archive.
+ */
+@interface DFCacheArchiveEntry : NSObject
+
+- (instancetype)initWithIdentifier:(NSString *)identifier data:(NSData *)data attributes:(nullable NSDictionary *)attributes accessTime:(CFAbsoluteTime)accessTime NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+/*! Name of the file or the key of the entry of the storage engine.
+ */
+@property (nonatomic, readonly) NSString *identifier;
+@property (nonatomic, readonly) NSData *data;
+
+/*! Extended attributes of the entry: names and the values archived with NSKeyedArchiver (see NSURL+DFExtendedFileAttributes).
+ */
+@property (nullable, nonatomic, readonly) NSDictionary *attributes;
+@property (nonatomic, readonly) CFAbsoluteTime accessTime;
+
+@end
+
+
+/*! Writes cache archive to the stream: a header followed by the entry records and the end record. Each record is protected by a checksum. Records are buffered and written to the stream in large chunks.
+ */
+@interface DFCacheArchiveWriter : NSObject
+
+/*! Initializes writer and writes archive header. The stream is opened if needed.
+ */
+- (instancetype)initWithStream:(NSOutputStream *)stream NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+/*! Returns NO if the stream failed.
+ */
+- (BOOL)writeEntry:(DFCacheArchiveEntry *)entry;
+
+/*! Writes the end record and flushes the buffer. Returns NO if the stream failed.
+ */
+- (BOOL)finish;
+
+@end
+
+
+/*! Reads cache archive from the stream sequentially.
+ */
+@interface DFCacheArchiveReader : NSObject
+
+/*! Initializes reader and reads archive header. The stream is opened if needed.
+ */
+- (instancetype)initWithStream:(NSInputStream *)stream NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+/*! Returns the next entry or nil if the end record was reached or the archive is damaged.
+ */
+- (nullable DFCacheArchiveEntry *)nextEntry;
+
+/*! Returns YES once the valid end record was read and the number of the read entries matches it.
+ */
+@property (nonatomic, readonly, getter=isFinished) BOOL finished;
+
+@end
+
+NS_ASSUME_NONNULL_END
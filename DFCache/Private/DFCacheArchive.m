@@ -0,0 +1,320 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFCacheArchive.h"
+
+/*! Archive layout: magic and version followed by the records. Record layout: header, identifier, attributes, data. Attributes layout: u32 count, then u32 name length, name, u32 value length, value for each attribute. The end record has no payload, its data length is the number of the entries in the archive.
+ */
+typedef struct {
+    /*! Checksum of the record following the checksum, including payload.
+     */
+    uint32_t checksum;
+    uint8_t type;
+    uint8_t reserved[3];
+    double accessTime;
+    uint32_t identifierLength;
+    uint32_t attributesLength;
+    uint64_t dataLength;
+} _DFCacheArchiveRecordHeader;
+
+typedef NS_ENUM(uint8_t, _DFCacheArchiveRecordType) {
+    _DFCacheArchiveRecordTypeEnd = 0,
+    _DFCacheArchiveRecordTypeEntry = 1
+};
+
+static const uint32_t DFCacheArchiveMagic = 0x44464341; // "DFCA"
+static const uint32_t DFCacheArchiveVersion = 1;
+
+/*! Records are written to and read from the stream in chunks of this size.
+ */
+static const NSUInteger DFCacheArchiveBufferSize = 1024 * 1024;
+
+/*! Records that exceed these limits are considered damaged.
+ */
+static const uint32_t DFCacheArchiveMaximumIdentifierLength = 4096;
+static const uint32_t DFCacheArchiveMaximumAttributesLength = 16 * 1024 * 1024;
+static const uint64_t DFCacheArchiveMaximumDataLength = 4ull * 1024 * 1024 * 1024;
+
+static uint32_t _DFCacheArchiveChecksum(uint32_t hash, const uint8_t *bytes, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u; // FNV-1a
+    }
+    return hash;
+}
+
+static const uint32_t DFCacheArchiveChecksumBasis = 2166136261u;
+
+static NSData *_DFCacheArchiveEncodeAttributes(NSDictionary *attributes) {
+    NSMutableData *data = [NSMutableData new];
+    uint32_t count = (uint32_t)attributes.count;
+    [data appendBytes:&count length:sizeof(count)];
+    for (NSString *name in attributes) {
+        NSData *nameData = [name dataUsingEncoding:NSUTF8StringEncoding];
+        NSData *value = attributes[name];
+        uint32_t nameLength = (uint32_t)nameData.length, valueLength = (uint32_t)value.length;
+        [data appendBytes:&nameLength length:sizeof(nameLength)];
+        [data appendData:nameData];
+        [data appendBytes:&valueLength length:sizeof(valueLength)];
+        [data appendData:value];
+    }
+    return data;
+}
+
+/*! Returns nil if the attributes are damaged.
+ */
+static NSDictionary *_DFCacheArchiveDecodeAttributes(NSData *data) {
+    const uint8_t *bytes = data.bytes;
+    size_t length = data.length, offset = 0;
+    uint32_t count;
+    if (length < sizeof(count)) {
+        return nil;
+    }
+    memcpy(&count, bytes, sizeof(count));
+    offset += sizeof(count);
+    NSMutableDictionary *attributes = [NSMutableDictionary new];
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t nameLength, valueLength;
+        if (length - offset < sizeof(nameLength)) {
+            return nil;
+        }
+        memcpy(&nameLength, bytes + offset, sizeof(nameLength));
+        offset += sizeof(nameLength);
+        if (length - offset < nameLength) {
+            return nil;
+        }
+        NSString *name = [[NSString alloc] initWithBytes:bytes + offset length:nameLength encoding:NSUTF8StringEncoding];
+        offset += nameLength;
+        if (length - offset < sizeof(valueLength)) {
+            return nil;
+        }
+        memcpy(&valueLength, bytes + offset, sizeof(valueLength));
+        offset += sizeof(valueLength);
+        if (!name || length - offset < valueLength) {
+            return nil;
+        }
+        attributes[name] = [NSData dataWithBytes:bytes + offset length:valueLength];
+        offset += valueLength;
+    }
+    return attributes;
+}
+
+
+@implementation DFCacheArchiveEntry
+
+- (instancetype)initWithIdentifier:(NSString *)identifier data:(NSData *)data attributes:(NSDictionary *)attributes accessTime:(CFAbsoluteTime)accessTime {
+    if (self = [super init]) {
+        _identifier = identifier;
+        _data = data;
+        _attributes = attributes;
+        _accessTime = accessTime;
+    }
+    return self;
+}
+
+- (instancetype)init {
+    [NSException raise:NSInternalInconsistencyException format:@"Please use designated initialzier"];
+    return nil;
+}
+
+@end
+
+
+#pragma mark - DFCacheArchiveWriter -
+
+@implementation DFCacheArchiveWriter {
+    NSOutputStream *_stream;
+    NSMutableData *_buffer;
+    uint64_t _count;
+    BOOL _failed;
+}
+
+- (instancetype)initWithStream:(NSOutputStream *)stream {
+    if (self = [super init]) {
+        _stream = stream;
+        if (_stream.streamStatus == NSStreamStatusNotOpen) {
+            [_stream open];
+        }
+        _buffer = [[NSMutableData alloc] initWithCapacity:DFCacheArchiveBufferSize];
+        uint32_t header[2] = { DFCacheArchiveMagic, DFCacheArchiveVersion };
+        [_buffer appendBytes:header length:sizeof(header)];
+    }
+    return self;
+}
+
+- (instancetype)init {
+    [NSException raise:NSInternalInconsistencyException format:@"Please use designated initialzier"];
+    return nil;
+}
+
+- (BOOL)writeEntry:(DFCacheArchiveEntry *)entry {
+    NSData *identifier = [entry.identifier dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *attributes = _DFCacheArchiveEncodeAttributes(entry.attributes);
+    NSData *data = entry.data;
+    _DFCacheArchiveRecordHeader header = {
+        .type = _DFCacheArchiveRecordTypeEntry,
+        .accessTime = entry.accessTime,
+        .identifierLength = (uint32_t)identifier.length,
+        .attributesLength = (uint32_t)attributes.length,
+        .dataLength = data.length
+    };
+    uint32_t checksum = _DFCacheArchiveChecksum(DFCacheArchiveChecksumBasis, (const uint8_t *)&header + sizeof(header.checksum), sizeof(header) - sizeof(header.checksum));
+    checksum = _DFCacheArchiveChecksum(checksum, identifier.bytes, identifier.length);
+    checksum = _DFCacheArchiveChecksum(checksum, attributes.bytes, attributes.length);
+    header.checksum = _DFCacheArchiveChecksum(checksum, data.bytes, data.length);
+    [self _appendBytes:&header length:sizeof(header)];
+    [self _appendBytes:identifier.bytes length:identifier.length];
+    [self _appendBytes:attributes.bytes length:attributes.length];
+    [self _appendBytes:data.bytes length:data.length];
+    _count++;
+    return !_failed;
+}
+
+- (BOOL)finish {
+    _DFCacheArchiveRecordHeader header = { .type = _DFCacheArchiveRecordTypeEnd, .dataLength = _count };
+    header.checksum = _DFCacheArchiveChecksum(DFCacheArchiveChecksumBasis, (const uint8_t *)&header + sizeof(header.checksum), sizeof(header) - sizeof(header.checksum));
+    [self _appendBytes:&header length:sizeof(header)];
+    [self _flush];
+    return !_failed;
+}
+
+- (void)_appendBytes:(const void *)bytes length:(NSUInteger)length {
+    if (_buffer.length + length > DFCacheArchiveBufferSize) {
+        [self _flush];
+    }
+    if (length >= DFCacheArchiveBufferSize) {
+        // Large values are written directly without copying them into the buffer.
+        [self _writeBytes:bytes length:length];
+    } else {
+        [_buffer appendBytes:bytes length:length];
+    }
+}
+
+- (void)_flush {
+    [self _writeBytes:_buffer.bytes length:_buffer.length];
+    _buffer.length = 0;
+}
+
+- (void)_writeBytes:(const uint8_t *)bytes length:(NSUInteger)length {
+    while (length > 0 && !_failed) {
+        NSInteger written = [_stream write:bytes maxLength:length];
+        if (written <= 0) {
+            _failed = YES;
+            break;
+        }
+        bytes += written;
+        length -= written;
+    }
+}
+
+@end
+
+
+#pragma mark - DFCacheArchiveReader -
+
+@implementation DFCacheArchiveReader {
+    NSInputStream *_stream;
+    NSMutableData *_buffer;
+    NSUInteger _bufferOffset;
+    uint64_t _count;
+    BOOL _failed;
+}
+
+- (instancetype)initWithStream:(NSInputStream *)stream {
+    if (self = [super init]) {
+        _stream = stream;
+        if (_stream.streamStatus == NSStreamStatusNotOpen) {
+            [_stream open];
+        }
+        _buffer = [NSMutableData new];
+        uint32_t header[2];
+        _failed = ![self _readBytes:header length:sizeof(header)] || header[0] != DFCacheArchiveMagic || header[1] != DFCacheArchiveVersion;
+    }
+    return self;
+}
+
+- (instancetype)init {
+    [NSException raise:NSInternalInconsistencyException format:@"Please use designated initialzier"];
+    return nil;
+}
+
+- (DFCacheArchiveEntry *)nextEntry {
+    if (_failed || _finished) {
+        return nil;
+    }
+    _DFCacheArchiveRecordHeader header;
+    if (![self _readBytes:&header length:sizeof(header)]) {
+        _failed = YES;
+        return nil;
+    }
+    uint32_t checksum = _DFCacheArchiveChecksum(DFCacheArchiveChecksumBasis, (const uint8_t *)&header + sizeof(header.checksum), sizeof(header) - sizeof(header.checksum));
+    if (header.type == _DFCacheArchiveRecordTypeEnd) {
+        _finished = (checksum == header.checksum && header.dataLength == _count);
+        _failed = !_finished;
+        return nil;
+    }
+    if (header.type != _DFCacheArchiveRecordTypeEntry ||
+        header.identifierLength > DFCacheArchiveMaximumIdentifierLength ||
+        header.attributesLength > DFCacheArchiveMaximumAttributesLength ||
+        header.dataLength > DFCacheArchiveMaximumDataLength) {
+        _failed = YES;
+        return nil;
+    }
+    NSMutableData *identifier = [NSMutableData dataWithLength:header.identifierLength];
+    NSMutableData *attributes = [NSMutableData dataWithLength:header.attributesLength];
+    NSMutableData *data = [NSMutableData dataWithLength:(NSUInteger)header.dataLength];
+    if (![self _readBytes:identifier.mutableBytes length:identifier.length] ||
+        ![self _readBytes:attributes.mutableBytes length:attributes.length] ||
+        ![self _readBytes:data.mutableBytes length:data.length]) {
+        _failed = YES;
+        return nil;
+    }
+    checksum = _DFCacheArchiveChecksum(checksum, identifier.bytes, identifier.length);
+    checksum = _DFCacheArchiveChecksum(checksum, attributes.bytes, attributes.length);
+    checksum = _DFCacheArchiveChecksum(checksum, data.bytes, data.length);
+    NSString *identifierString = [[NSString alloc] initWithData:identifier encoding:NSUTF8StringEncoding];
+    NSDictionary *attributesDictionary = _DFCacheArchiveDecodeAttributes(attributes);
+    if (checksum != header.checksum || !identifierString.length || !attributesDictionary) {
+        _failed = YES;
+        return nil;
+    }
+    _count++;
+    return [[DFCacheArchiveEntry alloc] initWithIdentifier:identifierString data:data attributes:attributesDictionary accessTime:header.accessTime];
+}
+
+/*! Reads exactly the given number of bytes. Large reads bypass the buffer.
+ */
+- (BOOL)_readBytes:(void *)bytes length:(NSUInteger)length {
+    uint8_t *output = bytes;
+    while (length > 0) {
+        NSUInteger available = _buffer.length - _bufferOffset;
+        if (available > 0) {
+            NSUInteger count = MIN(available, length);
+            memcpy(output, (const uint8_t *)_buffer.bytes + _bufferOffset, count);
+            _bufferOffset += count;
+            output += count;
+            length -= count;
+            continue;
+        }
+        if (length >= DFCacheArchiveBufferSize) {
+            NSInteger read = [_stream read:output maxLength:length];
+            if (read <= 0) {
+                return NO;
+            }
+            output += read;
+            length -= read;
+            continue;
+        }
+        _buffer.length = DFCacheArchiveBufferSize;
+        NSInteger read = [_stream read:_buffer.mutableBytes maxLength:_buffer.length];
+        _buffer.length = MAX(read, 0);
+        _bufferOffset = 0;
+        if (read <= 0) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+@end
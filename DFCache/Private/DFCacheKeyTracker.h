@@ -0,0 +1,37 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Thread-safe bounded set of keys ranked by recency and frequency of access.
+ */
+@interface DFCacheKeyTracker : NSObject
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity NS_DESIGNATED_INITIALIZER;
+
+/*! Maximum number of tracked keys. Keys with the lowest priority are discarded first.
+ */
+@property (nonatomic) NSUInteger capacity;
+
+/*! Keys are only tracked while the tracker is enabled, disabling the tracker discards tracked keys. Default value is YES.
+ */
+@property (nonatomic, getter=isEnabled) BOOL enabled;
+
+- (void)recordAccessForKey:(NSString *)key;
+- (void)removeKey:(NSString *)key;
+- (void)removeAllKeys;
+
+/*! Starts tracking keys that were not accessed yet, highest priority first. Keys that are already tracked are not affected.
+ */
+- (void)addKeys:(NSArray *)keys;
+
+/*! Returns tracked keys ordered by priority, highest priority first.
+ */
+- (NSArray *)keysOrderedByPriority;
+
+@end
+
+NS_ASSUME_NONNULL_END
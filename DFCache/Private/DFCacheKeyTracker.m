@@ -0,0 +1,153 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFCacheKeyTracker.h"
+
+/*! Age (in seconds) at which the access frequency of the key weights half as much.
+ */
+static const NSTimeInterval DFCacheKeyTrackerRecencyHalfLife = 3600.0;
+
+@interface _DFCacheKeyTrackerEntry : NSObject {
+    @public
+    NSUInteger _accessCount;
+    CFAbsoluteTime _accessTime;
+}
+@end
+
+@implementation _DFCacheKeyTrackerEntry
+@end
+
+
+@implementation DFCacheKeyTracker {
+    NSMutableDictionary *_entries;
+    NSLock *_lock;
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity {
+    if (self = [super init]) {
+        _capacity = capacity;
+        _enabled = YES;
+        _entries = [NSMutableDictionary new];
+        _lock = [NSLock new];
+    }
+    return self;
+}
+
+- (instancetype)init {
+    return [self initWithCapacity:1000];
+}
+
+- (void)setCapacity:(NSUInteger)capacity {
+    [_lock lock];
+    _capacity = capacity;
+    [self _trimToCapacity:capacity];
+    [_lock unlock];
+}
+
+- (BOOL)isEnabled {
+    [_lock lock];
+    BOOL enabled = _enabled;
+    [_lock unlock];
+    return enabled;
+}
+
+- (void)setEnabled:(BOOL)enabled {
+    [_lock lock];
+    _enabled = enabled;
+    if (!enabled) {
+        [_entries removeAllObjects];
+    }
+    [_lock unlock];
+}
+
+- (void)recordAccessForKey:(NSString *)key {
+    if (!key) {
+        return;
+    }
+    [_lock lock];
+    if (!_enabled) {
+        [_lock unlock];
+        return;
+    }
+    _DFCacheKeyTrackerEntry *entry = _entries[key];
+    if (!entry) {
+        entry = [_DFCacheKeyTrackerEntry new];
+        _entries[key] = entry;
+    }
+    entry->_accessCount++;
+    entry->_accessTime = CFAbsoluteTimeGetCurrent();
+    if (_entries.count > _capacity * 2) {
+        // Trim in batches to keep the cost of recording access amortized O(1).
+        [self _trimToCapacity:_capacity];
+    }
+    [_lock unlock];
+}
+
+- (void)removeKey:(NSString *)key {
+    if (!key) {
+        return;
+    }
+    [_lock lock];
+    [_entries removeObjectForKey:key];
+    [_lock unlock];
+}
+
+- (void)removeAllKeys {
+    [_lock lock];
+    [_entries removeAllObjects];
+    [_lock unlock];
+}
+
+- (void)addKeys:(NSArray *)keys {
+    [_lock lock];
+    if (!_enabled) {
+        [_lock unlock];
+        return;
+    }
+    CFAbsoluteTime time = CFAbsoluteTimeGetCurrent();
+    NSUInteger accessCount = keys.count;
+    for (NSString *key in keys) {
+        if (!_entries[key]) {
+            // Preserve the order of the keys by assigning decreasing access counts.
+            _DFCacheKeyTrackerEntry *entry = [_DFCacheKeyTrackerEntry new];
+            entry->_accessCount = accessCount;
+            entry->_accessTime = time;
+            _entries[key] = entry;
+        }
+        accessCount--;
+    }
+    [self _trimToCapacity:_capacity];
+    [_lock unlock];
+}
+
+- (NSArray *)keysOrderedByPriority {
+    [_lock lock];
+    NSArray *keys = [self _keysOrderedByPriority];
+    [_lock unlock];
+    return keys;
+}
+
+#pragma mark - Private (Lock Acquired)
+
+- (NSArray *)_keysOrderedByPriority {
+    CFAbsoluteTime time = CFAbsoluteTimeGetCurrent();
+    NSMutableDictionary *priorities = [[NSMutableDictionary alloc] initWithCapacity:_entries.count];
+    [_entries enumerateKeysAndObjectsUsingBlock:^(NSString *key, _DFCacheKeyTrackerEntry *entry, BOOL *stop) {
+        NSTimeInterval age = MAX(0.0, time - entry->_accessTime);
+        priorities[key] = @(entry->_accessCount / (1.0 + age / DFCacheKeyTrackerRecencyHalfLife));
+    }];
+    return [priorities keysSortedByValueWithOptions:0 usingComparator:^NSComparisonResult(NSNumber *obj1, NSNumber *obj2) {
+        return [obj2 compare:obj1];
+    }];
+}
+
+- (void)_trimToCapacity:(NSUInteger)capacity {
+    if (_entries.count <= capacity) {
+        return;
+    }
+    NSArray *keys = [self _keysOrderedByPriority];
+    [_entries removeObjectsForKeys:[keys subarrayWithRange:NSMakeRange(capacity, keys.count - capacity)]];
+}
+
+@end
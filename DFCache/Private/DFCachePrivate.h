@@ -4,6 +4,12 @@
 
 #import <Foundation/Foundation.h>
 
+#pragma mark - Constants -
+
+/*! Extended attribute name used to store value transformer associated with data.
+ */
+static NSString *const DFCacheAttributeValueTransformerNameKey = @"_df_cache_value_transformer_name_key";
+
 #pragma mark - Functions -
 
 static inline void
@@ -26,6 +32,18 @@ _dwarf_cache_sha1(const char *data, uint32_t length);
 extern NSString *
 _dwarf_bytes_to_str(unsigned long long bytes);
 
+/*! Frames data as [name length (1 byte)][value transformer name][data] so that the data is stored together with the name of its value transformer.
+ @return Frame or nil if the name is longer than 255 bytes.
+ */
+extern NSData *
+_dwarf_cache_frame(NSData *data, NSString *valueTransformerName);
+
+/*! Returns data of the frame created by _dwarf_cache_frame or nil if the frame is malformed.
+ @param valueTransformerName On return contains the name of the value transformer, might be NULL.
+ */
+extern NSData *
+_dwarf_cache_unframe(NSData *frame, NSString *__autoreleasing *valueTransformerName);
+
 #pragma mark - Types -
 
 typedef unsigned long long _dwarf_cache_bytes;
@@ -27,3 +27,32 @@ NSString *
 _dwarf_bytes_to_str(unsigned long long bytes) {
     return [NSByteCountFormatter stringFromByteCount:bytes countStyle:NSByteCountFormatterCountStyleBinary];
 }
+
+NSData *
+_dwarf_cache_frame(NSData *data, NSString *valueTransformerName) {
+    NSData *name = [valueTransformerName dataUsingEncoding:NSUTF8StringEncoding];
+    if (name.length > UINT8_MAX) {
+        return nil;
+    }
+    uint8_t nameLength = (uint8_t)name.length;
+    NSMutableData *frame = [NSMutableData dataWithCapacity:1 + nameLength + data.length];
+    [frame appendBytes:&nameLength length:1];
+    [frame appendData:name ?: [NSData data]];
+    [frame appendData:data];
+    return frame;
+}
+
+NSData *
+_dwarf_cache_unframe(NSData *frame, NSString *__autoreleasing *valueTransformerName) {
+    if (!frame.length) {
+        return nil;
+    }
+    NSUInteger nameLength = ((const uint8_t *)frame.bytes)[0];
+    if (1 + nameLength > frame.length) {
+        return nil;
+    }
+    if (valueTransformerName) {
+        *valueTransformerName = nameLength ? [[NSString alloc] initWithBytes:(const uint8_t *)frame.bytes + 1 length:nameLength encoding:NSUTF8StringEncoding] : nil;
+    }
+    return [frame subdataWithRange:NSMakeRange(1 + nameLength, frame.length - 1 - nameLength)];
+}
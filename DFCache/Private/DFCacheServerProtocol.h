@@ -0,0 +1,91 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import <Foundation/Foundation.h>
+#import <sys/un.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/* Binary protocol spoken by DFCacheServer and DFCacheClient over a Unix domain socket.
+
+ Frame: [length (uint32)][code (uint8)][payload (length - 1 bytes)]. Request code is the operation, response code is the status. Integers are little-endian, fields are [length (uint32)][bytes]. Server sends a response to each request in the order of requests so that clients can pipeline requests without waiting for the responses.
+
+ Operation       Request payload                 Response payload
+ Get             key                             data
+ Put             key, data                       -
+ Remove          count (uint32), keys            -
+ RemoveAll       -                               -
+ GetMetadata     key                             archived metadata
+ SetMetadata     key, archived metadata          -
+ RemoveMetadata  key                             -
+ MultiGet        count (uint32), keys            for each key: found (uint8), data if found
+
+ Response that would be longer than the maximum frame length is answered with the Error status. MultiGet response is cut short instead, the keys that are missing from the response are not found.
+ */
+
+typedef NS_ENUM(uint8_t, DFCacheServerOperation) {
+    DFCacheServerOperationGet = 1,
+    DFCacheServerOperationPut = 2,
+    DFCacheServerOperationRemove = 3,
+    DFCacheServerOperationRemoveAll = 4,
+    DFCacheServerOperationGetMetadata = 5,
+    DFCacheServerOperationSetMetadata = 6,
+    DFCacheServerOperationRemoveMetadata = 7,
+    DFCacheServerOperationMultiGet = 8
+};
+
+typedef NS_ENUM(uint8_t, DFCacheServerStatus) {
+    DFCacheServerStatusOK = 0,
+    DFCacheServerStatusNotFound = 1,
+    DFCacheServerStatusError = 2
+};
+
+/*! Maximum length of the frame. Peer that sends a longer frame is disconnected.
+ */
+extern const uint32_t DFCacheServerMaximumFrameLength;
+
+/*! Maximum time in milliseconds to wait for the socket to become writable. Peer that doesn't read its socket for that long is disconnected.
+ */
+extern const int DFCacheServerWriteTimeout;
+
+/*! Cursor over the frame payload. Reading past the end of the payload marks cursor as failed.
+ */
+typedef struct {
+    const uint8_t *bytes;
+    NSUInteger length;
+    NSUInteger offset;
+    BOOL failed;
+} _DFCacheServerCursor;
+
+/*! Appends the frame with the given code and payload. Returns NO without appending anything if the frame would be longer than DFCacheServerMaximumFrameLength.
+ */
+extern BOOL _DFCacheServerAppendFrame(NSMutableData *buffer, uint8_t code, NSData *__nullable payload);
+
+extern void _DFCacheServerAppendUInt32(NSMutableData *payload, uint32_t value);
+extern void _DFCacheServerAppendField(NSMutableData *payload, NSData *__nullable field);
+extern void _DFCacheServerAppendString(NSMutableData *payload, NSString *string);
+
+/*! Parses the frame that starts at the given offset of the buffer and advances the offset past the frame. Returns NO if the frame is not received yet.
+ @param invalid On return is YES if the frame is longer than DFCacheServerMaximumFrameLength.
+ */
+extern BOOL _DFCacheServerReadFrame(NSData *buffer, NSUInteger *offset, uint8_t *code, NSData *__nullable *__nonnull payload, BOOL *invalid);
+
+extern _DFCacheServerCursor _DFCacheServerCursorMake(NSData *payload);
+extern uint32_t _DFCacheServerReadUInt32(_DFCacheServerCursor *cursor);
+extern NSData *__nullable _DFCacheServerReadField(_DFCacheServerCursor *cursor);
+extern NSString *__nullable _DFCacheServerReadString(_DFCacheServerCursor *cursor);
+
+/*! Unarchives metadata received from the peer. Returns nil if the archive is malformed or doesn't contain a dictionary.
+ */
+extern NSDictionary *__nullable _DFCacheServerUnarchiveMetadata(NSData *__nullable data);
+
+/*! Writes all the bytes to the socket, waiting for the socket to become writable if needed. Returns NO if the peer is disconnected or the socket doesn't become writable within DFCacheServerWriteTimeout.
+ */
+extern BOOL _DFCacheServerWrite(int socket, NSData *data);
+
+/*! Returns address of the Unix domain socket with the given path. Returns NO if the path is too long.
+ */
+extern BOOL _DFCacheServerSocketAddress(NSString *path, struct sockaddr_un *address);
+
+NS_ASSUME_NONNULL_END
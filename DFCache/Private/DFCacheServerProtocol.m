@@ -0,0 +1,139 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFCacheServerProtocol.h"
+#import <libkern/OSByteOrder.h>
+#import <poll.h>
+#import <sys/socket.h>
+#import <unistd.h>
+
+const uint32_t DFCacheServerMaximumFrameLength = 1024 * 1024 * 64;
+const int DFCacheServerWriteTimeout = 10 * 1000;
+
+BOOL _DFCacheServerAppendFrame(NSMutableData *buffer, uint8_t code, NSData *payload) {
+    if (payload.length >= DFCacheServerMaximumFrameLength) {
+        return NO;
+    }
+    _DFCacheServerAppendUInt32(buffer, (uint32_t)(1 + payload.length));
+    [buffer appendBytes:&code length:1];
+    if (payload) {
+        [buffer appendData:payload];
+    }
+    return YES;
+}
+
+void _DFCacheServerAppendUInt32(NSMutableData *payload, uint32_t value) {
+    uint32_t bytes = OSSwapHostToLittleInt32(value);
+    [payload appendBytes:&bytes length:sizeof(bytes)];
+}
+
+void _DFCacheServerAppendField(NSMutableData *payload, NSData *field) {
+    _DFCacheServerAppendUInt32(payload, (uint32_t)field.length);
+    if (field) {
+        [payload appendData:field];
+    }
+}
+
+void _DFCacheServerAppendString(NSMutableData *payload, NSString *string) {
+    _DFCacheServerAppendField(payload, [string dataUsingEncoding:NSUTF8StringEncoding]);
+}
+
+BOOL _DFCacheServerReadFrame(NSData *buffer, NSUInteger *offset, uint8_t *code, NSData *__autoreleasing *payload, BOOL *invalid) {
+    *invalid = NO;
+    if (buffer.length < *offset + sizeof(uint32_t) + 1) {
+        return NO;
+    }
+    const uint8_t *bytes = (const uint8_t *)buffer.bytes + *offset;
+    uint32_t length = OSReadLittleInt32(bytes, 0);
+    if (length == 0 || length > DFCacheServerMaximumFrameLength) {
+        *invalid = YES;
+        return NO;
+    }
+    if (buffer.length - *offset - sizeof(uint32_t) < length) {
+        return NO;
+    }
+    *code = bytes[sizeof(uint32_t)];
+    *payload = [NSData dataWithBytes:bytes + sizeof(uint32_t) + 1 length:length - 1];
+    *offset += sizeof(uint32_t) + length;
+    return YES;
+}
+
+_DFCacheServerCursor _DFCacheServerCursorMake(NSData *payload) {
+    return (_DFCacheServerCursor){ .bytes = payload.bytes, .length = payload.length, .offset = 0, .failed = NO };
+}
+
+uint32_t _DFCacheServerReadUInt32(_DFCacheServerCursor *cursor) {
+    if (cursor->failed || cursor->length - cursor->offset < sizeof(uint32_t)) {
+        cursor->failed = YES;
+        return 0;
+    }
+    uint32_t value = OSReadLittleInt32(cursor->bytes, cursor->offset);
+    cursor->offset += sizeof(uint32_t);
+    return value;
+}
+
+NSData *_DFCacheServerReadField(_DFCacheServerCursor *cursor) {
+    uint32_t length = _DFCacheServerReadUInt32(cursor);
+    if (cursor->failed || cursor->length - cursor->offset < length) {
+        cursor->failed = YES;
+        return nil;
+    }
+    NSData *field = [NSData dataWithBytes:cursor->bytes + cursor->offset length:length];
+    cursor->offset += length;
+    return field;
+}
+
+NSString *_DFCacheServerReadString(_DFCacheServerCursor *cursor) {
+    NSData *field = _DFCacheServerReadField(cursor);
+    return field ? [[NSString alloc] initWithData:field encoding:NSUTF8StringEncoding] : nil;
+}
+
+NSDictionary *_DFCacheServerUnarchiveMetadata(NSData *data) {
+    if (!data) {
+        return nil;
+    }
+    id metadata;
+    @try {
+        metadata = [NSKeyedUnarchiver unarchiveObjectWithData:data];
+    } @catch (NSException *exception) {
+        return nil; // NSKeyedUnarchiver raises on malformed archives
+    }
+    return [metadata isKindOfClass:[NSDictionary class]] ? metadata : nil;
+}
+
+BOOL _DFCacheServerWrite(int socket, NSData *data) {
+    const uint8_t *bytes = data.bytes;
+    NSUInteger written = 0;
+    while (written < data.length) {
+        ssize_t count = write(socket, bytes + written, data.length - written);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                struct pollfd descriptor = { .fd = socket, .events = POLLOUT };
+                int ready = poll(&descriptor, 1, DFCacheServerWriteTimeout);
+                if (ready > 0 || (ready < 0 && errno == EINTR)) {
+                    continue;
+                }
+                return NO; // Peer doesn't read
+            }
+            return NO;
+        }
+        written += count;
+    }
+    return YES;
+}
+
+BOOL _DFCacheServerSocketAddress(NSString *path, struct sockaddr_un *address) {
+    const char *fileSystemPath = path.fileSystemRepresentation;
+    if (!fileSystemPath || strlen(fileSystemPath) >= sizeof(address->sun_path)) {
+        return NO;
+    }
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    address->sun_len = sizeof(*address);
+    strlcpy(address->sun_path, fileSystemPath, sizeof(address->sun_path));
+    return YES;
+}
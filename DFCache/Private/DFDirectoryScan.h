@@ -0,0 +1,59 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_OPTIONS(NSUInteger, DFDirectoryScanOptions) {
+    DFDirectoryScanOptionNone = 0,
+    /*! Skips files which names start with a period.
+     */
+    DFDirectoryScanOptionSkipsHiddenFiles = 1 << 0
+};
+
+typedef struct {
+    /*! Offset of the null-terminated file name in the names buffer.
+     */
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    /*! Allocated size of the file, in bytes.
+     */
+    unsigned long long size;
+    /*! Length of the file contents, in bytes.
+     */
+    unsigned long long logicalSize;
+    CFAbsoluteTime accessTime;
+} DFDirectoryScanEntry;
+
+
+/*! Immutable snapshot of the regular files in a directory: names, sizes and access times.
+ @discussion Entries are stored in a single C array and file names in a single buffer, no objects are created per file. Directory is read with getattrlistbulk(2) which returns names and attributes of many files in a single system call. Falls back to readdir(3) and fstatat(2) on the systems where getattrlistbulk(2) is not available (prior to OS X 10.10 and iOS 8) or not supported by the file system. Empty files that keep the data of file storage entries inline (see -[DFFileStorage inlineDataThreshold]) are reported with the length of their data and a single allocation unit.
+ */
+@interface DFDirectoryScan : NSObject
+
+/*! Scans the directory at the given path. Returns nil if the directory can't be read.
+ */
+- (nullable instancetype)initWithPath:(NSString *)path options:(DFDirectoryScanOptions)options NS_DESIGNATED_INITIALIZER;
+
+@property (nonatomic, readonly) NSUInteger count;
+@property (nonatomic, readonly) const DFDirectoryScanEntry *entries;
+
+/*! Sum of the allocated sizes of all files, in bytes.
+ */
+@property (nonatomic, readonly) unsigned long long totalSize;
+
+/*! Sum of the logical sizes of all files, in bytes.
+ */
+@property (nonatomic, readonly) unsigned long long totalLogicalSize;
+
+/*! Returns null-terminated name of the file at the given index.
+ */
+- (const char *)filenameAtIndex:(NSUInteger)index NS_RETURNS_INNER_POINTER;
+
+- (NSString *)filenameStringAtIndex:(NSUInteger)index;
+
+@end
+
+NS_ASSUME_NONNULL_END
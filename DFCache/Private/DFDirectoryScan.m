@@ -0,0 +1,278 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFDirectoryScan.h"
+#import "DFFileStoragePrivate.h"
+#import <dirent.h>
+#import <fcntl.h>
+#import <sys/attr.h>
+#import <sys/stat.h>
+#import <sys/vnode.h>
+#import <sys/xattr.h>
+#import <unistd.h>
+
+/*! Size of the buffer that getattrlistbulk(2) fills with the attributes of the directory entries.
+ */
+static const size_t DFDirectoryScanBulkBufferSize = 256 * 1024;
+
+static CFAbsoluteTime _DFDirectoryScanAbsoluteTime(struct timespec time) {
+    return (time.tv_sec - kCFAbsoluteTimeIntervalSince1970) + time.tv_nsec / 1.0e9;
+}
+
+@implementation DFDirectoryScan {
+    DFDirectoryScanEntry *_entries;
+    NSUInteger _capacity;
+    char *_names;
+    size_t _namesLength;
+    size_t _namesCapacity;
+}
+
+- (void)dealloc {
+    free(_entries);
+    free(_names);
+}
+
+- (instancetype)initWithPath:(NSString *)path options:(DFDirectoryScanOptions)options {
+    if (self = [super init]) {
+        BOOL skipsHiddenFiles = (options & DFDirectoryScanOptionSkipsHiddenFiles) != 0;
+        const char *directoryPath = [path fileSystemRepresentation];
+        if (![self _scanWithBulkAttributesAtPath:directoryPath skipsHiddenFiles:skipsHiddenFiles]) {
+            [self _removeAllEntries];
+            if (![self _scanWithDirectoryStreamAtPath:directoryPath skipsHiddenFiles:skipsHiddenFiles]) {
+                return nil;
+            }
+        }
+        [self _accountInlineDataAtPath:directoryPath];
+    }
+    return self;
+}
+
+- (instancetype)init {
+    [NSException raise:NSInternalInconsistencyException format:@"Please use designated initialzier"];
+    return nil;
+}
+
+- (const DFDirectoryScanEntry *)entries {
+    return _entries;
+}
+
+- (const char *)filenameAtIndex:(NSUInteger)index {
+    return _names + _entries[index].nameOffset;
+}
+
+- (NSString *)filenameStringAtIndex:(NSUInteger)index {
+    return [[NSFileManager defaultManager] stringWithFileSystemRepresentation:[self filenameAtIndex:index] length:_entries[index].nameLength];
+}
+
+#pragma mark - Scan
+
+- (BOOL)_scanWithBulkAttributesAtPath:(const char *)path skipsHiddenFiles:(BOOL)skipsHiddenFiles {
+#if DF_FILE_STORAGE_CHECKS_SYSTEM_CALLS
+    if (&getattrlistbulk == NULL) {
+        return NO;
+    }
+#endif
+    // Directory is opened separately because getattrlistbulk(2) advances the position of the descriptor.
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return NO;
+    }
+    struct attrlist attributes = {
+        .bitmapcount = ATTR_BIT_MAP_COUNT,
+        .commonattr = ATTR_CMN_RETURNED_ATTRS | ATTR_CMN_NAME | ATTR_CMN_ERROR | ATTR_CMN_OBJTYPE | ATTR_CMN_ACCTIME,
+        .fileattr = ATTR_FILE_DATALENGTH | ATTR_FILE_DATAALLOCSIZE
+    };
+    char *buffer = malloc(DFDirectoryScanBulkBufferSize);
+    BOOL success = YES;
+    for (;;) {
+        int count = getattrlistbulk(fd, &attributes, buffer, DFDirectoryScanBulkBufferSize, 0);
+        if (count == 0) {
+            break;
+        }
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            success = NO;
+            break;
+        }
+        // Attributes are packed in the order of their bits, see getattrlist(2).
+        const char *entry = buffer;
+        for (int i = 0; i < count; i++) {
+            const char *field = entry;
+            uint32_t length;
+            memcpy(&length, field, sizeof(length));
+            field += sizeof(length);
+            entry += length;
+
+            attribute_set_t returned;
+            memcpy(&returned, field, sizeof(returned));
+            field += sizeof(returned);
+            if (returned.commonattr & ATTR_CMN_ERROR) {
+                uint32_t error;
+                memcpy(&error, field, sizeof(error));
+                field += sizeof(error);
+                if (error != 0) {
+                    continue;
+                }
+            }
+            if (!(returned.commonattr & ATTR_CMN_NAME)) {
+                continue;
+            }
+            attrreference_t nameReference;
+            memcpy(&nameReference, field, sizeof(nameReference));
+            const char *name = field + nameReference.attr_dataoffset;
+            field += sizeof(nameReference);
+
+            fsobj_type_t type = VNON;
+            if (returned.commonattr & ATTR_CMN_OBJTYPE) {
+                memcpy(&type, field, sizeof(type));
+                field += sizeof(type);
+            }
+            struct timespec accessTime = {0, 0};
+            if (returned.commonattr & ATTR_CMN_ACCTIME) {
+                memcpy(&accessTime, field, sizeof(accessTime));
+                field += sizeof(accessTime);
+            }
+            off_t logicalSize = 0;
+            if (returned.fileattr & ATTR_FILE_DATALENGTH) {
+                memcpy(&logicalSize, field, sizeof(logicalSize));
+                field += sizeof(logicalSize);
+            }
+            off_t size = 0;
+            if (returned.fileattr & ATTR_FILE_DATAALLOCSIZE) {
+                memcpy(&size, field, sizeof(size));
+                field += sizeof(size);
+            }
+            if (type != VREG || (skipsHiddenFiles && name[0] == '.')) {
+                continue;
+            }
+            [self _addEntryWithName:name size:size logicalSize:logicalSize accessTime:_DFDirectoryScanAbsoluteTime(accessTime)];
+        }
+    }
+    free(buffer);
+    close(fd);
+    return success;
+}
+
+- (BOOL)_scanWithDirectoryStreamAtPath:(const char *)path skipsHiddenFiles:(BOOL)skipsHiddenFiles {
+    DIR *directory = opendir(path);
+    if (!directory) {
+        return NO;
+    }
+#if DF_FILE_STORAGE_CHECKS_SYSTEM_CALLS
+    BOOL atSystemCallsAvailable = (&fstatat != NULL);
+#else
+    BOOL atSystemCallsAvailable = YES;
+#endif
+    char filePath[PATH_MAX];
+    size_t pathLength = strlcpy(filePath, path, sizeof(filePath) - 1);
+    filePath[pathLength++] = '/';
+    struct dirent *directoryEntry;
+    while ((directoryEntry = readdir(directory)) != NULL) {
+        const char *name = directoryEntry->d_name;
+        if (name[0] == '.' && (skipsHiddenFiles || name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
+        }
+        if (directoryEntry->d_type != DT_REG && directoryEntry->d_type != DT_UNKNOWN) {
+            continue;
+        }
+        struct stat fileStat;
+        int result;
+        if (atSystemCallsAvailable) {
+            result = fstatat(dirfd(directory), name, &fileStat, AT_SYMLINK_NOFOLLOW);
+        } else {
+            strlcpy(filePath + pathLength, name, sizeof(filePath) - pathLength);
+            result = lstat(filePath, &fileStat);
+        }
+        if (result != 0 || !S_ISREG(fileStat.st_mode)) {
+            continue;
+        }
+        [self _addEntryWithName:name size:fileStat.st_blocks * 512 logicalSize:fileStat.st_size accessTime:_DFDirectoryScanAbsoluteTime(fileStat.st_atimespec)];
+    }
+    closedir(directory);
+    return YES;
+}
+
+/*! Replaces the sizes of the empty files that keep their data inline in the extended attribute (see DFFileStorage).
+ */
+- (void)_accountInlineDataAtPath:(const char *)path {
+#if DF_FILE_STORAGE_CHECKS_SYSTEM_CALLS
+    BOOL atSystemCallsAvailable = (&openat != NULL);
+#else
+    BOOL atSystemCallsAvailable = YES;
+#endif
+    int directoryDescriptor = atSystemCallsAvailable ? open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC) : -1;
+    char filePath[PATH_MAX];
+    size_t pathLength = strlcpy(filePath, path, sizeof(filePath) - 1);
+    filePath[pathLength++] = '/';
+    for (NSUInteger i = 0; i < _count; i++) {
+        DFDirectoryScanEntry *entry = &_entries[i];
+        if (entry->logicalSize > 0) {
+            continue;
+        }
+        // Symbolic links are not followed, the same as by the scan.
+        const char *name = _names + entry->nameOffset;
+        int fd;
+        if (directoryDescriptor >= 0) {
+            fd = openat(directoryDescriptor, name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+        } else {
+            strlcpy(filePath + pathLength, name, sizeof(filePath) - pathLength);
+            fd = open(filePath, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+        }
+        if (fd < 0) {
+            continue;
+        }
+        ssize_t length = fgetxattr(fd, DFFileStorageInlineDataAttributeName, NULL, 0, 0, 0);
+        close(fd);
+        if (length > 0) {
+            unsigned long long size = MAX(entry->size, DFFileStorageInlineDataAllocationUnit);
+            _totalSize += size - entry->size;
+            _totalLogicalSize += (unsigned long long)length;
+            entry->size = size;
+            entry->logicalSize = (unsigned long long)length;
+        }
+    }
+    if (directoryDescriptor >= 0) {
+        close(directoryDescriptor);
+    }
+}
+
+#pragma mark - Entries
+
+- (void)_addEntryWithName:(const char *)name size:(off_t)size logicalSize:(off_t)logicalSize accessTime:(CFAbsoluteTime)accessTime {
+    size_t nameLength = strlen(name);
+    if (_count == _capacity) {
+        _capacity = MAX(_capacity * 2, 64);
+        _entries = reallocf(_entries, _capacity * sizeof(DFDirectoryScanEntry));
+    }
+    if (_namesLength + nameLength + 1 > _namesCapacity) {
+        _namesCapacity = MAX(_namesCapacity * 2, _namesLength + nameLength + 1);
+        _names = reallocf(_names, _namesCapacity);
+    }
+    if (!_entries || !_names) {
+        [NSException raise:NSMallocException format:@"Failed to allocate memory for directory scan"];
+    }
+    memcpy(_names + _namesLength, name, nameLength + 1);
+    _entries[_count] = (DFDirectoryScanEntry){
+        .nameOffset = (uint32_t)_namesLength,
+        .nameLength = (uint32_t)nameLength,
+        .size = (unsigned long long)size,
+        .logicalSize = (unsigned long long)logicalSize,
+        .accessTime = accessTime
+    };
+    _namesLength += nameLength + 1;
+    _count++;
+    _totalSize += size;
+    _totalLogicalSize += logicalSize;
+}
+
+- (void)_removeAllEntries {
+    _count = 0;
+    _namesLength = 0;
+    _totalSize = 0;
+    _totalLogicalSize = 0;
+}
+
+@end
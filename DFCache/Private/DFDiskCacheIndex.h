@@ -0,0 +1,84 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface DFDiskCacheIndexEntry : NSObject
+
+- (instancetype)initWithFilename:(NSString *)filename size:(unsigned long long)size logicalSize:(unsigned long long)logicalSize accessTime:(CFAbsoluteTime)accessTime;
+
+@property (nonatomic, readonly) NSString *filename;
+
+/*! Allocated size of the file, in bytes.
+ */
+@property (nonatomic) unsigned long long size;
+
+/*! Length of the file contents, in bytes.
+ */
+@property (nonatomic) unsigned long long logicalSize;
+@property (nonatomic) CFAbsoluteTime accessTime;
+
+@end
+
+
+/*! Thread-safe in-memory index of the disk cache contents: file names, sizes and access times.
+ @discussion Index is not ready until it is built either from the snapshot or by scanning storage directory. Mutations that happen while index is being built take precedence over the results of the build.
+ */
+@interface DFDiskCacheIndex : NSObject
+
+@property (nonatomic, readonly, getter=isReady) BOOL ready;
+
+/*! Returns YES if index was mutated since the last time the snapshot was written.
+ */
+@property (nonatomic, readonly, getter=isDirty) BOOL dirty;
+
+/*! Sum of the allocated sizes of all entries, in bytes.
+ */
+@property (nonatomic, readonly) unsigned long long totalSize;
+
+/*! Sum of the logical sizes of all entries, in bytes.
+ */
+@property (nonatomic, readonly) unsigned long long totalLogicalSize;
+
+@property (nonatomic, readonly) NSUInteger count;
+
+- (nullable DFDiskCacheIndexEntry *)entryForFilename:(NSString *)filename;
+- (void)setSize:(unsigned long long)size logicalSize:(unsigned long long)logicalSize accessTime:(CFAbsoluteTime)accessTime forFilename:(NSString *)filename;
+- (void)updateAccessTime:(CFAbsoluteTime)accessTime forFilename:(NSString *)filename;
+- (void)removeEntryForFilename:(NSString *)filename;
+- (void)removeEntriesForFilenames:(NSArray *)filenames;
+
+/*! Removes all entries and marks index as ready. Cancels index build if any.
+ */
+- (void)removeAllEntries;
+
+/*! Returns all entries sorted by access time, least recently used first.
+ */
+- (NSArray *)entriesSortedByAccessTime;
+
+#pragma mark - Build
+
+/*! Marks index as not ready and returns build generation that should be passed to -finishBuildWithEntries:generation:.
+ */
+- (NSUInteger)beginBuild;
+
+/*! Merges entries with the mutations that happened since the build began and marks index as ready. Has no effect if the build was cancelled.
+ */
+- (void)finishBuildWithEntries:(NSArray *)entries generation:(NSUInteger)generation;
+
+#pragma mark - Snapshot
+
+/*! Writes snapshot of the index to the given path. Snapshot is only valid together with the journal of the same epoch.
+ */
+- (BOOL)writeSnapshotToFile:(NSString *)path epoch:(uint64_t)epoch;
+
+/*! Returns entries from the snapshot or nil if snapshot doesn't exist or is corrupted.
+ */
++ (nullable NSArray *)entriesFromSnapshotAtPath:(NSString *)path epoch:(nullable uint64_t *)epoch;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,281 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFDiskCacheIndex.h"
+
+static const uint32_t DFDiskCacheIndexSnapshotMagic = 0x58494644; // "DFIX"
+static const uint32_t DFDiskCacheIndexSnapshotVersion = 3;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t epoch;
+    uint64_t count;
+} _DFDiskCacheIndexSnapshotHeader;
+
+@implementation DFDiskCacheIndexEntry
+
+- (instancetype)initWithFilename:(NSString *)filename size:(unsigned long long)size logicalSize:(unsigned long long)logicalSize accessTime:(CFAbsoluteTime)accessTime {
+    if (self = [super init]) {
+        _filename = filename;
+        _size = size;
+        _logicalSize = logicalSize;
+        _accessTime = accessTime;
+    }
+    return self;
+}
+
+@end
+
+
+@implementation DFDiskCacheIndex {
+    NSMutableDictionary *_entries;
+    NSLock *_lock;
+    NSUInteger _generation;
+    unsigned long long _totalSize;
+    unsigned long long _totalLogicalSize;
+    BOOL _dirty;
+
+    /*! File names of the entries mutated while the index is being built, nil if index is ready.
+     */
+    NSMutableSet *_mutatedFilenames;
+}
+
+- (instancetype)init {
+    if (self = [super init]) {
+        _entries = [NSMutableDictionary new];
+        _lock = [NSLock new];
+    }
+    return self;
+}
+
+- (BOOL)isReady {
+    [_lock lock];
+    BOOL ready = _mutatedFilenames == nil;
+    [_lock unlock];
+    return ready;
+}
+
+- (BOOL)isDirty {
+    [_lock lock];
+    BOOL dirty = _dirty;
+    [_lock unlock];
+    return dirty;
+}
+
+- (unsigned long long)totalSize {
+    [_lock lock];
+    unsigned long long totalSize = _totalSize;
+    [_lock unlock];
+    return totalSize;
+}
+
+- (unsigned long long)totalLogicalSize {
+    [_lock lock];
+    unsigned long long totalLogicalSize = _totalLogicalSize;
+    [_lock unlock];
+    return totalLogicalSize;
+}
+
+- (NSUInteger)count {
+    [_lock lock];
+    NSUInteger count = _entries.count;
+    [_lock unlock];
+    return count;
+}
+
+- (DFDiskCacheIndexEntry *)entryForFilename:(NSString *)filename {
+    [_lock lock];
+    DFDiskCacheIndexEntry *entry = _entries[filename];
+    [_lock unlock];
+    return entry;
+}
+
+- (void)setSize:(unsigned long long)size logicalSize:(unsigned long long)logicalSize accessTime:(CFAbsoluteTime)accessTime forFilename:(NSString *)filename {
+    [_lock lock];
+    DFDiskCacheIndexEntry *entry = _entries[filename];
+    if (entry) {
+        _totalSize -= entry.size;
+        _totalLogicalSize -= entry.logicalSize;
+        entry.size = size;
+        entry.logicalSize = logicalSize;
+        entry.accessTime = accessTime;
+    } else {
+        _entries[filename] = [[DFDiskCacheIndexEntry alloc] initWithFilename:filename size:size logicalSize:logicalSize accessTime:accessTime];
+    }
+    _totalSize += size;
+    _totalLogicalSize += logicalSize;
+    [_mutatedFilenames addObject:filename];
+    _dirty = YES;
+    [_lock unlock];
+}
+
+- (void)updateAccessTime:(CFAbsoluteTime)accessTime forFilename:(NSString *)filename {
+    [_lock lock];
+    DFDiskCacheIndexEntry *entry = _entries[filename];
+    if (entry) {
+        entry.accessTime = accessTime;
+        _dirty = YES;
+    }
+    [_lock unlock];
+}
+
+- (void)removeEntryForFilename:(NSString *)filename {
+    [_lock lock];
+    [self _removeEntryForFilename:filename];
+    [_lock unlock];
+}
+
+- (void)removeEntriesForFilenames:(NSArray *)filenames {
+    [_lock lock];
+    for (NSString *filename in filenames) {
+        [self _removeEntryForFilename:filename];
+    }
+    [_lock unlock];
+}
+
+- (void)_removeEntryForFilename:(NSString *)filename {
+    DFDiskCacheIndexEntry *entry = _entries[filename];
+    if (entry) {
+        _totalSize -= entry.size;
+        _totalLogicalSize -= entry.logicalSize;
+        [_entries removeObjectForKey:filename];
+        _dirty = YES;
+    }
+    [_mutatedFilenames addObject:filename];
+}
+
+- (void)removeAllEntries {
+    [_lock lock];
+    [_entries removeAllObjects];
+    _totalSize = 0;
+    _totalLogicalSize = 0;
+    _generation++;
+    _mutatedFilenames = nil;
+    _dirty = YES;
+    [_lock unlock];
+}
+
+- (NSArray *)entriesSortedByAccessTime {
+    [_lock lock];
+    NSArray *entries = [_entries allValues];
+    [_lock unlock];
+    return [entries sortedArrayWithOptions:NSSortConcurrent usingComparator:^NSComparisonResult(DFDiskCacheIndexEntry *entry1, DFDiskCacheIndexEntry *entry2) {
+        if (entry1.accessTime == entry2.accessTime) {
+            return NSOrderedSame;
+        }
+        return entry1.accessTime < entry2.accessTime ? NSOrderedAscending : NSOrderedDescending;
+    }];
+}
+
+#pragma mark - Build
+
+- (NSUInteger)beginBuild {
+    [_lock lock];
+    _generation++;
+    _mutatedFilenames = [NSMutableSet new];
+    NSUInteger generation = _generation;
+    [_lock unlock];
+    return generation;
+}
+
+- (void)finishBuildWithEntries:(NSArray *)entries generation:(NSUInteger)generation {
+    [_lock lock];
+    if (generation == _generation && _mutatedFilenames) {
+        for (DFDiskCacheIndexEntry *entry in entries) {
+            if (![_mutatedFilenames containsObject:entry.filename] && !_entries[entry.filename]) {
+                _entries[entry.filename] = entry;
+                _totalSize += entry.size;
+                _totalLogicalSize += entry.logicalSize;
+            }
+        }
+        _dirty = _mutatedFilenames.count > 0;
+        _mutatedFilenames = nil;
+    }
+    [_lock unlock];
+}
+
+#pragma mark - Snapshot
+
+- (BOOL)writeSnapshotToFile:(NSString *)path epoch:(uint64_t)epoch {
+    [_lock lock];
+    NSArray *entries = [_entries allValues];
+    _dirty = NO;
+    [_lock unlock];
+
+    NSMutableData *data = [NSMutableData dataWithCapacity:sizeof(_DFDiskCacheIndexSnapshotHeader) + entries.count * 64];
+    _DFDiskCacheIndexSnapshotHeader header = {
+        .magic = DFDiskCacheIndexSnapshotMagic,
+        .version = DFDiskCacheIndexSnapshotVersion,
+        .epoch = epoch,
+        .count = entries.count
+    };
+    [data appendBytes:&header length:sizeof(header)];
+    for (DFDiskCacheIndexEntry *entry in entries) {
+        const char *filename = [entry.filename UTF8String];
+        uint8_t length = (uint8_t)MIN(strlen(filename), UINT8_MAX);
+        uint64_t size = entry.size;
+        uint64_t logicalSize = entry.logicalSize;
+        double accessTime = entry.accessTime;
+        [data appendBytes:&length length:sizeof(length)];
+        [data appendBytes:filename length:length];
+        [data appendBytes:&size length:sizeof(size)];
+        [data appendBytes:&logicalSize length:sizeof(logicalSize)];
+        [data appendBytes:&accessTime length:sizeof(accessTime)];
+    }
+    BOOL success = [data writeToFile:path atomically:YES];
+    if (!success) {
+        [_lock lock];
+        _dirty = YES;
+        [_lock unlock];
+    }
+    return success;
+}
+
++ (NSArray *)entriesFromSnapshotAtPath:(NSString *)path epoch:(uint64_t *)epoch {
+    NSData *data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:nil];
+    if (data.length < sizeof(_DFDiskCacheIndexSnapshotHeader)) {
+        return nil;
+    }
+    _DFDiskCacheIndexSnapshotHeader header;
+    [data getBytes:&header length:sizeof(header)];
+    if (header.magic != DFDiskCacheIndexSnapshotMagic ||
+        header.version != DFDiskCacheIndexSnapshotVersion) {
+        return nil;
+    }
+    NSMutableArray *entries = [[NSMutableArray alloc] initWithCapacity:(NSUInteger)header.count];
+    const uint8_t *bytes = data.bytes;
+    const uint8_t *end = bytes + data.length;
+    const uint8_t *ptr = bytes + sizeof(header);
+    for (uint64_t i = 0; i < header.count; i++) {
+        if (ptr + 1 > end) {
+            return nil;
+        }
+        uint8_t length = *ptr;
+        ptr += 1;
+        if (ptr + length + sizeof(uint64_t) * 2 + sizeof(double) > end) {
+            return nil;
+        }
+        NSString *filename = [[NSString alloc] initWithBytes:ptr length:length encoding:NSUTF8StringEncoding];
+        ptr += length;
+        uint64_t size;
+        uint64_t logicalSize;
+        double accessTime;
+        memcpy(&size, ptr, sizeof(size));
+        ptr += sizeof(size);
+        memcpy(&logicalSize, ptr, sizeof(logicalSize));
+        ptr += sizeof(logicalSize);
+        memcpy(&accessTime, ptr, sizeof(accessTime));
+        ptr += sizeof(accessTime);
+        if (filename) {
+            [entries addObject:[[DFDiskCacheIndexEntry alloc] initWithFilename:filename size:size logicalSize:logicalSize accessTime:accessTime]];
+        }
+    }
+    if (epoch) {
+        *epoch = header.epoch;
+    }
+    return entries;
+}
+
+@end
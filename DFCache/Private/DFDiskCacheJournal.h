@@ -0,0 +1,80 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_ENUM(uint8_t, DFDiskCacheJournalRecordType) {
+    /*! Write of the entry has started. Value is the identifier of the process that writes the entry.
+     */
+    DFDiskCacheJournalRecordTypeBegin = 1,
+    /*! Entry was written. Value is the allocated size of the entry, logical size is the length of its contents.
+     */
+    DFDiskCacheJournalRecordTypeCommit = 2,
+    /*! Write of the entry has failed and was rolled back.
+     */
+    DFDiskCacheJournalRecordTypeAbort = 3,
+    /*! Entry was removed.
+     */
+    DFDiskCacheJournalRecordTypeRemove = 4,
+    /*! Entry was read. Time is the access time of the entry.
+     */
+    DFDiskCacheJournalRecordTypeAccess = 5
+};
+
+@interface DFDiskCacheJournalRecord : NSObject
+
+@property (nonatomic, readonly) DFDiskCacheJournalRecordType type;
+@property (nonatomic, readonly) NSString *filename;
+@property (nonatomic, readonly) unsigned long long value;
+@property (nonatomic, readonly) unsigned long long logicalSize;
+@property (nonatomic, readonly) CFAbsoluteTime time;
+
+@end
+
+
+/*! Thread-safe write-ahead journal of the disk cache index mutations.
+ @discussion Journal is only valid on top of the index snapshot with the same epoch. Each checkpoint writes a new snapshot and starts a new journal with the incremented epoch. Writes that are in progress during the checkpoint are carried over to the new journal.
+ */
+@interface DFDiskCacheJournal : NSObject
+
+/*! Opens journal at the given path or creates a new one. Doesn't read the records.
+ */
+- (instancetype)initWithPath:(NSString *)path NS_DESIGNATED_INITIALIZER;
+
+@property (nonatomic, readonly) NSString *path;
+
+/*! Epoch of the journal.
+ */
+@property (nonatomic, readonly) uint64_t epoch;
+
+/*! Reads records that were written before the journal was opened. Returns nil if the journal is corrupted. Incomplete record at the end of the journal is ignored.
+ */
+- (nullable NSArray *)recordsWrittenBeforeOpen;
+
+- (void)logBeginForFilename:(NSString *)filename;
+- (void)logCommitForFilename:(NSString *)filename size:(unsigned long long)size logicalSize:(unsigned long long)logicalSize accessTime:(CFAbsoluteTime)accessTime;
+- (void)logAbortForFilename:(NSString *)filename;
+- (void)logRemoveForFilename:(NSString *)filename;
+
+/*! Appends remove records for all the given file names with a single write.
+ */
+- (void)logRemoveForFilenames:(NSArray *)filenames;
+
+/*! Access records are coalesced in memory, only the latest access time of each entry is kept, and are appended in batches with a single write. Pending access records are appended by -synchronize and are dropped by the checkpoint because the snapshot already has the access times.
+ */
+- (void)logAccessForFilename:(NSString *)filename accessTime:(CFAbsoluteTime)accessTime;
+
+/*! Appends pending access records and synchronizes journal with the disk.
+ */
+- (void)synchronize;
+
+/*! Starts a new journal with the incremented epoch. The block is called with the new epoch and should write index snapshot. Journal is not modified if the block returns NO.
+ */
+- (BOOL)checkpointWithSnapshotBlock:(BOOL (^)(uint64_t epoch))block;
+
+@end
+
+NS_ASSUME_NONNULL_END
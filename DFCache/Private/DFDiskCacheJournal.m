@@ -0,0 +1,277 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFDiskCacheJournal.h"
+#import <fcntl.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
+static const uint32_t DFDiskCacheJournalMagic = 0x4C4A4644; // "DFJL"
+static const uint32_t DFDiskCacheJournalVersion = 2;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t epoch;
+} _DFDiskCacheJournalHeader;
+
+/*! Record layout: type (1 byte), filename length (1 byte), filename, value (8 bytes), logical size (8 bytes), time (8 bytes), checksum of all the preceding bytes (4 bytes).
+ */
+static const size_t DFDiskCacheJournalRecordFixedLength = 1 + 1 + sizeof(uint64_t) * 2 + sizeof(double) + sizeof(uint32_t);
+
+/*! Number of the coalesced access records that are appended with a single write.
+ */
+static const NSUInteger DFDiskCacheJournalAccessBatchCount = 256;
+
+static uint32_t _DFDiskCacheJournalChecksum(const uint8_t *bytes, size_t length) {
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+@implementation DFDiskCacheJournalRecord
+
+- (instancetype)initWithType:(DFDiskCacheJournalRecordType)type filename:(NSString *)filename value:(unsigned long long)value logicalSize:(unsigned long long)logicalSize time:(CFAbsoluteTime)time {
+    if (self = [super init]) {
+        _type = type;
+        _filename = filename;
+        _value = value;
+        _logicalSize = logicalSize;
+        _time = time;
+    }
+    return self;
+}
+
+@end
+
+
+@implementation DFDiskCacheJournal {
+    NSLock *_lock;
+    int _fd;
+    off_t _openLength;
+
+    /*! File names of the entries that are being written by the current process.
+     */
+    NSCountedSet *_pendingFilenames;
+
+    /*! File name -> access time of the access records that are not yet appended.
+     */
+    NSMutableDictionary *_pendingAccessTimes;
+}
+
+- (instancetype)initWithPath:(NSString *)path {
+    if (self = [super init]) {
+        _path = path;
+        _lock = [NSLock new];
+        _pendingFilenames = [NSCountedSet new];
+        _pendingAccessTimes = [NSMutableDictionary new];
+        _fd = open([path fileSystemRepresentation], O_RDWR | O_APPEND | O_CREAT, 0644);
+        if (_fd >= 0) {
+            _DFDiskCacheJournalHeader header;
+            if (pread(_fd, &header, sizeof(header), 0) == sizeof(header) && header.magic == DFDiskCacheJournalMagic && header.version == DFDiskCacheJournalVersion) {
+                _epoch = header.epoch;
+                struct stat fileStat;
+                _openLength = fstat(_fd, &fileStat) == 0 ? fileStat.st_size : 0;
+            } else {
+                // Journal is new or corrupted, it doesn't match any snapshot.
+                ftruncate(_fd, 0);
+                header = (_DFDiskCacheJournalHeader){ .magic = DFDiskCacheJournalMagic, .version = DFDiskCacheJournalVersion, .epoch = 0 };
+                write(_fd, &header, sizeof(header));
+            }
+        }
+    }
+    return self;
+}
+
+- (instancetype)init {
+    [NSException raise:NSInternalInconsistencyException format:@"Please use designated initialzier"];
+    return nil;
+}
+
+- (void)dealloc {
+    [self _appendPendingAccessRecords];
+    if (_fd >= 0) {
+        close(_fd);
+    }
+}
+
+#pragma mark - Read
+
+- (NSArray *)recordsWrittenBeforeOpen {
+    if (_fd < 0 || _openLength < (off_t)sizeof(_DFDiskCacheJournalHeader)) {
+        return nil;
+    }
+    NSMutableData *data = [NSMutableData dataWithLength:(NSUInteger)(_openLength - sizeof(_DFDiskCacheJournalHeader))];
+    if (pread(_fd, data.mutableBytes, data.length, sizeof(_DFDiskCacheJournalHeader)) != (ssize_t)data.length) {
+        return nil;
+    }
+    NSMutableArray *records = [NSMutableArray new];
+    const uint8_t *ptr = data.bytes;
+    const uint8_t *end = ptr + data.length;
+    while (ptr + DFDiskCacheJournalRecordFixedLength <= end) {
+        const uint8_t *record = ptr;
+        uint8_t type = record[0];
+        uint8_t length = record[1];
+        size_t recordLength = DFDiskCacheJournalRecordFixedLength + length;
+        if (ptr + recordLength > end) {
+            break;
+        }
+        uint32_t checksum;
+        memcpy(&checksum, record + recordLength - sizeof(checksum), sizeof(checksum));
+        if (checksum != _DFDiskCacheJournalChecksum(record, recordLength - sizeof(checksum))) {
+            break; // Record was only partially written.
+        }
+        NSString *filename = [[NSString alloc] initWithBytes:record + 2 length:length encoding:NSUTF8StringEncoding];
+        uint64_t value;
+        uint64_t logicalSize;
+        double time;
+        memcpy(&value, record + 2 + length, sizeof(value));
+        memcpy(&logicalSize, record + 2 + length + sizeof(value), sizeof(logicalSize));
+        memcpy(&time, record + 2 + length + sizeof(value) + sizeof(logicalSize), sizeof(time));
+        if (filename) {
+            [records addObject:[[DFDiskCacheJournalRecord alloc] initWithType:type filename:filename value:value logicalSize:logicalSize time:time]];
+        }
+        ptr += recordLength;
+    }
+    return records;
+}
+
+#pragma mark - Write
+
+- (void)logBeginForFilename:(NSString *)filename {
+    [_lock lock];
+    [_pendingFilenames addObject:filename];
+    [self _appendRecordWithType:DFDiskCacheJournalRecordTypeBegin filename:filename value:getpid() logicalSize:0 time:CFAbsoluteTimeGetCurrent()];
+    [_lock unlock];
+}
+
+- (void)logCommitForFilename:(NSString *)filename size:(unsigned long long)size logicalSize:(unsigned long long)logicalSize accessTime:(CFAbsoluteTime)accessTime {
+    [_lock lock];
+    [_pendingFilenames removeObject:filename];
+    [_pendingAccessTimes removeObjectForKey:filename];
+    [self _appendRecordWithType:DFDiskCacheJournalRecordTypeCommit filename:filename value:size logicalSize:logicalSize time:accessTime];
+    [_lock unlock];
+}
+
+- (void)logAbortForFilename:(NSString *)filename {
+    [_lock lock];
+    [_pendingFilenames removeObject:filename];
+    [self _appendRecordWithType:DFDiskCacheJournalRecordTypeAbort filename:filename value:0 logicalSize:0 time:CFAbsoluteTimeGetCurrent()];
+    [_lock unlock];
+}
+
+- (void)logRemoveForFilename:(NSString *)filename {
+    [_lock lock];
+    [_pendingAccessTimes removeObjectForKey:filename];
+    [self _appendRecordWithType:DFDiskCacheJournalRecordTypeRemove filename:filename value:0 logicalSize:0 time:CFAbsoluteTimeGetCurrent()];
+    [_lock unlock];
+}
+
+- (void)logRemoveForFilenames:(NSArray *)filenames {
+    if (!filenames.count) {
+        return;
+    }
+    [_lock lock];
+    [_pendingAccessTimes removeObjectsForKeys:filenames];
+    if (_fd >= 0) {
+        NSMutableData *data = [NSMutableData dataWithCapacity:filenames.count * (DFDiskCacheJournalRecordFixedLength + 40)];
+        CFAbsoluteTime time = CFAbsoluteTimeGetCurrent();
+        for (NSString *filename in filenames) {
+            [self _appendRecordWithType:DFDiskCacheJournalRecordTypeRemove filename:filename value:0 logicalSize:0 time:time toData:data];
+        }
+        write(_fd, data.bytes, data.length);
+    }
+    [_lock unlock];
+}
+
+- (void)logAccessForFilename:(NSString *)filename accessTime:(CFAbsoluteTime)accessTime {
+    [_lock lock];
+    _pendingAccessTimes[filename] = @(accessTime);
+    if (_pendingAccessTimes.count >= DFDiskCacheJournalAccessBatchCount) {
+        [self _appendPendingAccessRecords];
+    }
+    [_lock unlock];
+}
+
+- (void)synchronize {
+    [_lock lock];
+    [self _appendPendingAccessRecords];
+    if (_fd >= 0) {
+        fsync(_fd);
+    }
+    [_lock unlock];
+}
+
+- (BOOL)checkpointWithSnapshotBlock:(BOOL (^)(uint64_t))block {
+    [_lock lock];
+    uint64_t epoch = _epoch + 1;
+    BOOL success = block(epoch);
+    if (success) {
+        NSMutableData *data = [NSMutableData new];
+        _DFDiskCacheJournalHeader header = { .magic = DFDiskCacheJournalMagic, .version = DFDiskCacheJournalVersion, .epoch = epoch };
+        [data appendBytes:&header length:sizeof(header)];
+        for (NSString *filename in _pendingFilenames) {
+            [self _appendRecordWithType:DFDiskCacheJournalRecordTypeBegin filename:filename value:getpid() logicalSize:0 time:CFAbsoluteTimeGetCurrent() toData:data];
+        }
+        success = [data writeToFile:_path atomically:YES];
+        if (success) {
+            if (_fd >= 0) {
+                close(_fd);
+            }
+            _fd = open([_path fileSystemRepresentation], O_RDWR | O_APPEND);
+            _epoch = epoch;
+            [_pendingAccessTimes removeAllObjects];
+        }
+    }
+    [_lock unlock];
+    return success;
+}
+
+#pragma mark - Private (Lock Acquired)
+
+- (void)_appendPendingAccessRecords {
+    if (!_pendingAccessTimes.count) {
+        return;
+    }
+    if (_fd >= 0) {
+        NSMutableData *data = [NSMutableData dataWithCapacity:_pendingAccessTimes.count * (DFDiskCacheJournalRecordFixedLength + 40)];
+        for (NSString *filename in _pendingAccessTimes) {
+            [self _appendRecordWithType:DFDiskCacheJournalRecordTypeAccess filename:filename value:0 logicalSize:0 time:[_pendingAccessTimes[filename] doubleValue] toData:data];
+        }
+        write(_fd, data.bytes, data.length);
+    }
+    [_pendingAccessTimes removeAllObjects];
+}
+
+- (void)_appendRecordWithType:(DFDiskCacheJournalRecordType)type filename:(NSString *)filename value:(unsigned long long)value logicalSize:(unsigned long long)logicalSize time:(CFAbsoluteTime)time {
+    if (_fd < 0) {
+        return;
+    }
+    NSMutableData *data = [NSMutableData dataWithCapacity:DFDiskCacheJournalRecordFixedLength + UINT8_MAX];
+    [self _appendRecordWithType:type filename:filename value:value logicalSize:logicalSize time:time toData:data];
+    // Record is written with a single write(2) call so that it is either appended completely or detected as incomplete by the checksum.
+    write(_fd, data.bytes, data.length);
+}
+
+- (void)_appendRecordWithType:(DFDiskCacheJournalRecordType)type filename:(NSString *)filename value:(unsigned long long)value logicalSize:(unsigned long long)logicalSize time:(CFAbsoluteTime)time toData:(NSMutableData *)data {
+    const char *name = [filename UTF8String];
+    uint8_t header[2] = { type, (uint8_t)MIN(strlen(name), UINT8_MAX) };
+    uint64_t recordValue = value;
+    uint64_t recordLogicalSize = logicalSize;
+    double recordTime = time;
+    NSUInteger offset = data.length;
+    [data appendBytes:header length:sizeof(header)];
+    [data appendBytes:name length:header[1]];
+    [data appendBytes:&recordValue length:sizeof(recordValue)];
+    [data appendBytes:&recordLogicalSize length:sizeof(recordLogicalSize)];
+    [data appendBytes:&recordTime length:sizeof(recordTime)];
+    uint32_t checksum = _DFDiskCacheJournalChecksum((const uint8_t *)data.bytes + offset, data.length - offset);
+    [data appendBytes:&checksum length:sizeof(checksum)];
+}
+
+@end
@@ -0,0 +1,38 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFDiskCacheIndex.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Index of the disk cache contents shared by all processes that open the same disk cache directory. Entries are kept in a hash table of a memory-mapped file. The table grows up to 1,048,576 slots, the other processes remap the file when they take the lock.
+ @discussion Mutations are serialized by flock(2) on the index file which the kernel releases when the process that holds it dies. Mutation in progress is marked in the index header, the next process that takes the lock after the crash recounts the totals. Access times are updated without locking.
+
+ Index doesn't need snapshots or journal, the file is the index. Index is not ready (and disk cache falls back to scanning its directory) until it is built by the cleanup leader or when the hash table can't grow any further.
+ */
+@interface DFDiskCacheSharedIndex : DFDiskCacheIndex
+
+/*! Opens or creates shared index file at the given path. Returns nil if the file can't be mapped.
+ */
+- (nullable instancetype)initWithPath:(NSString *)path;
+
+/*! Returns YES if the receiver holds the leadership. Leadership is held by a single process at a time until it closes the index or dies.
+ */
+@property (nonatomic, readonly, getter=isLeader) BOOL leader;
+
+/*! Attempts to acquire the leadership without waiting. Returns YES if the receiver is the leader.
+ */
+- (BOOL)acquireLeadership;
+
+/*! Rehashes the table to drop the slots of the removed entries which slow down the lookups. Does nothing until removed entries take at least 1/8 of the table.
+ */
+- (void)compact;
+
+/*! Calls the block under the index lock and then removes all entries. Processes that write entries meanwhile wait for the lock, so the block can remove the files of all entries without racing them.
+ */
+- (void)removeAllEntriesUsingBlock:(void (^)(void))block;
+
+@end
+
+NS_ASSUME_NONNULL_END
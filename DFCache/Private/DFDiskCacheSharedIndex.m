@@ -0,0 +1,554 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFDiskCacheSharedIndex.h"
+#import <fcntl.h>
+#import <sys/file.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
+static const uint32_t DFDiskCacheSharedIndexMagic = 0x49534644; // "DFSI"
+static const uint32_t DFDiskCacheSharedIndexVersion = 1;
+
+/*! Number of slots of the new index, must be a power of two. Table is considered full at 3/4 of the slots and is then rehashed into a table twice as large, up to the maximum number of slots.
+ */
+static const uint64_t DFDiskCacheSharedIndexSlotCount = 1 << 12;
+static const uint64_t DFDiskCacheSharedIndexMaximumSlotCount = 1 << 20;
+
+static const uint64_t DFDiskCacheSharedIndexSlotEmpty = 0;
+static const uint64_t DFDiskCacheSharedIndexSlotRemoved = 1;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t slotCount;
+    uint32_t ready;
+    /*! Set while the process that holds the lock mutates the index. If it is set when the lock is taken the previous holder died during the mutation.
+     */
+    uint32_t mutating;
+    uint64_t generation;
+    uint64_t count;
+    uint64_t removedCount;
+    uint64_t totalSize;
+    uint64_t totalLogicalSize;
+} _DFDiskCacheSharedIndexHeader;
+
+/*! Slot of the hash table. Slot is published by writing the hash last, so the slots that were partially written by a crashed process are never visible.
+ */
+typedef struct {
+    uint64_t hash;
+    uint64_t size;
+    uint64_t logicalSize;
+    /*! Bits of CFAbsoluteTime, updated atomically without the lock.
+     */
+    uint64_t accessTime;
+    uint8_t filenameLength;
+    char filename[55];
+} _DFDiskCacheSharedIndexSlot;
+
+static uint64_t _DFDiskCacheSharedIndexHash(const char *filename, size_t length) {
+    uint64_t hash = 14695981039346656037ull; // FNV-1a
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)filename[i];
+        hash *= 1099511628211ull;
+    }
+    return hash > DFDiskCacheSharedIndexSlotRemoved ? hash : hash + 2;
+}
+
+static inline uint64_t _DFDiskCacheSharedIndexTimeBits(CFAbsoluteTime time) {
+    uint64_t bits;
+    memcpy(&bits, &time, sizeof(bits));
+    return bits;
+}
+
+static inline CFAbsoluteTime _DFDiskCacheSharedIndexTime(uint64_t bits) {
+    CFAbsoluteTime time;
+    memcpy(&time, &bits, sizeof(time));
+    return time;
+}
+
+static inline size_t _DFDiskCacheSharedIndexFileLength(uint64_t slotCount) {
+    return (size_t)(sizeof(_DFDiskCacheSharedIndexHeader) + slotCount * sizeof(_DFDiskCacheSharedIndexSlot));
+}
+
+/*! Mapping of the index file, unmapped when deallocated.
+ */
+@interface _DFDiskCacheSharedIndexMap : NSObject {
+    @public
+    void *_bytes;
+    size_t _length;
+}
+@end
+
+@implementation _DFDiskCacheSharedIndexMap
+
+- (void)dealloc {
+    munmap(_bytes, _length);
+}
+
+@end
+
+
+@implementation DFDiskCacheSharedIndex {
+    int _fd;
+    int _leaderFd;
+    /*! Mappings of the index file, the current one is the last. Mappings replaced when the table grows are kept until the index is closed since the lookups without the lock might still be reading them.
+     */
+    NSMutableArray *_maps;
+    _DFDiskCacheSharedIndexHeader *_header;
+    _DFDiskCacheSharedIndexSlot *_slots;
+    uint64_t _slotMask;
+    BOOL _leader;
+
+    /*! flock(2) doesn't exclude the threads of the same process, they are serialized by the process lock first.
+     */
+    NSLock *_processLock;
+}
+
+- (instancetype)initWithPath:(NSString *)path {
+    if (self = [super init]) {
+        _fd = -1;
+        _leaderFd = -1;
+        _processLock = [NSLock new];
+        _maps = [NSMutableArray new];
+        _fd = open([path fileSystemRepresentation], O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        _leaderFd = open([[path stringByAppendingPathExtension:@"leader"] fileSystemRepresentation], O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (_fd < 0 || _leaderFd < 0) {
+            return nil;
+        }
+        flock(_fd, LOCK_EX);
+        BOOL mapped = [self _mapFile];
+        flock(_fd, LOCK_UN);
+        if (!mapped) {
+            return nil;
+        }
+    }
+    return self;
+}
+
+- (void)dealloc {
+    if (_fd >= 0) {
+        close(_fd);
+    }
+    if (_leaderFd >= 0) {
+        close(_leaderFd); // Releases the leadership
+    }
+}
+
+/*! Maps index file, creates a new index if the file doesn't contain a valid one. Must be called under the file lock.
+ */
+- (BOOL)_mapFile {
+    struct stat fileStat;
+    if (fstat(_fd, &fileStat) != 0) {
+        return NO;
+    }
+    _DFDiskCacheSharedIndexHeader header;
+    BOOL valid = fileStat.st_size >= (off_t)sizeof(header) && pread(_fd, &header, sizeof(header), 0) == sizeof(header) &&
+    header.magic == DFDiskCacheSharedIndexMagic && header.version == DFDiskCacheSharedIndexVersion &&
+    header.slotCount > 0 && (header.slotCount & (header.slotCount - 1)) == 0 &&
+    header.slotCount <= DFDiskCacheSharedIndexMaximumSlotCount &&
+    (unsigned long long)fileStat.st_size == _DFDiskCacheSharedIndexFileLength(header.slotCount);
+    uint64_t slotCount = valid ? header.slotCount : DFDiskCacheSharedIndexSlotCount;
+    if (!valid) {
+        // Truncating to zero length first zero-fills the table.
+        if (ftruncate(_fd, 0) != 0 || ftruncate(_fd, (off_t)_DFDiskCacheSharedIndexFileLength(slotCount)) != 0) {
+            return NO;
+        }
+    }
+    if (![self _mapTableWithSlotCount:slotCount]) {
+        return NO;
+    }
+    if (!valid) {
+        _header->slotCount = slotCount;
+        _header->version = DFDiskCacheSharedIndexVersion;
+        _header->magic = DFDiskCacheSharedIndexMagic;
+    } else if (_header->mutating) {
+        [self _recount];
+        _header->mutating = 0;
+    }
+    return YES;
+}
+
+/*! Maps the table with the given number of slots. Slots are published before the slot mask so that the lookups without the lock never combine the mask of the larger table with the slots of the smaller one.
+ */
+- (BOOL)_mapTableWithSlotCount:(uint64_t)slotCount {
+    size_t length = _DFDiskCacheSharedIndexFileLength(slotCount);
+    void *bytes = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (bytes == MAP_FAILED) {
+        return NO;
+    }
+    _DFDiskCacheSharedIndexMap *map = [_DFDiskCacheSharedIndexMap new];
+    map->_bytes = bytes;
+    map->_length = length;
+    [_maps addObject:map];
+    _header = bytes;
+    __atomic_store_n(&_slots, (_DFDiskCacheSharedIndexSlot *)((uint8_t *)bytes + sizeof(_DFDiskCacheSharedIndexHeader)), __ATOMIC_RELEASE);
+    __atomic_store_n(&_slotMask, slotCount - 1, __ATOMIC_RELEASE);
+    return YES;
+}
+
+/*! Rehashes the entries into the table with the given number of slots, which drops the slots of the removed entries. The file grows if the table is larger, the other processes remap it when they take the lock. Must be called under the lock.
+ */
+- (BOOL)_rehashWithSlotCount:(uint64_t)slotCount {
+    uint64_t previousSlotCount = _slotMask + 1;
+    if (slotCount > DFDiskCacheSharedIndexMaximumSlotCount) {
+        return NO;
+    }
+    size_t length = (size_t)(previousSlotCount * sizeof(_DFDiskCacheSharedIndexSlot));
+    _DFDiskCacheSharedIndexSlot *slots = malloc(length);
+    if (!slots) {
+        return NO;
+    }
+    memcpy(slots, _slots, length);
+    if (slotCount != previousSlotCount) {
+        if (ftruncate(_fd, (off_t)_DFDiskCacheSharedIndexFileLength(slotCount)) != 0) {
+            free(slots);
+            return NO;
+        }
+        if (![self _mapTableWithSlotCount:slotCount]) {
+            // The file must match the table described by its header.
+            ftruncate(_fd, (off_t)_DFDiskCacheSharedIndexFileLength(previousSlotCount));
+            free(slots);
+            return NO;
+        }
+        _header->slotCount = slotCount;
+    }
+    [self _removeAllSlots];
+    for (uint64_t i = 0; i < previousSlotCount; i++) {
+        _DFDiskCacheSharedIndexSlot *slot = &slots[i];
+        if (slot->hash != DFDiskCacheSharedIndexSlotEmpty && slot->hash != DFDiskCacheSharedIndexSlotRemoved) {
+            NSString *filename = [[NSString alloc] initWithBytes:slot->filename length:slot->filenameLength encoding:NSUTF8StringEncoding];
+            if (filename) {
+                [self _setSize:slot->size logicalSize:slot->logicalSize accessTime:_DFDiskCacheSharedIndexTime(slot->accessTime) forFilename:filename];
+            }
+        }
+    }
+    free(slots);
+    return YES;
+}
+
+#pragma mark - Locking
+
+/*! Takes the lock and remaps the table if another process has grown it. Returns NO if the table can't be remapped, the index must not be accessed until the lock is released then.
+ */
+- (BOOL)_lock {
+    [_processLock lock];
+    flock(_fd, LOCK_EX);
+    if (_header->slotCount != _slotMask + 1 && ![self _mapTableWithSlotCount:_header->slotCount]) {
+        return NO;
+    }
+    if (_header->mutating) {
+        [self _recount];
+    }
+    _header->mutating = 1;
+    return YES;
+}
+
+- (void)_unlock {
+    if (_header->slotCount != _slotMask + 1) {
+        // Remapping failed, the index wasn't mutated.
+        flock(_fd, LOCK_UN);
+        [_processLock unlock];
+        return;
+    }
+    _header->mutating = 0;
+    flock(_fd, LOCK_UN);
+    [_processLock unlock];
+}
+
+/*! Recounts the totals from the slots after the process died during the mutation. Must be called under the lock.
+ */
+- (void)_recount {
+    uint64_t count = 0, removedCount = 0, totalSize = 0, totalLogicalSize = 0;
+    for (uint64_t i = 0; i <= _slotMask; i++) {
+        _DFDiskCacheSharedIndexSlot *slot = &_slots[i];
+        if (slot->hash == DFDiskCacheSharedIndexSlotRemoved) {
+            removedCount++;
+        } else if (slot->hash != DFDiskCacheSharedIndexSlotEmpty) {
+            count++;
+            totalSize += slot->size;
+            totalLogicalSize += slot->logicalSize;
+        }
+    }
+    _header->count = count;
+    _header->removedCount = removedCount;
+    _header->totalSize = totalSize;
+    _header->totalLogicalSize = totalLogicalSize;
+}
+
+#pragma mark - Leadership
+
+- (BOOL)isLeader {
+    [_processLock lock];
+    BOOL leader = _leader;
+    [_processLock unlock];
+    return leader;
+}
+
+- (BOOL)acquireLeadership {
+    [_processLock lock];
+    if (!_leader) {
+        _leader = flock(_leaderFd, LOCK_EX | LOCK_NB) == 0;
+    }
+    BOOL leader = _leader;
+    [_processLock unlock];
+    return leader;
+}
+
+#pragma mark - Slots
+
+/*! Finds the slot of the entry. Safe to call without the lock, slots never move while the index is not being rehashed.
+ */
+- (_DFDiskCacheSharedIndexSlot *)_slotForFilename:(const char *)filename length:(size_t)length hash:(uint64_t)hash {
+    uint64_t slotMask = __atomic_load_n(&_slotMask, __ATOMIC_ACQUIRE);
+    _DFDiskCacheSharedIndexSlot *slots = __atomic_load_n(&_slots, __ATOMIC_ACQUIRE);
+    for (uint64_t i = 0; i <= slotMask; i++) {
+        _DFDiskCacheSharedIndexSlot *slot = &slots[(hash + i) & slotMask];
+        uint64_t slotHash = __atomic_load_n(&slot->hash, __ATOMIC_ACQUIRE);
+        if (slotHash == DFDiskCacheSharedIndexSlotEmpty) {
+            return NULL;
+        }
+        if (slotHash == hash && slot->filenameLength == length && memcmp(slot->filename, filename, length) == 0) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+- (_DFDiskCacheSharedIndexSlot *)_slotForFilename:(NSString *)filename {
+    const char *string = [filename fileSystemRepresentation];
+    size_t length = strlen(string);
+    return [self _slotForFilename:string length:length hash:_DFDiskCacheSharedIndexHash(string, length)];
+}
+
+/*! Remaps the table before the lookup without the lock if another process has grown it.
+ */
+- (void)_remapIfNeeded {
+    if (__atomic_load_n(&_header->slotCount, __ATOMIC_ACQUIRE) != __atomic_load_n(&_slotMask, __ATOMIC_ACQUIRE) + 1) {
+        [self _lock];
+        [self _unlock];
+    }
+}
+
+/*! Inserts or updates the entry, grows the table if it is full. Marks index as not ready if the table can't grow. Must be called under the lock.
+ */
+- (BOOL)_setSize:(unsigned long long)size logicalSize:(unsigned long long)logicalSize accessTime:(CFAbsoluteTime)accessTime forFilename:(NSString *)filename {
+    const char *string = [filename fileSystemRepresentation];
+    size_t length = strlen(string);
+    uint64_t hash = _DFDiskCacheSharedIndexHash(string, length);
+    _DFDiskCacheSharedIndexSlot *slot = [self _slotForFilename:string length:length hash:hash];
+    if (slot) {
+        _header->totalSize += size - slot->size;
+        _header->totalLogicalSize += logicalSize - slot->logicalSize;
+        slot->size = size;
+        slot->logicalSize = logicalSize;
+        __atomic_store_n(&slot->accessTime, _DFDiskCacheSharedIndexTimeBits(accessTime), __ATOMIC_RELAXED);
+        return YES;
+    }
+    if (length > sizeof(slot->filename)) {
+        _header->ready = 0; // Contents are no longer fully indexed
+        return NO;
+    }
+    if ((_header->count + _header->removedCount + 1) * 4 > (_slotMask + 1) * 3) {
+        // The table is grown once live entries take half of it, otherwise it is full of removed entries.
+        uint64_t slotCount = (_header->count + 1) * 2 > _slotMask + 1 ? (_slotMask + 1) * 2 : _slotMask + 1;
+        if (![self _rehashWithSlotCount:slotCount]) {
+            _header->ready = 0;
+            return NO;
+        }
+    }
+    for (uint64_t i = 0; i <= _slotMask; i++) {
+        slot = &_slots[(hash + i) & _slotMask];
+        if (slot->hash == DFDiskCacheSharedIndexSlotEmpty || slot->hash == DFDiskCacheSharedIndexSlotRemoved) {
+            break;
+        }
+    }
+    if (slot->hash == DFDiskCacheSharedIndexSlotRemoved) {
+        _header->removedCount--;
+    }
+    slot->size = size;
+    slot->logicalSize = logicalSize;
+    slot->accessTime = _DFDiskCacheSharedIndexTimeBits(accessTime);
+    slot->filenameLength = (uint8_t)length;
+    memcpy(slot->filename, string, length);
+    __atomic_store_n(&slot->hash, hash, __ATOMIC_RELEASE);
+    _header->count++;
+    _header->totalSize += size;
+    _header->totalLogicalSize += logicalSize;
+    return YES;
+}
+
+/*! Must be called under the lock.
+ */
+- (void)_removeSlotForFilename:(NSString *)filename {
+    _DFDiskCacheSharedIndexSlot *slot = [self _slotForFilename:filename];
+    if (slot) {
+        _header->count--;
+        _header->removedCount++;
+        _header->totalSize -= slot->size;
+        _header->totalLogicalSize -= slot->logicalSize;
+        __atomic_store_n(&slot->hash, DFDiskCacheSharedIndexSlotRemoved, __ATOMIC_RELEASE);
+    }
+}
+
+/*! Must be called under the lock.
+ */
+- (void)_removeAllSlots {
+    memset(_slots, 0, (size_t)((_slotMask + 1) * sizeof(_DFDiskCacheSharedIndexSlot)));
+    _header->count = 0;
+    _header->removedCount = 0;
+    _header->totalSize = 0;
+    _header->totalLogicalSize = 0;
+}
+
+- (DFDiskCacheIndexEntry *)_entryWithSlot:(const _DFDiskCacheSharedIndexSlot *)slot {
+    NSString *filename = [[NSString alloc] initWithBytes:slot->filename length:MIN(slot->filenameLength, sizeof(slot->filename)) encoding:NSUTF8StringEncoding];
+    if (!filename) {
+        return nil;
+    }
+    return [[DFDiskCacheIndexEntry alloc] initWithFilename:filename size:slot->size logicalSize:slot->logicalSize accessTime:_DFDiskCacheSharedIndexTime(__atomic_load_n(&slot->accessTime, __ATOMIC_RELAXED))];
+}
+
+#pragma mark - DFDiskCacheIndex
+
+- (BOOL)isReady {
+    return __atomic_load_n(&_header->ready, __ATOMIC_ACQUIRE) != 0;
+}
+
+- (BOOL)isDirty {
+    return NO; // Index file is the index
+}
+
+- (unsigned long long)totalSize {
+    return __atomic_load_n(&_header->totalSize, __ATOMIC_RELAXED);
+}
+
+- (unsigned long long)totalLogicalSize {
+    return __atomic_load_n(&_header->totalLogicalSize, __ATOMIC_RELAXED);
+}
+
+- (NSUInteger)count {
+    return (NSUInteger)__atomic_load_n(&_header->count, __ATOMIC_RELAXED);
+}
+
+- (DFDiskCacheIndexEntry *)entryForFilename:(NSString *)filename {
+    [self _remapIfNeeded];
+    _DFDiskCacheSharedIndexSlot *slot = [self _slotForFilename:filename];
+    return slot ? [self _entryWithSlot:slot] : nil;
+}
+
+- (void)setSize:(unsigned long long)size logicalSize:(unsigned long long)logicalSize accessTime:(CFAbsoluteTime)accessTime forFilename:(NSString *)filename {
+    if ([self _lock]) {
+        [self _setSize:size logicalSize:logicalSize accessTime:accessTime forFilename:filename];
+    }
+    [self _unlock];
+}
+
+- (void)updateAccessTime:(CFAbsoluteTime)accessTime forFilename:(NSString *)filename {
+    // Recency is updated without the lock. If the slot is reused concurrently the access time of another entry is updated which only affects the order of eviction.
+    [self _remapIfNeeded];
+    _DFDiskCacheSharedIndexSlot *slot = [self _slotForFilename:filename];
+    if (slot) {
+        __atomic_store_n(&slot->accessTime, _DFDiskCacheSharedIndexTimeBits(accessTime), __ATOMIC_RELAXED);
+    }
+}
+
+- (void)removeEntryForFilename:(NSString *)filename {
+    if ([self _lock]) {
+        [self _removeSlotForFilename:filename];
+    }
+    [self _unlock];
+}
+
+- (void)removeEntriesForFilenames:(NSArray *)filenames {
+    if ([self _lock]) {
+        for (NSString *filename in filenames) {
+            [self _removeSlotForFilename:filename];
+        }
+    }
+    [self _unlock];
+}
+
+- (void)removeAllEntries {
+    [self removeAllEntriesUsingBlock:nil];
+}
+
+- (void)removeAllEntriesUsingBlock:(void (^)(void))block {
+    BOOL locked = [self _lock];
+    if (block) {
+        block();
+    }
+    if (locked) {
+        [self _removeAllSlots];
+        _header->generation++;
+        _header->ready = 1;
+    }
+    [self _unlock];
+}
+
+- (NSArray *)entriesSortedByAccessTime {
+    NSMutableArray *entries = [NSMutableArray new];
+    if ([self _lock]) {
+        for (uint64_t i = 0; i <= _slotMask; i++) {
+            _DFDiskCacheSharedIndexSlot *slot = &_slots[i];
+            if (slot->hash != DFDiskCacheSharedIndexSlotEmpty && slot->hash != DFDiskCacheSharedIndexSlotRemoved) {
+                DFDiskCacheIndexEntry *entry = [self _entryWithSlot:slot];
+                if (entry) {
+                    [entries addObject:entry];
+                }
+            }
+        }
+    }
+    [self _unlock];
+    return [entries sortedArrayWithOptions:NSSortConcurrent usingComparator:^NSComparisonResult(DFDiskCacheIndexEntry *entry1, DFDiskCacheIndexEntry *entry2) {
+        if (entry1.accessTime == entry2.accessTime) {
+            return NSOrderedSame;
+        }
+        return entry1.accessTime < entry2.accessTime ? NSOrderedAscending : NSOrderedDescending;
+    }];
+}
+
+- (void)compact {
+    if ([self _lock] && _header->removedCount > (_slotMask + 1) / 8) {
+        [self _rehashWithSlotCount:_slotMask + 1];
+    }
+    [self _unlock];
+}
+
+#pragma mark - Build
+
+- (NSUInteger)beginBuild {
+    NSUInteger generation = 0;
+    if ([self _lock]) {
+        [self _removeAllSlots];
+        _header->ready = 0;
+        generation = (NSUInteger)++_header->generation;
+    }
+    [self _unlock];
+    return generation;
+}
+
+- (void)finishBuildWithEntries:(NSArray *)entries generation:(NSUInteger)generation {
+    if ([self _lock] && generation == _header->generation && !_header->ready) {
+        // Entries written by any process during the build take precedence. Entries removed during the build are restored and then removed by the first read that misses them.
+        BOOL complete = YES;
+        for (DFDiskCacheIndexEntry *entry in entries) {
+            if (![self _slotForFilename:entry.filename] && ![self _setSize:entry.size logicalSize:entry.logicalSize accessTime:entry.accessTime forFilename:entry.filename]) {
+                complete = NO;
+                break;
+            }
+        }
+        _header->ready = complete ? 1 : 0;
+    }
+    [self _unlock];
+}
+
+#pragma mark - Snapshot
+
+- (BOOL)writeSnapshotToFile:(NSString *)path epoch:(uint64_t)epoch {
+    return NO; // Shared index is persisted by its file
+}
+
+@end
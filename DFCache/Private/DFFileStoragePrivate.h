@@ -0,0 +1,84 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFFileStorage.h"
+#import <sys/stat.h>
+
+@class DFDirectoryScan;
+
+/* *at(2) system calls and getattrlistbulk(2) are only available on OS X 10.10, iOS 8 and later. They are weakly linked and checked at runtime when the deployment target is older, on the other deployment targets (including tvOS and watchOS) they are always available.
+ */
+#if (defined(__MAC_OS_X_VERSION_MIN_REQUIRED) && __MAC_OS_X_VERSION_MIN_REQUIRED < 101000) || (defined(__IPHONE_OS_VERSION_MIN_REQUIRED) && __IPHONE_OS_VERSION_MIN_REQUIRED < 80000)
+#define DF_FILE_STORAGE_CHECKS_SYSTEM_CALLS 1
+#else
+#define DF_FILE_STORAGE_CHECKS_SYSTEM_CALLS 0
+#endif
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Prefix of the temporary files that entries are written to before they are moved in place. Temporary files are hidden so that they are never mistaken for entries.
+ */
+static NSString *const DFFileStorageTemporaryFilePrefix = @".tmp.";
+
+/*! Name of the extended attribute that contains the data of the entries stored inline.
+ */
+static const char *const DFFileStorageInlineDataAttributeName = "_df_file_storage_inline_data";
+
+/*! Allocated size of the entries stored inline, in bytes. The data of such entries is kept with the file metadata, they are accounted as a single allocation unit of the file system so that capacity limits apply to them.
+ */
+static const unsigned long long DFFileStorageInlineDataAllocationUnit = 4096;
+
+@interface DFFileStorage ()
+
+/*! Initializes storage without a directory. Used by the subclasses that keep their contents in another storage engine, file operations fail for such storage.
+ */
+- (instancetype)_initWithoutDirectory NS_DESIGNATED_INITIALIZER;
+
+@end
+
+/*! File operations relative to the storage directory. When available they use *at(2) system calls on the directory descriptor that storage keeps open so that the kernel doesn't have to resolve the full path of the storage directory on each operation.
+ @discussion All methods return -1 and set errno on failure like the underlying system calls.
+ */
+@interface DFFileStorage (DFFileStoragePrivate)
+
+/*! Descriptor of the storage directory or -1 if it isn't open.
+ */
+- (int)_directoryDescriptor;
+
+- (int)_openFilename:(NSString *)filename flags:(int)flags;
+
+/*! Entries stored inline are reported with the length of their inline data as st_size and at least a single allocation unit (see DFFileStorageInlineDataAllocationUnit) as st_blocks.
+ */
+- (int)_statFilename:(NSString *)filename stat:(struct stat *)fileStat;
+- (int)_unlinkFilename:(NSString *)filename;
+- (int)_renameFilename:(NSString *)filename toFilename:(NSString *)toFilename;
+
+/*! Removes files in parallel using at most maximumConcurrentRemovalCount workers. Returns file names of the files that were removed or didn't exist.
+ */
+- (NSArray *)_unlinkFilenames:(NSArray *)filenames;
+
+/*! Scans storage directory skipping hidden files. Unlike contentsWithResourceKeys: doesn't create objects per file.
+ */
+- (nullable DFDirectoryScan *)_scanContents;
+
+/*! Returns name of the temporary file that the given process writes the entry to.
+ */
+- (NSString *)_temporaryFilenameForFilename:(NSString *)filename processIdentifier:(pid_t)processIdentifier;
+
+/*! Writes data and extended attributes to the file through a single file descriptor. Returns YES if the file was written.
+ @param synchronize If YES the file is synchronized with the disk using fsync(2).
+ */
+- (BOOL)_writeData:(NSData *)data extendedAttributes:(nullable NSDictionary *)attributes toFilename:(NSString *)filename synchronize:(BOOL)synchronize;
+
+/*! Writes data and extended attributes which values are already archived with NSKeyedArchiver.
+ */
+- (BOOL)_writeData:(NSData *)data archivedExtendedAttributes:(nullable NSDictionary *)attributes toFilename:(NSString *)filename synchronize:(BOOL)synchronize;
+
+/*! Reads data and all extended attributes of the file without unarchiving their values. The file is read bypassing the page cache since it isn't expected to be read again soon.
+ */
+- (nullable NSData *)_readFilename:(NSString *)filename archivedExtendedAttributes:(NSDictionary *__nullable __autoreleasing *__nullable)attributes;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,140 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Order of the keys in LSM storage: byte-wise order of their UTF-8 representations. All components of the storage must compare keys with these functions.
+ */
+static inline int DFLSMCompareKeyBytes(const void *key1, size_t length1, const void *key2, size_t length2) {
+    int result = memcmp(key1, key2, MIN(length1, length2));
+    if (result != 0) {
+        return result;
+    }
+    return (length1 < length2) ? -1 : ((length1 > length2) ? 1 : 0);
+}
+
+static inline NSComparisonResult DFLSMCompareKeys(NSString *key1, NSString *key2) {
+    const char *bytes1 = [key1 UTF8String];
+    const char *bytes2 = [key2 UTF8String];
+    int result = DFLSMCompareKeyBytes(bytes1, strlen(bytes1), bytes2, strlen(bytes2));
+    return (result < 0) ? NSOrderedAscending : ((result > 0) ? NSOrderedDescending : NSOrderedSame);
+}
+
+/*! Writes data to a temporary file, synchronizes it with the disk and moves it to the given path so that the file at the path is never partially written.
+ */
+extern BOOL DFLSMWriteFile(NSData *data, NSString *path);
+
+/*! Iterator over the sorted key-value pairs, including the removed keys (tombstones).
+ */
+@protocol DFLSMIterator <NSObject>
+
+@property (nonatomic, readonly, getter=isValid) BOOL valid;
+@property (nonatomic, readonly) NSString *key;
+@property (nonatomic, readonly, getter=isRemoved) BOOL removed;
+
+/*! Returns nil for the removed keys.
+ */
+@property (nonatomic, readonly, nullable) NSData *value;
+
+/*! Positions iterator at the first key that is greater than or equal to the given key.
+ */
+- (void)seekToKey:(nullable NSString *)key;
+- (void)next;
+
+@end
+
+
+/*! Iterator over the sorted snapshot of the key-value pairs. Values are NSData or NSNull for the tombstones.
+ */
+@interface DFLSMArrayIterator : NSObject <DFLSMIterator>
+
+- (instancetype)initWithDictionary:(NSDictionary *)dictionary NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+
+/*! Iterates the tables with disjoint key ranges sorted by their keys (tables of the single level) one after another. Seek only opens the table that may contain the key.
+ */
+@interface DFLSMConcatenatingIterator : NSObject <DFLSMIterator>
+
+- (instancetype)initWithTables:(NSArray *)tables NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+
+/*! Merges multiple iterators. When the same key is found in multiple iterators the value of the first one wins (iterators must be ordered from the newest to the oldest).
+ */
+@interface DFLSMMergingIterator : NSObject <DFLSMIterator>
+
+- (instancetype)initWithIterators:(NSArray *)iterators NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+
+typedef NS_ENUM(NSUInteger, DFLSMLookupResult) {
+    DFLSMLookupResultNotFound,
+    DFLSMLookupResultFound,
+    /*! Key was removed, older tables must not be checked.
+     */
+    DFLSMLookupResultRemoved
+};
+
+/*! Immutable sorted table (SSTable) on disk.
+ @discussion Table consists of data blocks with the sorted entries, Bloom filter of the keys, index with the last key of each block and a fixed size footer. File is memory mapped.
+ */
+@interface DFLSMTable : NSObject
+
+/*! Opens table at the given path. Returns nil if the table is damaged.
+ */
+- (nullable instancetype)initWithPath:(NSString *)path number:(uint64_t)number NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+@property (nonatomic, readonly) NSString *path;
+@property (nonatomic, readonly) uint64_t number;
+@property (nonatomic, readonly) NSString *smallestKey;
+@property (nonatomic, readonly) NSString *largestKey;
+@property (nonatomic, readonly) unsigned long long fileSize;
+
+/*! Looks up the key. Checks the Bloom filter first so that most lookups of the keys that are not in the table don't touch data blocks.
+ */
+- (DFLSMLookupResult)lookupKey:(NSString *)key data:(NSData *__nullable *__nonnull)data;
+
+/*! Returns YES if table key range overlaps the given range. Nil bounds are unbounded.
+ */
+- (BOOL)overlapsRangeFromKey:(nullable NSString *)smallestKey toKey:(nullable NSString *)largestKey;
+
+- (id<DFLSMIterator>)iterator;
+
+@end
+
+
+/*! Writes sorted table. Keys must be added in increasing order.
+ */
+@interface DFLSMTableBuilder : NSObject
+
+- (instancetype)initWithPath:(NSString *)path NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+/*! Adds entry to the table. Nil value adds a tombstone.
+ */
+- (void)addKey:(NSString *)key value:(nullable NSData *)value;
+
+@property (nonatomic, readonly) NSUInteger entryCount;
+
+/*! Estimated size of the table file, in bytes.
+ */
+@property (nonatomic, readonly) unsigned long long estimatedSize;
+
+/*! Writes table file. Returns NO if the file can't be written.
+ */
+- (BOOL)finish;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,723 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFLSMTable.h"
+#import <fcntl.h>
+#import <unistd.h>
+
+static const uint32_t DFLSMTableMagic = 0x44464c53; // "DFLS"
+
+/*! Data block is finished once its size reaches this value.
+ */
+static const size_t DFLSMTableBlockSize = 4096;
+
+/*! 10 bits per key with 7 hash functions gives ~1% false positive rate.
+ */
+static const NSUInteger DFLSMTableBloomBitsPerKey = 10;
+static const uint32_t DFLSMTableBloomHashCount = 7;
+
+typedef NS_ENUM(uint8_t, _DFLSMEntryType) {
+    _DFLSMEntryTypeValue = 1,
+    _DFLSMEntryTypeTombstone = 2
+};
+
+/*! Entry: u8 type, u32 key length, u32 value length, key, value.
+ */
+static const size_t _DFLSMEntryHeaderLength = 9;
+
+typedef struct {
+    uint8_t type;
+    uint32_t keyLength;
+    uint32_t valueLength;
+    const uint8_t *key;
+    const uint8_t *value;
+} _DFLSMEntry;
+
+typedef struct {
+    uint64_t bloomOffset;
+    uint64_t bloomLength;
+    uint64_t indexOffset;
+    uint64_t indexLength;
+    uint32_t hashCount;
+    uint32_t entryCount;
+    uint32_t indexChecksum;
+    uint32_t magic;
+} _DFLSMTableFooter;
+
+typedef struct {
+    uint64_t offset;
+    uint32_t length;
+    uint32_t lastKeyLength;
+    const uint8_t *lastKey;
+} _DFLSMBlockHandle;
+
+static uint32_t _DFLSMHash(const void *bytes, size_t length) {
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < length; i++) {
+        hash ^= ((const uint8_t *)bytes)[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*! Double hashing, k hash functions are derived from a single hash.
+ */
+static BOOL _DFLSMBloomMayContain(const uint8_t *bloom, size_t length, uint32_t hashCount, uint32_t hash) {
+    if (length == 0) {
+        return YES;
+    }
+    uint64_t bitCount = (uint64_t)length * 8;
+    uint32_t delta = (hash >> 17) | (hash << 15);
+    for (uint32_t i = 0; i < hashCount; i++) {
+        uint64_t bit = hash % bitCount;
+        if ((bloom[bit / 8] & (1 << (bit % 8))) == 0) {
+            return NO;
+        }
+        hash += delta;
+    }
+    return YES;
+}
+
+static size_t _DFLSMReadEntry(const uint8_t *bytes, size_t length, _DFLSMEntry *entry) {
+    if (length < _DFLSMEntryHeaderLength) {
+        return 0;
+    }
+    entry->type = bytes[0];
+    memcpy(&entry->keyLength, bytes + 1, sizeof(uint32_t));
+    memcpy(&entry->valueLength, bytes + 5, sizeof(uint32_t));
+    size_t entryLength = _DFLSMEntryHeaderLength + (size_t)entry->keyLength + entry->valueLength;
+    if (entryLength > length || (entry->type != _DFLSMEntryTypeValue && entry->type != _DFLSMEntryTypeTombstone)) {
+        return 0;
+    }
+    entry->key = bytes + _DFLSMEntryHeaderLength;
+    entry->value = entry->key + entry->keyLength;
+    return entryLength;
+}
+
+BOOL DFLSMWriteFile(NSData *data, NSString *path) {
+    NSString *temporaryPath = [path stringByAppendingString:@".tmp"];
+    int fd = open([temporaryPath fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return NO;
+    }
+    const uint8_t *bytes = data.bytes;
+    size_t remaining = data.length;
+    while (remaining > 0) {
+        ssize_t written = write(fd, bytes, remaining);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        bytes += written;
+        remaining -= written;
+    }
+    BOOL success = (remaining == 0) && (fcntl(fd, F_FULLFSYNC) == 0 || fsync(fd) == 0);
+    close(fd);
+    if (success) {
+        success = rename([temporaryPath fileSystemRepresentation], [path fileSystemRepresentation]) == 0;
+    }
+    if (!success) {
+        unlink([temporaryPath fileSystemRepresentation]);
+    }
+    return success;
+}
+
+static NSString *_DFLSMKeyString(const uint8_t *bytes, size_t length) {
+    return [[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding];
+}
+
+
+#pragma mark - DFLSMTable -
+
+@interface DFLSMTable ()
+
+- (NSUInteger)_blockCount;
+- (const uint8_t *)_bytesForBlockAtIndex:(NSUInteger)index length:(size_t *)length;
+- (NSUInteger)_blockIndexForKeyBytes:(const char *)key length:(size_t)length;
+
+@end
+
+@interface _DFLSMTableIterator : NSObject <DFLSMIterator>
+
+- (instancetype)initWithTable:(DFLSMTable *)table;
+
+@end
+
+@implementation DFLSMTable {
+    NSData *_data;
+    const uint8_t *_bytes;
+    const uint8_t *_bloom;
+    size_t _bloomLength;
+    uint32_t _hashCount;
+    _DFLSMBlockHandle *_blocks;
+    NSUInteger _blockCount;
+}
+
+- (void)dealloc {
+    free(_blocks);
+}
+
+- (instancetype)initWithPath:(NSString *)path number:(uint64_t)number {
+    if (self = [super init]) {
+        _path = path;
+        _number = number;
+        _data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedAlways error:nil];
+        if (!_data || ![self _load]) {
+            return nil;
+        }
+    }
+    return self;
+}
+
+- (instancetype)init {
+    [NSException raise:NSInternalInconsistencyException format:@"Please use designated initialzier"];
+    return nil;
+}
+
+- (BOOL)_load {
+    _fileSize = _data.length;
+    if (_fileSize < sizeof(_DFLSMTableFooter)) {
+        return NO;
+    }
+    _bytes = _data.bytes;
+    _DFLSMTableFooter footer;
+    uint64_t dataEnd = _fileSize - sizeof(footer);
+    memcpy(&footer, _bytes + dataEnd, sizeof(footer));
+    if (footer.magic != DFLSMTableMagic || footer.entryCount == 0 ||
+        footer.bloomOffset > dataEnd || footer.bloomLength > dataEnd - footer.bloomOffset ||
+        footer.indexOffset > dataEnd || footer.indexLength > dataEnd - footer.indexOffset) {
+        return NO;
+    }
+    if (_DFLSMHash(_bytes + footer.indexOffset, (size_t)footer.indexLength) != footer.indexChecksum) {
+        return NO;
+    }
+    _bloom = _bytes + footer.bloomOffset;
+    _bloomLength = (size_t)footer.bloomLength;
+    _hashCount = footer.hashCount;
+
+    // Index entry: u32 key length, last key of the block, u64 block offset, u32 block length.
+    const uint8_t *index = _bytes + footer.indexOffset;
+    size_t remaining = (size_t)footer.indexLength;
+    NSUInteger capacity = 0;
+    while (remaining > 0) {
+        uint32_t keyLength;
+        if (remaining < sizeof(keyLength)) {
+            return NO;
+        }
+        memcpy(&keyLength, index, sizeof(keyLength));
+        size_t handleLength = sizeof(uint32_t) + (size_t)keyLength + sizeof(uint64_t) + sizeof(uint32_t);
+        if (handleLength > remaining) {
+            return NO;
+        }
+        if (_blockCount == capacity) {
+            capacity = MAX(capacity * 2, 16);
+            _blocks = reallocf(_blocks, capacity * sizeof(_DFLSMBlockHandle));
+            if (!_blocks) {
+                [NSException raise:NSMallocException format:@"Failed to allocate memory for table index"];
+            }
+        }
+        _DFLSMBlockHandle *handle = &_blocks[_blockCount++];
+        handle->lastKey = index + sizeof(uint32_t);
+        handle->lastKeyLength = keyLength;
+        memcpy(&handle->offset, handle->lastKey + keyLength, sizeof(uint64_t));
+        memcpy(&handle->length, handle->lastKey + keyLength + sizeof(uint64_t), sizeof(uint32_t));
+        if (handle->offset > footer.bloomOffset || handle->length > footer.bloomOffset - handle->offset) {
+            return NO;
+        }
+        index += handleLength;
+        remaining -= handleLength;
+    }
+    if (_blockCount == 0) {
+        return NO;
+    }
+    _DFLSMEntry entry;
+    if (!_DFLSMReadEntry(_bytes + _blocks[0].offset, _blocks[0].length, &entry)) {
+        return NO;
+    }
+    _smallestKey = _DFLSMKeyString(entry.key, entry.keyLength);
+    _largestKey = _DFLSMKeyString(_blocks[_blockCount - 1].lastKey, _blocks[_blockCount - 1].lastKeyLength);
+    return _smallestKey != nil && _largestKey != nil;
+}
+
+- (DFLSMLookupResult)lookupKey:(NSString *)key data:(NSData *__autoreleasing *)data {
+    const char *keyBytes = [key UTF8String];
+    size_t keyLength = strlen(keyBytes);
+    if (!_DFLSMBloomMayContain(_bloom, _bloomLength, _hashCount, _DFLSMHash(keyBytes, keyLength))) {
+        return DFLSMLookupResultNotFound;
+    }
+    NSUInteger blockIndex = [self _blockIndexForKeyBytes:keyBytes length:keyLength];
+    if (blockIndex == _blockCount) {
+        return DFLSMLookupResultNotFound;
+    }
+    size_t remaining;
+    const uint8_t *bytes = [self _bytesForBlockAtIndex:blockIndex length:&remaining];
+    _DFLSMEntry entry;
+    size_t entryLength;
+    while ((entryLength = _DFLSMReadEntry(bytes, remaining, &entry)) > 0) {
+        int order = DFLSMCompareKeyBytes(entry.key, entry.keyLength, keyBytes, keyLength);
+        if (order == 0) {
+            if (entry.type == _DFLSMEntryTypeTombstone) {
+                return DFLSMLookupResultRemoved;
+            }
+            // Data is copied so that it outlives the table file which gets removed after compaction.
+            *data = [NSData dataWithBytes:entry.value length:entry.valueLength];
+            return DFLSMLookupResultFound;
+        }
+        if (order > 0) {
+            break;
+        }
+        bytes += entryLength;
+        remaining -= entryLength;
+    }
+    return DFLSMLookupResultNotFound;
+}
+
+- (BOOL)overlapsRangeFromKey:(NSString *)smallestKey toKey:(NSString *)largestKey {
+    if (smallestKey && DFLSMCompareKeys(_largestKey, smallestKey) == NSOrderedAscending) {
+        return NO;
+    }
+    if (largestKey && DFLSMCompareKeys(_smallestKey, largestKey) == NSOrderedDescending) {
+        return NO;
+    }
+    return YES;
+}
+
+- (id<DFLSMIterator>)iterator {
+    return [[_DFLSMTableIterator alloc] initWithTable:self];
+}
+
+- (NSUInteger)_blockCount {
+    return _blockCount;
+}
+
+- (const uint8_t *)_bytesForBlockAtIndex:(NSUInteger)index length:(size_t *)length {
+    *length = _blocks[index].length;
+    return _bytes + _blocks[index].offset;
+}
+
+/*! Returns index of the first block which last key is greater than or equal to the given key, or block count if there is no such block.
+ */
+- (NSUInteger)_blockIndexForKeyBytes:(const char *)key length:(size_t)length {
+    NSUInteger lower = 0;
+    NSUInteger upper = _blockCount;
+    while (lower < upper) {
+        NSUInteger middle = lower + (upper - lower) / 2;
+        if (DFLSMCompareKeyBytes(_blocks[middle].lastKey, _blocks[middle].lastKeyLength, key, length) < 0) {
+            lower = middle + 1;
+        } else {
+            upper = middle;
+        }
+    }
+    return lower;
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@ %p> { number = %llu, size = %llu, keys = [%@, %@] }", [self class], self, _number, _fileSize, _smallestKey, _largestKey];
+}
+
+@end
+
+
+#pragma mark - _DFLSMTableIterator -
+
+@implementation _DFLSMTableIterator {
+    DFLSMTable *_table;
+    NSUInteger _blockIndex;
+    size_t _offset;
+    _DFLSMEntry _entry;
+    size_t _entryLength;
+    NSString *_key;
+}
+
+@synthesize valid = _valid;
+
+- (instancetype)initWithTable:(DFLSMTable *)table {
+    if (self = [super init]) {
+        _table = table;
+    }
+    return self;
+}
+
+- (NSString *)key {
+    if (!_key) {
+        _key = _DFLSMKeyString(_entry.key, _entry.keyLength) ?: @"";
+    }
+    return _key;
+}
+
+- (BOOL)isRemoved {
+    return _entry.type == _DFLSMEntryTypeTombstone;
+}
+
+- (NSData *)value {
+    if (_entry.type == _DFLSMEntryTypeTombstone) {
+        return nil;
+    }
+    return [NSData dataWithBytes:_entry.value length:_entry.valueLength];
+}
+
+- (void)seekToKey:(NSString *)key {
+    if (!key) {
+        [self _positionAtBlockIndex:0];
+        return;
+    }
+    const char *keyBytes = [key UTF8String];
+    size_t keyLength = strlen(keyBytes);
+    [self _positionAtBlockIndex:[_table _blockIndexForKeyBytes:keyBytes length:keyLength]];
+    while (_valid && DFLSMCompareKeyBytes(_entry.key, _entry.keyLength, keyBytes, keyLength) < 0) {
+        [self next];
+    }
+}
+
+- (void)next {
+    if (_valid) {
+        _offset += _entryLength;
+        [self _readEntry];
+    }
+}
+
+- (void)_positionAtBlockIndex:(NSUInteger)index {
+    _blockIndex = index;
+    _offset = 0;
+    [self _readEntry];
+}
+
+- (void)_readEntry {
+    _key = nil;
+    NSUInteger blockCount = [_table _blockCount];
+    while (_blockIndex < blockCount) {
+        size_t length;
+        const uint8_t *bytes = [_table _bytesForBlockAtIndex:_blockIndex length:&length];
+        if (_offset < length) {
+            _entryLength = _DFLSMReadEntry(bytes + _offset, length - _offset, &_entry);
+            if (_entryLength > 0) {
+                _valid = YES;
+                return;
+            }
+        }
+        _blockIndex++;
+        _offset = 0;
+    }
+    _valid = NO;
+}
+
+@end
+
+
+#pragma mark - DFLSMArrayIterator -
+
+@implementation DFLSMArrayIterator {
+    NSArray *_keys;
+    NSArray *_values;
+    NSUInteger _index;
+}
+
+- (instancetype)initWithDictionary:(NSDictionary *)dictionary {
+    if (self = [super init]) {
+        _keys = [dictionary.allKeys sortedArrayUsingComparator:^NSComparisonResult(NSString *key1, NSString *key2) {
+            return DFLSMCompareKeys(key1, key2);
+        }];
+        _values = [dictionary objectsForKeys:_keys notFoundMarker:[NSNull null]];
+    }
+    return self;
+}
+
+- (instancetype)init {
+    [NSException raise:NSInternalInconsistencyException format:@"Please use designated initialzier"];
+    return nil;
+}
+
+- (BOOL)isValid {
+    return _index < _keys.count;
+}
+
+- (NSString *)key {
+    return _keys[_index];
+}
+
+- (BOOL)isRemoved {
+    return _values[_index] == [NSNull null];
+}
+
+- (NSData *)value {
+    id value = _values[_index];
+    return (value == [NSNull null]) ? nil : value;
+}
+
+- (void)seekToKey:(NSString *)key {
+    if (!key) {
+        _index = 0;
+        return;
+    }
+    _index = [_keys indexOfObject:key inSortedRange:NSMakeRange(0, _keys.count) options:NSBinarySearchingInsertionIndex | NSBinarySearchingFirstEqual usingComparator:^NSComparisonResult(NSString *key1, NSString *key2) {
+        return DFLSMCompareKeys(key1, key2);
+    }];
+}
+
+- (void)next {
+    if (_index < _keys.count) {
+        _index++;
+    }
+}
+
+@end
+
+
+#pragma mark - DFLSMConcatenatingIterator -
+
+@implementation DFLSMConcatenatingIterator {
+    NSArray *_tables;
+    NSUInteger _index;
+    id<DFLSMIterator> _iterator;
+}
+
+- (instancetype)initWithTables:(NSArray *)tables {
+    if (self = [super init]) {
+        _tables = [tables copy];
+    }
+    return self;
+}
+
+- (instancetype)init {
+    [NSException raise:NSInternalInconsistencyException format:@"Please use designated initialzier"];
+    return nil;
+}
+
+- (BOOL)isValid {
+    return _iterator.valid;
+}
+
+- (NSString *)key {
+    return _iterator.key;
+}
+
+- (BOOL)isRemoved {
+    return _iterator.removed;
+}
+
+- (NSData *)value {
+    return _iterator.value;
+}
+
+- (void)seekToKey:(NSString *)key {
+    NSUInteger lower = 0;
+    NSUInteger upper = key ? _tables.count : 0;
+    while (lower < upper) {
+        NSUInteger middle = lower + (upper - lower) / 2;
+        if (DFLSMCompareKeys(((DFLSMTable *)_tables[middle]).largestKey, key) == NSOrderedAscending) {
+            lower = middle + 1;
+        } else {
+            upper = middle;
+        }
+    }
+    [self _openTableAtIndex:lower seekKey:key];
+}
+
+- (void)next {
+    [_iterator next];
+    if (_iterator && !_iterator.valid) {
+        [self _openTableAtIndex:_index + 1 seekKey:nil];
+    }
+}
+
+- (void)_openTableAtIndex:(NSUInteger)index seekKey:(NSString *)key {
+    for (_index = index; _index < _tables.count; _index++) {
+        _iterator = [(DFLSMTable *)_tables[_index] iterator];
+        [_iterator seekToKey:key];
+        if (_iterator.valid) {
+            return;
+        }
+        key = nil;
+    }
+    _iterator = nil;
+}
+
+@end
+
+
+#pragma mark - DFLSMMergingIterator -
+
+@implementation DFLSMMergingIterator {
+    NSArray *_iterators;
+    id<DFLSMIterator> _current;
+}
+
+- (instancetype)initWithIterators:(NSArray *)iterators {
+    if (self = [super init]) {
+        _iterators = [iterators copy];
+    }
+    return self;
+}
+
+- (instancetype)init {
+    [NSException raise:NSInternalInconsistencyException format:@"Please use designated initialzier"];
+    return nil;
+}
+
+- (BOOL)isValid {
+    return _current != nil;
+}
+
+- (NSString *)key {
+    return _current.key;
+}
+
+- (BOOL)isRemoved {
+    return _current.removed;
+}
+
+- (NSData *)value {
+    return _current.value;
+}
+
+- (void)seekToKey:(NSString *)key {
+    for (id<DFLSMIterator> iterator in _iterators) {
+        [iterator seekToKey:key];
+    }
+    [self _findSmallest];
+}
+
+- (void)next {
+    if (!_current) {
+        return;
+    }
+    // Skips older versions of the current key, each iterator has at most one.
+    NSString *key = _current.key;
+    for (id<DFLSMIterator> iterator in _iterators) {
+        if (iterator.valid && DFLSMCompareKeys(iterator.key, key) == NSOrderedSame) {
+            [iterator next];
+        }
+    }
+    [self _findSmallest];
+}
+
+- (void)_findSmallest {
+    id<DFLSMIterator> current;
+    for (id<DFLSMIterator> iterator in _iterators) {
+        // Strict comparison, the newest iterator wins among equal keys.
+        if (iterator.valid && (!current || DFLSMCompareKeys(iterator.key, current.key) == NSOrderedAscending)) {
+            current = iterator;
+        }
+    }
+    _current = current;
+}
+
+@end
+
+
+#pragma mark - DFLSMTableBuilder -
+
+@implementation DFLSMTableBuilder {
+    NSString *_path;
+    NSMutableData *_data;
+    NSMutableData *_index;
+    size_t _blockOffset;
+    NSData *_lastKey;
+    uint32_t *_hashes;
+    NSUInteger _hashesCapacity;
+}
+
+- (void)dealloc {
+    free(_hashes);
+}
+
+- (instancetype)initWithPath:(NSString *)path {
+    if (self = [super init]) {
+        _path = path;
+        _data = [NSMutableData new];
+        _index = [NSMutableData new];
+    }
+    return self;
+}
+
+- (instancetype)init {
+    [NSException raise:NSInternalInconsistencyException format:@"Please use designated initialzier"];
+    return nil;
+}
+
+- (void)addKey:(NSString *)key value:(NSData *)value {
+    NSData *keyData = [key dataUsingEncoding:NSUTF8StringEncoding];
+    uint8_t header[_DFLSMEntryHeaderLength];
+    header[0] = value ? _DFLSMEntryTypeValue : _DFLSMEntryTypeTombstone;
+    uint32_t keyLength = (uint32_t)keyData.length;
+    uint32_t valueLength = (uint32_t)value.length;
+    memcpy(header + 1, &keyLength, sizeof(keyLength));
+    memcpy(header + 5, &valueLength, sizeof(valueLength));
+    [_data appendBytes:header length:sizeof(header)];
+    [_data appendData:keyData];
+    if (value) {
+        [_data appendData:value];
+    }
+    if (_entryCount == _hashesCapacity) {
+        _hashesCapacity = MAX(_hashesCapacity * 2, 256);
+        _hashes = reallocf(_hashes, _hashesCapacity * sizeof(uint32_t));
+        if (!_hashes) {
+            [NSException raise:NSMallocException format:@"Failed to allocate memory for table builder"];
+        }
+    }
+    _hashes[_entryCount++] = _DFLSMHash(keyData.bytes, keyData.length);
+    _lastKey = keyData;
+    if (_data.length - _blockOffset >= DFLSMTableBlockSize) {
+        [self _finishBlock];
+    }
+}
+
+- (unsigned long long)estimatedSize {
+    return _data.length + _index.length + (_entryCount * DFLSMTableBloomBitsPerKey) / 8 + sizeof(_DFLSMTableFooter);
+}
+
+- (void)_finishBlock {
+    if (_data.length == _blockOffset) {
+        return;
+    }
+    uint32_t keyLength = (uint32_t)_lastKey.length;
+    uint64_t offset = _blockOffset;
+    uint32_t length = (uint32_t)(_data.length - _blockOffset);
+    [_index appendBytes:&keyLength length:sizeof(keyLength)];
+    [_index appendData:_lastKey];
+    [_index appendBytes:&offset length:sizeof(offset)];
+    [_index appendBytes:&length length:sizeof(length)];
+    _blockOffset = _data.length;
+}
+
+- (BOOL)finish {
+    if (_entryCount == 0) {
+        return NO;
+    }
+    [self _finishBlock];
+
+    _DFLSMTableFooter footer = {0};
+    size_t bloomLength = (MAX(_entryCount * DFLSMTableBloomBitsPerKey, 64) + 7) / 8;
+    NSMutableData *bloom = [NSMutableData dataWithLength:bloomLength];
+    uint8_t *bits = bloom.mutableBytes;
+    uint64_t bitCount = (uint64_t)bloomLength * 8;
+    for (NSUInteger i = 0; i < _entryCount; i++) {
+        uint32_t hash = _hashes[i];
+        uint32_t delta = (hash >> 17) | (hash << 15);
+        for (uint32_t j = 0; j < DFLSMTableBloomHashCount; j++) {
+            uint64_t bit = hash % bitCount;
+            bits[bit / 8] |= (1 << (bit % 8));
+            hash += delta;
+        }
+    }
+    footer.bloomOffset = _data.length;
+    footer.bloomLength = bloomLength;
+    footer.hashCount = DFLSMTableBloomHashCount;
+    [_data appendData:bloom];
+
+    footer.indexOffset = _data.length;
+    footer.indexLength = _index.length;
+    footer.indexChecksum = _DFLSMHash(_index.bytes, _index.length);
+    [_data appendData:_index];
+
+    footer.entryCount = (uint32_t)_entryCount;
+    footer.magic = DFLSMTableMagic;
+    [_data appendBytes:&footer length:sizeof(footer)];
+
+    return DFLSMWriteFile(_data, _path);
+}
+
+@end
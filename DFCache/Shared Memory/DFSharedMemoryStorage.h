@@ -0,0 +1,76 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import <Foundation/Foundation.h>
+#import "DFStorageEngine.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Storage engine that keeps entries in a POSIX shared memory segment shared by all processes on the host that open storage with the same name. Segment outlives the processes until it is removed (see +removeSegmentWithName:).
+ @discussion Segment is a set-associative hash table of fixed-size slots. Each key maps to a set of 8 slots, writing a new entry into a full set evicts its least recently used entry. Readers never lock: each slot is protected by a sequence lock, readers copy the entry and retry if the slot was written concurrently. Writers take the ownership of a single slot. Slots abandoned by the writers that died during the write are reclaimed.
+
+ Storage is a cache, not a durable store: writes are best-effort and might be dropped if the slot is busy, entries that don't fit into a slot are not stored. DFCache uses shared memory storage as a memory tier of encoded data shared by the processes (see -[DFCache sharedMemoryTier]) underneath the memory cache of each process.
+ */
+@interface DFSharedMemoryStorage : NSObject <DFStorageEngine>
+
+/*! Opens shared memory segment with the given name or creates it with the given capacity.
+ @param name Name of the segment. Processes that use the same name share the contents.
+ @param capacity Size of the segment, in bytes. Ignored if the segment already exists.
+ @param slotSize Maximum size of the entry (key and data), in bytes. Ignored if the segment already exists.
+ @return Storage or nil if the segment can't be created or mapped.
+ */
+- (nullable instancetype)initWithName:(NSString *)name capacity:(unsigned long long)capacity slotSize:(NSUInteger)slotSize NS_DESIGNATED_INITIALIZER;
+
+/*! Opens or creates shared memory segment with the given name, 64 Mb capacity and 16 Kb slots.
+ */
+- (nullable instancetype)initWithName:(NSString *)name;
+
+/*! Unavailable initializer, please use designated initializer.
+ */
+- (instancetype)init NS_UNAVAILABLE;
+
+/*! Removes segment with the given name. Processes that already mapped the segment keep using it, the new ones create a new segment.
+ */
++ (BOOL)removeSegmentWithName:(NSString *)name;
+
+@property (nonatomic, readonly) NSString *name;
+
+/*! Returns the number of slots of the segment.
+ */
+@property (nonatomic, readonly) NSUInteger slotCount;
+
+/*! Returns the maximum size of the entry (key and data), in bytes.
+ */
+@property (nonatomic, readonly) NSUInteger slotSize;
+
+/*! Number of reads that found data, counted by all processes.
+ */
+@property (nonatomic, readonly) unsigned long long hitCount;
+
+/*! Number of reads that found no data, counted by all processes.
+ */
+@property (nonatomic, readonly) unsigned long long missCount;
+
+/*! Number of entries evicted to make room for the new ones, counted by all processes.
+ */
+@property (nonatomic, readonly) unsigned long long evictionCount;
+
+- (nullable NSData *)dataForKey:(NSString *)key;
+- (void)setData:(NSData *)data forKey:(NSString *)key;
+- (void)removeDataForKey:(NSString *)key;
+- (void)removeDataForKeys:(NSArray *)keys;
+- (void)removeAllData;
+- (BOOL)containsDataForKey:(NSString *)key;
+
+/*! Returns the size of the stored keys and data, in bytes.
+ */
+- (unsigned long long)contentsSize;
+
+/*! Returns the number of the stored entries.
+ */
+- (NSUInteger)contentsCount;
+
+@end
+
+NS_ASSUME_NONNULL_END
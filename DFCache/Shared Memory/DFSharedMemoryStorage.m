@@ -0,0 +1,521 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFSharedMemoryStorage.h"
+#import <fcntl.h>
+#import <sched.h>
+#import <signal.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
+static const uint32_t DFSharedMemoryStorageMagic = 0x4d534644; // "DFSM"
+static const uint32_t DFSharedMemoryStorageVersion = 1;
+
+/*! Number of slots in each set.
+ */
+static const uint64_t DFSharedMemoryStorageWayCount = 8;
+
+/*! Number of times readers and writers retry the slot which is being written by another writer. Slots are only owned for the time it takes to copy the entry.
+ */
+static const NSUInteger DFSharedMemoryStorageAttemptCount = 1000;
+
+/*! Number of milliseconds that the process which opens the segment waits for the process which creates it.
+ */
+static const NSUInteger DFSharedMemoryStorageOpenTimeout = 1000;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t slotCount;
+    uint64_t slotSize;
+    uint64_t slotStride;
+    uint64_t hitCount;
+    uint64_t missCount;
+    uint64_t evictionCount;
+    uint64_t reserved;
+} _DFSharedMemoryHeader;
+
+/*! Slot header, followed by the key and the data. Fields are only valid if the sequence is even and doesn't change while they are read.
+ */
+typedef struct {
+    /*! Sequence lock, odd while the slot is written.
+     */
+    uint32_t sequence;
+    /*! Process identifier of the last writer, used to reclaim the slots of the dead writers.
+     */
+    int32_t writer;
+    /*! Hash of the key, 0 if the slot is empty.
+     */
+    uint64_t hash;
+    uint32_t keyLength;
+    uint32_t dataLength;
+    /*! Bits of CFAbsoluteTime, updated by the readers without taking the slot.
+     */
+    uint64_t accessTime;
+} _DFSharedMemorySlot;
+
+static uint64_t _DFSharedMemoryStorageHash(const void *bytes, size_t length) {
+    uint64_t hash = 14695981039346656037ull; // FNV-1a
+    for (size_t i = 0; i < length; i++) {
+        hash ^= ((const uint8_t *)bytes)[i];
+        hash *= 1099511628211ull;
+    }
+    return hash ?: 1;
+}
+
+static inline uint64_t _DFSharedMemoryStorageTimeBits(CFAbsoluteTime time) {
+    uint64_t bits;
+    memcpy(&bits, &time, sizeof(bits));
+    return bits;
+}
+
+static inline CFAbsoluteTime _DFSharedMemoryStorageTime(uint64_t bits) {
+    CFAbsoluteTime time;
+    memcpy(&time, &bits, sizeof(time));
+    return time;
+}
+
+/*! POSIX shared memory names are limited to 31 characters on Darwin so the segments are named by the hash of the storage name.
+ */
+static NSString *_DFSharedMemoryStorageSegmentName(NSString *name) {
+    NSData *data = [name dataUsingEncoding:NSUTF8StringEncoding];
+    return [NSString stringWithFormat:@"/dfcache.%016llx", _DFSharedMemoryStorageHash(data.bytes, data.length)];
+}
+
+/*! Takes the ownership of the slot. Returns NO if the slot is owned by another writer.
+ @param sequence On return contains the odd sequence of the owned slot which is passed to _DFSharedMemorySlotRelease.
+ */
+static BOOL _DFSharedMemorySlotAcquire(_DFSharedMemorySlot *slot, uint32_t *sequence) {
+    uint32_t current = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+    if (current & 1) {
+        // Reclaims the slot abandoned by the writer that died during the write. The slot stays owned (odd) while its contents are discarded.
+        pid_t writer = __atomic_load_n(&slot->writer, __ATOMIC_RELAXED);
+        if (writer > 0 && writer != getpid() && kill(writer, 0) == -1 && errno == ESRCH &&
+            __atomic_compare_exchange_n(&slot->sequence, &current, current + 2, NO, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            __atomic_store_n(&slot->writer, getpid(), __ATOMIC_RELAXED);
+            slot->hash = 0;
+            *sequence = current + 2;
+            return YES;
+        }
+        return NO;
+    }
+    if (!__atomic_compare_exchange_n(&slot->sequence, &current, current + 1, NO, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return NO;
+    }
+    __atomic_store_n(&slot->writer, getpid(), __ATOMIC_RELAXED);
+    *sequence = current + 1;
+    return YES;
+}
+
+static void _DFSharedMemorySlotRelease(_DFSharedMemorySlot *slot, uint32_t sequence) {
+    __atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELEASE);
+}
+
+
+@implementation DFSharedMemoryStorage {
+    _DFSharedMemoryHeader *_header;
+    size_t _length;
+    uint64_t _slotStride;
+    uint64_t _setCount;
+}
+
+- (instancetype)initWithName:(NSString *)name capacity:(unsigned long long)capacity slotSize:(NSUInteger)slotSize {
+    if (self = [super init]) {
+        if (!name.length) {
+            [NSException raise:NSInvalidArgumentException format:@"Attempting to initialize storage without name"];
+        }
+        _name = [name copy];
+        if (![self _mapSegmentWithCapacity:capacity slotSize:slotSize]) {
+            return nil;
+        }
+    }
+    return self;
+}
+
+- (instancetype)initWithName:(NSString *)name {
+    return [self initWithName:name capacity:1024 * 1024 * 64 slotSize:1024 * 16];
+}
+
+- (instancetype)init {
+    [NSException raise:NSInternalInconsistencyException format:@"Please use designated initialzier"];
+    return nil;
+}
+
+- (void)dealloc {
+    if (_header) {
+        munmap(_header, _length);
+    }
+}
+
++ (BOOL)removeSegmentWithName:(NSString *)name {
+    return shm_unlink([_DFSharedMemoryStorageSegmentName(name) UTF8String]) == 0;
+}
+
+#pragma mark - Segment
+
+/*! Creates the segment or maps the existing one. The process that creates the segment publishes the header by writing the magic last, the other processes wait for it.
+ */
+- (BOOL)_mapSegmentWithCapacity:(unsigned long long)capacity slotSize:(NSUInteger)slotSize {
+    const char *segmentName = [_DFSharedMemoryStorageSegmentName(_name) UTF8String];
+    uint64_t slotStride = (sizeof(_DFSharedMemorySlot) + slotSize + 63) & ~63ull;
+    uint64_t slotCount = MAX(capacity / slotStride / DFSharedMemoryStorageWayCount, 1) * DFSharedMemoryStorageWayCount;
+    size_t length = (size_t)(sizeof(_DFSharedMemoryHeader) + slotCount * slotStride);
+
+    int fd = shm_open(segmentName, O_RDWR | O_CREAT | O_EXCL, 0600);
+    BOOL created = fd >= 0;
+    if (created) {
+        if (ftruncate(fd, (off_t)length) != 0) {
+            close(fd);
+            shm_unlink(segmentName);
+            return NO;
+        }
+    } else {
+        fd = errno == EEXIST ? shm_open(segmentName, O_RDWR, 0600) : -1;
+        if (fd < 0) {
+            return NO;
+        }
+        struct stat fileStat;
+        for (NSUInteger i = 0; fstat(fd, &fileStat) == 0 && fileStat.st_size == 0 && i < DFSharedMemoryStorageOpenTimeout; i++) {
+            usleep(1000); // The segment isn't sized yet
+        }
+        if (fstat(fd, &fileStat) != 0 || fileStat.st_size < (off_t)sizeof(_DFSharedMemoryHeader)) {
+            close(fd);
+            return NO;
+        }
+        length = (size_t)fileStat.st_size;
+    }
+    void *map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NO;
+    }
+    _DFSharedMemoryHeader *header = map;
+    if (created) {
+        header->version = DFSharedMemoryStorageVersion;
+        header->slotCount = slotCount;
+        header->slotSize = slotSize;
+        header->slotStride = slotStride;
+        __atomic_store_n(&header->magic, DFSharedMemoryStorageMagic, __ATOMIC_RELEASE);
+    } else {
+        for (NSUInteger i = 0; __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != DFSharedMemoryStorageMagic && i < DFSharedMemoryStorageOpenTimeout; i++) {
+            usleep(1000);
+        }
+        BOOL valid = __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) == DFSharedMemoryStorageMagic &&
+        header->version == DFSharedMemoryStorageVersion && header->slotCount > 0 && header->slotCount % DFSharedMemoryStorageWayCount == 0 &&
+        header->slotStride >= sizeof(_DFSharedMemorySlot) + header->slotSize &&
+        sizeof(_DFSharedMemoryHeader) + header->slotCount * header->slotStride <= length;
+        if (!valid) {
+            munmap(map, length);
+            return NO;
+        }
+    }
+    _header = header;
+    _length = length;
+    _slotCount = (NSUInteger)header->slotCount;
+    _slotSize = (NSUInteger)header->slotSize;
+    _slotStride = header->slotStride;
+    _setCount = header->slotCount / DFSharedMemoryStorageWayCount;
+    return YES;
+}
+
+- (_DFSharedMemorySlot *)_slotAtIndex:(uint64_t)index {
+    return (_DFSharedMemorySlot *)((uint8_t *)_header + sizeof(_DFSharedMemoryHeader) + index * _slotStride);
+}
+
+- (uint64_t)_firstSlotIndexForHash:(uint64_t)hash {
+    return (hash % _setCount) * DFSharedMemoryStorageWayCount;
+}
+
+#pragma mark - Read
+
+/*! Reads the entry for the given key without taking any slot. Retries the slot if it is written concurrently.
+ @param data If not NULL on return contains the copy of the entry data.
+ */
+- (BOOL)_readEntryForKey:(NSData *)key hash:(uint64_t)hash data:(NSData *__autoreleasing *)data stat:(DFStorageEntryStat *)stat {
+    uint64_t firstIndex = [self _firstSlotIndexForHash:hash];
+    for (uint64_t way = 0; way < DFSharedMemoryStorageWayCount; way++) {
+        _DFSharedMemorySlot *slot = [self _slotAtIndex:firstIndex + way];
+        const uint8_t *payload = (const uint8_t *)(slot + 1);
+        for (NSUInteger attempt = 0; attempt < DFSharedMemoryStorageAttemptCount; attempt++) {
+            uint32_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+            if (sequence & 1) {
+                sched_yield();
+                continue;
+            }
+            if (__atomic_load_n(&slot->hash, __ATOMIC_RELAXED) != hash) {
+                break;
+            }
+            uint32_t keyLength = slot->keyLength;
+            uint32_t dataLength = slot->dataLength;
+            CFAbsoluteTime accessTime = _DFSharedMemoryStorageTime(__atomic_load_n(&slot->accessTime, __ATOMIC_RELAXED));
+            BOOL match = keyLength == key.length && (uint64_t)keyLength + dataLength <= _slotSize && memcmp(payload, key.bytes, keyLength) == 0;
+            NSData *copy = (match && data) ? [NSData dataWithBytes:payload + keyLength length:dataLength] : nil;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) != sequence) {
+                continue; // Slot was written while it was read
+            }
+            if (!match) {
+                break;
+            }
+            if (data) {
+                *data = copy;
+            }
+            if (stat) {
+                *stat = (DFStorageEntryStat){ .size = keyLength + dataLength, .accessTime = accessTime };
+            }
+            return YES;
+        }
+    }
+    return NO;
+}
+
+- (NSData *)dataForKey:(NSString *)key {
+    if (!key) {
+        return nil;
+    }
+    NSData *keyData = [key dataUsingEncoding:NSUTF8StringEncoding];
+    uint64_t hash = _DFSharedMemoryStorageHash(keyData.bytes, keyData.length);
+    NSData *data;
+    if ([self _readEntryForKey:keyData hash:hash data:&data stat:NULL]) {
+        __atomic_fetch_add(&_header->hitCount, 1, __ATOMIC_RELAXED);
+        [self _updateAccessTimeForKey:keyData hash:hash];
+        return data;
+    }
+    __atomic_fetch_add(&_header->missCount, 1, __ATOMIC_RELAXED);
+    return nil;
+}
+
+/*! Updates access time of the entry without taking the slot. If the slot is reused concurrently the access time of another entry is updated which only affects the order of eviction.
+ */
+- (void)_updateAccessTimeForKey:(NSData *)key hash:(uint64_t)hash {
+    uint64_t firstIndex = [self _firstSlotIndexForHash:hash];
+    for (uint64_t way = 0; way < DFSharedMemoryStorageWayCount; way++) {
+        _DFSharedMemorySlot *slot = [self _slotAtIndex:firstIndex + way];
+        if (__atomic_load_n(&slot->hash, __ATOMIC_RELAXED) == hash) {
+            __atomic_store_n(&slot->accessTime, _DFSharedMemoryStorageTimeBits(CFAbsoluteTimeGetCurrent()), __ATOMIC_RELAXED);
+            return;
+        }
+    }
+}
+
+- (BOOL)containsDataForKey:(NSString *)key {
+    if (!key) {
+        return NO;
+    }
+    NSData *keyData = [key dataUsingEncoding:NSUTF8StringEncoding];
+    return [self _readEntryForKey:keyData hash:_DFSharedMemoryStorageHash(keyData.bytes, keyData.length) data:NULL stat:NULL];
+}
+
+#pragma mark - Write
+
+/*! Takes the ownership of the slot, retrying while it is owned by another writer. Returns NO if the slot stays busy.
+ */
+- (BOOL)_acquireSlot:(_DFSharedMemorySlot *)slot sequence:(uint32_t *)sequence {
+    for (NSUInteger attempt = 0; attempt < DFSharedMemoryStorageAttemptCount; attempt++) {
+        if (_DFSharedMemorySlotAcquire(slot, sequence)) {
+            return YES;
+        }
+        sched_yield();
+    }
+    return NO;
+}
+
+/*! Returns YES if the owned slot contains the entry for the given key.
+ */
+static BOOL _DFSharedMemorySlotContainsKey(const _DFSharedMemorySlot *slot, NSData *key, uint64_t hash) {
+    return slot->hash == hash && slot->keyLength == key.length && memcmp(slot + 1, key.bytes, key.length) == 0;
+}
+
+- (void)setData:(NSData *)data forKey:(NSString *)key {
+    if (!data || !key) {
+        return;
+    }
+    NSData *keyData = [key dataUsingEncoding:NSUTF8StringEncoding];
+    uint64_t hash = _DFSharedMemoryStorageHash(keyData.bytes, keyData.length);
+    if (keyData.length + data.length > _slotSize) {
+        [self _removeEntryForKey:keyData hash:hash];
+        return;
+    }
+    // Prefers the slot of the same key, then an empty slot, then the least recently used one.
+    uint64_t firstIndex = [self _firstSlotIndexForHash:hash];
+    uint64_t index = UINT64_MAX, emptyIndex = UINT64_MAX, oldestIndex = firstIndex;
+    CFAbsoluteTime oldestAccessTime = DBL_MAX;
+    for (uint64_t way = 0; way < DFSharedMemoryStorageWayCount && index == UINT64_MAX; way++) {
+        _DFSharedMemorySlot *slot = [self _slotAtIndex:firstIndex + way];
+        uint64_t slotHash = __atomic_load_n(&slot->hash, __ATOMIC_RELAXED);
+        if (slotHash == hash) {
+            index = firstIndex + way;
+        } else if (slotHash == 0) {
+            emptyIndex = MIN(emptyIndex, firstIndex + way);
+        } else {
+            CFAbsoluteTime accessTime = _DFSharedMemoryStorageTime(__atomic_load_n(&slot->accessTime, __ATOMIC_RELAXED));
+            if (accessTime < oldestAccessTime) {
+                oldestAccessTime = accessTime;
+                oldestIndex = firstIndex + way;
+            }
+        }
+    }
+    if (index == UINT64_MAX) {
+        index = emptyIndex != UINT64_MAX ? emptyIndex : oldestIndex;
+    }
+    _DFSharedMemorySlot *slot = [self _slotAtIndex:index];
+    uint32_t sequence;
+    if (![self _acquireSlot:slot sequence:&sequence]) {
+        [self _removeEntryForKey:keyData hash:hash]; // The write is dropped, the previous data must not be served
+        return;
+    }
+    if (slot->hash != 0 && !_DFSharedMemorySlotContainsKey(slot, keyData, hash)) {
+        __atomic_fetch_add(&_header->evictionCount, 1, __ATOMIC_RELAXED);
+    }
+    uint8_t *payload = (uint8_t *)(slot + 1);
+    memcpy(payload, keyData.bytes, keyData.length);
+    memcpy(payload + keyData.length, data.bytes, data.length);
+    slot->keyLength = (uint32_t)keyData.length;
+    slot->dataLength = (uint32_t)data.length;
+    slot->accessTime = _DFSharedMemoryStorageTimeBits(CFAbsoluteTimeGetCurrent());
+    slot->hash = hash;
+    _DFSharedMemorySlotRelease(slot, sequence);
+
+    // Removes the copies of the entry that the concurrent writers might have put into the other slots of the set.
+    for (uint64_t way = 0; way < DFSharedMemoryStorageWayCount; way++) {
+        if (firstIndex + way != index) {
+            [self _removeEntryForKey:keyData hash:hash inSlot:[self _slotAtIndex:firstIndex + way]];
+        }
+    }
+}
+
+- (void)_removeEntryForKey:(NSData *)key hash:(uint64_t)hash {
+    uint64_t firstIndex = [self _firstSlotIndexForHash:hash];
+    for (uint64_t way = 0; way < DFSharedMemoryStorageWayCount; way++) {
+        [self _removeEntryForKey:key hash:hash inSlot:[self _slotAtIndex:firstIndex + way]];
+    }
+}
+
+- (void)_removeEntryForKey:(NSData *)key hash:(uint64_t)hash inSlot:(_DFSharedMemorySlot *)slot {
+    if (__atomic_load_n(&slot->hash, __ATOMIC_RELAXED) != hash) {
+        return;
+    }
+    uint32_t sequence;
+    if ([self _acquireSlot:slot sequence:&sequence]) {
+        if (_DFSharedMemorySlotContainsKey(slot, key, hash)) {
+            slot->hash = 0;
+        }
+        _DFSharedMemorySlotRelease(slot, sequence);
+    }
+}
+
+- (void)removeDataForKey:(NSString *)key {
+    if (key) {
+        NSData *keyData = [key dataUsingEncoding:NSUTF8StringEncoding];
+        [self _removeEntryForKey:keyData hash:_DFSharedMemoryStorageHash(keyData.bytes, keyData.length)];
+    }
+}
+
+- (void)removeDataForKeys:(NSArray *)keys {
+    for (NSString *key in keys) {
+        [self removeDataForKey:key];
+    }
+}
+
+- (void)removeAllData {
+    for (uint64_t i = 0; i < _slotCount; i++) {
+        _DFSharedMemorySlot *slot = [self _slotAtIndex:i];
+        uint32_t sequence;
+        if (__atomic_load_n(&slot->hash, __ATOMIC_RELAXED) != 0 && [self _acquireSlot:slot sequence:&sequence]) {
+            slot->hash = 0;
+            _DFSharedMemorySlotRelease(slot, sequence);
+        }
+    }
+}
+
+#pragma mark - Contents
+
+/*! Enumerates consistent snapshots of the stored entries. Entries written concurrently might be skipped.
+ */
+- (void)_enumerateEntriesUsingBlock:(void (^)(NSData *key, DFStorageEntryStat stat, BOOL *stop))block {
+    BOOL stop = NO;
+    for (uint64_t i = 0; i < _slotCount && !stop; i++) {
+        _DFSharedMemorySlot *slot = [self _slotAtIndex:i];
+        uint32_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        if ((sequence & 1) || __atomic_load_n(&slot->hash, __ATOMIC_RELAXED) == 0) {
+            continue;
+        }
+        uint32_t keyLength = MIN(slot->keyLength, (uint32_t)_slotSize);
+        uint32_t dataLength = slot->dataLength;
+        NSData *key = [NSData dataWithBytes:slot + 1 length:keyLength];
+        CFAbsoluteTime accessTime = _DFSharedMemoryStorageTime(__atomic_load_n(&slot->accessTime, __ATOMIC_RELAXED));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == sequence) {
+            block(key, (DFStorageEntryStat){ .size = keyLength + dataLength, .accessTime = accessTime }, &stop);
+        }
+    }
+}
+
+- (unsigned long long)contentsSize {
+    unsigned long long __block contentsSize = 0;
+    [self _enumerateEntriesUsingBlock:^(NSData *key, DFStorageEntryStat stat, BOOL *stop) {
+        contentsSize += stat.size;
+    }];
+    return contentsSize;
+}
+
+- (NSUInteger)contentsCount {
+    NSUInteger __block count = 0;
+    [self _enumerateEntriesUsingBlock:^(NSData *key, DFStorageEntryStat stat, BOOL *stop) {
+        count++;
+    }];
+    return count;
+}
+
+- (unsigned long long)hitCount {
+    return __atomic_load_n(&_header->hitCount, __ATOMIC_RELAXED);
+}
+
+- (unsigned long long)missCount {
+    return __atomic_load_n(&_header->missCount, __ATOMIC_RELAXED);
+}
+
+- (unsigned long long)evictionCount {
+    return __atomic_load_n(&_header->evictionCount, __ATOMIC_RELAXED);
+}
+
+#pragma mark - Storage Engine
+
+- (BOOL)getStat:(DFStorageEntryStat *)stat forKey:(NSString *)key {
+    if (!key) {
+        return NO;
+    }
+    NSData *keyData = [key dataUsingEncoding:NSUTF8StringEncoding];
+    return [self _readEntryForKey:keyData hash:_DFSharedMemoryStorageHash(keyData.bytes, keyData.length) data:NULL stat:stat];
+}
+
+- (NSString *)identifierForKey:(NSString *)key {
+    return key;
+}
+
+- (NSString *)keyForIdentifier:(NSString *)identifier {
+    return identifier;
+}
+
+- (void)enumerateEntriesUsingBlock:(void (^)(NSString *, DFStorageEntryStat, BOOL *))block {
+    [self _enumerateEntriesUsingBlock:^(NSData *key, DFStorageEntryStat stat, BOOL *stop) {
+        NSString *identifier = [[NSString alloc] initWithData:key encoding:NSUTF8StringEncoding];
+        if (identifier) {
+            block(identifier, stat, stop);
+        }
+    }];
+}
+
+- (void)removeEntriesWithIdentifiers:(NSArray *)identifiers {
+    [self removeDataForKeys:identifiers];
+}
+
+#pragma mark - Miscellaneous
+
+- (NSString *)debugDescription {
+    return [NSString stringWithFormat:@"<%@ %p> { name: %@; slots: %lu; slot size: %lu }", [self class], self, _name, (unsigned long)_slotCount, (unsigned long)_slotSize];
+}
+
+@end
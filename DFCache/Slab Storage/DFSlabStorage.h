@@ -0,0 +1,81 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import <Foundation/Foundation.h>
+#import "DFStorageEngine.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Key-value storage for small values that keeps them in fixed-size slots of large preallocated files instead of a file per entry.
+ @discussion Slots are grouped into slab classes of geometrically growing sizes (64 bytes to 16 Kb, growth factor 1.25). Each value goes to the smallest class with slots large enough to hold the value together with its key. Each class is backed by a single file that grows by 1 Mb pages while storage size is under capacity. Once the capacity is reached the least recently used entry of the class is evicted to make room for the new one (per-class LRU, like memcached).
+
+ Allocation, read and overwrite (when the value stays in the same class) take constant time and don't create files. Storage keeps an in-memory index of its contents which is rebuilt from the slab files when storage is initialized. Each slot is protected by a checksum, slots damaged by the interrupted writes are discarded.
+ Slab storage is a storage engine, entry identifiers are the keys written into the slots (keys longer than 250 bytes are replaced with their SHA1 hashes).
+ */
+@interface DFSlabStorage : NSObject <DFStorageEngine>
+
+/*! Initializes and returns storage with the given directory path. Reads slab files to build the index of the contents.
+ @param path Storage directory path.
+ @param error A pointer to an error object. If an error occurs while creating storage directory, the pointer is set to the file system error (see NSFileManager).
+ */
+- (instancetype)initWithPath:(NSString *)path error:(NSError **)error NS_DESIGNATED_INITIALIZER;
+
+/*! Unavailable initializer, please use designated initializer.
+ */
+- (instancetype)init NS_UNAVAILABLE;
+
+/*! Returns storage directory path.
+ */
+@property (nonatomic, readonly) NSString *path;
+
+/*! Maximum size of the slab files, in bytes. Default value is 100 Mb.
+ @discussion Slab files never shrink. Lowering capacity below the current size of the files only stops them from growing.
+ */
+@property (nonatomic) unsigned long long capacity;
+
+/*! Maximum length of the value together with its key that fits into the largest slot. Values that don't fit are not stored.
+ */
+@property (nonatomic, readonly) NSUInteger maximumEntryLength;
+
+/*! Number of entries evicted to make room for the new ones since storage was initialized.
+ */
+@property (nonatomic, readonly) unsigned long long evictionCount;
+
+/*! Called with the identifier of the entry that was evicted to make room for the new one. Called on the writing thread after the write.
+ */
+@property (nullable, nonatomic, copy) void (^evictionHandler)(NSArray *identifiers);
+
+- (nullable NSData *)dataForKey:(NSString *)key;
+
+/*! Stores data for the given key. Overwrites the value in place if the new value belongs to the same slab class. Evicts the least recently used entry of the class if storage has reached its capacity.
+ */
+- (void)setData:(NSData *)data forKey:(NSString *)key;
+
+- (void)removeDataForKey:(NSString *)key;
+
+/*! Removes all storage contents and slab files.
+ */
+- (void)removeAllData;
+
+- (BOOL)containsDataForKey:(NSString *)key;
+
+/*! Returns the total size of the slots occupied by the entries, in bytes.
+ */
+- (unsigned long long)contentsSize;
+
+/*! Returns the total length of the stored values, in bytes.
+ */
+- (unsigned long long)contentsLogicalSize;
+
+/*! Returns the number of the stored entries.
+ */
+- (NSUInteger)contentsCount;
+
+/*! Synchronizes slab files with the disk.
+ */
+- (void)synchronize;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,630 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFCachePrivate.h"
+#import "DFSlabStorage.h"
+#import <CommonCrypto/CommonDigest.h>
+#import <fcntl.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
+/*! Slab files grow by pages of this size.
+ */
+static const uint32_t DFSlabStoragePageSize = 1024 * 1024;
+static const uint32_t DFSlabStorageMinimumSlotSize = 64;
+static const uint32_t DFSlabStorageMaximumSlotSize = 16 * 1024;
+static const double DFSlabStorageGrowthFactor = 1.25;
+
+/*! Longer keys are replaced with their SHA-1 hashes.
+ */
+static const NSUInteger DFSlabStorageMaximumKeyLength = 250;
+
+/*! Slot layout: header, key, value. The rest of the slot is unused.
+ */
+typedef struct {
+    /*! Checksum of the slot contents following the checksum, including key and value.
+     */
+    uint32_t checksum;
+    uint32_t valueLength;
+    /*! Sequence number of the write. When the same key is found in multiple slots during recovery the most recent write wins.
+     */
+    uint64_t sequence;
+    uint16_t keyLength;
+    uint8_t used;
+    uint8_t reserved[5];
+} _DFSlabSlotHeader;
+
+static uint32_t _DFSlabStorageChecksum(const uint8_t *bytes, size_t length) {
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*! Returns key that is written into the slot.
+ */
+static NSString *_DFSlabStorageStoredKey(NSString *key) {
+    const char *string = [key UTF8String];
+    size_t length = strlen(string);
+    return length <= DFSlabStorageMaximumKeyLength ? key : _dwarf_cache_sha1(string, (uint32_t)length);
+}
+
+
+@interface _DFSlabEntry : NSObject {
+    @public
+    NSString *_key;
+    NSUInteger _classIndex;
+    uint32_t _slot;
+    uint64_t _sequence;
+    uint32_t _length; // Length of the value
+    CFAbsoluteTime _accessTime; // 0 for the recovered entries
+    __unsafe_unretained _DFSlabEntry *_previous; // More recently used
+    __unsafe_unretained _DFSlabEntry *_next; // Less recently used
+}
+@end
+
+@implementation _DFSlabEntry
+@end
+
+
+/*! Slab class: slab file, free list and LRU list of the entries. Only mutated with the storage lock acquired. The file descriptor is closed when the class is deallocated so that the reads that are in progress can finish after storage contents are removed.
+ */
+@interface _DFSlabClass : NSObject {
+    @public
+    uint32_t _slotSize;
+    int _fd;
+    uint32_t _slotCount;
+    uint32_t *_freeSlots;
+    uint32_t _freeSlotCount;
+    uint32_t _entryCount;
+    __unsafe_unretained _DFSlabEntry *_head;
+    __unsafe_unretained _DFSlabEntry *_tail;
+}
+@end
+
+@implementation _DFSlabClass
+
+- (void)dealloc {
+    if (_fd >= 0) {
+        close(_fd);
+    }
+    free(_freeSlots);
+}
+
+- (void)pushFreeSlot:(uint32_t)slot {
+    _freeSlots[_freeSlotCount++] = slot;
+}
+
+- (BOOL)popFreeSlot:(uint32_t *)slot {
+    if (_freeSlotCount == 0) {
+        return NO;
+    }
+    *slot = _freeSlots[--_freeSlotCount];
+    return YES;
+}
+
+/*! Adds a page to the slab file and puts its slots into the free list.
+ */
+- (BOOL)grow {
+    uint32_t count = MAX(1, DFSlabStoragePageSize / _slotSize);
+    off_t length = (off_t)(_slotCount + count) * _slotSize;
+    fstore_t store = { .fst_flags = F_ALLOCATECONTIG | F_ALLOCATEALL, .fst_posmode = F_PEOFPOSMODE, .fst_offset = 0, .fst_length = (off_t)count * _slotSize };
+    if (fcntl(_fd, F_PREALLOCATE, &store) == -1) {
+        store.fst_flags = F_ALLOCATEALL;
+        fcntl(_fd, F_PREALLOCATE, &store);
+    }
+    if (ftruncate(_fd, length) != 0) {
+        return NO;
+    }
+    [self _reserveFreeSlots:_freeSlotCount + count];
+    for (uint32_t i = count; i > 0; i--) {
+        [self pushFreeSlot:_slotCount + i - 1]; // Lower slots are allocated first
+    }
+    _slotCount += count;
+    return YES;
+}
+
+- (void)_reserveFreeSlots:(uint32_t)count {
+    _freeSlots = reallocf(_freeSlots, MAX(count, 1) * sizeof(uint32_t));
+    if (!_freeSlots) {
+        [NSException raise:NSMallocException format:@"Failed to allocate slab free list"];
+    }
+}
+
+- (void)insertEntryAtHead:(_DFSlabEntry *)entry {
+    entry->_previous = nil;
+    entry->_next = _head;
+    if (_head) {
+        _head->_previous = entry;
+    }
+    _head = entry;
+    if (!_tail) {
+        _tail = entry;
+    }
+    _entryCount++;
+}
+
+- (void)removeEntry:(_DFSlabEntry *)entry {
+    if (entry->_previous) {
+        entry->_previous->_next = entry->_next;
+    } else {
+        _head = entry->_next;
+    }
+    if (entry->_next) {
+        entry->_next->_previous = entry->_previous;
+    } else {
+        _tail = entry->_previous;
+    }
+    entry->_previous = nil;
+    entry->_next = nil;
+    _entryCount--;
+}
+
+- (void)moveEntryToHead:(_DFSlabEntry *)entry {
+    if (_head != entry) {
+        [self removeEntry:entry];
+        [self insertEntryAtHead:entry];
+    }
+}
+
+@end
+
+
+@implementation DFSlabStorage {
+    NSLock *_lock;
+    NSArray *_classes;
+    NSMutableDictionary *_entries;
+    uint64_t _sequence;
+    unsigned long long _filesSize;
+    unsigned long long _contentsSize;
+    unsigned long long _contentsLogicalSize;
+    unsigned long long _evictionCount;
+}
+
+- (instancetype)initWithPath:(NSString *)path error:(NSError *__autoreleasing *)error {
+    if (self = [super init]) {
+        if (!path.length) {
+            [NSException raise:NSInvalidArgumentException format:@"Attempting to initialize storage without directory path"];
+        }
+        _path = path;
+        _capacity = 1024 * 1024 * 100; // 100 Mb
+        _lock = [NSLock new];
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        if (![fileManager fileExistsAtPath:_path]) {
+            [fileManager createDirectoryAtPath:_path withIntermediateDirectories:YES attributes:nil error:error];
+        }
+        [self _openClasses];
+    }
+    return self;
+}
+
+- (instancetype)init {
+    [NSException raise:NSInternalInconsistencyException format:@"Please use designated initialzier"];
+    return nil;
+}
+
+- (NSUInteger)maximumEntryLength {
+    return DFSlabStorageMaximumSlotSize - sizeof(_DFSlabSlotHeader);
+}
+
+#pragma mark - Read
+
+- (NSData *)dataForKey:(NSString *)key {
+    if (!key) {
+        return nil;
+    }
+    NSString *storedKey = _DFSlabStorageStoredKey(key);
+    [_lock lock];
+    _DFSlabEntry *entry = _entries[storedKey];
+    _DFSlabClass *slabClass = entry ? _classes[entry->_classIndex] : nil;
+    uint32_t slot = entry ? entry->_slot : 0;
+    if (entry) {
+        entry->_accessTime = CFAbsoluteTimeGetCurrent();
+        [slabClass moveEntryToHead:entry];
+    }
+    [_lock unlock];
+    if (!entry) {
+        return nil;
+    }
+    // Slot is read without the lock. The slot might get reused or overwritten in the meantime, the key and the checksum are verified to detect that.
+    uint8_t *buffer = malloc(slabClass->_slotSize);
+    NSData *data = nil;
+    if (pread(slabClass->_fd, buffer, slabClass->_slotSize, (off_t)slot * slabClass->_slotSize) == (ssize_t)slabClass->_slotSize) {
+        const char *keyBytes = [storedKey UTF8String];
+        size_t keyLength = strlen(keyBytes);
+        _DFSlabSlotHeader header;
+        memcpy(&header, buffer, sizeof(header));
+        if ([self _isValidSlot:buffer header:&header slotSize:slabClass->_slotSize] &&
+            header.keyLength == keyLength &&
+            memcmp(buffer + sizeof(header), keyBytes, keyLength) == 0) {
+            data = [NSData dataWithBytes:buffer + sizeof(header) + keyLength length:header.valueLength];
+        }
+    }
+    free(buffer);
+    return data;
+}
+
+- (BOOL)containsDataForKey:(NSString *)key {
+    if (!key) {
+        return NO;
+    }
+    [_lock lock];
+    BOOL contains = _entries[_DFSlabStorageStoredKey(key)] != nil;
+    [_lock unlock];
+    return contains;
+}
+
+- (unsigned long long)contentsSize {
+    [_lock lock];
+    unsigned long long contentsSize = _contentsSize;
+    [_lock unlock];
+    return contentsSize;
+}
+
+- (unsigned long long)contentsLogicalSize {
+    [_lock lock];
+    unsigned long long contentsLogicalSize = _contentsLogicalSize;
+    [_lock unlock];
+    return contentsLogicalSize;
+}
+
+- (NSUInteger)contentsCount {
+    [_lock lock];
+    NSUInteger count = _entries.count;
+    [_lock unlock];
+    return count;
+}
+
+- (unsigned long long)evictionCount {
+    [_lock lock];
+    unsigned long long evictionCount = _evictionCount;
+    [_lock unlock];
+    return evictionCount;
+}
+
+#pragma mark - Write
+
+- (void)setData:(NSData *)data forKey:(NSString *)key {
+    if (!data || !key) {
+        return;
+    }
+    NSString *storedKey = _DFSlabStorageStoredKey(key);
+    const char *keyBytes = [storedKey UTF8String];
+    size_t keyLength = strlen(keyBytes);
+    NSUInteger classIndex = [self _classIndexForSlotLength:sizeof(_DFSlabSlotHeader) + keyLength + data.length];
+    if (classIndex == NSNotFound) {
+        return;
+    }
+    // Writes are performed with the lock acquired so that the slot can't be reused by another write while it is being written.
+    [_lock lock];
+    _DFSlabClass *slabClass = _classes[classIndex];
+    _DFSlabEntry *entry = _entries[storedKey];
+    if (entry && entry->_classIndex != classIndex) {
+        [self _removeEntry:entry];
+        entry = nil;
+    }
+    NSString *evictedKey;
+    if (entry) {
+        [slabClass moveEntryToHead:entry];
+    } else {
+        uint32_t slot;
+        if (![self _allocateSlot:&slot slabClass:slabClass evictedKey:&evictedKey]) {
+            [_lock unlock];
+            return;
+        }
+        entry = [_DFSlabEntry new];
+        entry->_key = storedKey;
+        entry->_classIndex = classIndex;
+        entry->_slot = slot;
+        _entries[storedKey] = entry;
+        [slabClass insertEntryAtHead:entry];
+        _contentsSize += slabClass->_slotSize;
+    }
+    _contentsLogicalSize -= entry->_length;
+    entry->_length = (uint32_t)data.length;
+    _contentsLogicalSize += entry->_length;
+    entry->_sequence = ++_sequence;
+    entry->_accessTime = CFAbsoluteTimeGetCurrent();
+    if (![self _writeSlot:entry->_slot slabClass:slabClass key:keyBytes keyLength:keyLength data:data sequence:entry->_sequence]) {
+        [self _removeEntry:entry];
+    }
+    [_lock unlock];
+    void (^evictionHandler)(NSArray *) = self.evictionHandler;
+    if (evictedKey && evictionHandler) {
+        evictionHandler(@[ evictedKey ]);
+    }
+}
+
+- (void)removeDataForKey:(NSString *)key {
+    if (!key) {
+        return;
+    }
+    [_lock lock];
+    _DFSlabEntry *entry = _entries[_DFSlabStorageStoredKey(key)];
+    if (entry) {
+        [self _removeEntry:entry];
+    }
+    [_lock unlock];
+}
+
+- (void)removeAllData {
+    [_lock lock];
+    _classes = nil;
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    [fileManager removeItemAtPath:_path error:nil];
+    [fileManager createDirectoryAtPath:_path withIntermediateDirectories:YES attributes:nil error:nil];
+    [self _openClasses];
+    [_lock unlock];
+}
+
+- (void)synchronize {
+    [_lock lock];
+    NSArray *classes = _classes;
+    [_lock unlock];
+    for (_DFSlabClass *slabClass in classes) {
+        if (slabClass->_entryCount > 0) {
+            fsync(slabClass->_fd);
+        }
+    }
+}
+
+#pragma mark - Storage Engine
+
+- (BOOL)getStat:(DFStorageEntryStat *)stat forKey:(NSString *)key {
+    if (!key) {
+        return NO;
+    }
+    [_lock lock];
+    _DFSlabEntry *entry = _entries[_DFSlabStorageStoredKey(key)];
+    if (entry && stat) {
+        _DFSlabClass *slabClass = _classes[entry->_classIndex];
+        *stat = (DFStorageEntryStat){ .size = slabClass->_slotSize, .accessTime = entry->_accessTime };
+    }
+    [_lock unlock];
+    return entry != nil;
+}
+
+- (NSString *)identifierForKey:(NSString *)key {
+    return _DFSlabStorageStoredKey(key);
+}
+
+/*! Stored keys that look like SHA-1 hashes might be the hashes of the long keys, original keys of such entries are unknown.
+ */
+- (NSString *)keyForIdentifier:(NSString *)identifier {
+    if (identifier.length == 2 * CC_SHA1_DIGEST_LENGTH && [identifier rangeOfCharacterFromSet:[[NSCharacterSet characterSetWithCharactersInString:@"0123456789abcdef"] invertedSet]].location == NSNotFound) {
+        return nil;
+    }
+    return identifier;
+}
+
+- (void)enumerateEntriesUsingBlock:(void (^)(NSString *, DFStorageEntryStat, BOOL *))block {
+    // The block is called without the lock so that it can access storage.
+    [_lock lock];
+    NSMutableArray *identifiers = [[NSMutableArray alloc] initWithCapacity:_entries.count];
+    NSMutableData *stats = [[NSMutableData alloc] initWithCapacity:_entries.count * sizeof(DFStorageEntryStat)];
+    for (_DFSlabEntry *entry in [_entries objectEnumerator]) {
+        _DFSlabClass *slabClass = _classes[entry->_classIndex];
+        DFStorageEntryStat stat = { .size = slabClass->_slotSize, .accessTime = entry->_accessTime };
+        [identifiers addObject:entry->_key];
+        [stats appendBytes:&stat length:sizeof(stat)];
+    }
+    [_lock unlock];
+    const DFStorageEntryStat *entryStats = stats.bytes;
+    BOOL stop = NO;
+    for (NSUInteger i = 0; i < identifiers.count && !stop; i++) {
+        block(identifiers[i], entryStats[i], &stop);
+    }
+}
+
+- (void)removeEntriesWithIdentifiers:(NSArray *)identifiers {
+    [_lock lock];
+    for (NSString *identifier in identifiers) {
+        _DFSlabEntry *entry = _entries[identifier];
+        if (entry) {
+            [self _removeEntry:entry];
+        }
+    }
+    [_lock unlock];
+}
+
+#pragma mark - Private (Lock Acquired)
+
+- (NSUInteger)_classIndexForSlotLength:(size_t)length {
+    for (NSUInteger i = 0; i < _classes.count; i++) {
+        _DFSlabClass *slabClass = _classes[i];
+        if (slabClass->_slotSize >= length) {
+            return i;
+        }
+    }
+    return NSNotFound;
+}
+
+/*! Evicts the least recently used entry of the class if storage has reached its capacity.
+ @param evictedKey Set to the key of the evicted entry, if any.
+ */
+- (BOOL)_allocateSlot:(uint32_t *)slot slabClass:(_DFSlabClass *)slabClass evictedKey:(NSString *__autoreleasing *)evictedKey {
+    if ([slabClass popFreeSlot:slot]) {
+        return YES;
+    }
+    unsigned long long pageSize = (unsigned long long)MAX(1, DFSlabStoragePageSize / slabClass->_slotSize) * slabClass->_slotSize;
+    if (_filesSize + pageSize <= _capacity && [slabClass grow]) {
+        _filesSize += pageSize;
+        return [slabClass popFreeSlot:slot];
+    }
+    if (slabClass->_tail) {
+        *evictedKey = slabClass->_tail->_key;
+        [self _removeEntry:slabClass->_tail];
+        _evictionCount++;
+        return [slabClass popFreeSlot:slot];
+    }
+    return NO;
+}
+
+- (void)_removeEntry:(_DFSlabEntry *)entry {
+    _DFSlabClass *slabClass = _classes[entry->_classIndex];
+    [slabClass removeEntry:entry];
+    [_entries removeObjectForKey:entry->_key];
+    _contentsSize -= slabClass->_slotSize;
+    _contentsLogicalSize -= entry->_length;
+    // Clear the header so that the entry isn't recovered.
+    _DFSlabSlotHeader header = {0};
+    pwrite(slabClass->_fd, &header, sizeof(header), (off_t)entry->_slot * slabClass->_slotSize);
+    [slabClass pushFreeSlot:entry->_slot];
+}
+
+- (BOOL)_writeSlot:(uint32_t)slot slabClass:(_DFSlabClass *)slabClass key:(const char *)key keyLength:(size_t)keyLength data:(NSData *)data sequence:(uint64_t)sequence {
+    size_t length = sizeof(_DFSlabSlotHeader) + keyLength + data.length;
+    uint8_t *buffer = malloc(length);
+    _DFSlabSlotHeader header = {
+        .valueLength = (uint32_t)data.length,
+        .sequence = sequence,
+        .keyLength = (uint16_t)keyLength,
+        .used = 1
+    };
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + sizeof(header), key, keyLength);
+    memcpy(buffer + sizeof(header) + keyLength, data.bytes, data.length);
+    header.checksum = _DFSlabStorageChecksum(buffer + sizeof(uint32_t), length - sizeof(uint32_t));
+    memcpy(buffer, &header.checksum, sizeof(uint32_t));
+    BOOL success = pwrite(slabClass->_fd, buffer, length, (off_t)slot * slabClass->_slotSize) == (ssize_t)length;
+    free(buffer);
+    return success;
+}
+
+- (BOOL)_isValidSlot:(const uint8_t *)slot header:(const _DFSlabSlotHeader *)header slotSize:(uint32_t)slotSize {
+    if (!header->used) {
+        return NO;
+    }
+    size_t length = sizeof(_DFSlabSlotHeader) + header->keyLength + (size_t)header->valueLength;
+    if (length > slotSize) {
+        return NO;
+    }
+    return header->checksum == _DFSlabStorageChecksum(slot + sizeof(uint32_t), length - sizeof(uint32_t));
+}
+
+#pragma mark - Recovery
+
+/*! Opens (or creates) slab files and rebuilds the index from the slots.
+ */
+- (void)_openClasses {
+    _entries = [NSMutableDictionary new];
+    _sequence = 0;
+    _filesSize = 0;
+    _contentsSize = 0;
+    _contentsLogicalSize = 0;
+    NSMutableArray *classes = [NSMutableArray new];
+    NSMutableArray *recoveredEntries = [NSMutableArray new];
+    uint32_t slotSize = DFSlabStorageMinimumSlotSize;
+    while (YES) {
+        _DFSlabClass *slabClass = [_DFSlabClass new];
+        slabClass->_slotSize = slotSize;
+        NSString *filename = [NSString stringWithFormat:@"slab-%u", slotSize];
+        slabClass->_fd = open([[_path stringByAppendingPathComponent:filename] fileSystemRepresentation], O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        [classes addObject:slabClass];
+        _classes = classes;
+        [self _recoverSlabClass:slabClass classIndex:classes.count - 1 entries:recoveredEntries];
+        if (slotSize >= DFSlabStorageMaximumSlotSize) {
+            break;
+        }
+        slotSize = MIN(DFSlabStorageMaximumSlotSize, ((uint32_t)(slotSize * DFSlabStorageGrowthFactor) + 7) & ~7u);
+    }
+    _classes = [classes copy];
+    // The least recently written entries are evicted first.
+    [recoveredEntries sortUsingComparator:^NSComparisonResult(_DFSlabEntry *entry1, _DFSlabEntry *entry2) {
+        return entry1->_sequence == entry2->_sequence ? NSOrderedSame : (entry1->_sequence < entry2->_sequence ? NSOrderedAscending : NSOrderedDescending);
+    }];
+    for (_DFSlabEntry *entry in recoveredEntries) {
+        if (_entries[entry->_key] == entry) {
+            _DFSlabClass *slabClass = _classes[entry->_classIndex];
+            [slabClass insertEntryAtHead:entry];
+            _contentsSize += slabClass->_slotSize;
+            _contentsLogicalSize += entry->_length;
+        }
+    }
+}
+
+- (void)_recoverSlabClass:(_DFSlabClass *)slabClass classIndex:(NSUInteger)classIndex entries:(NSMutableArray *)recoveredEntries {
+    struct stat fileStat;
+    if (slabClass->_fd < 0 || fstat(slabClass->_fd, &fileStat) != 0) {
+        return;
+    }
+    const uint32_t slotSize = slabClass->_slotSize;
+    slabClass->_slotCount = (uint32_t)(fileStat.st_size / slotSize);
+    _filesSize += (unsigned long long)slabClass->_slotCount * slotSize;
+    [slabClass _reserveFreeSlots:slabClass->_slotCount];
+    BOOL *usedSlots = calloc(MAX(slabClass->_slotCount, 1), sizeof(BOOL));
+
+    // Slab file is read page by page.
+    const uint32_t slotsPerChunk = MAX(1, DFSlabStoragePageSize / slotSize);
+    uint8_t *buffer = malloc((size_t)slotsPerChunk * slotSize);
+    for (uint32_t first = 0; first < slabClass->_slotCount; first += slotsPerChunk) {
+        uint32_t count = MIN(slotsPerChunk, slabClass->_slotCount - first);
+        ssize_t length = pread(slabClass->_fd, buffer, (size_t)count * slotSize, (off_t)first * slotSize);
+        if (length < 0) {
+            break;
+        }
+        count = MIN(count, (uint32_t)(length / slotSize));
+        for (uint32_t i = 0; i < count; i++) {
+            const uint8_t *slot = buffer + (size_t)i * slotSize;
+            _DFSlabSlotHeader header;
+            memcpy(&header, slot, sizeof(header));
+            if (![self _isValidSlot:slot header:&header slotSize:slotSize]) {
+                continue;
+            }
+            NSString *key = [[NSString alloc] initWithBytes:slot + sizeof(header) length:header.keyLength encoding:NSUTF8StringEncoding];
+            if (!key) {
+                continue;
+            }
+            _DFSlabEntry *existing = _entries[key];
+            if (existing && existing->_sequence > header.sequence) {
+                continue;
+            }
+            if (existing) {
+                // Stale copy of the entry left by an interrupted move to another class.
+                _DFSlabClass *existingClass = _classes[existing->_classIndex];
+                if (existingClass == slabClass) {
+                    usedSlots[existing->_slot] = NO;
+                } else {
+                    [existingClass pushFreeSlot:existing->_slot];
+                }
+            }
+            _DFSlabEntry *entry = [_DFSlabEntry new];
+            entry->_key = key;
+            entry->_classIndex = classIndex;
+            entry->_slot = first + i;
+            entry->_sequence = header.sequence;
+            entry->_length = header.valueLength;
+            _entries[key] = entry;
+            [recoveredEntries addObject:entry];
+            usedSlots[first + i] = YES;
+            _sequence = MAX(_sequence, header.sequence);
+        }
+    }
+    free(buffer);
+    for (uint32_t slot = slabClass->_slotCount; slot > 0; slot--) {
+        if (!usedSlots[slot - 1]) {
+            [slabClass pushFreeSlot:slot - 1];
+        }
+    }
+    free(usedSlots);
+}
+
+#pragma mark - Miscellaneous
+
+- (NSString *)debugDescription {
+    [_lock lock];
+    NSMutableString *classes = [NSMutableString new];
+    for (_DFSlabClass *slabClass in _classes) {
+        if (slabClass->_slotCount > 0) {
+            [classes appendFormat:@"%@%u: %u/%u", (classes.length ? @", " : @""), slabClass->_slotSize, slabClass->_entryCount, slabClass->_slotCount];
+        }
+    }
+    NSString *description = [NSString stringWithFormat:@"<%@ %p> { capacity: %@; usage: %@; files: %@; entries: %lu; classes: { %@ } }", [self class], self, _dwarf_bytes_to_str(_capacity), _dwarf_bytes_to_str(_contentsSize), _dwarf_bytes_to_str(_filesSize), (unsigned long)_entries.count, classes];
+    [_lock unlock];
+    return description;
+}
+
+@end
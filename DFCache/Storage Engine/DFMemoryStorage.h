@@ -0,0 +1,21 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import <Foundation/Foundation.h>
+#import "DFStorageEngine.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Storage engine that keeps entries in memory. Contents are lost when storage is deallocated.
+ @discussion Useful in tests and for the disk caches that are meant to live in memory-backed file systems. Unlike NSCache, storage never discards entries on its own, DFDiskCache cleanup evicts them like it does with the files.
+ */
+@interface DFMemoryStorage : NSObject <DFStorageEngine>
+
+/*! Returns the number of the stored entries.
+ */
+- (NSUInteger)contentsCount;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,161 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFMemoryStorage.h"
+
+@interface _DFMemoryStorageEntry : NSObject {
+    @public
+    NSData *_data;
+    CFAbsoluteTime _accessTime;
+}
+@end
+
+@implementation _DFMemoryStorageEntry
+@end
+
+
+@implementation DFMemoryStorage {
+    NSMutableDictionary *_entries;
+    unsigned long long _contentsSize;
+    NSLock *_lock;
+}
+
+- (instancetype)init {
+    if (self = [super init]) {
+        _entries = [NSMutableDictionary new];
+        _lock = [NSLock new];
+    }
+    return self;
+}
+
+- (NSData *)dataForKey:(NSString *)key {
+    if (!key) {
+        return nil;
+    }
+    [_lock lock];
+    _DFMemoryStorageEntry *entry = _entries[key];
+    NSData *data;
+    if (entry) {
+        entry->_accessTime = CFAbsoluteTimeGetCurrent();
+        data = entry->_data;
+    }
+    [_lock unlock];
+    return data;
+}
+
+- (void)setData:(NSData *)data forKey:(NSString *)key {
+    if (!data || !key) {
+        return;
+    }
+    _DFMemoryStorageEntry *entry = [_DFMemoryStorageEntry new];
+    entry->_data = [data copy];
+    entry->_accessTime = CFAbsoluteTimeGetCurrent();
+    [_lock lock];
+    [self _removeEntryForKey:key];
+    _entries[key] = entry;
+    _contentsSize += entry->_data.length;
+    [_lock unlock];
+}
+
+- (void)removeDataForKey:(NSString *)key {
+    if (!key) {
+        return;
+    }
+    [_lock lock];
+    [self _removeEntryForKey:key];
+    [_lock unlock];
+}
+
+- (void)removeDataForKeys:(NSArray *)keys {
+    [self removeEntriesWithIdentifiers:keys];
+}
+
+- (void)removeAllData {
+    [_lock lock];
+    [_entries removeAllObjects];
+    _contentsSize = 0;
+    [_lock unlock];
+}
+
+- (BOOL)containsDataForKey:(NSString *)key {
+    if (!key) {
+        return NO;
+    }
+    [_lock lock];
+    BOOL contains = _entries[key] != nil;
+    [_lock unlock];
+    return contains;
+}
+
+- (unsigned long long)contentsSize {
+    [_lock lock];
+    unsigned long long contentsSize = _contentsSize;
+    [_lock unlock];
+    return contentsSize;
+}
+
+- (NSUInteger)contentsCount {
+    [_lock lock];
+    NSUInteger count = _entries.count;
+    [_lock unlock];
+    return count;
+}
+
+#pragma mark - Entries
+
+- (BOOL)getStat:(DFStorageEntryStat *)stat forKey:(NSString *)key {
+    if (!key) {
+        return NO;
+    }
+    [_lock lock];
+    _DFMemoryStorageEntry *entry = _entries[key];
+    if (entry && stat) {
+        *stat = (DFStorageEntryStat){ .size = entry->_data.length, .accessTime = entry->_accessTime };
+    }
+    [_lock unlock];
+    return entry != nil;
+}
+
+- (NSString *)identifierForKey:(NSString *)key {
+    return key;
+}
+
+- (NSString *)keyForIdentifier:(NSString *)identifier {
+    return identifier;
+}
+
+- (void)enumerateEntriesUsingBlock:(void (^)(NSString *, DFStorageEntryStat, BOOL *))block {
+    [_lock lock];
+    NSDictionary *entries = [_entries copy];
+    [_lock unlock];
+    [entries enumerateKeysAndObjectsUsingBlock:^(NSString *key, _DFMemoryStorageEntry *entry, BOOL *stop) {
+        block(key, (DFStorageEntryStat){ .size = entry->_data.length, .accessTime = entry->_accessTime }, stop);
+    }];
+}
+
+- (void)removeEntriesWithIdentifiers:(NSArray *)identifiers {
+    [_lock lock];
+    for (NSString *identifier in identifiers) {
+        [self _removeEntryForKey:identifier];
+    }
+    [_lock unlock];
+}
+
+/*! Must be called with the lock acquired.
+ */
+- (void)_removeEntryForKey:(NSString *)key {
+    _DFMemoryStorageEntry *entry = _entries[key];
+    if (entry) {
+        _contentsSize -= entry->_data.length;
+        [_entries removeObjectForKey:key];
+    }
+}
+
+#pragma mark - Miscellaneous
+
+- (NSString *)debugDescription {
+    return [NSString stringWithFormat:@"<%@ %p> { entries: %lu }", [self class], self, (unsigned long)self.contentsCount];
+}
+
+@end
@@ -0,0 +1,93 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Status of the entry stored by the storage engine.
+ */
+typedef struct {
+    /*! Space used by the entry, in bytes.
+     */
+    unsigned long long size;
+    /*! Time of the last access to the entry, 0 if engine doesn't track access times.
+     */
+    CFAbsoluteTime accessTime;
+} DFStorageEntryStat;
+
+/*! Key-value storage that DFDiskCache keeps its entries in. DFFileStorage (a file per key), DFSlabStorage, DFLSMStorage and DFMemoryStorage are storage engines.
+ @discussion Entries are enumerated and evicted by their identifiers. Identifier is the name under which engine stores the entry: the key itself or its derivative when engine doesn't keep the original keys (DFFileStorage stores file names which are hashes of the keys).
+ */
+@protocol DFStorageEngine <NSObject>
+
+- (nullable NSData *)dataForKey:(NSString *)key;
+
+- (void)setData:(NSData *)data forKey:(NSString *)key;
+
+- (void)removeDataForKey:(NSString *)key;
+
+- (void)removeAllData;
+
+- (BOOL)containsDataForKey:(NSString *)key;
+
+/*! Returns the space used by the engine contents, in bytes.
+ */
+- (unsigned long long)contentsSize;
+
+/*! Reads status of the entry for the given key. Returns NO if there is no such entry.
+ */
+- (BOOL)getStat:(DFStorageEntryStat *)stat forKey:(NSString *)key;
+
+/*! Returns identifier of the entry for the given key.
+ */
+- (NSString *)identifierForKey:(NSString *)key;
+
+/*! Enumerates identifiers and statuses of all the stored entries.
+ */
+- (void)enumerateEntriesUsingBlock:(void (^)(NSString *identifier, DFStorageEntryStat stat, BOOL *stop))block;
+
+/*! Removes the entries with the given identifiers. Used by the cleanup to evict entries found by enumeration.
+ */
+- (void)removeEntriesWithIdentifiers:(NSArray *)identifiers;
+
+@optional
+
+/*! Returns the key that the entry with the given identifier was stored with, nil if the engine can't tell (DFFileStorage and DFSlabStorage only keep the hashes of the keys). DFDiskCache exports and demotes entries of the engine by their keys, the entries of the engines that don't implement this method can't be exported or demoted.
+ */
+- (nullable NSString *)keyForIdentifier:(NSString *)identifier;
+
+/*! Returns the total length of the stored data, in bytes. Unlike contentsSize doesn't include the space wasted by the engine (partially filled blocks and slots, garbage). DFDiskCache reports contentsSize as the logical size of the engines that don't implement this method.
+ */
+- (unsigned long long)contentsLogicalSize;
+
+/*! Reads data for multiple keys at once. Engines that spread their contents across several devices can read them in parallel. Returns dictionary with key:data pairs of the found entries.
+ */
+- (NSDictionary *)dataForKeys:(NSArray *)keys;
+
+/*! Writes entries of the batch (key:data pairs) at once. Engines that support locality groups store the entries of the same group next to each other.
+ */
+- (void)setDataBatch:(NSDictionary *)batch localityGroup:(nullable NSString *)group;
+
+- (void)removeDataForKeys:(NSArray *)keys;
+
+/*! Enumerates keys that start with the given prefix. Engines that keep their keys sorted (DFLSMStorage) only read the part of the contents that contains such keys.
+ */
+- (void)enumerateKeysWithPrefix:(NSString *)prefix usingBlock:(void (^)(NSString *key, BOOL *stop))block;
+
+/*! Removes all entries which keys start with the given prefix.
+ */
+- (void)removeDataForKeysWithPrefix:(NSString *)prefix;
+
+/*! Synchronizes the engine contents with the disk.
+ */
+- (void)synchronize;
+
+/*! Called with the identifiers of the entries that engine evicted on its own (for example, to make room for the new entries). Might be called on any thread.
+ */
+@property (nullable, nonatomic, copy) void (^evictionHandler)(NSArray *identifiers);
+
+@end
+
+NS_ASSUME_NONNULL_END
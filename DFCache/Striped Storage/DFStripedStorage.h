@@ -0,0 +1,66 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import <Foundation/Foundation.h>
+#import "DFStorageEngine.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Storage engine that stripes entries across several storage engines, for example across file storages in the directories on different disks (see DFDiskCache -initWithEngine:).
+ @discussion Keys are placed on the stripes by consistent hashing: each stripe owns a number of points on the hash ring proportional to its weight, a key belongs to the stripe that owns the first point after the hash of the key. Adding or removing a stripe only remaps the keys that belong to the stripe.
+
+ Entries of the remapped keys are left in their previous stripes where they are never read again and are evicted by cleanup as the least recently used ones. Removing data for the key removes it from all stripes so that the remapped entries never resurface. Stripes are identified on the ring by their names, a removed stripe that is added back with the same name and weight gets back the same keys.
+
+ Each stripe has its own serial queue. Operations on multiple keys are split by stripe and performed on all stripes in parallel, operations on a single key are performed on the calling thread. Entry identifiers are the identifiers of the stripe engines prefixed with the tag of the stripe.
+ */
+@interface DFStripedStorage : NSObject <DFStorageEngine>
+
+/*! Initializes storage with a file storage in each of the given directories. Directory paths are used as the names of the stripes, all stripes have the same weight.
+ @param error A pointer to an error object. If an error occurs while creating storage directory, the pointer is set to the file system error (see NSFileManager).
+ */
+- (nullable instancetype)initWithPaths:(NSArray *)paths error:(NSError **)error;
+
+/*! Adds file storage in the given directory as a stripe named after the directory path.
+ @param weight Relative share of the keys that the stripe gets, for example capacity of the disk in terabytes. Must be greater than 0.
+ */
+- (BOOL)addStripeWithPath:(NSString *)path weight:(double)weight error:(NSError **)error;
+
+/*! Adds storage engine as a stripe with the given name. Replaces the stripe with the same name if there is one.
+ @param weight Relative share of the keys that the stripe gets. Must be greater than 0.
+ */
+- (void)addStripeWithName:(NSString *)name engine:(id<DFStorageEngine>)engine weight:(double)weight;
+
+/*! Removes the stripe with the given name from the ring. The keys of the stripe are remapped to the remaining stripes. Contents of the stripe engine are left intact.
+ */
+- (void)removeStripeWithName:(NSString *)name;
+
+/*! Returns names of the stripes.
+ */
+@property (nonatomic, readonly) NSArray *stripeNames;
+
+/*! Returns the engine of the stripe with the given name.
+ */
+- (nullable id<DFStorageEngine>)engineForStripeWithName:(NSString *)name;
+
+/*! Returns the name of the stripe that the given key belongs to.
+ */
+- (nullable NSString *)stripeNameForKey:(NSString *)key;
+
+/*! Reads data for the given keys on all stripes in parallel. Returns dictionary with key:data pairs of the found entries.
+ */
+- (NSDictionary *)dataForKeys:(NSArray *)keys;
+
+- (void)removeDataForKeys:(NSArray *)keys;
+
+/*! Synchronizes the stripe engines that support it.
+ */
+- (void)synchronize;
+
+/*! Called with the identifiers of the entries that the stripe engines evicted on their own.
+ */
+@property (nullable, nonatomic, copy) void (^evictionHandler)(NSArray *identifiers);
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,457 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFFileStorage.h"
+#import "DFStripedStorage.h"
+
+/*! Number of points on the hash ring per unit of stripe weight. More points give more even distribution of the keys.
+ */
+static const double DFStripedStoragePointsPerWeight = 160.0;
+static const NSUInteger DFStripedStorageMaximumPointCount = 160 * 1024;
+
+/*! Length of the stripe tag prefix of the entry identifiers: 8 hex digits followed by the separator.
+ */
+static const NSUInteger DFStripedStorageTagLength = 9;
+
+/*! Seeded 64-bit FNV-1a followed by the MurmurHash3 finalizer so that the hashes with different seeds are independent.
+ */
+static uint64_t _DFStripedStorageHash(const uint8_t *bytes, size_t length, uint64_t seed) {
+    uint64_t hash = 14695981039346656037ull ^ (seed * 0x9E3779B97F4A7C15ull);
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static uint64_t _DFStripedStorageStringHash(NSString *string, uint64_t seed) {
+    const char *bytes = [string UTF8String];
+    return _DFStripedStorageHash((const uint8_t *)bytes, strlen(bytes), seed);
+}
+
+typedef struct {
+    uint64_t hash;
+    uint32_t stripeIndex;
+} _DFStripedStorageRingPoint;
+
+
+@interface _DFStripe : NSObject {
+    @public
+    NSString *_name;
+    id<DFStorageEngine> _engine;
+    double _weight;
+    uint32_t _tag;
+    dispatch_queue_t _queue;
+}
+@end
+
+@implementation _DFStripe
+@end
+
+
+@implementation DFStripedStorage {
+    /*! Stripes and the hash ring which point to them by index. Both are immutable and replaced together under the lock.
+     */
+    NSArray *_stripes;
+    NSData *_ring;
+    NSLock *_lock;
+}
+
+- (instancetype)init {
+    if (self = [super init]) {
+        _stripes = @[];
+        _ring = [NSData data];
+        _lock = [NSLock new];
+    }
+    return self;
+}
+
+- (instancetype)initWithPaths:(NSArray *)paths error:(NSError *__autoreleasing *)error {
+    if (self = [self init]) {
+        for (NSString *path in paths) {
+            if (![self addStripeWithPath:path weight:1.0 error:error]) {
+                return nil;
+            }
+        }
+    }
+    return self;
+}
+
+#pragma mark - Stripes
+
+- (BOOL)addStripeWithPath:(NSString *)path weight:(double)weight error:(NSError *__autoreleasing *)error {
+    DFFileStorage *storage = [[DFFileStorage alloc] initWithPath:path error:error];
+    if (!storage) {
+        return NO;
+    }
+    [self addStripeWithName:path engine:storage weight:weight];
+    return YES;
+}
+
+- (void)addStripeWithName:(NSString *)name engine:(id<DFStorageEngine>)engine weight:(double)weight {
+    if (!name.length || !engine) {
+        [NSException raise:NSInvalidArgumentException format:@"Attempting to add stripe without a name or an engine"];
+    }
+    if (!(weight > 0.0)) {
+        [NSException raise:NSInvalidArgumentException format:@"Attempting to add stripe with invalid weight %f", weight];
+    }
+    _DFStripe *stripe = [_DFStripe new];
+    stripe->_name = [name copy];
+    stripe->_engine = engine;
+    stripe->_weight = weight;
+    stripe->_tag = (uint32_t)_DFStripedStorageStringHash(name, 0);
+    stripe->_queue = dispatch_queue_create("DFStripedStorage::StripeQueue", DISPATCH_QUEUE_SERIAL);
+    if ([engine respondsToSelector:@selector(setEvictionHandler:)]) {
+        DFStripedStorage *__weak weakSelf = self;
+        uint32_t tag = stripe->_tag;
+        engine.evictionHandler = ^(NSArray *identifiers) {
+            [weakSelf _stripeWithTag:tag didEvictIdentifiers:identifiers];
+        };
+    }
+    [_lock lock];
+    NSMutableArray *stripes = [NSMutableArray new];
+    for (_DFStripe *existingStripe in _stripes) {
+        if (![existingStripe->_name isEqualToString:name]) {
+            [stripes addObject:existingStripe];
+        }
+    }
+    [stripes addObject:stripe];
+    [self _setStripes:stripes];
+    [_lock unlock];
+}
+
+- (void)removeStripeWithName:(NSString *)name {
+    [_lock lock];
+    NSMutableArray *stripes = [NSMutableArray new];
+    for (_DFStripe *stripe in _stripes) {
+        if (![stripe->_name isEqualToString:name]) {
+            [stripes addObject:stripe];
+        }
+    }
+    [self _setStripes:stripes];
+    [_lock unlock];
+}
+
+/*! Replaces stripes and rebuilds the ring. Must be called under the lock.
+ */
+- (void)_setStripes:(NSArray *)stripes {
+    NSMutableData *ring = [NSMutableData new];
+    for (uint32_t i = 0; i < stripes.count; i++) {
+        _DFStripe *stripe = stripes[i];
+        NSUInteger count = MIN(MAX((NSUInteger)llround(stripe->_weight * DFStripedStoragePointsPerWeight), 1), DFStripedStorageMaximumPointCount);
+        // Points of the stripe only depend on its name so that other stripes don't affect which keys it owns.
+        uint64_t nameHash = _DFStripedStorageStringHash(stripe->_name, 0);
+        for (NSUInteger j = 0; j < count; j++) {
+            _DFStripedStorageRingPoint point = { .hash = _DFStripedStorageHash((const uint8_t *)&nameHash, sizeof(nameHash), j + 1), .stripeIndex = i };
+            [ring appendBytes:&point length:sizeof(point)];
+        }
+    }
+    qsort_b(ring.mutableBytes, ring.length / sizeof(_DFStripedStorageRingPoint), sizeof(_DFStripedStorageRingPoint), ^int(const void *lhs, const void *rhs) {
+        const _DFStripedStorageRingPoint *point1 = lhs, *point2 = rhs;
+        if (point1->hash != point2->hash) {
+            return point1->hash < point2->hash ? -1 : 1;
+        }
+        // Ties are broken by the stripe names so that the order doesn't depend on the order in which stripes were added.
+        return [((_DFStripe *)stripes[point1->stripeIndex])->_name compare:((_DFStripe *)stripes[point2->stripeIndex])->_name];
+    });
+    _stripes = [stripes copy];
+    _ring = [ring copy];
+}
+
+- (NSArray *)stripeNames {
+    NSMutableArray *names = [NSMutableArray new];
+    for (_DFStripe *stripe in [self _stripes]) {
+        [names addObject:stripe->_name];
+    }
+    return names;
+}
+
+- (id<DFStorageEngine>)engineForStripeWithName:(NSString *)name {
+    for (_DFStripe *stripe in [self _stripes]) {
+        if ([stripe->_name isEqualToString:name]) {
+            return stripe->_engine;
+        }
+    }
+    return nil;
+}
+
+- (NSString *)stripeNameForKey:(NSString *)key {
+    _DFStripe *stripe = [self _stripeForKey:key];
+    return stripe ? stripe->_name : nil;
+}
+
+- (NSArray *)_stripes {
+    [_lock lock];
+    NSArray *stripes = _stripes;
+    [_lock unlock];
+    return stripes;
+}
+
+- (_DFStripe *)_stripeForKey:(NSString *)key {
+    if (!key) {
+        return nil;
+    }
+    [_lock lock];
+    NSArray *stripes = _stripes;
+    NSData *ring = _ring;
+    [_lock unlock];
+    return [self _stripeForKey:key stripes:stripes ring:ring];
+}
+
+- (id<DFStorageEngine>)_engineForKey:(NSString *)key {
+    _DFStripe *stripe = [self _stripeForKey:key];
+    return stripe ? stripe->_engine : nil;
+}
+
+/*! Finds the first point of the ring after the hash of the key with binary search.
+ */
+- (_DFStripe *)_stripeForKey:(NSString *)key stripes:(NSArray *)stripes ring:(NSData *)ring {
+    const _DFStripedStorageRingPoint *points = ring.bytes;
+    NSUInteger count = ring.length / sizeof(_DFStripedStorageRingPoint);
+    if (!count) {
+        return nil;
+    }
+    uint64_t hash = _DFStripedStorageStringHash(key, 0);
+    NSUInteger low = 0, high = count;
+    while (low < high) {
+        NSUInteger middle = low + (high - low) / 2;
+        if (points[middle].hash < hash) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return stripes[points[low % count].stripeIndex];
+}
+
+/*! Groups keys by the stripes they belong to. Returns dictionary with stripe index:keys pairs.
+ */
+- (NSDictionary *)_keysByStripeIndexForKeys:(NSArray *)keys stripes:(NSArray **)outStripes {
+    [_lock lock];
+    NSArray *stripes = _stripes;
+    NSData *ring = _ring;
+    [_lock unlock];
+    NSMutableDictionary *keysByStripeIndex = [NSMutableDictionary new];
+    for (NSString *key in keys) {
+        _DFStripe *stripe = [self _stripeForKey:key stripes:stripes ring:ring];
+        if (stripe) {
+            NSNumber *index = @([stripes indexOfObjectIdenticalTo:stripe]);
+            NSMutableArray *stripeKeys = keysByStripeIndex[index] ?: (keysByStripeIndex[index] = [NSMutableArray new]);
+            [stripeKeys addObject:key];
+        }
+    }
+    *outStripes = stripes;
+    return keysByStripeIndex;
+}
+
+/*! Performs block for each stripe on the queue of the stripe, waits until all stripes are done.
+ */
+- (void)_performOnStripes:(NSArray *)stripes block:(void (^)(_DFStripe *stripe))block {
+    dispatch_group_t group = dispatch_group_create();
+    for (_DFStripe *stripe in stripes) {
+        dispatch_group_async(group, stripe->_queue, ^{
+            block(stripe);
+        });
+    }
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+}
+
+#pragma mark - Read & Write
+
+- (NSData *)dataForKey:(NSString *)key {
+    return [[self _engineForKey:key] dataForKey:key];
+}
+
+- (NSDictionary *)dataForKeys:(NSArray *)keys {
+    NSArray *stripes;
+    NSDictionary *keysByStripeIndex = [self _keysByStripeIndexForKeys:keys stripes:&stripes];
+    NSMutableDictionary *batch = [NSMutableDictionary new];
+    NSLock *lock = [NSLock new];
+    NSMutableArray *readStripes = [NSMutableArray new];
+    for (NSNumber *index in keysByStripeIndex) {
+        [readStripes addObject:stripes[index.unsignedIntegerValue]];
+    }
+    [self _performOnStripes:readStripes block:^(_DFStripe *stripe) {
+        NSMutableDictionary *stripeBatch = [NSMutableDictionary new];
+        for (NSString *key in keysByStripeIndex[@([stripes indexOfObjectIdenticalTo:stripe])]) {
+            NSData *data = [stripe->_engine dataForKey:key];
+            if (data) {
+                stripeBatch[key] = data;
+            }
+        }
+        [lock lock];
+        [batch addEntriesFromDictionary:stripeBatch];
+        [lock unlock];
+    }];
+    return batch;
+}
+
+- (void)setData:(NSData *)data forKey:(NSString *)key {
+    if (data && key) {
+        [[self _engineForKey:key] setData:data forKey:key];
+    }
+}
+
+- (void)removeDataForKey:(NSString *)key {
+    if (!key) {
+        return;
+    }
+    // Entries of the remapped keys might remain in the other stripes.
+    for (_DFStripe *stripe in [self _stripes]) {
+        [stripe->_engine removeDataForKey:key];
+    }
+}
+
+- (void)removeDataForKeys:(NSArray *)keys {
+    if (!keys.count) {
+        return;
+    }
+    [self _performOnStripes:[self _stripes] block:^(_DFStripe *stripe) {
+        if ([stripe->_engine respondsToSelector:@selector(removeDataForKeys:)]) {
+            [stripe->_engine removeDataForKeys:keys];
+        } else {
+            for (NSString *key in keys) {
+                [stripe->_engine removeDataForKey:key];
+            }
+        }
+    }];
+}
+
+- (void)removeAllData {
+    [self _performOnStripes:[self _stripes] block:^(_DFStripe *stripe) {
+        [stripe->_engine removeAllData];
+    }];
+}
+
+- (BOOL)containsDataForKey:(NSString *)key {
+    return [[self _engineForKey:key] containsDataForKey:key];
+}
+
+- (unsigned long long)contentsSize {
+    unsigned long long contentsSize = 0;
+    for (_DFStripe *stripe in [self _stripes]) {
+        contentsSize += [stripe->_engine contentsSize];
+    }
+    return contentsSize;
+}
+
+- (unsigned long long)contentsLogicalSize {
+    unsigned long long contentsLogicalSize = 0;
+    for (_DFStripe *stripe in [self _stripes]) {
+        id<DFStorageEngine> engine = stripe->_engine;
+        contentsLogicalSize += [engine respondsToSelector:@selector(contentsLogicalSize)] ? [engine contentsLogicalSize] : [engine contentsSize];
+    }
+    return contentsLogicalSize;
+}
+
+- (void)synchronize {
+    [self _performOnStripes:[self _stripes] block:^(_DFStripe *stripe) {
+        if ([stripe->_engine respondsToSelector:@selector(synchronize)]) {
+            [stripe->_engine synchronize];
+        }
+    }];
+}
+
+#pragma mark - Entries
+
+- (BOOL)getStat:(DFStorageEntryStat *)stat forKey:(NSString *)key {
+    return [[self _engineForKey:key] getStat:stat forKey:key];
+}
+
+- (NSString *)identifierForKey:(NSString *)key {
+    _DFStripe *stripe = [self _stripeForKey:key];
+    return stripe ? [self _identifierWithTag:stripe->_tag stripeIdentifier:[stripe->_engine identifierForKey:key]] : key;
+}
+
+- (void)enumerateEntriesUsingBlock:(void (^)(NSString *, DFStorageEntryStat, BOOL *))block {
+    BOOL __block stop = NO;
+    for (_DFStripe *stripe in [self _stripes]) {
+        [stripe->_engine enumerateEntriesUsingBlock:^(NSString *identifier, DFStorageEntryStat stat, BOOL *stripeStop) {
+            block([self _identifierWithTag:stripe->_tag stripeIdentifier:identifier], stat, &stop);
+            *stripeStop = stop;
+        }];
+        if (stop) {
+            break;
+        }
+    }
+}
+
+- (void)removeEntriesWithIdentifiers:(NSArray *)identifiers {
+    NSArray *stripes = [self _stripes];
+    NSMutableDictionary *identifiersByTag = [NSMutableDictionary new];
+    for (NSString *identifier in identifiers) {
+        uint32_t tag;
+        if (![self _getTag:&tag fromIdentifier:identifier]) {
+            continue;
+        }
+        NSMutableArray *stripeIdentifiers = identifiersByTag[@(tag)] ?: (identifiersByTag[@(tag)] = [NSMutableArray new]);
+        [stripeIdentifiers addObject:[identifier substringFromIndex:DFStripedStorageTagLength]];
+    }
+    NSMutableArray *removalStripes = [NSMutableArray new];
+    for (_DFStripe *stripe in stripes) {
+        if (identifiersByTag[@(stripe->_tag)]) {
+            [removalStripes addObject:stripe];
+        }
+    }
+    [self _performOnStripes:removalStripes block:^(_DFStripe *stripe) {
+        [stripe->_engine removeEntriesWithIdentifiers:identifiersByTag[@(stripe->_tag)]];
+    }];
+}
+
+/*! Entries that the remapped keys left in their previous stripes can't be read by their keys, nil is returned for them.
+ */
+- (NSString *)keyForIdentifier:(NSString *)identifier {
+    uint32_t tag;
+    if (![self _getTag:&tag fromIdentifier:identifier]) {
+        return nil;
+    }
+    _DFStripe *stripe;
+    for (_DFStripe *candidate in [self _stripes]) {
+        if (candidate->_tag == tag) {
+            stripe = candidate;
+            break;
+        }
+    }
+    if (![stripe->_engine respondsToSelector:@selector(keyForIdentifier:)]) {
+        return nil;
+    }
+    NSString *key = [stripe->_engine keyForIdentifier:[identifier substringFromIndex:DFStripedStorageTagLength]];
+    return [self _stripeForKey:key] == stripe ? key : nil;
+}
+
+- (NSString *)_identifierWithTag:(uint32_t)tag stripeIdentifier:(NSString *)identifier {
+    return [NSString stringWithFormat:@"%08x:%@", tag, identifier];
+}
+
+- (BOOL)_getTag:(uint32_t *)tag fromIdentifier:(NSString *)identifier {
+    if (identifier.length < DFStripedStorageTagLength || [identifier characterAtIndex:DFStripedStorageTagLength - 1] != ':') {
+        return NO;
+    }
+    *tag = (uint32_t)strtoul([[identifier substringToIndex:DFStripedStorageTagLength - 1] UTF8String], NULL, 16);
+    return YES;
+}
+
+- (void)_stripeWithTag:(uint32_t)tag didEvictIdentifiers:(NSArray *)identifiers {
+    void (^handler)(NSArray *) = self.evictionHandler;
+    if (handler) {
+        NSMutableArray *stripedIdentifiers = [[NSMutableArray alloc] initWithCapacity:identifiers.count];
+        for (NSString *identifier in identifiers) {
+            [stripedIdentifiers addObject:[self _identifierWithTag:tag stripeIdentifier:identifier]];
+        }
+        handler(stripedIdentifiers);
+    }
+}
+
+#pragma mark - Miscellaneous
+
+- (NSString *)debugDescription {
+    return [NSString stringWithFormat:@"<%@ %p> { stripes: %@ }", [self class], self, self.stripeNames];
+}
+
+@end
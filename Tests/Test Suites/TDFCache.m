@@ -290,6 +290,84 @@
     XCTAssertTrue([metadata[metaKey] isEqualToString:customValueMod]);
 }
 
+#pragma mark - Memory Snapshot
+
+- (void)testMemorySnapshotSaveAndRestore {
+    NSString *name = [[NSUUID UUID] UUIDString];
+    DFCache *cache = [[DFCache alloc] initWithName:name];
+    [cache setMemorySnapshotEnabled:YES];
+    
+    NSDictionary *objects;
+    [cache storeStringsWithCount:5 strings:&objects];
+    [cache saveMemorySnapshot];
+    
+    // Make sure that all previous disk IO operations finished executing.
+    XCTAssertNotNil([cache cachedDataForKey:[objects allKeys][0]]);
+    
+    DFCache *restartedCache = [[DFCache alloc] initWithName:name];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"restore"];
+    [restartedCache restoreMemorySnapshotWithCompletion:^(NSUInteger count) {
+        XCTAssertTrue(count == objects.count);
+        for (NSString *key in objects) {
+            XCTAssertEqualObjects([restartedCache.memoryCache objectForKey:key], objects[key]);
+        }
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:3.0 handler:nil];
+    [restartedCache removeAllObjects];
+}
+
+- (void)testMemorySnapshotRestoreRespectsMemoryCacheCountLimit {
+    NSString *name = [[NSUUID UUID] UUIDString];
+    DFCache *cache = [[DFCache alloc] initWithName:name];
+    [cache setMemorySnapshotEnabled:YES];
+    
+    NSDictionary *objects;
+    [cache storeStringsWithCount:40 strings:&objects];
+    [cache saveMemorySnapshot];
+    XCTAssertNotNil([cache cachedDataForKey:[objects allKeys][0]]);
+    
+    NSCache *memoryCache = [NSCache new];
+    memoryCache.countLimit = 10;
+    DFCache *restartedCache = [[DFCache alloc] initWithDiskCache:cache.diskCache memoryCache:memoryCache];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"restore"];
+    [restartedCache restoreMemorySnapshotWithCompletion:^(NSUInteger count) {
+        XCTAssertTrue(count >= 10 && count < objects.count);
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:3.0 handler:nil];
+    [restartedCache removeAllObjects];
+}
+
+- (void)testMemorySnapshotIsRestoredWhenEnabled {
+    NSString *name = [[NSUUID UUID] UUIDString];
+    DFCache *cache = [[DFCache alloc] initWithName:name];
+    [cache setMemorySnapshotEnabled:YES];
+    
+    NSDictionary *objects;
+    [cache storeStringsWithCount:5 strings:&objects];
+    [cache saveMemorySnapshot];
+    XCTAssertNotNil([cache cachedDataForKey:[objects allKeys][0]]);
+    
+    DFCache *restartedCache = [[DFCache alloc] initWithName:name];
+    [restartedCache setMemorySnapshotEnabled:YES];
+    NSString *key = [objects allKeys][0];
+    for (NSUInteger i = 0; i < 300 && ![restartedCache.memoryCache objectForKey:key]; i++) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+    XCTAssertEqualObjects([restartedCache.memoryCache objectForKey:key], objects[key]);
+    [restartedCache removeAllObjects];
+}
+
+- (void)testMemorySnapshotRestoreWithoutSnapshot {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"restore"];
+    [_cache restoreMemorySnapshotWithCompletion:^(NSUInteger count) {
+        XCTAssertTrue(count == 0);
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:3.0 handler:nil];
+}
+
 #pragma mark - Data
 
 - (void)testCachedDataForKeyAsynchronous {
@@ -0,0 +1,150 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFCache.h"
+#import "DFMemoryStorage.h"
+#import <XCTest/XCTest.h>
+
+@interface TDFCacheArchive : XCTestCase
+
+@end
+
+@implementation TDFCacheArchive {
+    NSString *_path;
+}
+
+- (void)setUp {
+    _path = [[DFDiskCache cachesDirectoryPath] stringByAppendingPathComponent:@"_tests_archive_"];
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtPath:_path error:nil];
+}
+
+- (void)testDiskCacheRoundTrip {
+    DFDiskCache *source = [[DFDiskCache alloc] initWithName:@"_tests_archive_source_"];
+    NSMutableDictionary *entries = [NSMutableDictionary new];
+    for (NSUInteger i = 0; i < 600; i++) {
+        NSString *key = [NSString stringWithFormat:@"_key_%lu", (unsigned long)i];
+        entries[key] = [self _dataWithLength:(i % 3 == 0) ? 100000 : 100];
+        [source setData:entries[key] forKey:key extendedAttributes:@{ @"_attr_key" : key }];
+    }
+    XCTAssertTrue([self _exportDiskCache:source]);
+
+    DFDiskCache *destination = [[DFDiskCache alloc] initWithName:@"_tests_archive_destination_"];
+    XCTAssertTrue([destination importContentsFromStream:[NSInputStream inputStreamWithFileAtPath:_path]]);
+    XCTAssertEqual(destination.contentsCount, 600);
+    for (NSString *key in entries) {
+        id value;
+        XCTAssertEqualObjects([destination dataForKey:key options:DFFileStorageReadOptionsNone extendedAttributeValue:&value forName:@"_attr_key"], entries[key]);
+        XCTAssertEqualObjects(value, key);
+    }
+    [source removeAllData];
+    [destination removeAllData];
+}
+
+- (void)testEngineRoundTrip {
+    DFDiskCache *source = [[DFDiskCache alloc] initWithEngine:[DFMemoryStorage new]];
+    NSData *data = [self _dataWithLength:1000];
+    [source setData:data forKey:@"_key_1" extendedAttributes:@{ @"_attr_key" : @"_attr_value" }];
+    XCTAssertTrue([self _exportDiskCache:source]);
+
+    DFDiskCache *destination = [[DFDiskCache alloc] initWithEngine:[DFMemoryStorage new]];
+    XCTAssertTrue([destination importContentsFromStream:[NSInputStream inputStreamWithFileAtPath:_path]]);
+    XCTAssertEqualObjects([destination dataForKey:@"_key_1"], data);
+    XCTAssertEqualObjects([destination extendedAttributeValueForName:@"_attr_key" key:@"_key_1"], @"_attr_value");
+}
+
+- (void)testStripedEngineRoundTrip {
+    DFStripedStorage *storage = [DFStripedStorage new];
+    [storage addStripeWithName:@"_stripe_1" engine:[DFMemoryStorage new] weight:1.0];
+    [storage addStripeWithName:@"_stripe_2" engine:[DFMemoryStorage new] weight:1.0];
+    DFDiskCache *source = [[DFDiskCache alloc] initWithEngine:storage];
+    NSMutableDictionary *entries = [NSMutableDictionary new];
+    for (NSUInteger i = 0; i < 20; i++) {
+        NSString *key = [NSString stringWithFormat:@"_key_%lu", (unsigned long)i];
+        entries[key] = [self _dataWithLength:100];
+        [source setData:entries[key] forKey:key];
+    }
+    XCTAssertTrue([self _exportDiskCache:source]);
+
+    DFDiskCache *destination = [[DFDiskCache alloc] initWithEngine:[DFMemoryStorage new]];
+    XCTAssertTrue([destination importContentsFromStream:[NSInputStream inputStreamWithFileAtPath:_path]]);
+    XCTAssertEqual(destination.contentsCount, 20);
+    for (NSString *key in entries) {
+        XCTAssertEqualObjects([destination dataForKey:key], entries[key]);
+    }
+}
+
+- (void)testExportFailsWhenEngineDoesNotKnowKeys {
+    NSString *path = [[DFDiskCache cachesDirectoryPath] stringByAppendingPathComponent:@"_tests_archive_file_storage_"];
+    DFFileStorage *storage = [[DFFileStorage alloc] initWithPath:path error:nil];
+    DFDiskCache *source = [[DFDiskCache alloc] initWithEngine:storage];
+    [source setData:[self _dataWithLength:100] forKey:@"_key_1"];
+    XCTAssertFalse([self _exportDiskCache:source]);
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+- (void)testDamagedArchiveIsRejected {
+    DFDiskCache *source = [[DFDiskCache alloc] initWithEngine:[DFMemoryStorage new]];
+    [source setData:[self _dataWithLength:1000] forKey:@"_key_1"];
+    [source setData:[self _dataWithLength:1000] forKey:@"_key_2"];
+    XCTAssertTrue([self _exportDiskCache:source]);
+
+    NSMutableData *contents = [NSMutableData dataWithContentsOfFile:_path];
+    contents.length -= 1; // Truncated end record.
+    [contents writeToFile:_path atomically:YES];
+    DFDiskCache *destination = [[DFDiskCache alloc] initWithEngine:[DFMemoryStorage new]];
+    XCTAssertFalse([destination importContentsFromStream:[NSInputStream inputStreamWithFileAtPath:_path]]);
+
+    contents = [NSMutableData dataWithContentsOfFile:_path];
+    ((uint8_t *)contents.mutableBytes)[contents.length / 2] ^= 0xFF;
+    [contents writeToFile:_path atomically:YES];
+    XCTAssertFalse([destination importContentsFromStream:[NSInputStream inputStreamWithFileAtPath:_path]]);
+}
+
+- (void)testCacheRoundTripKeepsMetadataAndTransformer {
+    DFCache *source = [[DFCache alloc] initWithName:@"_tests_archive_cache_source_"];
+    [source storeObject:@{ @"_value_key" : @"_value" } forKey:@"_key_1"];
+    [source setMetadata:@{ @"_meta_key" : @"_meta_value" } forKey:@"_key_1"];
+
+    XCTestExpectation *exportExpectation = [self expectationWithDescription:@"export"];
+    NSOutputStream *output = [NSOutputStream outputStreamToFileAtPath:_path append:NO];
+    [source exportContentsToStream:output completion:^(BOOL success) {
+        XCTAssertTrue(success);
+        [exportExpectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:5.0 handler:nil];
+    [output close];
+
+    DFCache *destination = [[DFCache alloc] initWithName:@"_tests_archive_cache_destination_"];
+    XCTestExpectation *importExpectation = [self expectationWithDescription:@"import"];
+    [destination importContentsFromStream:[NSInputStream inputStreamWithFileAtPath:_path] completion:^(BOOL success) {
+        XCTAssertTrue(success);
+        [importExpectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:5.0 handler:nil];
+
+    XCTAssertEqualObjects([destination cachedObjectForKey:@"_key_1"], @{ @"_value_key" : @"_value" });
+    XCTAssertEqualObjects([destination metadataForKey:@"_key_1"][@"_meta_key"], @"_meta_value");
+    [source removeAllObjects];
+    [destination removeAllObjects];
+}
+
+#pragma mark - Helpers
+
+- (BOOL)_exportDiskCache:(DFDiskCache *)diskCache {
+    NSOutputStream *stream = [NSOutputStream outputStreamToFileAtPath:_path append:NO];
+    BOOL success = [diskCache exportContentsToStream:stream];
+    [stream close];
+    return success;
+}
+
+- (NSData *)_dataWithLength:(NSUInteger)length {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    arc4random_buf(data.mutableBytes, length);
+    return data;
+}
+
+@end
@@ -0,0 +1,113 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFCache.h"
+#import "DFCacheBundle.h"
+#import <XCTest/XCTest.h>
+
+@interface TDFCacheBundle : XCTestCase
+
+@end
+
+@implementation TDFCacheBundle {
+    NSString *_path;
+}
+
+- (void)setUp {
+    _path = [[DFDiskCache cachesDirectoryPath] stringByAppendingPathComponent:@"_tests_bundle_"];
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtPath:_path error:nil];
+}
+
+- (void)testAllKeysAreFound {
+    DFCacheBundleBuilder *builder = [[DFCacheBundleBuilder alloc] initWithPath:_path];
+    NSMutableDictionary *entries = [NSMutableDictionary new];
+    for (NSUInteger i = 0; i < 5000; i++) {
+        NSString *key = [NSString stringWithFormat:@"_key_%lu", (unsigned long)i];
+        entries[key] = [self _dataWithLength:i % 100];
+        [builder addData:entries[key] forKey:key];
+    }
+    XCTAssertTrue([builder finish]);
+
+    DFCacheBundle *bundle = [[DFCacheBundle alloc] initWithPath:_path error:nil];
+    XCTAssertNotNil(bundle);
+    XCTAssertEqual(bundle.count, 5000);
+    for (NSString *key in entries) {
+        XCTAssertEqualObjects([bundle dataForKey:key], entries[key]);
+    }
+    XCTAssertNil([bundle dataForKey:@"_key_missing"]);
+    XCTAssertFalse([bundle containsDataForKey:@"_key_5000"]);
+
+    NSMutableSet *keys = [NSMutableSet new];
+    [bundle enumerateKeysUsingBlock:^(NSString *key, BOOL *stop) {
+        [keys addObject:key];
+    }];
+    XCTAssertEqualObjects(keys, [NSSet setWithArray:entries.allKeys]);
+}
+
+- (void)testExtendedAttributesAndDuplicateKeys {
+    DFCacheBundleBuilder *builder = [[DFCacheBundleBuilder alloc] initWithPath:_path];
+    NSData *data = [self _dataWithLength:100];
+    [builder addData:[self _dataWithLength:10] forKey:@"_key_1"];
+    [builder addData:data forKey:@"_key_1" extendedAttributes:@{ @"_attr_key" : @"_attr_value" }];
+    XCTAssertEqual(builder.count, 1);
+    XCTAssertTrue([builder finish]);
+
+    DFCacheBundle *bundle = [[DFCacheBundle alloc] initWithPath:_path error:nil];
+    id value;
+    XCTAssertEqualObjects([bundle dataForKey:@"_key_1" extendedAttributeValue:&value forName:@"_attr_key"], data);
+    XCTAssertEqualObjects(value, @"_attr_value");
+}
+
+- (void)testDamagedBundleIsRejected {
+    DFCacheBundleBuilder *builder = [[DFCacheBundleBuilder alloc] initWithPath:_path];
+    [builder addData:[self _dataWithLength:100] forKey:@"_key_1"];
+    XCTAssertTrue([builder finish]);
+
+    NSMutableData *contents = [NSMutableData dataWithContentsOfFile:_path];
+    ((uint8_t *)contents.mutableBytes)[contents.length - 1] ^= 0xFF;
+    [contents writeToFile:_path atomically:YES];
+    NSError *error;
+    XCTAssertNil([[DFCacheBundle alloc] initWithPath:_path error:&error]);
+    XCTAssertEqual(error.code, NSFileReadCorruptFileError);
+}
+
+- (void)testCacheReadsFromMountedBundle {
+    DFCacheBundleBuilder *builder = [[DFCacheBundleBuilder alloc] initWithPath:_path];
+    [builder addObject:@{ @"_value_key" : @"_value" } forKey:@"_key_1" valueTransformerFactory:[DFValueTransformerFactory defaultFactory]];
+    NSData *data = [self _dataWithLength:100];
+    [builder addData:data forKey:@"_key_2"];
+    XCTAssertTrue([builder finish]);
+
+    DFCache *cache = [[DFCache alloc] initWithName:@"_tests_bundle_cache_"];
+    [cache mountBundle:[[DFCacheBundle alloc] initWithPath:_path error:nil]];
+    XCTAssertEqual(cache.bundles.count, 1);
+    XCTAssertEqualObjects([cache cachedObjectForKey:@"_key_1"], @{ @"_value_key" : @"_value" });
+    XCTAssertEqualObjects([cache cachedDataForKey:@"_key_2"], data);
+    XCTAssertFalse([cache.diskCache containsDataForKey:@"_key_2"]);
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"read"];
+    [cache.memoryCache removeAllObjects];
+    [cache cachedObjectForKey:@"_key_1" completion:^(id object) {
+        XCTAssertEqualObjects(object, @{ @"_value_key" : @"_value" });
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:2.0 handler:nil];
+
+    [cache unmountBundle:cache.bundles.firstObject];
+    XCTAssertNil([cache cachedDataForKey:@"_key_2"]);
+    [cache removeAllObjects];
+}
+
+#pragma mark - Helpers
+
+- (NSData *)_dataWithLength:(NSUInteger)length {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    arc4random_buf(data.mutableBytes, length);
+    return data;
+}
+
+@end
@@ -0,0 +1,215 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFCache.h"
+#import <XCTest/XCTest.h>
+#import <sys/socket.h>
+#import <sys/un.h>
+#import <unistd.h>
+
+/*! Server and clients run in the same process and talk over a real Unix domain socket.
+ */
+@interface TDFCacheServer : XCTestCase
+
+@end
+
+@implementation TDFCacheServer {
+    DFCache *_cache;
+    DFCacheServer *_server;
+    NSString *_socketPath;
+}
+
+- (void)setUp {
+    [super setUp];
+
+    static NSUInteger _index = 0;
+
+    NSString *cacheName = [NSString stringWithFormat:@"_dt_cache_server_testcase_%lu", (unsigned long)_index];
+    _cache = [[DFCache alloc] initWithName:cacheName memoryCache:[NSCache new]];
+    _index++;
+    _socketPath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"_tests_dfcached.sock"];
+    _server = [[DFCacheServer alloc] initWithCache:_cache socketPath:_socketPath];
+    NSError *error;
+    XCTAssertTrue([_server startWithError:&error], @"%@", error);
+}
+
+- (void)tearDown {
+    [super tearDown];
+
+    [_server stop];
+    [_cache removeAllObjects];
+    _cache = nil;
+}
+
+- (void)testStoreAndReadObjects {
+    DFCacheClient *client1 = [self _client];
+    DFCacheClient *client2 = [self _client];
+    [client1 storeObject:@{ @"key" : @"value" } forKey:@"_key"];
+    [client1 cachedDataForKey:@"_key"]; // Waits for the write, connections are served independently
+    XCTAssertEqualObjects([client2 cachedObjectForKey:@"_key"], (@{ @"key" : @"value" }));
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"read"];
+    [client1 removeObjectForKey:@"_key"];
+    [client1 cachedDataForKey:@"_key"];
+    [client2.memoryCache removeAllObjects];
+    [client2 cachedObjectForKey:@"_key" completion:^(id object) {
+        XCTAssertNil(object);
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:3.0 handler:nil];
+}
+
+- (void)testStoreAndReadData {
+    DFCacheClient *client = [self _client];
+    NSData *data = [self _dataWithLength:100000];
+    [client storeData:data forKey:@"_key"];
+    XCTAssertEqualObjects([client cachedDataForKey:@"_key"], data);
+    XCTAssertEqualObjects([_cache cachedDataForKey:@"_key"], data);
+    XCTAssertNil([client cachedDataForKey:@"_missing_key"]);
+}
+
+- (void)testPipelinedRequestsAreExecutedInOrder {
+    DFCacheClient *client = [self _client];
+    NSMutableArray *keys = [NSMutableArray new];
+    for (NSUInteger i = 0; i < 100; i++) {
+        NSString *key = [NSString stringWithFormat:@"_key_%lu", (unsigned long)i];
+        [client storeData:[key dataUsingEncoding:NSUTF8StringEncoding] forKey:key];
+        [client removeObjectForKey:key];
+        [client storeData:[key dataUsingEncoding:NSUTF8StringEncoding] forKey:key];
+        [keys addObject:key];
+    }
+    [keys addObject:@"_missing_key"];
+    NSDictionary *batch = [client batchCachedDataForKeys:keys];
+    XCTAssertEqual(batch.count, 100);
+    for (NSString *key in batch) {
+        XCTAssertEqualObjects(batch[key], [key dataUsingEncoding:NSUTF8StringEncoding]);
+    }
+}
+
+- (void)testBatchReadObjects {
+    DFCacheClient *client1 = [self _client];
+    DFCacheClient *client2 = [self _client];
+    [client1 storeObject:@"value_1" forKey:@"_key_1"];
+    [client1 storeObject:@"value_2" forKey:@"_key_2"];
+    [client1 cachedDataForKey:@"_key_2"]; // Waits for the writes
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"batch"];
+    [client2 batchCachedObjectsForKeys:@[ @"_key_1", @"_key_2", @"_key_3" ] completion:^(NSDictionary *batch) {
+        XCTAssertEqualObjects(batch, (@{ @"_key_1" : @"value_1", @"_key_2" : @"value_2" }));
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:3.0 handler:nil];
+}
+
+- (void)testMetadata {
+    DFCacheClient *client = [self _client];
+    [client storeObject:@"value" forKey:@"_key"];
+    [client setMetadata:@{ @"revalidated" : @YES } forKey:@"_key"];
+    XCTAssertEqualObjects([client metadataForKey:@"_key"][@"revalidated"], @YES);
+    [client removeMetadataForKey:@"_key"];
+    XCTAssertNil([client metadataForKey:@"_key"]);
+}
+
+- (void)testClientFailsWhenServerStops {
+    DFCacheClient *client = [self _client];
+    [client storeData:[self _dataWithLength:100] forKey:@"_key"];
+    XCTAssertNotNil([client cachedDataForKey:@"_key"]);
+    [_server stop];
+    for (NSUInteger i = 0; i < 300 && client.connected; i++) {
+        [NSThread sleepForTimeInterval:0.01];
+    }
+    XCTAssertFalse(client.connected);
+    XCTAssertNil([client cachedDataForKey:@"_key"]);
+    XCTAssertNil([[DFCacheClient alloc] initWithSocketPath:_socketPath error:nil]);
+}
+
+- (void)testRequestsFailWhenServerDoesNotRespond {
+    // Listening socket that never accepts, connections wait in the backlog.
+    NSString *socketPath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"_tests_silent.sock"];
+    int fd = [self _socket];
+    struct sockaddr_un address = [self _addressWithPath:socketPath];
+    unlink(address.sun_path);
+    XCTAssertEqual(bind(fd, (struct sockaddr *)&address, sizeof(address)), 0);
+    XCTAssertEqual(listen(fd, 4), 0);
+
+    DFCacheClient *client = [[DFCacheClient alloc] initWithSocketPath:socketPath error:nil];
+    XCTAssertNotNil(client);
+    client.requestTimeout = 0.2;
+    XCTestExpectation *expectation = [self expectationWithDescription:@"read"];
+    [client cachedDataForKey:@"_key_1" completion:^(NSData *data) {
+        XCTAssertNil(data);
+        [expectation fulfill];
+    }];
+    XCTAssertNil([client cachedDataForKey:@"_key_2"]);
+    [self waitForExpectationsWithTimeout:3.0 handler:nil];
+    XCTAssertFalse(client.connected);
+    close(fd);
+    unlink(address.sun_path);
+}
+
+- (void)testServerClosesConnectionWithInvalidFrame {
+    int fd = [self _socket];
+    struct sockaddr_un address = [self _addressWithPath:_socketPath];
+    XCTAssertEqual(connect(fd, (struct sockaddr *)&address, sizeof(address)), 0);
+    // Frame length is checked as soon as the header arrives, the payload is never sent.
+    uint8_t header[] = { 0xff, 0xff, 0xff, 0xff, 1 /* Get */ };
+    XCTAssertEqual(write(fd, header, sizeof(header)), (ssize_t)sizeof(header));
+    struct timeval timeout = { .tv_sec = 3 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    uint8_t byte;
+    XCTAssertEqual(read(fd, &byte, 1), 0);
+    close(fd);
+}
+
+- (void)testServerAnswersMalformedMetadataWithError {
+    int fd = [self _socket];
+    struct sockaddr_un address = [self _addressWithPath:_socketPath];
+    XCTAssertEqual(connect(fd, (struct sockaddr *)&address, sizeof(address)), 0);
+    // SetMetadata with the key "_key" and the archive that NSKeyedUnarchiver can't read.
+    uint8_t frame[] = { 17, 0, 0, 0, 6 /* SetMetadata */, 4, 0, 0, 0, '_', 'k', 'e', 'y', 4, 0, 0, 0, 0xde, 0xad, 0xbe, 0xef };
+    XCTAssertEqual(write(fd, frame, sizeof(frame)), (ssize_t)sizeof(frame));
+    struct timeval timeout = { .tv_sec = 3 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    uint8_t response[5];
+    XCTAssertEqual(recv(fd, response, sizeof(response), MSG_WAITALL), (ssize_t)sizeof(response));
+    XCTAssertEqual(response[0], 1);
+    XCTAssertEqual(response[4], 2 /* Error */);
+    close(fd);
+    // Server is still running.
+    DFCacheClient *client = [self _client];
+    [client storeData:[self _dataWithLength:100] forKey:@"_key"];
+    XCTAssertNotNil([client cachedDataForKey:@"_key"]);
+}
+
+#pragma mark - Helpers
+
+- (int)_socket {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    XCTAssertTrue(fd >= 0);
+    return fd;
+}
+
+- (struct sockaddr_un)_addressWithPath:(NSString *)path {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    address.sun_len = sizeof(address);
+    strlcpy(address.sun_path, path.fileSystemRepresentation, sizeof(address.sun_path));
+    return address;
+}
+
+- (DFCacheClient *)_client {
+    NSError *error;
+    DFCacheClient *client = [[DFCacheClient alloc] initWithSocketPath:_socketPath error:&error];
+    XCTAssertNotNil(client, @"%@", error);
+    return client;
+}
+
+- (NSData *)_dataWithLength:(NSUInteger)length {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    arc4random_buf(data.mutableBytes, length);
+    return data;
+}
+
+@end
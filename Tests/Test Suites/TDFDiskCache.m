@@ -3,6 +3,7 @@
 // Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
 
 #import "DFDiskCache.h"
+#import "NSURL+DFExtendedFileAttributes.h"
 #import <XCTest/XCTest.h>
 
 @interface TDFDiskCache : XCTestCase
@@ -50,6 +51,342 @@
     XCTAssertTrue([_diskCache containsDataForKey:keys[1]]);
 }
 
+- (void)testRemoveMultipleUpdatesIndex {
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5f]];
+    NSArray *keys = @[ @"_key_1", @"_key_2", @"_key_3" ];
+    for (NSString *key in keys) {
+        [_diskCache setData:[self _dataWithLength:100000] forKey:key];
+    }
+    [_diskCache removeDataForKeys:@[ keys[0], keys[1] ]];
+    XCTAssertFalse([_diskCache containsDataForKey:keys[0]]);
+    XCTAssertFalse([_diskCache containsDataForKey:keys[1]]);
+    XCTAssertEqual(_diskCache.contentsLogicalSize, 100000);
+    
+    // Removals are recorded in the journal.
+    DFDiskCache *diskCache = [[DFDiskCache alloc] initWithPath:_diskCache.path error:nil];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5f]];
+    XCTAssertEqual(diskCache.contentsLogicalSize, 100000);
+}
+
+- (void)testGhostHitsAreCountedForEvictedEntries {
+    unsigned long long length = 400000;
+    _diskCache.capacity = length + 10000;
+    _diskCache.cleanupRate = 1.f; // Only one should remain.
+    
+    NSArray *keys = @[ @"_key_1", @"_key_2", @"_key_3" ];
+    for (NSString *key in keys) {
+        [_diskCache setData:[self _dataWithLength:length] forKey:key];
+    }
+    
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:1.1f]];
+    
+    [_diskCache dataForKey:keys[2]];
+    [_diskCache cleanup];
+    XCTAssertTrue(_diskCache.statistics.evictionCount == 2);
+    
+    XCTAssertNil([_diskCache dataForKey:keys[0]]);
+    XCTAssertNil([_diskCache dataForKey:@"_key_never_stored"]);
+    XCTAssertNotNil([_diskCache dataForKey:keys[2]]);
+    XCTAssertTrue(_diskCache.statistics.ghostHitCount == 1);
+    XCTAssertTrue(_diskCache.statistics.hitCount == 2);
+    XCTAssertTrue(_diskCache.statistics.missCount == 2);
+    
+    // Evicted entry counts as a ghost hit only once.
+    XCTAssertNil([_diskCache dataForKey:keys[0]]);
+    XCTAssertTrue(_diskCache.statistics.ghostHitCount == 1);
+    
+    [_diskCache resetStatistics];
+    XCTAssertTrue(_diskCache.statistics.missCount == 0);
+}
+
+- (void)testGhostListCapacity {
+    _diskCache.capacity = 1;
+    _diskCache.cleanupRate = 0.f;
+    _diskCache.ghostListCapacity = 1;
+    
+    NSArray *keys = @[ @"_key_1", @"_key_2" ];
+    for (NSString *key in keys) {
+        [_diskCache setData:[self _dataWithLength:1000] forKey:key];
+    }
+    [_diskCache cleanup];
+    XCTAssertTrue(_diskCache.statistics.evictionCount == 2);
+    
+    [_diskCache dataForKey:keys[0]];
+    [_diskCache dataForKey:keys[1]];
+    XCTAssertTrue(_diskCache.statistics.ghostHitCount == 1);
+}
+
+- (void)testGhostListIsSafeToUseConcurrently {
+    _diskCache.capacity = 1;
+    _diskCache.cleanupRate = 0.f;
+    NSMutableArray *keys = [NSMutableArray new];
+    for (NSUInteger i = 0; i < 100; i++) {
+        [keys addObject:[NSString stringWithFormat:@"_key_%lu", (unsigned long)i]];
+        [_diskCache setData:[self _dataWithLength:100] forKey:keys.lastObject];
+    }
+    [_diskCache cleanup];
+    dispatch_apply(8, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t worker) {
+        for (NSString *key in keys) {
+            [_diskCache dataForKey:key];
+            if (worker == 0) {
+                [_diskCache setData:[self _dataWithLength:100] forKey:key];
+                [_diskCache cleanup];
+            }
+        }
+    });
+    XCTAssertTrue(_diskCache.statistics.ghostHitCount >= 1);
+}
+
+- (void)testContentsSizeIsTrackedByIndex {
+    NSArray *keys = @[ @"_key_1", @"_key_2", @"_key_3" ];
+    for (NSString *key in keys) {
+        [_diskCache setData:[self _dataWithLength:100000] forKey:key];
+    }
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5f]];
+    
+    unsigned long long contentsSize = _diskCache.contentsSize;
+    XCTAssertTrue(contentsSize >= 300000);
+    
+    [_diskCache removeDataForKey:keys[0]];
+    XCTAssertTrue(_diskCache.contentsSize < contentsSize);
+}
+
+- (void)testContentsLogicalSizeIsTrackedByIndex {
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5f]];
+    [_diskCache setData:[self _dataWithLength:100001] forKey:@"_key_1"];
+    [_diskCache setData:[self _dataWithLength:1] forKey:@"_key_2"];
+    
+    XCTAssertEqual(_diskCache.contentsLogicalSize, 100002);
+    XCTAssertTrue(_diskCache.contentsSize >= _diskCache.contentsLogicalSize);
+    
+    DFDiskCache *diskCache = [[DFDiskCache alloc] initWithPath:_diskCache.path error:nil];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5f]];
+    XCTAssertEqual(diskCache.contentsLogicalSize, 100002);
+}
+
+- (void)testReconciliationDriftIsCounted {
+    [_diskCache setData:[self _dataWithLength:10000] forKey:@"_key_1"];
+    XCTAssertTrue(_diskCache.contentsSize > 0);
+    [_diskCache reconcileContents];
+    XCTAssertEqual(_diskCache.statistics.reconciliationCount, 1);
+    XCTAssertEqual(_diskCache.statistics.contentsSizeDrift, 0);
+    
+    [[self _dataWithLength:10000] writeToFile:[_diskCache pathForKey:@"_key_2"] atomically:NO];
+    [_diskCache reconcileContents];
+    XCTAssertEqual(_diskCache.statistics.reconciliationCount, 2);
+    XCTAssertTrue(_diskCache.statistics.contentsSizeDrift > 0);
+}
+
+- (void)testReconciliationCorrectsIndex {
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5f]];
+    [_diskCache setData:[self _dataWithLength:10000] forKey:@"_key_1"];
+    [_diskCache setData:[self _dataWithLength:10000] forKey:@"_key_2"];
+    XCTAssertEqual(_diskCache.contentsCount, 2);
+
+    // Storage directory is modified by other means.
+    [[NSFileManager defaultManager] removeItemAtPath:[_diskCache pathForKey:@"_key_1"] error:nil];
+    [[self _dataWithLength:20000] writeToFile:[_diskCache pathForKey:@"_key_3"] atomically:NO];
+    XCTAssertTrue([_diskCache reconcileContents] != 0);
+    XCTAssertEqual(_diskCache.contentsCount, 2);
+    XCTAssertEqual(_diskCache.contentsLogicalSize, 30000);
+    XCTAssertEqual([_diskCache reconcileContents], 0);
+}
+
+- (void)testIndexSnapshotIsReusedByNewInstance {
+    NSArray *keys = @[ @"_key_1", @"_key_2", @"_key_3" ];
+    for (NSString *key in keys) {
+        [_diskCache setData:[self _dataWithLength:100000] forKey:key];
+    }
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5f]];
+    [_diskCache cleanup];
+    unsigned long long contentsSize = _diskCache.contentsSize;
+    
+    DFDiskCache *diskCache = [[DFDiskCache alloc] initWithPath:_diskCache.path error:nil];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5f]];
+    XCTAssertTrue(diskCache.contentsSize == contentsSize);
+    for (NSString *key in keys) {
+        XCTAssertNotNil([diskCache dataForKey:key]);
+    }
+}
+
+- (void)testJournalIsReplayedByNewInstance {
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5f]];
+    
+    // Mutations made after the last checkpoint are only recorded in the journal.
+    NSArray *keys = @[ @"_key_1", @"_key_2", @"_key_3" ];
+    for (NSString *key in keys) {
+        [_diskCache setData:[self _dataWithLength:100000] forKey:key];
+    }
+    [_diskCache removeDataForKey:keys[0]];
+    unsigned long long contentsSize = _diskCache.contentsSize;
+    
+    DFDiskCache *diskCache = [[DFDiskCache alloc] initWithPath:_diskCache.path error:nil];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5f]];
+    XCTAssertTrue(diskCache.contentsSize == contentsSize);
+    XCTAssertNil([diskCache dataForKey:keys[0]]);
+    XCTAssertNotNil([diskCache dataForKey:keys[1]]);
+}
+
+- (void)testAccessTimesAreReplayedByNewInstance {
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5f]];
+    
+    NSArray *keys = @[ @"_key_1", @"_key_2" ];
+    for (NSString *key in keys) {
+        [_diskCache setData:[self _dataWithLength:100000] forKey:key];
+    }
+    [_diskCache synchronize];
+    // The entry written first is the most recently used one.
+    [_diskCache dataForKey:keys[0]];
+    [_diskCache synchronize];
+    
+    DFDiskCache *diskCache = [[DFDiskCache alloc] initWithPath:_diskCache.path error:nil];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5f]];
+    diskCache.capacity = 150000;
+    diskCache.cleanupRate = 1.f; // Only one should remain.
+    [diskCache cleanup];
+    XCTAssertNotNil([diskCache dataForKey:keys[0]]);
+    XCTAssertNil([diskCache dataForKey:keys[1]]);
+}
+
+- (void)testExtendedAttributesAreWrittenWithData {
+    [_diskCache setData:[self _dataWithLength:1000] forKey:@"_key_1" extendedAttributes:@{ @"_attr_key" : @"_attr_value" }];
+    XCTAssertNotNil([_diskCache dataForKey:@"_key_1"]);
+    XCTAssertEqualObjects([[_diskCache URLForKey:@"_key_1"] df_extendedAttributeValueForKey:@"_attr_key" error:nil], @"_attr_value");
+}
+
+- (void)testOrphanedTemporaryFilesAreRemovedDuringRecovery {
+    [_diskCache setData:[self _dataWithLength:1000] forKey:@"_key_1"];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5f]];
+    
+    // Simulate a write interrupted by a crash of the other process with no usable journal.
+    [[NSFileManager defaultManager] removeItemAtPath:_diskCache.internalDirectoryPath error:nil];
+    NSString *orphanPath = [_diskCache.path stringByAppendingPathComponent:[NSString stringWithFormat:@".tmp.%i.%@", getpid() + 1, [_diskCache filenameForKey:@"_key_2"]]];
+    [[self _dataWithLength:1000] writeToFile:orphanPath atomically:NO];
+    
+    DFDiskCache *diskCache = [[DFDiskCache alloc] initWithPath:_diskCache.path error:nil];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5f]];
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:orphanPath]);
+    XCTAssertNotNil([diskCache dataForKey:@"_key_1"]);
+    XCTAssertNil([diskCache dataForKey:@"_key_2"]);
+}
+
+- (void)testRecoveryKeepsEntriesWithoutValueTransformer {
+    [_diskCache setData:[self _dataWithLength:1000] forKey:@"_key_1" extendedAttributes:@{ @"_df_cache_value_transformer_name_key" : @"_transformer" }];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5f]];
+    
+    // Directory without the journal, data stored without the attribute (see -[DFCache storeData:forKey:]) and a temporary file of an interrupted write.
+    [[NSFileManager defaultManager] removeItemAtPath:_diskCache.internalDirectoryPath error:nil];
+    [[self _dataWithLength:1000] writeToFile:[_diskCache pathForKey:@"_key_2"] atomically:NO];
+    NSString *temporaryPath = [_diskCache.path stringByAppendingPathComponent:@".tmp.999999.orphan"];
+    [[self _dataWithLength:1000] writeToFile:temporaryPath atomically:NO];
+    
+    DFDiskCache *diskCache = [[DFDiskCache alloc] initWithPath:_diskCache.path error:nil];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5f]];
+    XCTAssertNotNil([diskCache dataForKey:@"_key_1"]);
+    XCTAssertNotNil([diskCache dataForKey:@"_key_2"]);
+    XCTAssertEqual(diskCache.contentsCount, 2);
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:temporaryPath]);
+}
+
+#pragma mark - Durability
+
+- (void)testGroupCommitServesPendingWritesFromMemory {
+    _diskCache.durability = DFDiskCacheDurabilityGroupCommit;
+    _diskCache.groupCommitInterval = 10.0;
+    
+    NSData *data = [self _dataWithLength:1000];
+    [_diskCache setData:data forKey:@"_key_1"];
+    XCTAssertTrue([_diskCache containsDataForKey:@"_key_1"]);
+    XCTAssertEqualObjects([_diskCache dataForKey:@"_key_1"], data);
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:[_diskCache pathForKey:@"_key_1"]]);
+    
+    [_diskCache synchronize];
+    XCTAssertTrue([[NSFileManager defaultManager] fileExistsAtPath:[_diskCache pathForKey:@"_key_1"]]);
+    XCTAssertEqualObjects([_diskCache dataForKey:@"_key_1"], data);
+}
+
+- (void)testGroupCommitIsTriggeredByByteThreshold {
+    _diskCache.durability = DFDiskCacheDurabilityGroupCommit;
+    _diskCache.groupCommitInterval = 10.0;
+    _diskCache.groupCommitByteThreshold = 1500;
+    
+    [_diskCache setData:[self _dataWithLength:1000] forKey:@"_key_1"];
+    [_diskCache setData:[self _dataWithLength:1000] forKey:@"_key_2"];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5f]];
+    XCTAssertTrue([[NSFileManager defaultManager] fileExistsAtPath:[_diskCache pathForKey:@"_key_1"]]);
+    XCTAssertTrue([[NSFileManager defaultManager] fileExistsAtPath:[_diskCache pathForKey:@"_key_2"]]);
+}
+
+- (void)testGroupCommitRemovePendingWrite {
+    _diskCache.durability = DFDiskCacheDurabilityGroupCommit;
+    _diskCache.groupCommitInterval = 10.0;
+    
+    [_diskCache setData:[self _dataWithLength:1000] forKey:@"_key_1"];
+    [_diskCache removeDataForKey:@"_key_1"];
+    [_diskCache synchronize];
+    XCTAssertNil([_diskCache dataForKey:@"_key_1"]);
+}
+
+- (void)testGroupCommitExtendedAttributesOfPendingWrite {
+    _diskCache.durability = DFDiskCacheDurabilityGroupCommit;
+    _diskCache.groupCommitInterval = 10.0;
+    
+    [_diskCache setData:[self _dataWithLength:1000] forKey:@"_key_1" extendedAttributes:@{ @"_attr_key" : @"_attr_value" }];
+    XCTAssertEqualObjects([[_diskCache URLForKey:@"_key_1"] df_extendedAttributeValueForKey:@"_attr_key" error:nil], @"_attr_value");
+}
+
+- (void)testPerWriteDurability {
+    _diskCache.durability = DFDiskCacheDurabilityPerWrite;
+    NSData *data = [self _dataWithLength:1000];
+    [_diskCache setData:data forKey:@"_key_1"];
+    XCTAssertTrue([[NSFileManager defaultManager] fileExistsAtPath:[_diskCache pathForKey:@"_key_1"]]);
+    XCTAssertEqualObjects([_diskCache dataForKey:@"_key_1"], data);
+}
+
+#pragma mark - Performance
+
+- (void)testWriteThroughputWithoutDurability {
+    [self _measureWriteThroughputWithDurability:DFDiskCacheDurabilityNone];
+}
+
+- (void)testWriteThroughputWithGroupCommit {
+    [self _measureWriteThroughputWithDurability:DFDiskCacheDurabilityGroupCommit];
+}
+
+- (void)testWriteThroughputWithPerWriteDurability {
+    [self _measureWriteThroughputWithDurability:DFDiskCacheDurabilityPerWrite];
+}
+
+- (void)testCleanupPerformance {
+    NSData *data = [self _dataWithLength:1024];
+    __block NSUInteger iteration = 0;
+    [self measureMetrics:[[self class] defaultPerformanceMetrics] automaticallyStartMeasuring:NO forBlock:^{
+        iteration++;
+        for (NSUInteger i = 0; i < 2000; i++) {
+            [_diskCache setData:data forKey:[NSString stringWithFormat:@"_key_%lu_%lu", (unsigned long)iteration, (unsigned long)i]];
+        }
+        _diskCache.capacity = 1;
+        _diskCache.cleanupRate = 0.f;
+        [self startMeasuring];
+        [_diskCache cleanup];
+        [self stopMeasuring];
+        XCTAssertEqual(_diskCache.contentsCount, 0);
+    }];
+}
+
+- (void)_measureWriteThroughputWithDurability:(DFDiskCacheDurability)durability {
+    _diskCache.durability = durability;
+    NSData *data = [self _dataWithLength:16384];
+    __block NSUInteger iteration = 0;
+    [self measureBlock:^{
+        iteration++;
+        for (NSUInteger i = 0; i < 200; i++) {
+            [_diskCache setData:data forKey:[NSString stringWithFormat:@"_key_%lu_%lu", (unsigned long)iteration, (unsigned long)i]];
+        }
+        [_diskCache synchronize];
+    }];
+}
+
 #pragma mark - Helpers 
 
 - (NSData *)_dataWithLength:(unsigned long long)length {
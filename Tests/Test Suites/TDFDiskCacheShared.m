@@ -0,0 +1,136 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFCache.h"
+#import <XCTest/XCTest.h>
+
+/*! Disk caches opened on the same directory within a single process coordinate the same way separate processes do: each of them opens its own descriptors of the shared index.
+ */
+@interface TDFDiskCacheShared : XCTestCase
+
+@end
+
+@implementation TDFDiskCacheShared {
+    NSString *_path;
+}
+
+- (void)setUp {
+    _path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"_tests_shared_disk_cache_"];
+    [[NSFileManager defaultManager] removeItemAtPath:_path error:nil];
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtPath:_path error:nil];
+}
+
+- (void)testContentsAreAccountedAcrossCaches {
+    DFDiskCache *cache1 = [[DFDiskCache alloc] initWithPath:_path options:DFDiskCacheOptionShared error:nil];
+    DFDiskCache *cache2 = [[DFDiskCache alloc] initWithPath:_path options:DFDiskCacheOptionShared error:nil];
+    XCTAssertTrue(cache1.shared);
+    XCTAssertTrue(cache2.shared);
+    [cache1 cleanup]; // Builds index
+
+    [cache1 setData:[self _dataWithLength:1000] forKey:@"_key_1"];
+    [cache2 setData:[self _dataWithLength:1000] forKey:@"_key_2"];
+    XCTAssertEqual(cache1.contentsCount, 2);
+    XCTAssertEqual(cache2.contentsCount, 2);
+    XCTAssertEqual(cache1.contentsSize, cache2.contentsSize);
+
+    [cache2 removeDataForKey:@"_key_1"];
+    XCTAssertEqual(cache1.contentsCount, 1);
+}
+
+- (void)testRemoveAllDataKeepsIndexShared {
+    DFDiskCache *cache1 = [[DFDiskCache alloc] initWithPath:_path options:DFDiskCacheOptionShared error:nil];
+    DFDiskCache *cache2 = [[DFDiskCache alloc] initWithPath:_path options:DFDiskCacheOptionShared error:nil];
+    [cache1 cleanup]; // Builds index
+
+    [cache1 setData:[self _dataWithLength:1000] forKey:@"_key_1"];
+    [cache2 setData:[self _dataWithLength:1000] forKey:@"_key_2"];
+    [cache1 removeAllData];
+    XCTAssertEqual(cache2.contentsCount, 0);
+    XCTAssertEqual(cache2.contentsSize, 0);
+    XCTAssertFalse([cache2 containsDataForKey:@"_key_2"]);
+
+    // Both caches still use the same index file.
+    [cache2 setData:[self _dataWithLength:1000] forKey:@"_key_3"];
+    XCTAssertEqual(cache1.contentsCount, 1);
+    XCTAssertEqual(cache1.contentsSize, cache2.contentsSize);
+    XCTAssertTrue(cache1.cleanupLeader);
+}
+
+- (void)testIndexGrowsBeyondInitialTable {
+    DFDiskCache *cache1 = [[DFDiskCache alloc] initWithPath:_path options:DFDiskCacheOptionShared error:nil];
+    DFDiskCache *cache2 = [[DFDiskCache alloc] initWithPath:_path options:DFDiskCacheOptionShared error:nil];
+    [cache1 cleanup]; // Builds index
+
+    NSUInteger count = 5000; // More than the initial table holds
+    for (NSUInteger i = 0; i < count; i++) {
+        [cache1 setData:[self _dataWithLength:10] forKey:[NSString stringWithFormat:@"_key_%lu", (unsigned long)i]];
+    }
+    XCTAssertEqual(cache2.contentsCount, count);
+    [cache2 removeDataForKey:@"_key_0"];
+    XCTAssertEqual(cache1.contentsCount, count - 1);
+    XCTAssertEqual(cache1.contentsSize, cache2.contentsSize);
+}
+
+- (void)testOnlyLeaderPerformsCleanup {
+    DFDiskCache *cache2 = [[DFDiskCache alloc] initWithPath:_path options:DFDiskCacheOptionShared error:nil];
+    @autoreleasepool {
+        DFDiskCache *cache1 = [[DFDiskCache alloc] initWithPath:_path options:DFDiskCacheOptionShared error:nil];
+        XCTAssertTrue(cache2.cleanupLeader);
+        XCTAssertFalse(cache1.cleanupLeader);
+        [cache2 cleanup];
+
+        cache1.capacity = 1;
+        cache1.cleanupRate = 0.f;
+        [cache1 setData:[self _dataWithLength:1000] forKey:@"_key_1"];
+        [cache1 cleanup];
+        XCTAssertFalse(cache1.cleanupLeader);
+        XCTAssertTrue([cache1 containsDataForKey:@"_key_1"]);
+    }
+    XCTAssertTrue(cache2.cleanupLeader);
+}
+
+- (void)testLeadershipPassesOnWhenLeaderCloses {
+    DFDiskCache *cache2;
+    @autoreleasepool {
+        DFDiskCache *cache1 = [[DFDiskCache alloc] initWithPath:_path options:DFDiskCacheOptionShared error:nil];
+        cache2 = [[DFDiskCache alloc] initWithPath:_path options:DFDiskCacheOptionShared error:nil];
+        XCTAssertTrue(cache1.cleanupLeader);
+        [cache2 cleanup];
+        XCTAssertFalse(cache2.cleanupLeader);
+        cache1 = nil;
+    }
+    [cache2 cleanup];
+    XCTAssertTrue(cache2.cleanupLeader);
+}
+
+- (void)testRecencyIsShared {
+    DFDiskCache *cache1 = [[DFDiskCache alloc] initWithPath:_path options:DFDiskCacheOptionShared error:nil];
+    DFDiskCache *cache2 = [[DFDiskCache alloc] initWithPath:_path options:DFDiskCacheOptionShared error:nil];
+    [cache1 cleanup]; // Builds index
+    for (NSUInteger i = 0; i < 4; i++) {
+        [cache1 setData:[self _dataWithLength:1000] forKey:[NSString stringWithFormat:@"_key_%lu", (unsigned long)i]];
+        [NSThread sleepForTimeInterval:0.01];
+    }
+    // The oldest entry is read by the other cache, cleanup in the leader evicts the next oldest instead.
+    XCTAssertNotNil([cache2 dataForKey:@"_key_0"]);
+    cache1.capacity = cache1.contentsSize - 1;
+    cache1.cleanupRate = 1.f; // Evicts a single entry
+    [cache1 cleanup];
+    XCTAssertTrue([cache1 containsDataForKey:@"_key_0"]);
+    XCTAssertFalse([cache1 containsDataForKey:@"_key_1"]);
+    XCTAssertEqual(cache2.contentsCount, 3);
+}
+
+#pragma mark - Helpers
+
+- (NSData *)_dataWithLength:(NSUInteger)length {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    arc4random_buf(data.mutableBytes, length);
+    return data;
+}
+
+@end
@@ -0,0 +1,137 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFCache.h"
+#import "DFMemoryStorage.h"
+#import <XCTest/XCTest.h>
+
+@interface TDFDiskCacheTiers : XCTestCase
+
+@end
+
+@implementation TDFDiskCacheTiers {
+    DFMemoryStorage *_fastStorage;
+    DFMemoryStorage *_slowStorage;
+    DFDiskCache *_fastCache;
+    DFDiskCache *_slowCache;
+}
+
+- (void)setUp {
+    _fastStorage = [DFMemoryStorage new];
+    _slowStorage = [DFMemoryStorage new];
+    _fastCache = [[DFDiskCache alloc] initWithEngine:_fastStorage];
+    _slowCache = [[DFDiskCache alloc] initWithEngine:_slowStorage];
+    _fastCache.lowerTier = _slowCache;
+}
+
+- (void)testReadsPromoteEntriesAfterThreshold {
+    NSData *data = [self _dataWithLength:100];
+    [_slowCache setData:data forKey:@"_key_1" extendedAttributes:@{ @"_attr_key" : @"_attr_value" }];
+
+    XCTAssertEqualObjects([_fastCache dataForKey:@"_key_1"], data);
+    XCTAssertFalse([_fastStorage containsDataForKey:@"_key_1"]);
+    XCTAssertEqual(_fastCache.statistics.missCount, 1);
+    XCTAssertEqual(_slowCache.statistics.hitCount, 1);
+
+    XCTAssertEqualObjects([_fastCache dataForKey:@"_key_1"], data);
+    XCTAssertTrue([_fastStorage containsDataForKey:@"_key_1"]);
+    XCTAssertFalse([_slowStorage containsDataForKey:@"_key_1"]);
+    XCTAssertEqual(_fastCache.statistics.promotionCount, 1);
+    XCTAssertEqualObjects([_fastCache extendedAttributeValueForName:@"_attr_key" key:@"_key_1"], @"_attr_value");
+}
+
+- (void)testCleanupDemotesEntries {
+    _fastCache.capacity = 5000;
+    _fastCache.cleanupRate = 0.5f;
+    NSMutableDictionary *entries = [NSMutableDictionary new];
+    for (NSUInteger i = 0; i < 10; i++) {
+        NSString *key = [NSString stringWithFormat:@"_key_%lu", (unsigned long)i];
+        entries[key] = [self _dataWithLength:1000];
+        [_fastCache setData:entries[key] forKey:key];
+    }
+    [_fastCache cleanup];
+    XCTAssertTrue(_fastCache.statistics.demotionCount > 0);
+    XCTAssertEqual(_fastCache.statistics.demotionCount, _fastCache.statistics.evictionCount);
+    XCTAssertEqual(_fastStorage.contentsCount + _slowStorage.contentsCount, 10);
+    _fastCache.promotionThreshold = 0;
+    for (NSString *key in entries) {
+        XCTAssertEqualObjects([_fastCache dataForKey:key], entries[key]);
+    }
+}
+
+- (void)testStripedTiersDemoteAndPromoteEntries {
+    DFStripedStorage *fastStorage = [DFStripedStorage new];
+    [fastStorage addStripeWithName:@"_stripe_1" engine:[DFMemoryStorage new] weight:1.0];
+    [fastStorage addStripeWithName:@"_stripe_2" engine:[DFMemoryStorage new] weight:1.0];
+    DFStripedStorage *slowStorage = [DFStripedStorage new];
+    [slowStorage addStripeWithName:@"_stripe_1" engine:[DFMemoryStorage new] weight:1.0];
+    DFDiskCache *fastCache = [[DFDiskCache alloc] initWithEngine:fastStorage];
+    DFDiskCache *slowCache = [[DFDiskCache alloc] initWithEngine:slowStorage];
+    fastCache.lowerTier = slowCache;
+    XCTAssertNotEqualObjects([fastStorage identifierForKey:@"_key_1"], @"_key_1");
+
+    fastCache.capacity = 1;
+    fastCache.cleanupRate = 0.f;
+    NSMutableDictionary *entries = [NSMutableDictionary new];
+    for (NSUInteger i = 0; i < 10; i++) {
+        NSString *key = [NSString stringWithFormat:@"_key_%lu", (unsigned long)i];
+        entries[key] = [self _dataWithLength:1000];
+        [fastCache setData:entries[key] forKey:key];
+    }
+    [fastCache cleanup];
+    XCTAssertEqual(fastCache.contentsCount, 0);
+    XCTAssertEqual(slowCache.contentsCount, 10);
+    XCTAssertEqual(fastCache.statistics.demotionCount, 10);
+    for (NSString *key in entries) {
+        XCTAssertTrue([slowStorage containsDataForKey:key]);
+    }
+
+    fastCache.promotionThreshold = 1;
+    XCTAssertEqualObjects([fastCache dataForKey:@"_key_1"], entries[@"_key_1"]);
+    XCTAssertTrue([fastStorage containsDataForKey:@"_key_1"]);
+    XCTAssertFalse([slowStorage containsDataForKey:@"_key_1"]);
+}
+
+- (void)testLargeValuesBypassUpperTier {
+    _fastCache.largeValueThreshold = 500;
+    NSData *data = [self _dataWithLength:1000];
+    [_fastCache setData:[self _dataWithLength:100] forKey:@"_key_1"];
+    [_fastCache setData:data forKey:@"_key_1"];
+    XCTAssertFalse([_fastStorage containsDataForKey:@"_key_1"]);
+    XCTAssertTrue([_slowStorage containsDataForKey:@"_key_1"]);
+    XCTAssertEqualObjects([_fastCache dataForKey:@"_key_1"], data);
+    XCTAssertEqualObjects([_fastCache dataForKey:@"_key_1"], data);
+    XCTAssertFalse([_fastStorage containsDataForKey:@"_key_1"]);
+}
+
+- (void)testFileTiersDemoteAndRemove {
+    DFDiskCache *fastCache = [[DFDiskCache alloc] initWithName:@"_tests_tiers_fast_"];
+    DFDiskCache *slowCache = [[DFDiskCache alloc] initWithName:@"_tests_tiers_slow_"];
+    DFCache *cache = [[DFCache alloc] initWithDiskCaches:@[ fastCache, slowCache ] memoryCache:nil];
+    XCTAssertTrue(fastCache.lowerTier == slowCache);
+    fastCache.capacity = 1;
+    fastCache.cleanupRate = 0.f;
+    NSData *data = [self _dataWithLength:10000];
+    [fastCache setData:data forKey:@"_key_1" extendedAttributes:@{ @"_attr_key" : @"_attr_value" }];
+    [fastCache cleanup];
+    XCTAssertEqual(fastCache.contentsCount, 0);
+    XCTAssertEqual(slowCache.contentsCount, 1);
+    XCTAssertEqualObjects([cache cachedDataForKey:@"_key_1"], data);
+    XCTAssertEqualObjects([fastCache extendedAttributeValueForName:@"_attr_key" key:@"_key_1"], @"_attr_value");
+
+    [fastCache removeDataForKey:@"_key_1"];
+    XCTAssertFalse([fastCache containsDataForKey:@"_key_1"]);
+    XCTAssertEqual(slowCache.contentsCount, 0);
+    [fastCache removeAllData];
+}
+
+#pragma mark - Helpers
+
+- (NSData *)_dataWithLength:(NSUInteger)length {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    arc4random_buf(data.mutableBytes, length);
+    return data;
+}
+
+@end
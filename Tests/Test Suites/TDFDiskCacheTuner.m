@@ -0,0 +1,97 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFDiskCache.h"
+#import "DFDiskCacheTuner.h"
+#import <XCTest/XCTest.h>
+
+@interface TDFDiskCacheTuner : XCTestCase
+
+@end
+
+@implementation TDFDiskCacheTuner {
+    DFDiskCache *_diskCache;
+}
+
+- (void)setUp {
+    NSString *path = [[DFDiskCache cachesDirectoryPath] stringByAppendingPathComponent:@"_tests_"];
+    _diskCache = [[DFDiskCache alloc] initWithPath:path error:nil];
+}
+
+- (void)tearDown {
+    [_diskCache removeAllData];
+}
+
+- (void)testInitializationWithInvalidBoundsThrowsException {
+    XCTAssertThrowsSpecificNamed([[DFDiskCacheTuner alloc] initWithMinimumCapacity:100 maximumCapacity:10], NSException, NSInvalidArgumentException);
+}
+
+- (void)testTunerGrowsCapacityOnGhostHits {
+    DFDiskCacheTuner *tuner = [[DFDiskCacheTuner alloc] initWithMinimumCapacity:1000 maximumCapacity:100000];
+    tuner.minimumSampleCount = 1;
+    _diskCache.tuner = tuner;
+    _diskCache.capacity = 1000;
+    _diskCache.cleanupRate = 0.5f;
+
+    NSArray *keys = @[ @"_key_1", @"_key_2", @"_key_3" ];
+    for (NSString *key in keys) {
+        [_diskCache setData:[self _dataWithLength:2000] forKey:key];
+    }
+    [_diskCache cleanup];
+    for (NSString *key in keys) {
+        XCTAssertNil([_diskCache dataForKey:key]);
+    }
+    XCTAssertTrue(_diskCache.statistics.ghostHitCount == keys.count);
+
+    [tuner tuneDiskCache:_diskCache];
+    XCTAssertTrue(_diskCache.capacity > 1000);
+    XCTAssertTrue(_diskCache.capacity <= 100000);
+    XCTAssertEqualWithAccuracy(_diskCache.cleanupRate, tuner.minimumCleanupRate + 0.05f, 0.001f);
+}
+
+- (void)testTunerShrinksCapacityWhenTargetIsReached {
+    DFDiskCacheTuner *tuner = [[DFDiskCacheTuner alloc] initWithMinimumCapacity:1000 maximumCapacity:100000];
+    tuner.minimumSampleCount = 1;
+    tuner.targetHitRatio = 0.5f;
+    _diskCache.capacity = 50000;
+    _diskCache.cleanupRate = 0.8f;
+
+    [_diskCache setData:[self _dataWithLength:100] forKey:@"_key_1"];
+    for (NSUInteger i = 0; i < 10; i++) {
+        XCTAssertNotNil([_diskCache dataForKey:@"_key_1"]);
+    }
+    [tuner tuneDiskCache:_diskCache];
+    XCTAssertTrue(_diskCache.capacity < 50000);
+    XCTAssertEqualWithAccuracy(_diskCache.cleanupRate, 0.75f, 0.001f);
+}
+
+- (void)testTunerRespectsByteBudget {
+    DFDiskCacheTuner *tuner = [[DFDiskCacheTuner alloc] initWithMinimumCapacity:1000 maximumCapacity:100000];
+    tuner.minimumSampleCount = 1;
+    tuner.byteBudget = 5000;
+    _diskCache.capacity = 20000;
+
+    XCTAssertNil([_diskCache dataForKey:@"_key_1"]);
+    [tuner tuneDiskCache:_diskCache];
+    XCTAssertTrue(_diskCache.capacity == 5000);
+}
+
+- (void)testTunerWaitsForEnoughSamples {
+    DFDiskCacheTuner *tuner = [[DFDiskCacheTuner alloc] initWithMinimumCapacity:1000 maximumCapacity:100000];
+    tuner.byteBudget = 5000;
+    _diskCache.capacity = 20000;
+
+    XCTAssertNil([_diskCache dataForKey:@"_key_1"]);
+    [tuner tuneDiskCache:_diskCache];
+    XCTAssertTrue(_diskCache.capacity == 20000);
+}
+
+#pragma mark - Helpers
+
+- (NSData *)_dataWithLength:(unsigned long long)length {
+    void *raw = malloc(length);
+    return [NSData dataWithBytesNoCopy:raw length:length];
+}
+
+@end
@@ -4,6 +4,7 @@
 
 #import "DFFileStorage.h"
 #import "DFDiskCache.h"
+#import "NSURL+DFExtendedFileAttributes.h"
 #import <XCTest/XCTest.h>
 
 @interface TDFFileStorage : XCTestCase
@@ -44,6 +45,20 @@
     XCTAssertNil([_storage dataForKey:key]);
 }
 
+- (void)testRemoveMultiple {
+    NSMutableArray *keys = [NSMutableArray new];
+    for (NSUInteger i = 0; i < 20; i++) {
+        NSString *key = [NSString stringWithFormat:@"_key_%lu", (unsigned long)i];
+        [_storage setData:[self _tempData] forKey:key];
+        [keys addObject:key];
+    }
+    [_storage removeDataForKeys:[keys subarrayWithRange:NSMakeRange(0, 15)]];
+    for (NSUInteger i = 0; i < keys.count; i++) {
+        XCTAssertEqual([_storage containsDataForKey:keys[i]], i >= 15);
+    }
+    XCTAssertEqual(_storage.contentsCount, 5);
+}
+
 - (void)testRemoveAll {
     NSData *data = [self _tempData];
     NSString *key = @"_key";
@@ -65,6 +80,28 @@
     XCTAssertNotNil([_storage dataForKey:key]);
 }
 
+- (void)testRemoveAllWhileWriting {
+    NSData *data = [self _tempData];
+    dispatch_group_t group = dispatch_group_create();
+    dispatch_group_async(group, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        for (NSUInteger i = 0; i < 200; i++) {
+            NSString *key = [NSString stringWithFormat:@"_key_%lu", (unsigned long)i];
+            [_storage setData:data forKey:key];
+            [_storage dataForKey:key];
+        }
+    });
+    for (NSUInteger i = 0; i < 20; i++) {
+        [_storage removeAllData];
+    }
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    
+    // Storage directory descriptor stays valid after the directory is recreated.
+    [_storage removeAllData];
+    [_storage setData:data forKey:@"_key"];
+    XCTAssertEqualObjects([_storage dataForKey:@"_key"], data);
+    XCTAssertEqual([_storage contentsWithResourceKeys:nil].count, 1);
+}
+
 - (void)testContains {
     NSData *data = [self _tempData];
     NSString *key = @"_key";
@@ -111,6 +148,353 @@
     }
 }
 
+- (void)testContentsSizeMatchesContents {
+    [_storage setData:[self _tempData] forKey:@"_key"];
+    [_storage setData:[self _tempData] forKey:@"_key2"];
+    [[self _tempData] writeToFile:[_storage.path stringByAppendingPathComponent:@".hidden"] atomically:NO];
+    
+    unsigned long long size = 0;
+    for (NSURL *fileURL in [_storage contentsWithResourceKeys:@[NSURLFileAllocatedSizeKey]]) {
+        NSNumber *fileSize;
+        [fileURL getResourceValue:&fileSize forKey:NSURLFileAllocatedSizeKey error:nil];
+        size += [fileSize unsignedLongLongValue];
+    }
+    XCTAssertTrue(size > 0);
+    XCTAssertEqual(_storage.contentsSize, size);
+}
+
+- (void)testContentsTotalsAreUpdatedIncrementally {
+    XCTAssertEqual(_storage.contentsCount, 0);
+    [_storage setData:[self _tempData] forKey:@"_key"];
+    [_storage setData:[self _tempData] forKey:@"_key2"];
+    unsigned long long contentsSize = _storage.contentsSize;
+    XCTAssertTrue(contentsSize >= 20000);
+    XCTAssertEqual(_storage.contentsLogicalSize, 20000);
+    XCTAssertEqual(_storage.contentsCount, 2);
+    
+    // Overwrite is accounted by the difference.
+    [_storage setData:[self _tempData] forKey:@"_key2"];
+    XCTAssertEqual(_storage.contentsSize, contentsSize);
+    XCTAssertEqual(_storage.contentsCount, 2);
+    
+    [_storage removeDataForKey:@"_key"];
+    XCTAssertEqual(_storage.contentsLogicalSize, 10000);
+    XCTAssertEqual(_storage.contentsCount, 1);
+    XCTAssertEqual([_storage reconcileContents], 0);
+}
+
+- (void)testReconcileContentsDetectsDrift {
+    [_storage setData:[self _tempData] forKey:@"_key"];
+    unsigned long long contentsSize = _storage.contentsSize;
+    
+    // File written by other means is not accounted until the contents are reconciled.
+    [[self _tempData] writeToFile:[_storage pathForKey:@"_key2"] atomically:NO];
+    XCTAssertEqual(_storage.contentsSize, contentsSize);
+    XCTAssertTrue([_storage reconcileContents] > 0);
+    XCTAssertEqual(_storage.contentsCount, 2);
+    XCTAssertTrue(_storage.contentsSize > contentsSize);
+}
+
+- (void)testDataWithExtendedAttributeValue {
+    NSData *data = [self _tempData];
+    NSString *key = @"_key";
+    [_storage setData:data forKey:key];
+    [[_storage URLForKey:key] df_setExtendedAttributeValue:@"_attr_value" forKey:@"_attr_key"];
+    
+    id value;
+    XCTAssertEqualObjects([_storage dataForKey:key extendedAttributeValue:&value forName:@"_attr_key"], data);
+    XCTAssertEqualObjects(value, @"_attr_value");
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"read"];
+    [_storage readDataForKey:key extendedAttributeName:@"_attr_key" queue:dispatch_get_main_queue() completion:^(NSData *readData, id readValue) {
+        XCTAssertEqualObjects(readData, data);
+        XCTAssertEqualObjects(readValue, @"_attr_value");
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:3.0 handler:nil];
+}
+
+#pragma mark - Read Options
+
+- (void)testInlineData {
+    _storage.inlineDataThreshold = 256;
+    NSData *smallData = [@"small value" dataUsingEncoding:NSUTF8StringEncoding];
+    [_storage setData:smallData forKey:@"_key"];
+    NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:[_storage pathForKey:@"_key"] error:nil];
+    XCTAssertEqual([attributes fileSize], 0);
+    XCTAssertEqualObjects([_storage dataForKey:@"_key"], smallData);
+    
+    [_storage setData:[self _tempData] forKey:@"_key2"];
+    attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:[_storage pathForKey:@"_key2"] error:nil];
+    XCTAssertEqual([attributes fileSize], 10000);
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"read"];
+    [_storage readDataForKey:@"_key" queue:dispatch_get_main_queue() completion:^(NSData *data) {
+        XCTAssertEqualObjects(data, smallData);
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:3.0 handler:nil];
+}
+
+- (void)testInlineDataIsAccounted {
+    _storage.inlineDataThreshold = 256;
+    XCTAssertEqual([_storage contentsSize], 0);
+    NSData *smallData = [@"small value" dataUsingEncoding:NSUTF8StringEncoding];
+    [_storage setData:smallData forKey:@"_key"];
+    XCTAssertEqual([_storage contentsLogicalSize], smallData.length);
+    XCTAssertGreaterThanOrEqual([_storage contentsSize], 4096);
+    XCTAssertEqual([_storage contentsCount], 1);
+    XCTAssertEqual([_storage reconcileContents], 0); // Scan agrees with the running totals
+    [_storage removeDataForKey:@"_key"];
+    XCTAssertEqual([_storage contentsSize], 0);
+    XCTAssertEqual([_storage contentsLogicalSize], 0);
+}
+
+- (void)testReadOptions {
+    NSData *data = [self _tempData];
+    NSString *key = @"_key";
+    [_storage setData:data forKey:key];
+    [_storage prefetchDataForKeys:@[key, @"_missing_key"]];
+    XCTAssertEqualObjects([_storage dataForKey:key options:DFFileStorageReadOptionWillNeed], data);
+    XCTAssertEqualObjects([_storage dataForKey:key options:DFFileStorageReadOptionNoCache], data);
+}
+
+- (void)testNoCacheReadThreshold {
+    NSData *data = [self _tempData];
+    NSString *key = @"_key";
+    [_storage setData:data forKey:key];
+    _storage.noCacheReadThreshold = data.length / 2;
+    XCTAssertEqualObjects([_storage dataForKey:key], data);
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"read"];
+    [_storage readDataForKey:key queue:dispatch_get_main_queue() completion:^(NSData *readData) {
+        XCTAssertEqualObjects(readData, data);
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:3.0 handler:nil];
+}
+
+#pragma mark - Asynchronous Reads
+
+- (void)testReadData {
+    NSData *data = [self _tempData];
+    [_storage setData:data forKey:@"_key"];
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"read"];
+    [_storage readDataForKey:@"_key" queue:dispatch_get_main_queue() completion:^(NSData *readData) {
+        XCTAssertEqualObjects(readData, data);
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:3.0 handler:nil];
+}
+
+- (void)testReadMissingData {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"read"];
+    [_storage readDataForKey:@"_key" queue:dispatch_get_main_queue() completion:^(NSData *readData) {
+        XCTAssertNil(readData);
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:3.0 handler:nil];
+}
+
+- (void)testBatchReadData {
+    _storage.maximumConcurrentReadCount = 2;
+    NSMutableArray *keys = [NSMutableArray new];
+    for (NSUInteger i = 0; i < 10; i++) {
+        NSString *key = [NSString stringWithFormat:@"_key_%lu", (unsigned long)i];
+        if (i % 2 == 0) {
+            [_storage setData:[self _tempData] forKey:key];
+        }
+        [keys addObject:key];
+    }
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"read"];
+    [_storage readDataForKeys:keys queue:dispatch_get_main_queue() completion:^(NSDictionary *batch) {
+        XCTAssertTrue(batch.count == 5);
+        XCTAssertNotNil(batch[@"_key_0"]);
+        XCTAssertNil(batch[@"_key_1"]);
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:3.0 handler:nil];
+}
+
+- (void)testBatchReadWithExtendedAttribute {
+    [_storage setData:[self _tempData] forKey:@"_key_1"];
+    [_storage setData:[self _tempData] forKey:@"_key_2"];
+    [[_storage URLForKey:@"_key_1"] df_setExtendedAttributeValue:@"value" forKey:@"_attribute"];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"read"];
+    [_storage readDataForKeys:@[ @"_key_1", @"_key_2", @"_key_3" ] extendedAttributeName:@"_attribute" queue:dispatch_get_main_queue() completion:^(NSDictionary *batch, NSDictionary *values) {
+        XCTAssertEqual(batch.count, 2);
+        XCTAssertEqualObjects(values, @{ @"_key_1" : @"value" });
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:3.0 handler:nil];
+}
+
+- (void)testBatchReadInPhysicalOrderReturnsKeyedBatch {
+    NSMutableDictionary *entries = [NSMutableDictionary new];
+    for (NSUInteger i = 0; i < 10; i++) {
+        NSString *key = [NSString stringWithFormat:@"_key_%lu", (unsigned long)i];
+        entries[key] = [self _tempData];
+        [_storage setData:entries[key] forKey:key];
+    }
+    NSArray *keys = [[entries.allKeys arrayByAddingObject:@"_key_missing"] sortedArrayUsingSelector:@selector(compare:)];
+    NSArray *sortedKeys = [_storage keysSortedByPhysicalLocation:keys];
+    XCTAssertEqual(sortedKeys.count, keys.count);
+    XCTAssertEqualObjects(sortedKeys.lastObject, @"_key_missing");
+    XCTAssertEqualObjects([NSSet setWithArray:sortedKeys], [NSSet setWithArray:keys]);
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"read"];
+    [_storage readDataForKeys:keys.reverseObjectEnumerator.allObjects queue:dispatch_get_main_queue() completion:^(NSDictionary *batch) {
+        XCTAssertEqualObjects(batch, entries);
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:3.0 handler:nil];
+}
+
+#pragma mark - Performance
+
+- (void)testBatchReadPerformanceWithQueueDepth1 {
+    [self _measureBatchReadWithQueueDepth:1];
+}
+
+- (void)testBatchReadPerformanceWithQueueDepth4 {
+    [self _measureBatchReadWithQueueDepth:4];
+}
+
+- (void)testBatchReadPerformanceWithQueueDepth16 {
+    [self _measureBatchReadWithQueueDepth:16];
+}
+
+/*! Baseline for testBatchReadPerformanceInPhysicalOrder: uncached reads in random key order.
+ */
+- (void)testBatchReadPerformanceInKeyOrder {
+    [self _measureUncachedBatchReadInPhysicalOrder:NO];
+}
+
+- (void)testBatchReadPerformanceInPhysicalOrder {
+    [self _measureUncachedBatchReadInPhysicalOrder:YES];
+}
+
+- (void)_measureUncachedBatchReadInPhysicalOrder:(BOOL)physicalOrder {
+    _storage.readsInPhysicalOrder = physicalOrder;
+    _storage.noCacheReadThreshold = 1;
+    _storage.maximumConcurrentReadCount = 1;
+    NSMutableArray *keys = [NSMutableArray new];
+    for (NSUInteger i = 0; i < 500; i++) {
+        NSString *key = [NSString stringWithFormat:@"_key_%lu", (unsigned long)i];
+        [_storage setData:[self _tempData] forKey:key];
+        [keys addObject:key];
+    }
+    for (NSUInteger i = keys.count - 1; i > 0; i--) {
+        [keys exchangeObjectAtIndex:i withObjectAtIndex:arc4random_uniform((uint32_t)i + 1)];
+    }
+    dispatch_queue_t queue = dispatch_queue_create("TDFFileStorage::ReadQueue", DISPATCH_QUEUE_SERIAL);
+    [self measureBlock:^{
+        dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+        [_storage readDataForKeys:keys queue:queue completion:^(NSDictionary *batch) {
+            XCTAssertEqual(batch.count, keys.count);
+            dispatch_semaphore_signal(semaphore);
+        }];
+        dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+    }];
+}
+
+- (void)_measureBatchReadWithQueueDepth:(NSUInteger)queueDepth {
+    _storage.maximumConcurrentReadCount = queueDepth;
+    NSMutableArray *keys = [NSMutableArray new];
+    for (NSUInteger i = 0; i < 200; i++) {
+        NSString *key = [NSString stringWithFormat:@"_key_%lu", (unsigned long)i];
+        [_storage setData:[self _tempData] forKey:key];
+        [keys addObject:key];
+    }
+    dispatch_queue_t queue = dispatch_queue_create("TDFFileStorage::ReadQueue", DISPATCH_QUEUE_SERIAL);
+    [self measureBlock:^{
+        dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+        [_storage readDataForKeys:keys queue:queue completion:^(NSDictionary *batch) {
+            dispatch_semaphore_signal(semaphore);
+        }];
+        dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+    }];
+}
+
+- (void)testSmallReadPerformanceWhileStreamingLargeEntries {
+    [self _measureSmallReadsWhileStreamingLargeEntriesWithNoCacheThreshold:0];
+}
+
+- (void)testSmallReadPerformanceWhileStreamingLargeEntriesWithoutCaching {
+    [self _measureSmallReadsWhileStreamingLargeEntriesWithNoCacheThreshold:1024 * 1024];
+}
+
+/*! Measures reads of small entries while large entries are read once on the background thread.
+ */
+- (void)_measureSmallReadsWhileStreamingLargeEntriesWithNoCacheThreshold:(unsigned long long)threshold {
+    _storage.noCacheReadThreshold = threshold;
+    NSMutableArray *smallKeys = [NSMutableArray new];
+    for (NSUInteger i = 0; i < 100; i++) {
+        NSString *key = [NSString stringWithFormat:@"_small_key_%lu", (unsigned long)i];
+        [_storage setData:[self _tempData] forKey:key];
+        [smallKeys addObject:key];
+    }
+    NSMutableArray *largeKeys = [NSMutableArray new];
+    void *buffer = calloc(1, 8 * 1024 * 1024);
+    NSData *largeData = [NSData dataWithBytesNoCopy:buffer length:8 * 1024 * 1024];
+    for (NSUInteger i = 0; i < 8; i++) {
+        NSString *key = [NSString stringWithFormat:@"_large_key_%lu", (unsigned long)i];
+        [_storage setData:largeData forKey:key];
+        [largeKeys addObject:key];
+    }
+    
+    BOOL __block streaming = YES;
+    dispatch_group_t group = dispatch_group_create();
+    dispatch_group_async(group, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        while (streaming) {
+            @autoreleasepool {
+                for (NSString *key in largeKeys) {
+                    [_storage dataForKey:key];
+                }
+            }
+        }
+    });
+    [self measureBlock:^{
+        for (NSString *key in smallKeys) {
+            [_storage dataForKey:key];
+        }
+    }];
+    streaming = NO;
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+}
+
+- (void)testContentsSizePerformance {
+    [self _writeEntriesForScanBenchmark];
+    [self measureBlock:^{
+        XCTAssertTrue(_storage.contentsSize > 0);
+    }];
+}
+
+/*! Baseline for testContentsSizePerformance: the same scan with an NSURL and prefetched resource values per file.
+ */
+- (void)testContentsWithResourceKeysPerformance {
+    [self _writeEntriesForScanBenchmark];
+    [self measureBlock:^{
+        unsigned long long size = 0;
+        for (NSURL *fileURL in [_storage contentsWithResourceKeys:@[NSURLFileAllocatedSizeKey]]) {
+            NSNumber *fileSize;
+            [fileURL getResourceValue:&fileSize forKey:NSURLFileAllocatedSizeKey error:nil];
+            size += [fileSize unsignedLongLongValue];
+        }
+        XCTAssertTrue(size > 0);
+    }];
+}
+
+- (void)_writeEntriesForScanBenchmark {
+    NSData *data = [@"value" dataUsingEncoding:NSUTF8StringEncoding];
+    for (NSUInteger i = 0; i < 10000; i++) {
+        [_storage setData:data forKey:[NSString stringWithFormat:@"_key_%lu", (unsigned long)i]];
+    }
+}
+
 #pragma mark - Helpers
 
 - (NSData *)_tempData {
@@ -0,0 +1,168 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFCache.h"
+#import "DFDiskCache.h"
+#import "DFLSMStorage.h"
+#import <XCTest/XCTest.h>
+
+@interface TDFLSMStorage : XCTestCase
+
+@end
+
+@implementation TDFLSMStorage {
+    DFLSMStorage *_storage;
+}
+
+- (void)setUp {
+    NSString *path = [[DFDiskCache cachesDirectoryPath] stringByAppendingPathComponent:@"_tests_lsm_"];
+    _storage = [[DFLSMStorage alloc] initWithPath:path error:nil];
+}
+
+- (void)tearDown {
+    [_storage removeAllData];
+}
+
+- (void)testBasicFunctionality {
+    NSData *data = [self _dataWithLength:300];
+    [_storage setData:data forKey:@"_key"];
+    XCTAssertEqualObjects([_storage dataForKey:@"_key"], data);
+    XCTAssertTrue([_storage containsDataForKey:@"_key"]);
+
+    [_storage removeDataForKey:@"_key"];
+    XCTAssertNil([_storage dataForKey:@"_key"]);
+    XCTAssertFalse([_storage containsDataForKey:@"_key"]);
+}
+
+- (void)testReadsFromTables {
+    NSData *data1 = [self _dataWithLength:100];
+    NSData *data2 = [self _dataWithLength:200];
+    [_storage setData:data1 forKey:@"_key_1"];
+    [_storage setData:data2 forKey:@"_key_2"];
+    [_storage flush];
+    XCTAssertEqual([_storage tableCountAtLevel:0], 1);
+
+    // Tombstone in the newer table shadows the older value.
+    [_storage removeDataForKey:@"_key_1"];
+    [_storage flush];
+    XCTAssertNil([_storage dataForKey:@"_key_1"]);
+    XCTAssertEqualObjects([_storage dataForKey:@"_key_2"], data2);
+    XCTAssertNil([_storage dataForKey:@"_key_3"]);
+}
+
+- (void)testContentsAreRecoveredByNewInstance {
+    NSData *data1 = [self _dataWithLength:100];
+    NSData *data2 = [self _dataWithLength:200];
+    [_storage setData:data1 forKey:@"_key_1"];
+    [_storage flush];
+    [_storage setData:data2 forKey:@"_key_2"]; // Only in the log
+    [_storage removeDataForKey:@"_key_1"];
+
+    DFLSMStorage *storage = [[DFLSMStorage alloc] initWithPath:_storage.path error:nil];
+    XCTAssertNil([storage dataForKey:@"_key_1"]);
+    XCTAssertEqualObjects([storage dataForKey:@"_key_2"], data2);
+}
+
+- (void)testLevel0TablesAreCompacted {
+    NSMutableDictionary *entries = [NSMutableDictionary new];
+    for (NSUInteger i = 0; i < 8; i++) {
+        for (NSUInteger j = 0; j < 100; j++) {
+            NSString *key = [NSString stringWithFormat:@"_key_%lu", (unsigned long)(i * 50 + j)];
+            entries[key] = [self _dataWithLength:100];
+            [_storage setData:entries[key] forKey:key];
+        }
+        [_storage flush];
+    }
+    XCTAssertTrue([_storage tableCountAtLevel:0] < 4);
+    XCTAssertTrue([_storage tableCountAtLevel:1] > 0);
+    for (NSString *key in entries) {
+        XCTAssertEqualObjects([_storage dataForKey:key], entries[key]);
+    }
+}
+
+- (void)testEnumerateKeysWithPrefix {
+    NSData *data = [self _dataWithLength:10];
+    for (NSString *key in @[ @"a", @"user:1:name", @"user:1:avatar", @"user:2:name", @"user:1", @"z" ]) {
+        [_storage setData:data forKey:key];
+    }
+    [_storage flush];
+    [_storage removeDataForKey:@"user:1:name"];
+    [_storage setData:data forKey:@"user:1:email"];
+
+    NSMutableArray *keys = [NSMutableArray new];
+    [_storage enumerateKeysWithPrefix:@"user:1:" usingBlock:^(NSString *key, BOOL *stop) {
+        [keys addObject:key];
+    }];
+    XCTAssertEqualObjects(keys, (@[ @"user:1:avatar", @"user:1:email" ]));
+
+    [_storage removeDataForKeysWithPrefix:@"user:"];
+    XCTAssertNil([_storage dataForKey:@"user:2:name"]);
+    XCTAssertNotNil([_storage dataForKey:@"z"]);
+}
+
+- (void)testCacheRemovesObjectsWithPrefix {
+    DFCache *cache = [[DFCache alloc] initWithEngine:_storage memoryCache:[NSCache new]];
+    XCTAssertTrue(cache.diskCache.supportsKeyPrefixes);
+    [cache storeObject:@"name" forKey:@"user:1:name"];
+    [cache storeObject:@"avatar" forKey:@"user:1:avatar"];
+    [cache storeObject:@"name" forKey:@"user:2:name"];
+
+    NSMutableArray *keys = [NSMutableArray new];
+    [cache enumerateKeysWithPrefix:@"user:1:" usingBlock:^(NSString *key, BOOL *stop) {
+        [keys addObject:key];
+    }];
+    XCTAssertEqualObjects(keys, (@[ @"user:1:avatar", @"user:1:name" ]));
+
+    [cache removeObjectsForKeysWithPrefix:@"user:1:"];
+    XCTAssertNil([cache cachedObjectForKey:@"user:1:name"]);
+    XCTAssertNil([cache.memoryCache objectForKey:@"user:1:avatar"]);
+    XCTAssertNil([cache cachedObjectForKey:@"user:1:avatar"]);
+    XCTAssertEqualObjects([cache cachedObjectForKey:@"user:2:name"], @"name");
+}
+
+- (void)testEnumerateKeysAndDataInRange {
+    for (NSUInteger i = 0; i < 10; i++) {
+        [_storage setData:[self _dataWithLength:10] forKey:[NSString stringWithFormat:@"_key_%lu", (unsigned long)i]];
+        if (i % 3 == 0) {
+            [_storage flush];
+        }
+    }
+    NSMutableArray *keys = [NSMutableArray new];
+    [_storage enumerateKeysAndDataFromKey:@"_key_3" toKey:@"_key_7" usingBlock:^(NSString *key, NSData *data, BOOL *stop) {
+        XCTAssertEqualObjects([_storage dataForKey:key], data);
+        [keys addObject:key];
+    }];
+    XCTAssertEqualObjects(keys, (@[ @"_key_3", @"_key_4", @"_key_5", @"_key_6" ]));
+
+    __block NSUInteger count = 0;
+    [_storage enumerateKeysAndDataFromKey:nil toKey:nil usingBlock:^(NSString *key, NSData *data, BOOL *stop) {
+        count++;
+        *stop = (count == 2);
+    }];
+    XCTAssertEqual(count, 2);
+}
+
+#pragma mark - Performance
+
+- (void)testWritePerformance {
+    NSData *data = [self _dataWithLength:1000];
+    __block NSUInteger iteration = 0;
+    [self measureBlock:^{
+        iteration++;
+        for (NSUInteger i = 0; i < 1000; i++) {
+            [_storage setData:data forKey:[NSString stringWithFormat:@"_key_%lu_%lu", (unsigned long)iteration, (unsigned long)i]];
+        }
+        [_storage flush];
+    }];
+}
+
+#pragma mark - Helpers
+
+- (NSData *)_dataWithLength:(NSUInteger)length {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    arc4random_buf(data.mutableBytes, length);
+    return data;
+}
+
+@end
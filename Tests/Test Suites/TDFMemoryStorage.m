@@ -0,0 +1,109 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFCache.h"
+#import "DFDiskCache.h"
+#import "DFMemoryStorage.h"
+#import <XCTest/XCTest.h>
+
+@interface TDFMemoryStorage : XCTestCase
+
+@end
+
+@implementation TDFMemoryStorage {
+    DFMemoryStorage *_storage;
+    DFDiskCache *_diskCache;
+}
+
+- (void)setUp {
+    _storage = [DFMemoryStorage new];
+    _diskCache = [[DFDiskCache alloc] initWithEngine:_storage];
+}
+
+- (void)testBasicFunctionality {
+    NSData *data = [self _dataWithLength:300];
+    [_storage setData:data forKey:@"_key"];
+    XCTAssertEqualObjects([_storage dataForKey:@"_key"], data);
+    XCTAssertTrue([_storage containsDataForKey:@"_key"]);
+    XCTAssertEqual(_storage.contentsSize, 300);
+
+    DFStorageEntryStat stat;
+    XCTAssertTrue([_storage getStat:&stat forKey:@"_key"]);
+    XCTAssertEqual(stat.size, 300);
+    XCTAssertTrue(stat.accessTime > 0);
+
+    [_storage removeDataForKey:@"_key"];
+    XCTAssertNil([_storage dataForKey:@"_key"]);
+    XCTAssertFalse([_storage getStat:&stat forKey:@"_key"]);
+    XCTAssertEqual(_storage.contentsSize, 0);
+}
+
+- (void)testDiskCacheReadsAndWritesThroughEngine {
+    NSData *data = [self _dataWithLength:1000];
+    [_diskCache setData:data forKey:@"_key_1"];
+    XCTAssertEqualObjects([_diskCache dataForKey:@"_key_1"], data);
+    XCTAssertTrue([_storage containsDataForKey:@"_key_1"]);
+    XCTAssertEqual(_diskCache.contentsCount, 1);
+    XCTAssertTrue(_diskCache.engine == _storage);
+    XCTAssertNil(_diskCache.internalDirectoryPath);
+
+    [_diskCache removeDataForKeys:@[ @"_key_1" ]];
+    XCTAssertNil([_diskCache dataForKey:@"_key_1"]);
+    XCTAssertEqual(_storage.contentsCount, 0);
+}
+
+- (void)testDiskCacheCleanupEvictsEngineEntries {
+    unsigned long long length = 400000;
+    _diskCache.capacity = length + 10000;
+    _diskCache.cleanupRate = 1.f; // Only one should remain.
+
+    NSArray *keys = @[ @"_key_1", @"_key_2", @"_key_3" ];
+    for (NSString *key in keys) {
+        [_diskCache setData:[self _dataWithLength:length] forKey:key];
+    }
+    [_diskCache dataForKey:keys[1]];
+    [_diskCache cleanup];
+    XCTAssertEqual(_storage.contentsCount, 1);
+    XCTAssertTrue([_diskCache containsDataForKey:keys[1]]);
+    XCTAssertTrue(_diskCache.statistics.evictionCount == 2);
+
+    XCTAssertNil([_diskCache dataForKey:keys[0]]);
+    XCTAssertTrue(_diskCache.statistics.ghostHitCount == 1);
+}
+
+- (void)testDiskCacheExtendedAttributesAreStoredWithData {
+    NSData *data = [self _dataWithLength:1000];
+    [_diskCache setData:data forKey:@"_key_1" extendedAttributes:@{ @"_attr_key" : @"_attr_value" }];
+    XCTAssertEqualObjects([_diskCache extendedAttributeValueForName:@"_attr_key" key:@"_key_1"], @"_attr_value");
+
+    [_diskCache setExtendedAttributeValue:@"_attr_value_2" forName:@"_attr_key_2" key:@"_key_1"];
+    id value;
+    XCTAssertEqualObjects([_diskCache dataForKey:@"_key_1" extendedAttributeValue:&value forName:@"_attr_key_2"], data);
+    XCTAssertEqualObjects(value, @"_attr_value_2");
+
+    [_diskCache setExtendedAttributeValue:nil forName:@"_attr_key" key:@"_key_1"];
+    XCTAssertNil([_diskCache extendedAttributeValueForName:@"_attr_key" key:@"_key_1"]);
+
+    // Attribute isn't set for the missing entry.
+    [_diskCache setExtendedAttributeValue:@"_attr_value" forName:@"_attr_key" key:@"_key_2"];
+    XCTAssertFalse([_diskCache containsDataForKey:@"_key_2"]);
+}
+
+- (void)testCacheMetadataWithEngine {
+    DFCache *cache = [[DFCache alloc] initWithEngine:_storage memoryCache:nil];
+    [cache storeObject:@"_value" forKey:@"_key"];
+    [cache setMetadata:@{ @"_meta_key" : @"_meta_value" } forKey:@"_key"];
+    XCTAssertEqualObjects([cache metadataForKey:@"_key"][@"_meta_key"], @"_meta_value");
+    XCTAssertEqualObjects([cache cachedObjectForKey:@"_key"], @"_value");
+}
+
+#pragma mark - Helpers
+
+- (NSData *)_dataWithLength:(NSUInteger)length {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    arc4random_buf(data.mutableBytes, length);
+    return data;
+}
+
+@end
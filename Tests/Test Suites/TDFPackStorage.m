@@ -0,0 +1,110 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFCache.h"
+#import "DFPackStorage.h"
+#import <XCTest/XCTest.h>
+
+@interface TDFPackStorage : XCTestCase
+
+@end
+
+@implementation TDFPackStorage {
+    NSString *_path;
+    DFPackStorage *_storage;
+}
+
+- (void)setUp {
+    _path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"_tests_pack_storage_"];
+    [[NSFileManager defaultManager] removeItemAtPath:_path error:nil];
+    _storage = [[DFPackStorage alloc] initWithPath:_path error:nil];
+}
+
+- (void)tearDown {
+    _storage = nil;
+    [[NSFileManager defaultManager] removeItemAtPath:_path error:nil];
+}
+
+- (void)testWriteAndReopen {
+    NSData *data1 = [self _dataWithLength:100];
+    NSData *data2 = [self _dataWithLength:1000];
+    [_storage setData:data1 forKey:@"_key_1"];
+    [_storage setData:[self _dataWithLength:10] forKey:@"_key_2"];
+    [_storage setData:data2 forKey:@"_key_2"];
+    [_storage setData:[self _dataWithLength:10] forKey:@"_key_3"];
+    [_storage removeDataForKey:@"_key_3"];
+    XCTAssertEqualObjects([_storage dataForKey:@"_key_1"], data1);
+    XCTAssertEqualObjects([_storage dataForKey:@"_key_2"], data2);
+    XCTAssertNil([_storage dataForKey:@"_key_3"]);
+
+    [_storage synchronize];
+    _storage = [[DFPackStorage alloc] initWithPath:_path error:nil];
+    XCTAssertEqual(_storage.contentsCount, 2);
+    XCTAssertEqualObjects([_storage dataForKey:@"_key_1"], data1);
+    XCTAssertEqualObjects([_storage dataForKey:@"_key_2"], data2);
+    XCTAssertFalse([_storage containsDataForKey:@"_key_3"]);
+}
+
+- (void)testGroupedEntriesAreReadWithSingleRead {
+    NSMutableDictionary *batch = [NSMutableDictionary new];
+    for (NSUInteger i = 0; i < 20; i++) {
+        batch[[NSString stringWithFormat:@"_key_%lu", (unsigned long)i]] = [self _dataWithLength:1000];
+    }
+    [_storage setDataBatch:batch localityGroup:@"_group_1"];
+    [_storage setData:[self _dataWithLength:100000] forKey:@"_key_unrelated"];
+    XCTAssertEqualObjects([_storage localityGroupForKey:@"_key_1"], @"_group_1");
+
+    unsigned long long readCount = _storage.readCount;
+    XCTAssertEqualObjects([_storage dataForKeys:batch.allKeys], batch);
+    XCTAssertEqual(_storage.readCount - readCount, 1);
+
+    // Overwritten entry keeps its locality group.
+    [_storage setData:[self _dataWithLength:10] forKey:@"_key_1"];
+    XCTAssertEqualObjects([_storage localityGroupForKey:@"_key_1"], @"_group_1");
+}
+
+- (void)testCompactionRemovesGarbage {
+    _storage.segmentSize = 4096;
+    _storage.compactionThreshold = 1.f; // Disables background compaction
+    NSMutableDictionary *entries = [NSMutableDictionary new];
+    for (NSUInteger i = 0; i < 10; i++) {
+        NSString *key = [NSString stringWithFormat:@"_key_%lu", (unsigned long)i];
+        entries[key] = [self _dataWithLength:1000];
+        [_storage setDataBatch:@{ key : entries[key] } localityGroup:(i % 2) ? @"_group_odd" : @"_group_even"];
+        [_storage setData:[self _dataWithLength:1000] forKey:[NSString stringWithFormat:@"_garbage_%lu", (unsigned long)i]];
+        [_storage removeDataForKey:[NSString stringWithFormat:@"_garbage_%lu", (unsigned long)i]];
+    }
+    unsigned long long contentsSize = _storage.contentsSize;
+    [_storage compact];
+    XCTAssertTrue(_storage.contentsSize < contentsSize);
+    XCTAssertEqualObjects([_storage dataForKeys:entries.allKeys], entries);
+    XCTAssertEqualObjects([_storage localityGroupForKey:@"_key_3"], @"_group_odd");
+
+    _storage = [[DFPackStorage alloc] initWithPath:_path error:nil];
+    XCTAssertEqual(_storage.contentsCount, 10);
+    XCTAssertEqualObjects([_storage dataForKeys:entries.allKeys], entries);
+}
+
+- (void)testCacheStoresObjectsInLocalityGroup {
+    DFCache *cache = [[DFCache alloc] initWithEngine:_storage memoryCache:nil];
+    NSDictionary *objects = @{ @"_key_1" : @"_value_1", @"_key_2" : @"_value_2" };
+    [cache storeObjects:objects localityGroup:@"_group_1"];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"batch"];
+    [cache batchCachedObjectsForKeys:objects.allKeys completion:^(NSDictionary *batch) {
+        XCTAssertEqualObjects(batch, objects);
+        XCTAssertEqualObjects([_storage localityGroupForKey:@"_key_2"], @"_group_1");
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:3.0 handler:nil];
+}
+
+#pragma mark - Helpers
+
+- (NSData *)_dataWithLength:(NSUInteger)length {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    arc4random_buf(data.mutableBytes, length);
+    return data;
+}
+
+@end
@@ -0,0 +1,133 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFCache.h"
+#import <XCTest/XCTest.h>
+
+/*! Storages opened with the same name within a single process map the same segment the same way separate processes do.
+ */
+@interface TDFSharedMemoryStorage : XCTestCase
+
+@end
+
+@implementation TDFSharedMemoryStorage {
+    NSString *_name;
+}
+
+- (void)setUp {
+    _name = @"_tests_shared_memory_storage_";
+    [DFSharedMemoryStorage removeSegmentWithName:_name];
+}
+
+- (void)tearDown {
+    [DFSharedMemoryStorage removeSegmentWithName:_name];
+}
+
+- (void)testReadWrite {
+    DFSharedMemoryStorage *storage = [[DFSharedMemoryStorage alloc] initWithName:_name capacity:1024 * 1024 slotSize:4096];
+    XCTAssertNotNil(storage);
+    NSData *data = [self _dataWithLength:1000];
+    [storage setData:data forKey:@"_key"];
+    XCTAssertEqualObjects([storage dataForKey:@"_key"], data);
+    XCTAssertTrue([storage containsDataForKey:@"_key"]);
+    XCTAssertEqual(storage.contentsCount, 1);
+
+    NSData *update = [self _dataWithLength:2000];
+    [storage setData:update forKey:@"_key"];
+    XCTAssertEqualObjects([storage dataForKey:@"_key"], update);
+    XCTAssertEqual(storage.contentsCount, 1);
+
+    [storage removeDataForKey:@"_key"];
+    XCTAssertNil([storage dataForKey:@"_key"]);
+    XCTAssertEqual(storage.hitCount, 2);
+    XCTAssertEqual(storage.missCount, 1);
+}
+
+- (void)testContentsAreSharedByName {
+    DFSharedMemoryStorage *storage1 = [[DFSharedMemoryStorage alloc] initWithName:_name capacity:1024 * 1024 slotSize:4096];
+    DFSharedMemoryStorage *storage2 = [[DFSharedMemoryStorage alloc] initWithName:_name capacity:1024 slotSize:16];
+    XCTAssertEqual(storage2.slotCount, storage1.slotCount); // Geometry of the existing segment is used
+    XCTAssertEqual(storage2.slotSize, 4096);
+
+    NSData *data = [self _dataWithLength:1000];
+    [storage1 setData:data forKey:@"_key"];
+    XCTAssertEqualObjects([storage2 dataForKey:@"_key"], data);
+    [storage2 removeAllData];
+    XCTAssertFalse([storage1 containsDataForKey:@"_key"]);
+}
+
+- (void)testLeastRecentlyUsedEntryOfSetIsEvicted {
+    // Capacity of a single set of 8 slots.
+    DFSharedMemoryStorage *storage = [[DFSharedMemoryStorage alloc] initWithName:_name capacity:8 * 256 slotSize:128];
+    XCTAssertEqual(storage.slotCount, 8);
+    for (NSUInteger i = 0; i < 8; i++) {
+        [storage setData:[self _dataWithLength:64] forKey:[NSString stringWithFormat:@"_key_%lu", (unsigned long)i]];
+        [NSThread sleepForTimeInterval:0.002];
+    }
+    XCTAssertNotNil([storage dataForKey:@"_key_0"]);
+    [storage setData:[self _dataWithLength:64] forKey:@"_key_8"];
+    XCTAssertEqual(storage.evictionCount, 1);
+    XCTAssertTrue([storage containsDataForKey:@"_key_0"]);
+    XCTAssertFalse([storage containsDataForKey:@"_key_1"]);
+    XCTAssertEqual(storage.contentsCount, 8);
+}
+
+- (void)testEntriesThatDontFitIntoSlotAreNotStored {
+    DFSharedMemoryStorage *storage = [[DFSharedMemoryStorage alloc] initWithName:_name capacity:1024 * 1024 slotSize:1024];
+    [storage setData:[self _dataWithLength:100] forKey:@"_key"];
+    [storage setData:[self _dataWithLength:2000] forKey:@"_key"];
+    XCTAssertFalse([storage containsDataForKey:@"_key"]); // Previous data isn't served either
+}
+
+- (void)testCachesShareTier {
+    DFSharedMemoryStorage *tier = [[DFSharedMemoryStorage alloc] initWithName:_name capacity:1024 * 1024 slotSize:4096];
+    DFCache *cache1 = [[DFCache alloc] initWithDiskCache:nil memoryCache:nil];
+    DFCache *cache2 = [[DFCache alloc] initWithDiskCache:nil memoryCache:nil];
+    cache1.sharedMemoryTier = tier;
+    cache2.sharedMemoryTier = [[DFSharedMemoryStorage alloc] initWithName:_name];
+
+    [cache1 storeObject:@"value" forKey:@"_key"];
+    [cache1 cachedObjectForKey:@"_key"]; // Waits for the write
+    XCTAssertEqualObjects([cache2 cachedObjectForKey:@"_key"], @"value");
+
+    [cache2 removeObjectForKey:@"_key"];
+    XCTAssertNil([cache2 cachedObjectForKey:@"_key"]);
+    XCTAssertFalse([tier containsDataForKey:@"_key"]);
+}
+
+- (void)testReadsFromDiskFillTier {
+    DFDiskCache *diskCache = [[DFDiskCache alloc] initWithName:@"_tests_shared_memory_storage_disk_cache_"];
+    DFCache *cache = [[DFCache alloc] initWithDiskCache:diskCache memoryCache:nil];
+    DFSharedMemoryStorage *tier = [[DFSharedMemoryStorage alloc] initWithName:_name capacity:1024 * 1024 slotSize:4096];
+    cache.sharedMemoryTier = tier;
+    NSData *data = [self _dataWithLength:100];
+    [diskCache setData:data forKey:@"_key_1"];
+    [diskCache setData:data forKey:@"_key_2"];
+    [diskCache setData:data forKey:@"_key_3"];
+
+    XCTAssertEqualObjects([cache cachedDataForKey:@"_key_1"], data);
+    XCTAssertTrue([tier containsDataForKey:@"_key_1"]);
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"batch"];
+    [cache batchCachedDataForKeys:@[ @"_key_1", @"_key_2", @"_key_3" ] completion:^(NSDictionary *batch) {
+        XCTAssertEqual(batch.count, 3);
+        XCTAssertEqualObjects(batch[@"_key_1"], data);
+        XCTAssertEqualObjects(batch[@"_key_2"], data);
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:3.0 handler:nil];
+    XCTAssertTrue([tier containsDataForKey:@"_key_2"]);
+    XCTAssertTrue([tier containsDataForKey:@"_key_3"]);
+    [diskCache removeAllData];
+}
+
+#pragma mark - Helpers
+
+- (NSData *)_dataWithLength:(NSUInteger)length {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    arc4random_buf(data.mutableBytes, length);
+    return data;
+}
+
+@end
@@ -0,0 +1,129 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFDiskCache.h"
+#import "DFSlabStorage.h"
+#import <XCTest/XCTest.h>
+
+@interface TDFSlabStorage : XCTestCase
+
+@end
+
+@implementation TDFSlabStorage {
+    DFSlabStorage *_storage;
+}
+
+- (void)setUp {
+    NSString *path = [[DFDiskCache cachesDirectoryPath] stringByAppendingPathComponent:@"_tests_slab_"];
+    _storage = [[DFSlabStorage alloc] initWithPath:path error:nil];
+}
+
+- (void)tearDown {
+    [_storage removeAllData];
+}
+
+- (void)testBasicFunctionality {
+    NSData *data = [self _dataWithLength:300];
+    [_storage setData:data forKey:@"_key"];
+    XCTAssertEqualObjects([_storage dataForKey:@"_key"], data);
+    XCTAssertTrue([_storage containsDataForKey:@"_key"]);
+    XCTAssertEqual(_storage.contentsCount, 1);
+
+    [_storage removeDataForKey:@"_key"];
+    XCTAssertNil([_storage dataForKey:@"_key"]);
+    XCTAssertEqual(_storage.contentsCount, 0);
+    XCTAssertEqual(_storage.contentsSize, 0);
+}
+
+- (void)testOverwrite {
+    [_storage setData:[self _dataWithLength:300] forKey:@"_key"];
+    unsigned long long contentsSize = _storage.contentsSize;
+
+    // Same slab class, overwritten in place.
+    NSData *data = [self _dataWithLength:301];
+    [_storage setData:data forKey:@"_key"];
+    XCTAssertEqualObjects([_storage dataForKey:@"_key"], data);
+    XCTAssertEqual(_storage.contentsSize, contentsSize);
+
+    // Moved to another slab class.
+    data = [self _dataWithLength:3000];
+    [_storage setData:data forKey:@"_key"];
+    XCTAssertEqualObjects([_storage dataForKey:@"_key"], data);
+    XCTAssertEqual(_storage.contentsCount, 1);
+    XCTAssertTrue(_storage.contentsSize > contentsSize);
+}
+
+- (void)testEntriesThatDontFitAreNotStored {
+    [_storage setData:[self _dataWithLength:_storage.maximumEntryLength + 1] forKey:@"_key"];
+    XCTAssertFalse([_storage containsDataForKey:@"_key"]);
+}
+
+- (void)testContentsAreRecoveredByNewInstance {
+    NSData *data1 = [self _dataWithLength:100];
+    NSData *data2 = [self _dataWithLength:2000];
+    [_storage setData:data1 forKey:@"_key_1"];
+    [_storage setData:data2 forKey:@"_key_2"];
+    [_storage setData:data1 forKey:@"_key_3"];
+    [_storage removeDataForKey:@"_key_3"];
+
+    DFSlabStorage *storage = [[DFSlabStorage alloc] initWithPath:_storage.path error:nil];
+    XCTAssertEqualObjects([storage dataForKey:@"_key_1"], data1);
+    XCTAssertEqualObjects([storage dataForKey:@"_key_2"], data2);
+    XCTAssertNil([storage dataForKey:@"_key_3"]);
+    XCTAssertEqual(storage.contentsCount, 2);
+    XCTAssertEqual(storage.contentsSize, _storage.contentsSize);
+    XCTAssertEqual(storage.contentsLogicalSize, 2100);
+}
+
+- (void)testContentsLogicalSize {
+    [_storage setData:[self _dataWithLength:300] forKey:@"_key_1"];
+    [_storage setData:[self _dataWithLength:1000] forKey:@"_key_2"];
+    XCTAssertEqual(_storage.contentsLogicalSize, 1300);
+    XCTAssertTrue(_storage.contentsSize > _storage.contentsLogicalSize);
+
+    [_storage setData:[self _dataWithLength:301] forKey:@"_key_1"];
+    XCTAssertEqual(_storage.contentsLogicalSize, 1301);
+    DFDiskCache *diskCache = [[DFDiskCache alloc] initWithEngine:_storage];
+    XCTAssertEqual(diskCache.contentsLogicalSize, 1301);
+
+    [_storage removeDataForKey:@"_key_2"];
+    XCTAssertEqual(_storage.contentsLogicalSize, 301);
+}
+
+- (void)testLeastRecentlyUsedEntryOfTheClassIsEvicted {
+    // A single page per slab class.
+    _storage.capacity = 1024 * 1024;
+    NSUInteger count = 0;
+    while (_storage.evictionCount == 0) {
+        [_storage setData:[self _dataWithLength:1000] forKey:[NSString stringWithFormat:@"_key_%lu", (unsigned long)count]];
+        [_storage dataForKey:@"_key_0"]; // Keeps the first entry recently used
+        count++;
+    }
+    XCTAssertTrue([_storage containsDataForKey:@"_key_0"]);
+    XCTAssertFalse([_storage containsDataForKey:@"_key_1"]);
+    XCTAssertTrue([_storage containsDataForKey:[NSString stringWithFormat:@"_key_%lu", (unsigned long)count - 1]]);
+}
+
+#pragma mark - Performance
+
+- (void)testWritePerformance {
+    NSData *data = [self _dataWithLength:1000];
+    __block NSUInteger iteration = 0;
+    [self measureBlock:^{
+        iteration++;
+        for (NSUInteger i = 0; i < 1000; i++) {
+            [_storage setData:data forKey:[NSString stringWithFormat:@"_key_%lu_%lu", (unsigned long)iteration, (unsigned long)i]];
+        }
+    }];
+}
+
+#pragma mark - Helpers
+
+- (NSData *)_dataWithLength:(NSUInteger)length {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    arc4random_buf(data.mutableBytes, length);
+    return data;
+}
+
+@end
@@ -0,0 +1,101 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+#import "DFCache.h"
+#import "DFMemoryStorage.h"
+#import "DFStripedStorage.h"
+#import <XCTest/XCTest.h>
+
+@interface TDFStripedStorage : XCTestCase
+
+@end
+
+@implementation TDFStripedStorage {
+    DFStripedStorage *_storage;
+}
+
+- (void)setUp {
+    _storage = [DFStripedStorage new];
+    [_storage addStripeWithName:@"_stripe_1" engine:[DFMemoryStorage new] weight:1.0];
+    [_storage addStripeWithName:@"_stripe_2" engine:[DFMemoryStorage new] weight:1.0];
+    [_storage addStripeWithName:@"_stripe_3" engine:[DFMemoryStorage new] weight:2.0];
+}
+
+- (void)testKeysAreDistributedByWeight {
+    NSMutableDictionary *entries = [NSMutableDictionary new];
+    for (NSUInteger i = 0; i < 4000; i++) {
+        NSString *key = [NSString stringWithFormat:@"_key_%lu", (unsigned long)i];
+        entries[key] = [self _dataWithLength:10];
+        [_storage setData:entries[key] forKey:key];
+    }
+    for (NSString *key in entries) {
+        XCTAssertEqualObjects([_storage dataForKey:key], entries[key]);
+    }
+    XCTAssertEqualObjects([_storage dataForKeys:entries.allKeys], entries);
+    NSUInteger count1 = [(DFMemoryStorage *)[_storage engineForStripeWithName:@"_stripe_1"] contentsCount];
+    NSUInteger count3 = [(DFMemoryStorage *)[_storage engineForStripeWithName:@"_stripe_3"] contentsCount];
+    XCTAssertTrue(count1 > 600 && count1 < 1400);
+    XCTAssertTrue(count3 > 1400 && count3 < 2600);
+}
+
+- (void)testAddingStripeOnlyRemapsItsShare {
+    NSMutableDictionary *owners = [NSMutableDictionary new];
+    for (NSUInteger i = 0; i < 2000; i++) {
+        NSString *key = [NSString stringWithFormat:@"_key_%lu", (unsigned long)i];
+        owners[key] = [_storage stripeNameForKey:key];
+    }
+    [_storage addStripeWithName:@"_stripe_4" engine:[DFMemoryStorage new] weight:1.0];
+    for (NSString *key in owners) {
+        NSString *owner = [_storage stripeNameForKey:key];
+        XCTAssertTrue([owner isEqualToString:owners[key]] || [owner isEqualToString:@"_stripe_4"]);
+    }
+
+    [_storage removeStripeWithName:@"_stripe_4"];
+    for (NSString *key in owners) {
+        XCTAssertEqualObjects([_storage stripeNameForKey:key], owners[key]);
+    }
+}
+
+- (void)testRemovedDataDoesntResurfaceAfterRemapping {
+    NSString *key = nil;
+    for (NSUInteger i = 0; !key; i++) {
+        NSString *candidate = [NSString stringWithFormat:@"_key_%lu", (unsigned long)i];
+        NSString *owner = [_storage stripeNameForKey:candidate];
+        [_storage addStripeWithName:@"_stripe_4" engine:[DFMemoryStorage new] weight:1.0];
+        if ([[_storage stripeNameForKey:candidate] isEqualToString:@"_stripe_4"]) {
+            key = candidate;
+        }
+        [_storage removeStripeWithName:@"_stripe_4"];
+        XCTAssertEqualObjects([_storage stripeNameForKey:candidate], owner);
+    }
+    [_storage setData:[self _dataWithLength:10] forKey:key];
+    [_storage addStripeWithName:@"_stripe_4" engine:[DFMemoryStorage new] weight:1.0];
+    XCTAssertNil([_storage dataForKey:key]);
+    [_storage removeDataForKey:key];
+    [_storage removeStripeWithName:@"_stripe_4"];
+    XCTAssertNil([_storage dataForKey:key]);
+}
+
+- (void)testDiskCacheCleanupEvictsStripedEntries {
+    DFDiskCache *diskCache = [[DFDiskCache alloc] initWithEngine:_storage];
+    diskCache.capacity = 5000;
+    diskCache.cleanupRate = 0.5f;
+    for (NSUInteger i = 0; i < 10; i++) {
+        [diskCache setData:[self _dataWithLength:1000] forKey:[NSString stringWithFormat:@"_key_%lu", (unsigned long)i]];
+    }
+    XCTAssertEqual(diskCache.contentsCount, 10);
+    [diskCache cleanup];
+    XCTAssertTrue(_storage.contentsSize < 2500 + 100);
+    XCTAssertTrue(diskCache.statistics.evictionCount > 0);
+}
+
+#pragma mark - Helpers
+
+- (NSData *)_dataWithLength:(NSUInteger)length {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    arc4random_buf(data.mutableBytes, length);
+    return data;
+}
+
+@end
@@ -0,0 +1,69 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Alexander Grebenyuk (github.com/kean).
+
+/* dfcached serves a single cache to all the processes on the host (see DFCacheServer and DFCacheClient).
+
+ usage: dfcached [-n name] [-s socket path] [-d disk capacity, Mb] [-m memory capacity, Mb]
+ */
+
+#import "DFCache.h"
+#import <signal.h>
+#import <unistd.h>
+
+static void _DFCacheDaemonPrintUsage(void) {
+    fprintf(stderr, "usage: dfcached [-n name] [-s socket path] [-d disk capacity, Mb] [-m memory capacity, Mb]\n");
+}
+
+int main(int argc, char *argv[]) {
+    @autoreleasepool {
+        NSString *name = @"dfcached";
+        NSString *socketPath = @"/tmp/dfcached.sock";
+        unsigned long long diskCapacity = 100;
+        unsigned long long memoryCapacity = 64;
+        int option;
+        while ((option = getopt(argc, argv, "n:s:d:m:")) != -1) {
+            switch (option) {
+                case 'n': name = @(optarg); break;
+                case 's': socketPath = @(optarg); break;
+                case 'd': diskCapacity = strtoull(optarg, NULL, 10); break;
+                case 'm': memoryCapacity = strtoull(optarg, NULL, 10); break;
+                default:
+                    _DFCacheDaemonPrintUsage();
+                    return 1;
+            }
+        }
+
+        // The disk cache of the daemon is shared in case several daemons are started by mistake.
+        DFDiskCache *diskCache = [[DFDiskCache alloc] initWithName:name options:DFDiskCacheOptionShared];
+        diskCache.capacity = diskCapacity * 1024 * 1024;
+        diskCache.cleanupRate = 0.5f;
+        NSCache *memoryCache = [NSCache new];
+        memoryCache.name = name;
+        memoryCache.totalCostLimit = (NSUInteger)(memoryCapacity * 1024 * 1024);
+        DFCache *cache = [[DFCache alloc] initWithDiskCache:diskCache memoryCache:memoryCache];
+
+        DFCacheServer *server = [[DFCacheServer alloc] initWithCache:cache socketPath:socketPath];
+        NSError *error;
+        if (![server startWithError:&error]) {
+            fprintf(stderr, "dfcached: failed to listen on %s: %s\n", socketPath.fileSystemRepresentation, error.localizedDescription.UTF8String);
+            return 1;
+        }
+
+        // Removes the socket on termination.
+        NSMutableArray *signalSources = [NSMutableArray new];
+        for (NSNumber *signalNumber in @[ @(SIGINT), @(SIGTERM) ]) {
+            signal(signalNumber.intValue, SIG_IGN);
+            dispatch_source_t source = dispatch_source_create(DISPATCH_SOURCE_TYPE_SIGNAL, signalNumber.unsignedLongValue, 0, dispatch_get_main_queue());
+            dispatch_source_set_event_handler(source, ^{
+                [server stop];
+                exit(0);
+            });
+            dispatch_resume(source);
+            [signalSources addObject:source];
+        }
+        // Main run loop drives the cleanup timers of the cache and the signal sources.
+        [[NSRunLoop mainRunLoop] run];
+    }
+    return 0;
+}